@@ -1,3 +1,17 @@
 #!/bin/sh
 
-g++ src/*.cpp -Iinclude/ -o raytracer
+# Builds the headless command-line renderer, the render daemon, the
+# benchmarks and the ray log replayer, then checks every accelerator against
+# the flat one (see check_accelerators.sh). The GUI is built using qt_build.sh.
+# Run with PROFILING=1 to compile in timers which show where rendering time
+# goes (see Profiling.h).
+FLAGS="-O2 -std=gnu++98"
+if [ -n "$PROFILING" ] ; then
+	FLAGS="$FLAGS -DDW_RAYTRACER_PROFILING_ENABLED"
+fi
+g++ $FLAGS src/*.cpp src/cli/RaytracerCLI.cpp -Iinclude/ -lpthread -o raytracer-cli
+g++ $FLAGS src/*.cpp src/cli/RenderDaemon.cpp -Iinclude/ -lpthread -o raytracer-daemon
+g++ $FLAGS src/*.cpp src/cli/RaytracerBenchmark.cpp -Iinclude/ -lpthread -o raytracer-bench
+g++ $FLAGS src/*.cpp src/cli/RaytracerMicrobenchmark.cpp -Iinclude/ -lpthread -o raytracer-microbench
+g++ $FLAGS src/*.cpp src/cli/RaytracerReplay.cpp -Iinclude/ -lpthread -o raytracer-replay || exit 1
+./check_accelerators.sh
@@ -0,0 +1,14 @@
+#!/bin/sh
+
+# Checks the octree, BVH and grid find the same surfaces as testing every
+# triangle in turn. A small render of each terrain is recorded with the flat
+# accelerator, and its ray log replayed against the others. Exits with status
+# 1 if any query's result differs. build.sh runs this once it has built the
+# programs, so it must be run from the directory containing resources/.
+LOG=$(mktemp /tmp/raytracer-check.XXXXXX) || exit 1
+trap 'rm -f "$LOG" "$LOG.tga"' EXIT
+for TERRAIN in 1 2 3 ; do
+	./raytracer-cli accelerator=flat terrain=$TERRAIN width=120 height=90 \
+		--record-rays="$LOG" --output="$LOG.tga" > /dev/null || exit 1
+	./raytracer-replay --accelerator=octree,bvh,grid --repeat=1 "$LOG" || exit 1
+done
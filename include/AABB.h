@@ -1,6 +1,7 @@
 #ifndef DW_RAYTRACER_AABB_H
 #define DW_RAYTRACER_AABB_H
 
+#include <algorithm>
 #include "Vector3.h"
 #include "Ray.h"
 
@@ -47,6 +48,15 @@ public:
         return (intervalMin <= intervalMax);
     }
 
+    /* Grow box so it also contains another box. */
+    inline void expand(const AABB& other)
+    {
+        bounds[0] = Vector3(std::min(bounds[0].x, other.bounds[0].x),
+            std::min(bounds[0].y, other.bounds[0].y), std::min(bounds[0].z, other.bounds[0].z));
+        bounds[1] = Vector3(std::max(bounds[1].x, other.bounds[1].x),
+            std::max(bounds[1].y, other.bounds[1].y), std::max(bounds[1].z, other.bounds[1].z));
+    }
+
     inline bool contains(const Vector3& point) const
     {
         return (
@@ -0,0 +1,163 @@
+#ifndef DW_RAYTRACER_ACCELERATOR_H
+#define DW_RAYTRACER_ACCELERATOR_H
+
+#include <vector>
+#include <cstddef>
+#include "Shape.h"
+#include "AABB.h"
+#include "Octree.h"
+#include "Arena.h"
+#include "RenderSettings.h"
+#include "AcceleratorStatistics.h"
+
+namespace raytracer {
+
+/* Primitives (e.g. the triangles of a terrain) shared by every accelerator
+ * built over them, so trying another accelerator does not load the geometry
+ * again. The store cannot be changed once created. */
+class PrimitiveStore
+{
+
+public:
+    /* Takes ownership of the primitives. primitiveBounds[i] is a box which
+     * contains primitives[i], and 'boundingBox' contains all of them. If an
+     * arena is given, the primitives were created in it and are freed along
+     * with it, rather than deleted one by one. The store owns the arena. */
+    PrimitiveStore(const ShapeList& primitives, const std::vector<AABB>& primitiveBounds,
+        const AABB& boundingBox, Arena* arena = NULL);
+    ~PrimitiveStore();
+
+    unsigned int size() const;
+    const ShapeList& getPrimitives() const;
+    const std::vector<AABB>& getPrimitiveBounds() const;
+    const AABB& getBoundingBox() const;
+    /* Bytes used by the primitives and their bounds. */
+    size_t memoryUsed() const;
+
+private:
+    PrimitiveStore(const PrimitiveStore&);
+    PrimitiveStore& operator=(const PrimitiveStore&);
+
+    Arena* arena;
+    ShapeList primitives;
+    std::vector<AABB> primitiveBounds;
+    AABB boundingBox;
+
+};
+
+/* Settings accelerators are built with, which suit some scenes better than
+ * others (see AcceleratorTuning.h). Each type of accelerator only uses its
+ * own; the defaults are what each used before they could be changed. */
+struct AcceleratorParameters
+{
+    // Octree: shapes a node holds before it is split, and the deepest a
+    // node may be split to (zero for no limit)
+    unsigned int octreeNodeCapacity;
+    unsigned int octreeMaxDepth;
+    // BVH: most primitives a leaf holds
+    unsigned int bvhLeafPrimitives;
+    // Grid: average number of cells per primitive
+    float gridCellsPerPrimitive;
+
+    AcceleratorParameters();
+};
+
+/* Name of the type of accelerator followed by the parameters it uses, e.g.
+ * "bvh leaf-primitives=4". */
+std::string formatAcceleratorConfiguration(AcceleratorType type,
+    const AcceleratorParameters& parameters);
+
+/* Structure which speeds up finding the closest primitive of a store a ray
+ * hits. Accelerators are shapes, so can be put anywhere in a scene, but do
+ * not own the primitives they are built over. */
+class Accelerator : public Shape
+{
+
+public:
+    Accelerator(const PrimitiveStore* primitives, const AcceleratorParameters& parameters);
+
+    /* Build accelerator of the given type over the primitives, timing how
+     * long it takes. AUTO_ACCELERATOR builds whichever type and parameters
+     * trace rays looking down on the primitives fastest (see
+     * buildTunedAccelerator()), and its time includes trying the others. */
+    static Accelerator* build(AcceleratorType type, const PrimitiveStore* primitives,
+        const AcceleratorParameters& parameters = AcceleratorParameters());
+
+    /* Type of the accelerator, which is never AUTO_ACCELERATOR. */
+    virtual AcceleratorType getType() const = 0;
+    const PrimitiveStore* getPrimitives() const;
+    const AcceleratorParameters& getParameters() const;
+    /* Seconds taken to build the accelerator. */
+    double getBuildSeconds() const;
+    void setBuildSeconds(double seconds);
+    /* Bytes used by the accelerator, not including the primitives. */
+    virtual size_t memoryUsed() const = 0;
+    /* Nodes, depth, leaf occupancy, memory and SAH cost of the accelerator.
+     * Found by walking every node. */
+    virtual AcceleratorStatistics statistics() const = 0;
+
+protected:
+    const PrimitiveStore* primitives;
+    AcceleratorParameters parameters;
+    double buildSeconds;
+
+};
+
+/* Tests every primitive against each ray that enters their bounding box. */
+class FlatAccelerator : public Accelerator
+{
+
+public:
+    explicit FlatAccelerator(const PrimitiveStore* primitives);
+
+    virtual AcceleratorType getType() const;
+    virtual size_t memoryUsed() const;
+    virtual AcceleratorStatistics statistics() const;
+    virtual const Vector3& getCentre() const;
+    virtual bool hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const;
+    virtual bool shadowHit(const Ray& ray, float tMin, float tMax, float time, const Shape*& occludingShape) const;
+
+private:
+    Vector3 centre;
+
+};
+
+/* Primitives stored in an Octree, whose nodes are kept together in an
+ * arena. */
+class OctreeAccelerator : public Accelerator
+{
+
+public:
+    explicit OctreeAccelerator(const PrimitiveStore* primitives,
+        const AcceleratorParameters& parameters = AcceleratorParameters());
+    virtual ~OctreeAccelerator();
+
+    /* Use octree whose nodes were written by Octree::flatten() (with the
+     * default parameters), rather than inserting every primitive again.
+     * Returns NULL if the nodes are not a valid octree of the primitives. */
+    static OctreeAccelerator* fromFlattened(const PrimitiveStore* primitives,
+        const FlatOctreeNode* nodes, unsigned int numNodes);
+
+    Octree* getOctree() const;
+
+    virtual AcceleratorType getType() const;
+    virtual size_t memoryUsed() const;
+    virtual AcceleratorStatistics statistics() const;
+    virtual const Vector3& getCentre() const;
+    virtual bool hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const;
+    virtual bool shadowHit(const Ray& ray, float tMin, float tMax, float time, const Shape*& occludingShape) const;
+
+private:
+    /* Takes ownership of the arena the octree was created in. */
+    OctreeAccelerator(const PrimitiveStore* primitives, Arena* arena, Octree* octree);
+    OctreeAccelerator(const OctreeAccelerator&);
+    OctreeAccelerator& operator=(const OctreeAccelerator&);
+
+    Arena* arena;
+    Octree* octree;
+
+};
+
+}
+
+#endif
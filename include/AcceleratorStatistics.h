@@ -0,0 +1,65 @@
+#ifndef DW_RAYTRACER_ACCELERATORSTATISTICS_H
+#define DW_RAYTRACER_ACCELERATORSTATISTICS_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+#include "AABB.h"
+
+namespace raytracer {
+
+/* Shape of an accelerator's tree (or grid), for judging how well it was
+ * built: how many nodes it has and how deep they go, how many primitives
+ * its leaves hold and an estimate of how costly it is to trace rays
+ * through using the surface area heuristic (SAH). */
+struct AcceleratorStatistics
+{
+    /* Leaves holding more primitives than this are counted together. */
+    static const unsigned int MAX_COUNTED_OCCUPANCY = 32;
+
+    unsigned int numNodes; // including leaves
+    unsigned int numLeaves;
+    // nodesAtDepth[d] is the number of nodes at depth d (the root is at 0)
+    std::vector<unsigned int> nodesAtDepth;
+    // leafOccupancy[n] is the number of leaves holding n primitives (the
+    // last holds those with MAX_COUNTED_OCCUPANCY or more)
+    std::vector<unsigned int> leafOccupancy;
+    unsigned int maxLeafPrimitives;
+    // Primitives held by all leaves together, which is more than there are
+    // primitives if leaves share them (e.g. grid cells)
+    uint64_t primitiveReferences;
+    size_t memoryBytes;
+    // Expected number of nodes visited plus primitives tested by a ray
+    // crossing the root's box, if it visits every node whose box it
+    // crosses. Comparable between every kind of accelerator.
+    double sahCost;
+
+    /* Statistics of an empty tree whose root has the given box. */
+    explicit AcceleratorStatistics(const AABB& rootBounds);
+
+    /* Add a node to the statistics. Leaves are the nodes which hold
+     * primitives, rather than other nodes. */
+    void addNode(const AABB& bounds, unsigned int depth, bool isLeaf,
+        unsigned int numPrimitives = 0);
+
+    unsigned int maxDepth() const;
+    double meanLeafPrimitives() const;
+
+    /* Summary, depth histogram and leaf occupancy on three lines, each
+     * starting with 'indent'. */
+    std::string format(const std::string& indent = "") const;
+    /* Statistics as a JSON object. */
+    std::string formatJSON() const;
+
+private:
+    float rootArea;
+
+};
+
+/* Surface area of a box. */
+float surfaceArea(const AABB& box);
+
+}
+
+#endif
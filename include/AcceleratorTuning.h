@@ -0,0 +1,48 @@
+#ifndef DW_RAYTRACER_ACCELERATORTUNING_H
+#define DW_RAYTRACER_ACCELERATORTUNING_H
+
+#include <vector>
+#include "Accelerator.h"
+#include "Camera.h"
+
+namespace raytracer {
+
+/* Picking an accelerator for a set of primitives by trying several. Which
+ * type and build parameters are fastest depends on the primitives (e.g. a
+ * terrain of high peaks needs a different tree to a shallow one), so rather
+ * than guessing, each candidate is built and timed on a small set of probe
+ * rays, which should be like the rays that will be traced. */
+
+/* Type of accelerator and the parameters to build it with. */
+struct AcceleratorConfiguration
+{
+    AcceleratorType type;
+    AcceleratorParameters parameters;
+
+    AcceleratorConfiguration(AcceleratorType type,
+        const AcceleratorParameters& parameters = AcceleratorParameters()) :
+        type(type), parameters(parameters)
+    {
+    }
+};
+
+/* Every configuration buildTunedAccelerator() tries: a few node capacities
+ * and depth limits of octree, leaf sizes of BVH and grid resolutions. */
+std::vector<AcceleratorConfiguration> tuningCandidates();
+
+/* Build an accelerator over the primitives with each candidate, and keep
+ * the one which traces the probe rays fastest (the others are deleted). If
+ * there are no probe rays, builds the default octree. */
+Accelerator* buildTunedAccelerator(const PrimitiveStore* primitives,
+    const std::vector<Ray>& probeRays);
+
+/* Rays from the camera through a grid of 'raysPerSide' x 'raysPerSide'
+ * points spread across its view, appended to 'rays'. */
+void addCameraProbeRays(Camera camera, unsigned int raysPerSide, std::vector<Ray>& rays);
+/* Rays looking down on the box at an angle, aimed at a grid of points
+ * across it, for tuning when there is no camera to take rays from. */
+std::vector<Ray> overheadProbeRays(const AABB& box, unsigned int raysPerSide = 32);
+
+}
+
+#endif
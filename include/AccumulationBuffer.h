@@ -0,0 +1,92 @@
+#ifndef DW_RAYTRACER_ACCUMULATIONBUFFER_H
+#define DW_RAYTRACER_ACCUMULATIONBUFFER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "Colour.h"
+#include "Framebuffer.h"
+#include "RenderSettings.h"
+
+namespace raytracer {
+
+/* Sum of every sample taken for each pixel of a render, along with how
+ * many samples have been taken. Since no sample is thrown away, a render
+ * which was stopped can carry on from where it was, and a finished render
+ * can be given more samples. The buffer can be saved to and loaded from
+ * a checkpoint file, so this also works across runs of the program. */
+class AccumulationBuffer
+{
+
+public:
+    AccumulationBuffer();
+
+    /* Discard all samples and resize buffer for a render with the given
+     * settings. */
+    void reset(const RenderSettings& settings);
+    /* Returns true if samples in the buffer can be reused for a render with
+     * the given settings. This is the case when the image is the same apart
+     * from the number of samples, and the sample positions already used
+     * match those the new settings would use (i.e. random multisampling, or
+     * the same number of samples as before). */
+    bool canContinue(const RenderSettings& settings) const;
+    /* Change settings of a render which canContinue() said can be
+     * continued, keeping every sample taken so far. */
+    void continueWith(const RenderSettings& settings);
+    const RenderSettings& getSettings() const;
+
+    int getWidth() const;
+    int getHeight() const;
+
+    /* Record sample of pixel (x, y). 'hit' is false if its ray did not hit
+     * anything, in which case 'colour' is ignored. */
+    void addSample(int x, int y, const Colour& colour, bool hit);
+    unsigned int samplesTaken(int x, int y) const;
+    /* Samples still to be taken for pixel (x, y) to have as many as the
+     * settings ask for. */
+    unsigned int samplesNeeded(int x, int y) const;
+    /* Number of pixels which have every sample they need. */
+    unsigned int pixelsComplete() const;
+    bool isComplete() const;
+    /* Bytes used by the buffer's pixels. */
+    size_t memoryUsed() const;
+
+    /* Final colour of pixel (x, y): the average of the samples which hit
+     * something, or the background colour if none did. */
+    Colour resolve(int x, int y) const;
+    /* Write final colour of every pixel with at least one sample into
+     * target, at the same position. */
+    void resolveInto(Framebuffer* target) const;
+
+    /* Save buffer to checkpoint file, along with a key identifying the
+     * scene it was rendered from (see checkpointKey()). The file is
+     * replaced atomically, so a crash while saving leaves the previous
+     * checkpoint intact. Returns false if it could not be written. */
+    bool save(const std::string& filename, const std::string& sceneKey = "") const;
+    /* Load buffer from checkpoint file written by save(). Returns false,
+     * leaving the buffer unchanged, if the file is missing or invalid, or
+     * was saved with a different scene key. */
+    bool load(const std::string& filename, const std::string& sceneKey = "");
+
+private:
+    struct AccumulatedPixel
+    {
+        float r, g, b; // sum of colours of samples which hit something
+        unsigned int samples;
+        unsigned int hits;
+    };
+
+    unsigned int pixelIndex(int x, int y) const;
+
+    /* Recount pixels which have all the samples they need. */
+    void countCompletePixels();
+
+    RenderSettings settings;
+    std::vector<AccumulatedPixel> pixels;
+    unsigned int numPixelsComplete;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef DW_RAYTRACER_ARENA_H
+#define DW_RAYTRACER_ARENA_H
+
+#include <vector>
+#include <cstddef>
+
+namespace raytracer {
+
+/* Hands out memory from large blocks, one allocation after another, and
+ * frees it all at once when deleted. Objects created in the same arena
+ * (using "new (arena) Type(...)") sit next to each other in the order they
+ * were created, and freeing thousands of them costs one free() per block.
+ *
+ * Objects in an arena are never destroyed individually: their destructors
+ * are not called, so they must not own anything which needs freeing. An
+ * arena must only be used by one thread at a time. */
+class Arena
+{
+
+public:
+    static const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+    /* Size of a transparent huge page on x86-64 Linux. */
+    static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    /* If 'useHugePages' is true, blocks of at least HUGE_PAGE_SIZE are
+     * aligned to it and the kernel is asked to back them with huge pages,
+     * so traversing what is stored in them causes fewer TLB misses. */
+    explicit Arena(size_t blockSize = DEFAULT_BLOCK_SIZE, bool useHugePages = false);
+    ~Arena();
+
+    /* Returns NULL if memory could not be allocated. */
+    void* allocate(size_t bytes, size_t alignment = 16);
+    /* Bytes reserved by the arena, including any not handed out yet. */
+    size_t memoryUsed() const;
+
+private:
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+
+    /* Start a new block with room for at least 'bytes'. */
+    bool addBlock(size_t bytes);
+
+    size_t blockSize;
+    bool useHugePages;
+    std::vector<void*> blocks;
+    char* next; // next free byte of the newest block
+    char* end; // end of the newest block
+    size_t bytesReserved;
+
+};
+
+}
+
+/* Create objects in an arena. The matching delete is only called by the
+ * compiler, if a constructor throws. */
+void* operator new(size_t bytes, raytracer::Arena& arena);
+void operator delete(void* pointer, raytracer::Arena& arena);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef DW_RAYTRACER_BVHACCELERATOR_H
+#define DW_RAYTRACER_BVHACCELERATOR_H
+
+#include "Accelerator.h"
+
+namespace raytracer {
+
+/* Bounding volume hierarchy: a binary tree of boxes, each holding the boxes
+ * of its two children, with a few primitives in each leaf. Primitives are
+ * split between the children at the middle of the longest axis of their
+ * centres, so the tree adapts to how the primitives are spread out. */
+class BVHAccelerator : public Accelerator
+{
+
+public:
+    /* Most primitives a leaf holds, unless the parameters say otherwise. */
+    static const unsigned int MAX_LEAF_PRIMITIVES = 4;
+
+    explicit BVHAccelerator(const PrimitiveStore* primitives,
+        const AcceleratorParameters& parameters = AcceleratorParameters());
+
+    virtual AcceleratorType getType() const;
+    virtual size_t memoryUsed() const;
+    virtual AcceleratorStatistics statistics() const;
+    virtual const Vector3& getCentre() const;
+    virtual bool hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const;
+    virtual bool shadowHit(const Ray& ray, float tMin, float tMax, float time, const Shape*& occludingShape) const;
+
+private:
+    /* Nodes are stored depth first, so an interior node's first child
+     * always follows it. */
+    struct Node
+    {
+        AABB bounds;
+        // Leaves: index of first primitive in 'order'. Interior nodes:
+        // index of second child.
+        unsigned int index;
+        unsigned int numPrimitives; // zero for interior nodes
+    };
+
+    /* Build node for primitives order[start] to order[end - 1], returning
+     * its index. */
+    unsigned int buildNode(unsigned int start, unsigned int end, unsigned int depth);
+    /* Add node and those below it to 'statistics'. */
+    void addNodeStatistics(unsigned int index, unsigned int depth,
+        AcceleratorStatistics& statistics) const;
+
+    std::vector<Node> nodes;
+    // Indices of the store's primitives, in the order the leaves use them
+    std::vector<unsigned int> order;
+    Vector3 centre;
+    unsigned int maxLeafPrimitives;
+
+};
+
+}
+
+#endif
@@ -18,6 +18,8 @@ public:
 	/* Remove shape which is currently a child of the bounding shape.
 	 * If given shape is not a child, then it is silently ignored. */
 	bool removeShape(Shape* shapeToRemove);
+	/* Number of shapes which are children of the bounding shape. */
+	unsigned int numShapes() const;
 
     virtual const Vector3& getCentre() const;
     virtual bool hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const;
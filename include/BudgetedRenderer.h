@@ -0,0 +1,130 @@
+#ifndef DW_RAYTRACER_BUDGETEDRENDERER_H
+#define DW_RAYTRACER_BUDGETEDRENDERER_H
+
+#include <vector>
+#include <string>
+#include "Raytracer.h"
+#include "AccumulationBuffer.h"
+#include "GBuffer.h"
+#include "TileRenderer.h"
+
+namespace raytracer {
+
+/* What a render with a time budget achieved. */
+struct BudgetReport
+{
+    double budgetSeconds;
+    // Time taken in all, and by the pre-pass
+    double seconds;
+    double prePassSeconds;
+    // Passes over the image after the pre-pass, and the number of times
+    // samples were shared out between tiles
+    unsigned int rounds;
+    unsigned int allocations;
+    // True if stop() was called before the deadline
+    bool stopped;
+    // Samples each pixel has, including those it had before the render
+    double meanSamples;
+    unsigned int minSamples;
+    unsigned int maxSamples;
+    // Fewest samples of any pixel in each tile, row by row, 'tilesAcross'
+    // to a row
+    std::vector<unsigned int> tileSamples;
+    unsigned int tilesAcross;
+
+    BudgetReport();
+
+    /* Summary on one line, starting with 'indent'. */
+    std::string format(const std::string& indent = "") const;
+    /* Report as a JSON object. */
+    std::string formatJSON() const;
+};
+
+/* Renders as good an image as it can in a given amount of time, rather than
+ * taking a fixed number of samples per pixel. A pre-pass takes a couple of
+ * samples of every pixel, measuring how long each tile takes to sample and
+ * how much its samples vary. The time left is then shared out between the
+ * tiles, giving noisy tiles which are quick to sample the most samples:
+ * each tile gets a number in proportion to the standard deviation of its
+ * samples over the square root of their cost, which minimises the expected
+ * error of the image. Samples are taken a pass over the image at a time, so
+ * every tile has been improved when the deadline comes, and are shared out
+ * again after each pass using the time actually taken.
+ *
+ * Samples are added to an accumulation buffer, whose settings describe the
+ * image rendered. They must use random multisampling, and their number of
+ * samples is the most any pixel is given. Samples already in the buffer are
+ * kept, so a render can be given more time later. */
+class BudgetedRenderer
+{
+
+public:
+    /* Tiles the image is shared out in. */
+    static const int TILE_SIZE = 16;
+    /* Samples taken of each pixel by the pre-pass. */
+    static const unsigned int PRE_PASS_SAMPLES = 2;
+
+    /* The G-buffer is used as by renderTile(), and may be NULL. */
+    BudgetedRenderer(Raytracer* renderer, AccumulationBuffer* buffer,
+        GBuffer* gbuffer = NULL);
+
+    /* Take samples until 'budgetSeconds' have passed (a little more if a
+     * tile's samples take longer than expected), every pixel has as many as
+     * it may have, or stop() is called. Each tile is resolved into 'target'
+     * (if not NULL) as it is sampled, so it always holds the best image so
+     * far. Returns false if the buffer's settings do not use random
+     * multisampling. */
+    bool render(double budgetSeconds, Framebuffer* target, BudgetReport& report);
+    /* Make render() return once the tile it is sampling is done, or at once
+     * if it has not started yet (until resume() is called). May be
+     * called from any thread. */
+    void stop();
+    /* Undo stop(), so render() takes samples again. */
+    void resume();
+    /* Use a different G-buffer (or none) for later renders. */
+    void setGBuffer(GBuffer* gbuffer);
+
+private:
+    struct TileState
+    {
+        Tile tile;
+        // Time taken and samples taken by this render, to find the cost
+        // of a sample
+        double seconds;
+        uint64_t samples;
+        // Sum of the variance of each pixel's luminance, and the number of
+        // pixels it was measured for
+        double varianceSum;
+        unsigned int variancePixels;
+        // Fewest samples of any of the tile's pixels, and how many it is
+        // to be given
+        unsigned int samplesTaken;
+        unsigned int samplesTarget;
+    };
+
+    BudgetedRenderer(const BudgetedRenderer&);
+    BudgetedRenderer& operator=(const BudgetedRenderer&);
+
+    /* Give every pixel of the tile which has fewer samples than the most it
+     * may have one more. During the pre-pass, the luminance of each pixel's
+     * first sample is kept in 'firstLuminance' to find its variance. */
+    void sampleTile(TileState& state, std::vector<float>* firstLuminance,
+        Framebuffer* target);
+    /* Share out the samples which can be taken in the given time. */
+    void allocateSamples(double remainingSeconds);
+    /* Seconds one more sample of every pixel of the tile is expected to
+     * take. */
+    double expectedPassSeconds(const TileState& state) const;
+    bool stopRequested() const;
+
+    Raytracer* renderer;
+    AccumulationBuffer* buffer;
+    GBuffer* gbuffer;
+    std::vector<TileState> tiles;
+    bool stopping;
+
+};
+
+}
+
+#endif
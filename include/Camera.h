@@ -26,6 +26,9 @@ public:
 
     Ray getRayToPixel(float pixelX, float pixelY);
 
+    const Vector3& getPosition() const;
+    const Rect& getViewingRectangle() const;
+    float getDistance() const;
     bool isOrthographic() const;
     void setOrthographic(bool useOrthographicProjection);
 
@@ -2,6 +2,8 @@
 #define DW_RAYTRACER_COMMON_H
 
 #include <sstream>
+#include <stdint.h>
+#include <time.h>
 #include "Vector3.h"
 
 namespace raytracer {
@@ -18,6 +20,28 @@ namespace common
 
     /* Generate floating point number >= min && <= max. */
     float randomFloat(float min, float max);
+    /* Return wall-clock time in seconds, for timing how long operations take. */
+    double wallClockSeconds();
+    /* Read a counter which ticks at a constant rate and costs far less to
+     * read than the clock, for timing very short operations: the time stamp
+     * counter on x86, otherwise a monotonic clock in nanoseconds. Divide by
+     * cyclesPerSecond() to convert counts to seconds. */
+    inline uint64_t cycleCount()
+    {
+#if defined(__i386__) || defined(__x86_64__)
+        return __builtin_ia32_rdtsc();
+#else
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (static_cast<uint64_t>(now.tv_sec) * 1000000000u) + now.tv_nsec;
+#endif
+    }
+    /* Rate at which cycleCount() ticks, measured against the wall clock the
+     * first time it is called (which takes a few tens of milliseconds). */
+    double cyclesPerSecond();
+    /* Escape text so it can be written between quotes in a JSON string:
+     * quotes, backslashes and control characters are escaped. */
+    std::string escapeJSON(const std::string& text);
     
     /* Convert type T into a string. */
 	template<typename T>
@@ -0,0 +1,94 @@
+#ifndef DW_RAYTRACER_COMPILEDSCENE_H
+#define DW_RAYTRACER_COMPILEDSCENE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+#include "Image.h"
+#include "Octree.h"
+#include "ShapeLoaders.h"
+#include "MemoryReport.h"
+
+namespace raytracer {
+
+/* Scene resources stored on disk in the form they are used in memory:
+ * decoded images, terrain vertices and triangles, and each terrain's
+ * flattened octree. Loading a scene from one avoids decoding images and
+ * inserting every triangle into an octree again.
+ *
+ * The file is mapped into memory with a single mmap() and only read.
+ * Everything in it is stored at an offset from the start of the file
+ * rather than by pointer, so it can be used wherever it is mapped.
+ * Images created from a compiled scene refer to its pixels directly, so
+ * every process rendering the same scene on a host shares the decoded
+ * images, and they must not be used after it is deleted. Terrain is not
+ * shared: each process copies its vertices and triangles and rebuilds
+ * the octree from the flattened nodes, which is still far quicker than
+ * inserting every triangle again. */
+class CompiledScene
+{
+
+public:
+    /* Change whenever the file format or anything stored in it changes. */
+    static const unsigned int VERSION = 3;
+
+    ~CompiledScene();
+
+    /* Map compiled scene file into memory. Returns NULL if the file could
+     * not be read, was written by a different version or was compiled from
+     * resources other than those identified by 'signature'. */
+    static CompiledScene* open(const std::string& filename, uint64_t signature);
+    /* Write compiled scene file. An image may be NULL and a terrain may have
+     * no vertices if they could not be loaded. Octrees are those of the
+     * terrain with the same index. Returns false if it could not be written. */
+    static bool write(const std::string& filename, uint64_t signature,
+        const std::string& resourceHash, const std::vector<Image*>& images,
+        const std::vector<shapeloaders::TerrainGeometry>& terrains,
+        const std::vector<std::vector<FlatOctreeNode> >& octrees);
+
+    unsigned int numImages() const;
+    unsigned int numTerrains() const;
+    /* Hash of the contents of the files the scene was compiled from. */
+    const std::string& getResourceHash() const;
+    /* Add the mapped pixels of each image, the vertices and triangles of
+     * each terrain and its octree, and the rest of the file (headers and
+     * padding), to the "compiled scene" subsystem of the report. */
+    void reportMemory(MemoryReport& report) const;
+
+    /* Create image which uses the pixels of stored image, or return NULL
+     * if the image could not be loaded when the scene was compiled. */
+    Image* createImage(unsigned int index) const;
+    /* Copy geometry of stored terrain and point 'nodes' at its flattened
+     * octree, which Octree::fromFlattened() copies in turn.
+     * Returns false if the terrain could not be loaded when the scene was
+     * compiled. */
+    bool getTerrain(unsigned int index, shapeloaders::TerrainGeometry& geometry,
+        const FlatOctreeNode*& nodes, unsigned int& numNodes) const;
+
+private:
+    struct Header;
+    struct ImageEntry;
+    struct TerrainEntry;
+
+    CompiledScene(const char* data, size_t size);
+    CompiledScene(const CompiledScene&);
+    CompiledScene& operator=(const CompiledScene&);
+
+    /* Check every section of the file lies within it and is aligned. */
+    bool isValid() const;
+    bool sectionInFile(uint64_t offset, uint64_t size) const;
+
+    const Header* header() const;
+    const ImageEntry* imageEntries() const;
+    const TerrainEntry* terrainEntries() const;
+
+    const char* data; // start of mapped file
+    size_t size;
+    std::string resourceHash;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef DW_RAYTRACER_CONTENTHASH_H
+#define DW_RAYTRACER_CONTENTHASH_H
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+#include "Vector3.h"
+#include "Colour.h"
+
+namespace raytracer {
+
+/* 64-bit FNV-1a hash built up from the values added to it. The same values
+ * added in the same order always give the same hash, across runs of the
+ * program, so it can be used to identify content stored on disk. */
+class ContentHash
+{
+
+public:
+    ContentHash();
+
+    void addBytes(const void* data, size_t length);
+    void addInt(int value);
+    void addFloat(float value);
+    void addString(const std::string& value);
+    void addVector(const Vector3& value);
+    void addColour(const Colour& value);
+    /* Add entire contents of file. Returns false if it could not be read. */
+    bool addFile(const std::string& filename);
+    /* Add size and modification time of file, which is much quicker than
+     * adding its contents but still changes whenever the file is edited.
+     * Returns false if the file does not exist. */
+    bool addFileStatus(const std::string& filename);
+
+    uint64_t value() const;
+    /* Hash as 16 hexadecimal digits. */
+    std::string toHex() const;
+
+private:
+    uint64_t hash;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef DW_RAYTRACER_COSTMAP_H
+#define DW_RAYTRACER_COSTMAP_H
+
+#include <string>
+#include <vector>
+#include "Image.h"
+#include "TileRenderer.h"
+#include "RayCost.h"
+
+namespace raytracer {
+
+/* How much work went into each pixel of a render, for finding the parts of
+ * a scene which are expensive to render (e.g. where rays graze the terrain
+ * and visit many octree nodes). Each metric can be written as a false
+ * colour image to look at or as a floating point image (PFM) to process. */
+class CostMap
+{
+
+public:
+    enum Metric
+    {
+        NODES_VISITED = 0, // accelerator nodes, grid cells and bounding shapes
+        PRIMITIVE_TESTS,
+        SHADOW_RAYS,
+        SECONDARY_RAYS, // reflected and refracted rays
+        PIXEL_TIME // microseconds
+    };
+    static const unsigned int NUM_METRICS = 5;
+
+    CostMap(int width, int height);
+
+    /* Short name of metric, used in filenames. */
+    static const char* metricName(Metric metric);
+
+    int getWidth() const;
+    int getHeight() const;
+    float get(int x, int y, Metric metric) const;
+    void set(int x, int y, Metric metric, float value);
+    float maximum(Metric metric) const;
+    float mean(Metric metric) const;
+    /* Value which the given fraction (between 0 and 1) of pixels are below. */
+    float percentile(Metric metric, float fraction) const;
+
+    /* Image of metric where black is no work and colours run through blue,
+     * green and yellow to red for the most costly pixels (the top 1%).
+     * Must be deleted by the caller. */
+    Image* falseColour(Metric metric) const;
+    /* Write metric to a greyscale PFM file. Returns false if the file could
+     * not be written. */
+    bool writePFM(const std::string& filename, Metric metric) const;
+    /* Write every metric as "<prefix>-<name>.tga" and "<prefix>-<name>.pfm".
+     * Returns false if any file could not be written. */
+    bool writeAll(const std::string& prefix) const;
+
+private:
+    // accessed values[(((row * width) + column) * NUM_METRICS) + metric]
+    std::vector<float> values;
+    int width;
+    int height;
+
+};
+
+/* Render tile as renderTile() does (without a G-buffer), recording the cost
+ * of each pixel (x, y) at (x, y) in 'costs', which must be the size of the
+ * whole image. Should only be used by one thread at a time per renderer,
+ * as the numbers of shadow and secondary rays are read from its counters. */
+void renderCostedTile(Raytracer* renderer, const RenderSettings& settings,
+    const Tile& tile, Framebuffer* target, CostMap* costs);
+
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef DW_RAYTRACER_DEMOSCENE_H
+#define DW_RAYTRACER_DEMOSCENE_H
+
+#include "Raytracer.h"
+#include "BoundingShape.h"
+#include "Sphere.h"
+#include "ShapeLoaders.h"
+#include "Camera.h"
+#include "ResourceManager.h"
+#include "TerrainHeightTexture.h"
+#include "Line.h"
+#include "Raytracer.h"
+#include "Common.h"
+#include "Octree.h"
+#include "RenderSettings.h"
+#include "ContentHash.h"
+#include "CompiledScene.h"
+#include "LazyShape.h"
+#include "Accelerator.h"
+#include "MemoryReport.h"
+
+namespace raytracer {
+
+/* This contains all the ifnormation required to render the demo scene,
+ * with each possible viewpoint and variant of terrain. */
+struct DemoScene
+{
+	Raytracer* renderer; // object which performs the actual rendering
+	std::vector<Camera> cameras; // every viewpoint the scene has
+	// Contains each terrain to be rendered, with every type of accelerator:
+	// the variant at index (terrain * NUM_ACCELERATOR_TYPES) + type. They are
+	// LazyShapes, which are only built when a ray first reaches them, and
+	// the variants of a terrain share one copy of its triangles.
+	ShapeList terrainVariants;
+	// Human-readable name of each terrain
+	std::vector<std::string> terrainNames;
+	// An element at index i is a LazyShape holding lines that visualise
+	// the octree used to partition terrain i, built when first shown.
+	ShapeList octreeLines;
+	// All lights in scene
+	std::vector<PointLight> lights;
+	// Spheres in the scene, which can be moved or have their material changed
+	std::vector<Sphere*> spheres;
+	// Box which contains every shape in the scene
+	AABB boundary;
+	// Hash of the contents of every file the scene was loaded from
+	std::string resourceHash;
+	// Compiled scene the scene's images were loaded from, or NULL if they
+	// were loaded from their own files. Delete it only once the scene is
+	// no longer being rendered.
+	CompiledScene* compiledScene;
+};
+
+/* Build the demo scene. If a compiled scene filename is given and the file
+ * is up to date, the scene is loaded from it; otherwise the scene is built
+ * from its resource files and then compiled to that file, so it loads
+ * quickly next time. If any resource could not be loaded, the files which
+ * failed are printed and the scene's renderer is NULL. */
+DemoScene constructDemoScene(const std::string& compiledSceneFilename = "");
+/* Configure the scene's renderer (camera, effects, terrain, lights and
+ * octree visualisation) using the given settings. Returns false if the
+ * settings refer to a camera or terrain the scene does not have. */
+bool applyRenderSettings(DemoScene& scene, const RenderSettings& settings);
+/* The two halves of applyRenderSettings(). The first changes which
+ * terrain is in the scene's shared shape hierarchy, so must not be
+ * called while the scene is being rendered. The second only changes
+ * the given raytracer, which may be a copy of the scene's renderer. */
+bool applySceneGeometry(DemoScene& scene, const RenderSettings& settings);
+bool configureRenderer(const DemoScene& scene, const RenderSettings& settings,
+	Raytracer* renderer);
+/* Which terrain and accelerator the settings select. It is the same for
+ * all settings that need the same geometry to be in the scene (i.e. can
+ * be rendered without applySceneGeometry() being called in between).
+ * Unlike primaryRayGeometryHash(), it says nothing about the scene's
+ * contents. */
+std::string terrainSelectionKey(const RenderSettings& settings);
+/* Accelerator the settings render the terrain with, or NULL if it has not
+ * been built yet. */
+const Accelerator* builtTerrainAccelerator(const DemoScene& scene,
+	const RenderSettings& settings);
+/* As above, but builds the accelerator now if it has not been built. NULL
+ * if it could not be built. */
+const Accelerator* terrainAccelerator(const DemoScene& scene,
+	const RenderSettings& settings);
+/* Add the memory the scene uses to the report: its images, meshes and
+ * textures (see ResourceManager::reportMemory()), the triangles of each
+ * terrain and every accelerator built over them, octree lines, spheres
+ * and the compiled scene it was loaded from, if any. Terrain which has
+ * not been built yet is not counted, and is not built. */
+void reportSceneMemory(const DemoScene& scene, MemoryReport& report);
+/* Hash of everything which determines the image rendered with the given
+ * settings: the files the scene was loaded from, its spheres and their
+ * materials, the camera, the enabled lights and the settings themselves.
+ * Renders with the same key give the same image, so can be cached. */
+std::string renderCacheKey(const DemoScene& scene, const RenderSettings& settings);
+/* Hash of everything in the scene which determines what primary rays hit:
+ * the files it was loaded from, its spheres and their materials, and the
+ * camera the settings pick. The settings themselves are left out, as
+ * GBuffer::prepare() compares those. */
+std::string primaryRayGeometryHash(const DemoScene& scene, const RenderSettings& settings);
+/* As renderCacheKey(), but leaving out the number of samples, so a
+ * checkpoint saved with this key can be resumed with more samples. */
+std::string checkpointKey(const DemoScene& scene, const RenderSettings& settings);
+
+}
+
+#endif
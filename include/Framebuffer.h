@@ -0,0 +1,30 @@
+#ifndef DW_RAYTRACER_FRAMEBUFFER_H
+#define DW_RAYTRACER_FRAMEBUFFER_H
+
+#include "Colour.h"
+
+namespace raytracer {
+
+/* Interface to a 2D grid of pixels the renderer writes its output to. */
+class Framebuffer
+{
+
+public:
+    virtual ~Framebuffer() { }
+
+    virtual bool set(int x, int y, const Colour& colour) = 0;
+    virtual const Colour& get(int x, int y) const = 0;
+    virtual int getWidth() const = 0;
+    virtual int getHeight() const = 0;
+
+    /* Called by the renderer once rows [firstRow, firstRow + numRows)
+     * have been completely rendered. Framebuffers which page their
+     * contents out to disk use this to flush and evict finished rows.
+     * Does nothing by default. */
+    virtual void rowsFinished(int firstRow, int numRows) { }
+
+};
+
+}
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef DW_RAYTRACER_GBUFFER_H
+#define DW_RAYTRACER_GBUFFER_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "Raytracer.h"
+#include "RenderSettings.h"
+
+namespace raytracer {
+
+/* Cache of the surface hit by every primary ray of a render (position,
+ * normal, texture coordinates, shape, material and surface colour). If
+ * only the lights or effects change, the next render can shade the cached
+ * surfaces again instead of tracing every primary ray. Secondary rays
+ * (reflection, refraction and shadows) are still cast, since the light
+ * they bring back depends on the lights and effects.
+ *
+ * The cached shapes must not be changed or deleted while the buffer
+ * refers to them. */
+class GBuffer
+{
+
+public:
+    /* Default limit on memory used by the buffer. */
+    static const size_t DEFAULT_MAX_BYTES = 512 * 1024 * 1024;
+
+    explicit GBuffer(size_t maxBytes = DEFAULT_MAX_BYTES);
+
+    /* Make buffer ready to cache surfaces for a render with the given
+     * settings, of the scene identified by 'sceneKey' (see
+     * primaryRayGeometryHash()), which must change whenever the shapes do. If
+     * the render's settings, scene and sampling match those of the cached
+     * surfaces, they are kept; otherwise they are thrown away. Returns
+     * false if the render would need more memory than the buffer is
+     * allowed, in which case nothing is cached. */
+    bool prepare(const RenderSettings& settings, const std::string& sceneKey);
+    /* Throw away every cached surface. */
+    void clear();
+
+    /* Retrieve cached surface for sample of pixel (x, y). Returns false if
+     * the sample has not been cached. */
+    bool lookup(int x, int y, unsigned int sampleIndex, SurfaceHit& hit) const;
+    /* Cache surface for sample of pixel (x, y), or record that it missed
+     * everything if hit is NULL. Ignored if the sample is not in the
+     * render the buffer was prepared for. */
+    void store(int x, int y, unsigned int sampleIndex, const SurfaceHit* hit);
+
+    /* Number of samples cached. */
+    unsigned int samplesCached() const;
+    size_t memoryUsed() const;
+
+private:
+    /* Compact form of SurfaceHit, holding only what is needed to light it. */
+    struct CachedSurface
+    {
+        Vector3 point;
+        Vector3 normal;
+        Vector3 rayDirection;
+        Vector2 texCoord;
+        Colour objectColour;
+        const Shape* shape;
+        const Material* material;
+        unsigned char state; // see the SURFACE_ constants in GBuffer.cpp
+    };
+
+    /* Index of sample in cache, or -1 if it is out of range. */
+    long sampleIndex(int x, int y, unsigned int sample) const;
+
+    size_t maxBytes;
+    // Settings and scene which determine the surfaces hit by primary rays
+    std::string geometryKey;
+    int width;
+    int height;
+    unsigned int samplesPerPixel;
+    std::vector<CachedSurface> surfaces;
+    unsigned int numCached;
+
+};
+
+}
+
+#endif
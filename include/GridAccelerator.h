@@ -0,0 +1,53 @@
+#ifndef DW_RAYTRACER_GRIDACCELERATOR_H
+#define DW_RAYTRACER_GRIDACCELERATOR_H
+
+#include "Accelerator.h"
+
+namespace raytracer {
+
+/* Uniform grid of cells over the primitives' bounding box, each listing the
+ * primitives which overlap it. Rays walk through the cells they cross in
+ * order (Amanatides & Woo), so can stop at the first cell with a hit. */
+class GridAccelerator : public Accelerator
+{
+
+public:
+    /* Average number of cells per primitive, unless the parameters say
+     * otherwise. */
+    static const float CELLS_PER_PRIMITIVE;
+    /* Most cells along each axis. */
+    static const int MAX_RESOLUTION = 128;
+
+    explicit GridAccelerator(const PrimitiveStore* primitives,
+        const AcceleratorParameters& parameters = AcceleratorParameters());
+
+    virtual AcceleratorType getType() const;
+    virtual size_t memoryUsed() const;
+    virtual AcceleratorStatistics statistics() const;
+    virtual const Vector3& getCentre() const;
+    virtual bool hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const;
+    virtual bool shadowHit(const Ray& ray, float tMin, float tMax, float time, const Shape*& occludingShape) const;
+
+private:
+    /* Walk through cells ray crosses between tMin and tMax. If
+     * 'occludingShape' is given, stop at the first primitive hit; otherwise
+     * find the closest one. */
+    bool traverse(const Ray& ray, float tMin, float tMax, float time, HitRecord* record,
+        const Shape** occludingShape) const;
+    /* Cell containing position along an axis, clamped to the grid. */
+    int cellCoordinate(float position, int axis) const;
+
+    AABB bounds;
+    Vector3 centre;
+    int resolution[3]; // number of cells along each axis
+    float cellSize[3];
+    // Primitives of cell i are cellPrimitives[cellStart[i]] up to
+    // cellPrimitives[cellStart[i + 1] - 1]. Cells are stored x first.
+    std::vector<unsigned int> cellStart;
+    std::vector<unsigned int> cellPrimitives;
+
+};
+
+}
+
+#endif
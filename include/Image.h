@@ -3,30 +3,43 @@
 
 #include <vector>
 #include <string>
+#include <cstddef>
 #include "Colour.h"
+#include "Framebuffer.h"
 
 namespace raytracer {
 
-class Image
+class Image : public Framebuffer
 {
 
 public:
     Image(int width, int height, const Colour& background = Colour(0.0f, 0.0f, 0.0f));
+    /* Image whose pixels are stored elsewhere (e.g. in a memory-mapped
+     * file), one row after another. The pixels are not copied or freed by
+     * the image, so must outlive it, and cannot be changed. */
+    Image(int width, int height, const Colour* externalPixels);
+    Image(const Image& other);
+    Image& operator=(const Image& other);
     static Image fromFile(const std::string& filename);
 
     void clear(const Colour& colour);
-    bool set(int x, int y, const Colour& colour);
+    virtual bool set(int x, int y, const Colour& colour);
     /* Resizes the image to the given dimensions. */
     void setWidth(int newWidth);
     void setHeight(int newHeight);
     void resize(int newWidth, int newHeight);
 
-    const Colour& get(int x, int y) const;
-    int getWidth() const;
-    int getHeight() const;
+    virtual const Colour& get(int x, int y) const;
+    virtual int getWidth() const;
+    virtual int getHeight() const;
+    /* All pixels of the image, one row after another. */
+    const Colour* getPixels() const;
+    /* Bytes used by the image's own pixels (zero if stored externally). */
+    size_t memoryUsed() const;
 
 private:
-    std::vector<std::vector<Colour> > pixels; // accessed pixels[row][column]
+    std::vector<Colour> storage; // empty if pixels are stored externally
+    const Colour* pixels; // accessed pixels[(row * width) + column]
     int width;
     int height;
 
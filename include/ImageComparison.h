@@ -0,0 +1,38 @@
+#ifndef DW_RAYTRACER_IMAGECOMPARISON_H
+#define DW_RAYTRACER_IMAGECOMPARISON_H
+
+#include "Framebuffer.h"
+
+namespace raytracer {
+
+/* How far an image is from a reference image of the same scene, e.g. one
+ * rendered with many more samples. Colours are clamped to [0, 1] first, as
+ * they are when written to a file. */
+struct ImageError
+{
+    /* PSNR given to images identical to their reference. */
+    static const double MAX_PSNR;
+    /* Side of the square windows SSIM is found over, in pixels. */
+    static const int SSIM_WINDOW_SIZE = 8;
+
+    // Root mean square difference of every channel of every pixel
+    double rmse;
+    // Peak signal to noise ratio in decibels: higher is closer
+    double psnr;
+    // Mean structural similarity of the luminance of overlapping windows,
+    // which is 1 for identical images and falls as local contrast and
+    // structure (e.g. edges and noise) differ, which RMSE weighs poorly
+    double ssim;
+    // Largest difference of any channel
+    double maxError;
+
+    ImageError() : rmse(0.0), psnr(MAX_PSNR), ssim(1.0), maxError(0.0) { }
+};
+
+/* Compare image with reference. Returns false if they differ in size. */
+bool compareImages(const Framebuffer& image, const Framebuffer& reference,
+    ImageError& error);
+
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef DW_RAYTRACER_LAZYSHAPE_H
+#define DW_RAYTRACER_LAZYSHAPE_H
+
+#include "Shape.h"
+#include "AABB.h"
+#include "Threading.h"
+
+namespace raytracer {
+
+/* Builds the shape a LazyShape stands in for. */
+class ShapeBuilder
+{
+
+public:
+    virtual ~ShapeBuilder() { }
+    /* Returns NULL if the shape could not be built. */
+    virtual Shape* build() = 0;
+
+};
+
+/* Stands in for a shape which is expensive to build, such as a terrain and
+ * its octree. Only a box containing the shape is needed up front; the shape
+ * itself is built the first time a ray enters the box, so shapes which are
+ * never looked at cost nothing. If rays from several threads reach the shape
+ * at once, it is built by one of them while the others wait. */
+class LazyShape : public Shape
+{
+
+public:
+    /* Takes ownership of the builder and the shape it builds. */
+    LazyShape(const AABB& boundingBox, ShapeBuilder* builder);
+    virtual ~LazyShape();
+
+    /* Shape this stands in for, which is built now if it has not been
+     * already. NULL if it could not be built. */
+    Shape* getShape() const;
+    bool isBuilt() const;
+
+    /* Implemented for Shape abstract class. */
+    virtual const Vector3& getCentre() const;
+    virtual bool hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const;
+    virtual bool shadowHit(const Ray& ray, float tMin, float tMax, float time, const Shape*& occludingShape) const;
+
+private:
+    LazyShape(const LazyShape&);
+    LazyShape& operator=(const LazyShape&);
+
+    AABB boundingBox;
+    Vector3 centre;
+    ShapeBuilder* builder;
+    mutable threading::Mutex mutex; // held while the shape is built
+    mutable Shape* shape;
+    // Non-zero once 'shape' has been built. Read without the lock, so it is
+    // only set after the shape is fully built (see isBuilt()).
+    mutable int built;
+
+};
+
+}
+
+#endif
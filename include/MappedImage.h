@@ -0,0 +1,78 @@
+#ifndef DW_RAYTRACER_MAPPEDIMAGE_H
+#define DW_RAYTRACER_MAPPEDIMAGE_H
+
+#include <string>
+#include <cstddef>
+#include "Framebuffer.h"
+
+namespace raytracer {
+
+/* Framebuffer whose pixels are stored in a memory-mapped file rather
+ * than on the heap, so images far larger than physical memory can be
+ * rendered. Pixels are grouped into square tiles which are contiguous
+ * in the file. Once a tile is finished it can be flushed to disk and
+ * evicted from memory, with the operating system paging it back in if
+ * it is accessed again. */
+class MappedImage : public Framebuffer
+{
+
+public:
+    static const int DEFAULT_TILE_SIZE = 64;
+
+    MappedImage();
+    virtual ~MappedImage();
+
+    /* Create (or overwrite) file to store an image with the given
+     * dimensions and map it into memory. Returns false on failure. */
+    bool create(const std::string& filename, int width, int height,
+        int tileSize = DEFAULT_TILE_SIZE);
+    /* Map an existing framebuffer file previously made by create(). */
+    bool open(const std::string& filename);
+    /* Flush all pixels to disk and unmap the file. */
+    void close();
+    bool isOpen() const;
+
+    virtual bool set(int x, int y, const Colour& colour);
+    virtual const Colour& get(int x, int y) const;
+    virtual int getWidth() const;
+    virtual int getHeight() const;
+
+    int getTileSize() const;
+    int getTilesX() const;
+    int getTilesY() const;
+
+    /* Write tile's pixels to disk and release the memory it occupies. */
+    void flushTile(int tileX, int tileY);
+    /* Flushes every row of tiles whose last row is in the given range.
+     * This assumes rows are rendered from top to bottom. */
+    virtual void rowsFinished(int firstRow, int numRows);
+
+    /* Assemble final image straight from the file and write it as a TGA,
+     * one row of tiles at a time. Returns false if it could not be written. */
+    bool writeTGA(const std::string& filename, bool compress = false);
+
+private:
+    /* Map file with the given descriptor, reading dimensions from
+     * its header. */
+    bool mapFile(int fileDescriptor);
+    /* Index of pixel (x, y) in the tiled pixel array. */
+    size_t pixelIndex(int x, int y) const;
+    /* Flush and evict the given range of bytes of the pixel array. */
+    void flushRange(size_t start, size_t length);
+
+    int fd;
+    unsigned char* mapping;
+    size_t mappingSize;
+    Colour* pixels; // points into mapping, after the file header
+
+    int width;
+    int height;
+    int tileSize;
+    int tilesX; // number of tiles horizontally
+    int tilesY; // number of tiles vertically
+
+};
+
+}
+
+#endif
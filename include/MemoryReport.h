@@ -0,0 +1,58 @@
+#ifndef DW_RAYTRACER_MEMORYREPORT_H
+#define DW_RAYTRACER_MEMORYREPORT_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+namespace raytracer {
+
+/* Memory held by each resource of a program, grouped into subsystems (e.g.
+ * the "skyboxFront" resource of the "images" subsystem). Filled in by the
+ * owners of the memory (see ResourceManager::reportMemory() and
+ * reportSceneMemory() in DemoScene.h), so only what they account for is
+ * counted: the heap's own overhead is not.
+ *
+ * Memory mapped from files, such as a compiled scene, is counted apart
+ * from the rest, since its pages are shared by every process which maps
+ * the file and can be dropped by the operating system when memory is low. */
+class MemoryReport
+{
+
+public:
+    struct Entry
+    {
+        std::string subsystem;
+        std::string resource;
+        size_t bytes;
+        bool mapped; // mapped from a file, rather than allocated
+    };
+
+    /* Add bytes held by a resource. Resources added to the same subsystem
+     * more than once are listed once, with their bytes added together. */
+    void add(const std::string& subsystem, const std::string& resource, size_t bytes,
+        bool mapped = false);
+
+    /* Every resource, in the order they were first added. */
+    const std::vector<Entry>& getEntries() const;
+    /* Subsystems, in the order they were first added. */
+    std::vector<std::string> getSubsystems() const;
+    /* Bytes allocated (or, if 'mapped', mapped) by a subsystem, or by
+     * every subsystem if it is empty. */
+    size_t totalBytes(const std::string& subsystem = "", bool mapped = false) const;
+
+    /* Total and each subsystem on their own lines, each starting with
+     * 'indent'. If 'resources' is true, each resource is listed under its
+     * subsystem. */
+    std::string format(const std::string& indent = "", bool resources = true) const;
+    /* Report as a JSON object. */
+    std::string formatJSON() const;
+
+private:
+    std::vector<Entry> entries;
+
+};
+
+}
+
+#endif
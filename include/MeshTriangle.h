@@ -18,6 +18,8 @@ public:
     virtual void setMaterial(Material* newMaterial);
 
     const Vector3& getCentre() const;
+    /* Vertex 0, 1 or 2 of the triangle, in the order it was created with. */
+    const Vertex& getVertex(unsigned int index) const;
     bool hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const;
     bool shadowHit(const Ray& ray, float tMin, float tMax,
         float time, const Shape*& occludingShape) const;
@@ -4,9 +4,29 @@
 #include "Shape.h"
 #include "AABB.h"
 #include "Line.h"
+#include "Arena.h"
+#include "AcceleratorStatistics.h"
+#include <vector>
+#include <map>
 
 namespace raytracer {
 
+/* Node of an octree stored in a flat array, so it can be written to a file
+ * and read back without any pointers needing to be fixed up. The eight
+ * children of a node are stored next to each other, starting at index
+ * 'firstChild' (-1 if the node has no children). Shapes are indices into
+ * the list of shapes the octree was flattened with. */
+struct FlatOctreeNode
+{
+    static const unsigned int MAX_SHAPES = 8;
+
+    AABB boundary;
+    AABB hitBounds; // see Octree::fitBounds()
+    int firstChild;
+    unsigned int numShapes;
+    unsigned int shapes[MAX_SHAPES];
+};
+
 /* Test octree code to ensure it's functioning correctly. */
 namespace tests
 {
@@ -19,7 +39,16 @@ class Octree : public Shape
     friend void tests::testOctree();
 
 public:
-    Octree(const AABB& boundingBox);
+    /* Shapes a node holds before it is split, unless told otherwise. */
+    static const unsigned int OCTREE_NODE_CAPACITY = 8;
+
+    /* If an arena is given, this node should have been created in it, and
+     * so are its children. They are then freed along with the arena rather
+     * than when the node is deleted. A node is split into eight once it
+     * holds more than 'nodeCapacity' shapes, unless it is 'maxDepth' levels
+     * below the root (zero for no limit), in which case it holds them all. */
+    Octree(const AABB& boundingBox, Arena* arena = NULL,
+        unsigned int nodeCapacity = OCTREE_NODE_CAPACITY, unsigned int maxDepth = 0);
     virtual ~Octree();
 
     /* Return true if point is contained within this Octree node
@@ -27,6 +56,14 @@ public:
      * If false is returned, point was added to this node or any
      * of its children. */
     bool insert(Shape* shape);
+    /* Shapes are placed in a node by their centre alone, so can reach
+     * outside it. Once every shape has been inserted, this fits the box
+     * each node tests rays against to the shapes held by it and the nodes
+     * below it, so no part of a shape is missed. shapeBounds[i] must
+     * contain shapes[i], and every shape in the octree must be in
+     * 'shapes'. Until it is called, rays are tested against each node's
+     * region of space. */
+    void fitBounds(const ShapeList& shapes, const std::vector<AABB>& shapeBounds);
     void subdivide();
 
     /* Remove all shapes from this node (recursively). */
@@ -38,6 +75,20 @@ public:
      * of each subdivison of the octree. This recursively retrieves
      * lines from all the tree's children.. */
     LineList getBoundingLines();
+    /* Number of nodes in the octree, including this one. */
+    unsigned int numNodes() const;
+    /* Add this node and those below it to 'statistics'. */
+    void addStatistics(AcceleratorStatistics& statistics) const;
+
+    /* Append every node of the octree to 'nodes', root first, with parents
+     * always before their children. Every shape in the octree must be in
+     * 'shapes'. Returns false (leaving 'nodes' as it was) if a node holds
+     * more than FlatOctreeNode::MAX_SHAPES shapes. */
+    bool flatten(const ShapeList& shapes, std::vector<FlatOctreeNode>& nodes) const;
+    /* Rebuild octree from nodes written by flatten(), using the same list
+     * of shapes. Returns NULL if the nodes do not form a valid octree. */
+    static Octree* fromFlattened(const FlatOctreeNode* nodes, unsigned int numNodes,
+        const ShapeList& shapes, Arena* arena = NULL);
 
     /* Implemented for Shape abstract class. */
     virtual const Vector3& getCentre() const;
@@ -46,15 +97,31 @@ public:
 
 private:
     static const unsigned int MAX_CHILDREN = 8;
-    static const unsigned int OCTREE_NODE_CAPACITY = 8;
+
+    /* Make room for at least 'capacity' shapes. */
+    void reserveShapes(unsigned int capacity);
+    /* fitBounds() for this node and those below it. Returns false if they
+     * hold no shapes. */
+    bool fitBounds(const std::map<const Shape*, unsigned int>& shapeIndices,
+        const std::vector<AABB>& shapeBounds);
 
     AABB boundary; // region of space this octree node is for
+    // Box rays are tested against, which contains every shape held by this
+    // node and those below it (see fitBounds()). Empty if they hold none.
+    AABB hitBounds;
     Vector3 centre; // centre point of region this node is for
-    Shape* shapes[OCTREE_NODE_CAPACITY]; // shapes contained within this region
+    // Shapes contained within this region, allocated when the first is
+    // added (in the arena, if there is one)
+    Shape** shapes;
     Octree* children[8]; // all children of node
 
     unsigned int numShapes; // amount of shapes currently contained in this node
+    unsigned int shapeCapacity; // room in 'shapes'
     unsigned int numChildren; // amount of children node currently has
+    unsigned int nodeCapacity; // shapes held before the node is split
+    unsigned int depth; // levels below the root
+    unsigned int maxDepth; // deepest a node may be split to, or zero
+    Arena* arena; // arena nodes are created in, or NULL if on the heap
 
 };
 
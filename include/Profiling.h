@@ -0,0 +1,125 @@
+#ifndef DW_RAYTRACER_PROFILING_H
+#define DW_RAYTRACER_PROFILING_H
+
+#include <stdint.h>
+#include <string>
+#include "Common.h"
+
+namespace raytracer {
+
+/* Breakdown of where rendering time goes, measured by timers placed in the
+ * raytracer's hot paths. The timers are only compiled in when
+ * DW_RAYTRACER_PROFILING_ENABLED is defined (see build.sh), so normal builds
+ * pay nothing for them; in those, PROFILE_STAGE() does nothing and every
+ * count stays at zero.
+ *
+ * Each thread counts into its own counters, so timers never contend with
+ * each other. Time spent in a stage entered while another is being timed
+ * (e.g. primitive tests during traversal) counts towards the inner stage
+ * only, so the stages' times add up to the time spent in all of them. */
+namespace profiling
+{
+
+    enum Stage
+    {
+        RAY_GENERATION = 0, // camera rays
+        TRAVERSAL, // finding which shapes a ray may hit
+        PRIMITIVE_TESTS, // ray-triangle and ray-sphere tests
+        TEXTURE_LOOKUPS,
+        LOCAL_ILLUMINATION, // not including the shadow rays it casts
+        SECONDARY_RAYS // computing reflected and refracted rays
+    };
+    static const unsigned int NUM_STAGES = 6;
+
+#ifdef DW_RAYTRACER_PROFILING_ENABLED
+    static const bool ENABLED = true;
+#else
+    static const bool ENABLED = false;
+#endif
+
+    const char* stageName(Stage stage);
+
+    /* Cycles (see common::cycleCount()) spent in each stage, and the number
+     * of times it was entered. */
+    struct StageCounters
+    {
+        uint64_t cycles[NUM_STAGES];
+        uint64_t calls[NUM_STAGES];
+
+        StageCounters();
+
+        uint64_t totalCycles() const;
+    };
+
+    /* Counters of every thread added together, including threads which
+     * have exited since reset() was last called. Safe to call while
+     * rendering, so can be used to show progress. */
+    StageCounters totals();
+    /* Set every thread's counters to zero. Must not be called while
+     * anything is being rendered. */
+    void reset();
+    /* Time, share of the total and number of calls of each stage, one stage
+     * per line, for printing at the end of a render. */
+    std::string formatBreakdown(const StageCounters& counters);
+    /* Share of the total time of each stage on one short line. */
+    std::string formatSummary(const StageCounters& counters);
+
+    /* Counters of the calling thread, which are created (and registered, so
+     * totals() includes them) the first time the thread uses them. */
+    StageCounters* createThreadCounters();
+    extern __thread StageCounters* threadCounters;
+
+    /* Counts the time from its creation to its destruction towards a stage,
+     * less any time counted by timers created while it exists. */
+    class ScopedTimer
+    {
+
+    public:
+        explicit ScopedTimer(Stage stage) : stage(stage), nestedCycles(0),
+            parent(currentTimer)
+        {
+            currentTimer = this;
+            start = common::cycleCount();
+        }
+
+        ~ScopedTimer()
+        {
+            uint64_t elapsed = common::cycleCount() - start;
+            StageCounters* counters = (threadCounters) ? threadCounters : createThreadCounters();
+            // Stored atomically so other threads can read totals meanwhile
+            __atomic_store_n(&counters->cycles[stage],
+                counters->cycles[stage] + (elapsed - nestedCycles), __ATOMIC_RELAXED);
+            __atomic_store_n(&counters->calls[stage], counters->calls[stage] + 1,
+                __ATOMIC_RELAXED);
+            if (parent)
+                parent->nestedCycles += elapsed;
+            currentTimer = parent;
+        }
+
+    private:
+        ScopedTimer(const ScopedTimer&);
+        ScopedTimer& operator=(const ScopedTimer&);
+
+        // Innermost timer of the calling thread
+        static __thread ScopedTimer* currentTimer;
+
+        Stage stage;
+        uint64_t start;
+        uint64_t nestedCycles;
+        ScopedTimer* parent;
+
+    };
+
+}
+
+}
+
+/* Time the rest of the enclosing scope as the given profiling::Stage. */
+#ifdef DW_RAYTRACER_PROFILING_ENABLED
+#define PROFILE_STAGE(stage) \
+    raytracer::profiling::ScopedTimer stageTimer(raytracer::profiling::stage)
+#else
+#define PROFILE_STAGE(stage)
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef DW_RAYTRACER_RAYCOST_H
+#define DW_RAYTRACER_RAYCOST_H
+
+#include <stdint.h>
+
+namespace raytracer {
+
+/* Work done finding what rays hit: the nodes of acceleration structures
+ * (octree nodes, BVH nodes, grid cells and bounding shapes) visited and the
+ * primitives tested. */
+struct RayCost
+{
+    uint64_t nodesVisited;
+    uint64_t primitiveTests;
+
+    RayCost() : nodesVisited(0), primitiveTests(0) { }
+};
+
+/* Counting of the work each thread does, used to build cost maps (see
+ * CostMap.h). Work is only counted while a ScopedCounter exists on the
+ * thread, and otherwise costs a single test of a thread-local pointer. */
+namespace raycost
+{
+
+    // Cost being counted by the calling thread, or NULL
+    extern __thread RayCost* activeCost;
+
+    inline void countNodeVisit()
+    {
+        if (activeCost)
+            activeCost->nodesVisited++;
+    }
+
+    inline void countPrimitiveTest()
+    {
+        if (activeCost)
+            activeCost->primitiveTests++;
+    }
+
+    /* Adds work done by the calling thread to 'cost' for as long as it
+     * exists. */
+    class ScopedCounter
+    {
+
+    public:
+        explicit ScopedCounter(RayCost* cost) : previous(activeCost)
+        {
+            activeCost = cost;
+        }
+
+        ~ScopedCounter()
+        {
+            activeCost = previous;
+        }
+
+    private:
+        ScopedCounter(const ScopedCounter&);
+        ScopedCounter& operator=(const ScopedCounter&);
+
+        RayCost* previous;
+
+    };
+
+}
+
+}
+
+#endif
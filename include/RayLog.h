@@ -0,0 +1,79 @@
+#ifndef DW_RAYTRACER_RAYLOG_H
+#define DW_RAYTRACER_RAYLOG_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "Ray.h"
+#include "RenderSettings.h"
+
+namespace raytracer {
+
+/* Why a raytracer asked its root shape about a ray. Shadow queries only ask
+ * whether anything is in the way; the others ask for the closest surface. */
+enum RayQueryType
+{
+    PRIMARY_QUERY = 0,
+    REFLECTED_QUERY,
+    REFRACTED_QUERY,
+    SHADOW_QUERY
+};
+static const unsigned int NUM_RAY_QUERY_TYPES = 4;
+
+const char* rayQueryTypeName(RayQueryType type);
+
+/* Query a raytracer made of its root shape: the ray, the range of distances
+ * along it searched and what was found. Only holds plain numbers, so is
+ * written to ray log files as it is (40 bytes each). */
+struct RayQuery
+{
+    float origin[3];
+    float direction[3];
+    float tMin;
+    float tMax;
+    // Distance to the surface hit, or zero if nothing was (or for shadow
+    // queries, which do not find the closest surface)
+    float t;
+    uint8_t type; // RayQueryType
+    uint8_t hit;
+    uint8_t padding[2];
+
+    Ray ray() const;
+};
+
+/* Every query of the scene's shapes made while rendering an image, in the
+ * order they were made, along with the settings of the render. Replaying
+ * the queries against another accelerator (see raytracer-replay) times its
+ * traversal without any shading, and checks it finds the same surfaces. */
+class RayLog
+{
+
+public:
+    RayLog();
+
+    /* Discard all queries and start a log of a render with the given
+     * settings. */
+    void reset(const RenderSettings& settings);
+    void record(RayQueryType type, const Ray& ray, float tMin, float tMax,
+        bool hit, float t);
+
+    const RenderSettings& getSettings() const;
+    const std::vector<RayQuery>& getQueries() const;
+    /* Number of queries of the given type. */
+    uint64_t count(RayQueryType type) const;
+
+    /* Write log to file. Returns false if it could not be written. */
+    bool save(const std::string& filename) const;
+    /* Load log from file written by save(). Returns false, leaving the log
+     * unchanged, if the file is missing or invalid. */
+    bool load(const std::string& filename);
+
+private:
+    RenderSettings settings;
+    std::vector<RayQuery> queries;
+
+};
+
+}
+
+#endif
@@ -1,10 +1,13 @@
 #ifndef DW_RAYTRACER_RAYTRACER_H
 #define DW_RAYTRACER_RAYTRACER_H
 
+#include <stdint.h>
 #include "Shape.h"
 #include "Light.h"
 #include "Camera.h"
 #include "Ray.h"
+#include "RenderSettings.h"
+#include "RayLog.h"
 
 namespace raytracer {
 
@@ -22,11 +25,46 @@ static const float SHADOW_RAY_DISTANCE_THRESHOLD = 0.1f;
 // Colour to give all test shapes
 static const Colour TEST_SHAPE_COLOUR = Colour(1.0f, 1.0f, 0.5f);
 
+/* Surface hit by a ray, with everything needed to light it but before
+ * any lighting has been computed. */
+struct SurfaceHit
+{
+    HitRecord record;
+    Vector3 rayDirection;
+    // Material of the hit shape (or the default material) and the colour
+    // of the surface at the point hit, after any texturing
+    const Material* material;
+    Colour objectColour;
+    // False if only a test shape was hit
+    bool objectHit;
+    bool testShapeHit;
+
+    SurfaceHit() : material(NULL), objectHit(false), testShapeHit(false) { }
+};
+
+/* Told about every ray a raytracer casts, as the segment the ray actually
+ * covered (e.g. from its origin to the surface it hit). Shadow rays are
+ * reported separately, as only the shape of objects affects them. */
+class RayObserver
+{
+
+public:
+    virtual ~RayObserver() { }
+
+    virtual void raySegment(const Vector3& start, const Vector3& end, bool shadowRay) = 0;
+
+};
+
 class Raytracer
 {
 
 public:
     Raytracer(const Camera& camera);
+    /* Copies share the original's shapes instead of duplicating them, and
+     * do not delete them when destroyed. This allows several threads to
+     * render the same scene, each using their own raytracer. Ray counts
+     * of the copy start at zero and it has no ray observer or ray log. */
+    Raytracer(const Raytracer& other);
     virtual ~Raytracer();
 
     /* Single and multisample raytracing. */
@@ -35,6 +73,26 @@ public:
     	unsigned int samplesPerDirection, Colour& result); /* produces (samplesPerDirection * samplesPerDirection) samples */
     bool randomMultisample(float minX, float minY, float maxX, float maxY,
         unsigned int samples, Colour& result);
+    /* Render pixel (i, j) of an image with the given dimensions using
+     * the chosen sampling method. Returns false if nothing was hit. */
+    bool renderPixel(int i, int j, int imageWidth, int imageHeight,
+        SamplingMethod samplingMethod, unsigned int numSamples, Colour& result);
+    /* Cast only the sample with the given index (from zero) of those
+     * renderPixel() would cast for pixel (i, j), so samples can be taken
+     * separately and averaged later. Indices beyond the number of samples
+     * the sampling method takes give randomly placed samples. */
+    bool renderPixelSample(int i, int j, int imageWidth, int imageHeight,
+        SamplingMethod samplingMethod, unsigned int numSamples,
+        unsigned int sampleIndex, Colour& result);
+    /* renderPixelSample() split in two. The first casts the sample's ray and
+     * finds the surface it hits, returning false if nothing was hit. The
+     * second computes the colour of the surface using the current lights
+     * and effects, casting any secondary rays that needs. Surfaces can be
+     * kept and shaded again after only the lights or effects change. */
+    bool tracePixelSample(int i, int j, int imageWidth, int imageHeight,
+        SamplingMethod samplingMethod, unsigned int numSamples,
+        unsigned int sampleIndex, SurfaceHit& hit);
+    Colour shadeSurface(const SurfaceHit& hit);
     /* Methods which compute the contribution of different physical
      * phenoma to the final pixel colour. */
     Colour localIllumination(const Material* material, const Colour& objectColour, const HitRecord& record);
@@ -64,19 +122,35 @@ public:
      * and deletes it when the raytracer is destroyed. */
     void setRootTestShape(Shape* newRootTest, bool deletePrevious = true);
 
-    /* Accessors for statistics on trace. */
-    unsigned int primaryRays() const;
-    unsigned int reflectedRays() const;
-    unsigned int refractedRays() const;
-    unsigned int shadowRays() const;
-    unsigned int totalRays() const;
+    /* Accessors for statistics on trace. Counts are 64-bit, as large
+     * renders cast more rays than fit in 32 bits. */
+    uint64_t primaryRays() const;
+    uint64_t reflectedRays() const;
+    uint64_t refractedRays() const;
+    uint64_t shadowRays() const;
+    uint64_t totalRays() const;
     /* Used to reset ray counts to zero. */
     void resetRayCount();
 
+    /* Set object told about every primary, secondary and shadow ray cast
+     * from now on, or NULL to stop. The raytracer does not own it. */
+    void setRayObserver(RayObserver* observer);
+    /* Set log every query of the scene's shapes is recorded in from now on
+     * (see RayLog.h), or NULL to stop. The raytracer does not own it. */
+    void setRayLog(RayLog* log);
+
 private:
+    // Raytracers cannot be assigned to each other
+    Raytracer& operator=(const Raytracer& other);
+
     /* Fire a ray into the scene and recursively trace the colour of
      * the hit pixel (stored in record.colour). */
-    bool recursiveTrace(const Ray& ray, HitRecord& record, int depth);
+    bool recursiveTrace(const Ray& ray, RayQueryType type, HitRecord& record, int depth);
+    /* Find closest surface the ray hits, returning false if there is none.
+     * The type of ray is only used to record the query in the ray log. */
+    bool findSurface(const Ray& ray, RayQueryType type, SurfaceHit& hit);
+    /* Colour of surface hit by a ray at the given recursion depth. */
+    Colour shadeSurface(const SurfaceHit& hit, int depth);
 
     /* Used to compute reflection/refraction rays. */
     float computeSurfaceReflectivity(const Vector3& incoming,
@@ -97,6 +171,8 @@ private:
     // the same colour.
     Shape* rootTestShape;
     bool testShapesEnabled; // if true, test shapes will be drawn
+    // If true, root shapes are deleted when the raytracer is destroyed
+    bool ownsShapes;
 
     // Default material used if a shape does not have one specified
     Material defaultMaterial;
@@ -106,10 +182,13 @@ private:
 	bool shadowsEnabled;
 
     // Statistics on raytracer performance
-    unsigned int numPrimaryRays;
-    unsigned int numReflectedRays;
-    unsigned int numRefractedRays;
-    unsigned int numShadowRays;
+    uint64_t numPrimaryRays;
+    uint64_t numReflectedRays;
+    uint64_t numRefractedRays;
+    uint64_t numShadowRays;
+
+    RayObserver* rayObserver;
+    RayLog* rayLog;
 
 };
 
@@ -0,0 +1,58 @@
+#ifndef DW_RAYTRACER_RENDERCACHE_H
+#define DW_RAYTRACER_RENDERCACHE_H
+
+#include <string>
+#include <vector>
+#include "Framebuffer.h"
+#include "RenderSettings.h"
+#include "RenderProtocol.h"
+
+namespace raytracer {
+
+/* Rendered images stored on disk under a hash of everything which
+ * determines how they look (see renderCacheKey()), so an image which has
+ * been rendered before can be read back rather than rendered again. Each
+ * image is stored tile by tile, so a render which was stopped part way
+ * keeps the tiles it finished and rendering it again only renders the rest.
+ * Ray counts and time taken are stored with each image. */
+class RenderCache
+{
+
+public:
+    /* Images are split into tiles of this size, as by splitIntoTiles(). */
+    static const int TILE_SIZE = 32;
+
+    /* Cached images are stored in the given directory, which is created
+     * if it does not exist. */
+    explicit RenderCache(const std::string& directory);
+
+    /* Read every cached tile of the image with the given key and settings
+     * into 'target'. cachedTiles[i] is set to true if tile i was read, and
+     * 'summary' holds the ray counts and time taken to render the tiles
+     * read. Returns the number of tiles read. */
+    unsigned int lookup(const std::string& key, const RenderSettings& settings,
+        Framebuffer* target, std::vector<bool>& cachedTiles,
+        protocol::RenderSummary& summary) const;
+    /* Store tiles of 'image' for which renderedTiles[i] is true, along with
+     * the ray counts and time taken to render them, adding to any tiles of
+     * the image already stored. Returns false if they could not be written. */
+    bool store(const std::string& key, const RenderSettings& settings,
+        const Framebuffer& image, const std::vector<bool>& renderedTiles,
+        const protocol::RenderSummary& summary);
+
+private:
+    /* Contents of a file holding one cached image. */
+    struct Entry;
+
+    std::string filenameForKey(const std::string& key) const;
+    bool readEntry(const std::string& filename, const RenderSettings& settings,
+        Entry& entry) const;
+    bool writeEntry(const std::string& filename, const Entry& entry) const;
+
+    std::string directory;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef DW_RAYTRACER_RENDERPROTOCOL_H
+#define DW_RAYTRACER_RENDERPROTOCOL_H
+
+#include <string>
+#include <stdint.h>
+#include "RenderSettings.h"
+#include "TileRenderer.h"
+#include "Framebuffer.h"
+
+namespace raytracer {
+
+/* Messages exchanged with the render daemon. Requests and replies are
+ * single lines of text, except for tile pixel data.
+ *
+ * Client sends one of:
+ *     RENDER scene=<id> tile=<size> region=<x>,<y>,<width>,<height> <settings>
+ *     STATUS
+ *     TRACE <filename>
+ *     SHUTDOWN
+ * where <settings> are name=value pairs understood by setRenderSetting().
+ * 'tile' and 'region' are optional (the default region is the whole image).
+ *
+ * Daemon replies to RENDER with "OK <number of tiles>", followed by each
+ * tile in the order they finish:
+ *     TILE <x> <y> <width> <height>
+ * then width * height pixels as (r, g, b) 32-bit floats in host byte
+ * order, row by row. Once every tile has been sent:
+ *     DONE <seconds> <primary> <reflected> <refracted> <shadow rays>
+ * TRACE writes the events traced by the daemon so far (see Tracing.h) to a
+ * file on the daemon's machine, replying "OK <number of events>". Daemons
+ * only trace if started with --trace. TRACE and SHUTDOWN are only accepted
+ * over a Unix domain socket, never over TCP.
+ *
+ * Any failure is reported as "ERROR <message>". */
+namespace protocol
+{
+
+    static const int DEFAULT_TILE_SIZE = 64;
+    /* Largest requests the daemon accepts, so that a bad request can not
+     * make it allocate huge images or tile lists. */
+    static const int MAX_TILE_SIZE = 4096;
+    static const int MAX_IMAGE_SIZE = 32768;
+    static const int MAX_TILES_PER_REQUEST = 65536;
+
+    struct RenderRequest
+    {
+        std::string sceneId;
+        int tileSize;
+        // Region of the image to render. Zero-sized means the whole image.
+        Tile region;
+        RenderSettings settings;
+
+        RenderRequest() : sceneId("demo"), tileSize(DEFAULT_TILE_SIZE) { }
+    };
+
+    /* Statistics sent once a render has finished. */
+    struct RenderSummary
+    {
+        double seconds;
+        uint64_t primaryRays;
+        uint64_t reflectedRays;
+        uint64_t refractedRays;
+        uint64_t shadowRays;
+
+        RenderSummary() : seconds(0), primaryRays(0), reflectedRays(0),
+            refractedRays(0), shadowRays(0)
+        {
+        }
+    };
+
+    std::string formatRenderRequest(const RenderRequest& request);
+    /* Parse RENDER line. Returns false if it is malformed, or asks for
+     * more than the limits above. */
+    bool parseRenderRequest(const std::string& line, RenderRequest& request);
+    std::string formatRenderSummary(const RenderSummary& summary);
+    bool parseRenderSummary(const std::string& line, RenderSummary& summary);
+
+    /* Send tile header and pixel data. Pixels are read from 'source' at
+     * (x - sourceX, y - sourceY) for each pixel (x, y) in the tile. */
+    bool sendTile(int socket, const Tile& tile, const Framebuffer& source,
+        int sourceX = 0, int sourceY = 0);
+    /* Receive tile's pixel data after its header line has been parsed
+     * into 'tile'. Pixel (x, y) is written to (x - targetX, y - targetY)
+     * in 'target'. */
+    bool receiveTilePixels(int socket, const Tile& tile, Framebuffer* target,
+        int targetX = 0, int targetY = 0);
+    /* Parse TILE line. Returns false if it is malformed. */
+    bool parseTileHeader(const std::string& line, Tile& tile);
+
+}
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef DW_RAYTRACER_RENDERSERVICE_H
+#define DW_RAYTRACER_RENDERSERVICE_H
+
+#include <string>
+#include <map>
+#include <set>
+#include "DemoScene.h"
+#include "RenderProtocol.h"
+#include "Threading.h"
+
+namespace raytracer {
+
+/* Long-running render server. Scenes are built the first time they are
+ * requested and then kept in memory, so later jobs only pay for tracing
+ * rays. Clients connect over a Unix domain socket or TCP and send requests
+ * as described in RenderProtocol.h. Each connection is handled on its own
+ * thread, while the tiles of every job are rendered by one shared pool
+ * of threads. */
+class RenderService
+{
+
+public:
+    /* If 'numThreads' is zero, one render thread per processor is used. */
+    explicit RenderService(unsigned int numThreads = 0);
+    /* Waits for running jobs to finish, then frees every scene. */
+    ~RenderService();
+
+    /* Build scene with given ID now, rather than when it is first
+     * requested. Returns false if there is no such scene, or it could
+     * not be loaded. */
+    bool preloadScene(const std::string& sceneId);
+    /* Load the demo scene from the given compiled scene file (see
+     * constructDemoScene()). Must be called before the scene is built. */
+    void setCompiledSceneFilename(const std::string& filename);
+
+    /* Accept connections on the socket at the given path, or the given TCP
+     * port, until a client sends SHUTDOWN. Anyone who can reach a TCP port
+     * could use TRACE to write files or SHUTDOWN to stop the service, so
+     * those commands are refused over TCP. Return false if the socket could
+     * not be created. */
+    bool serveUnixSocket(const std::string& socketPath);
+    bool serveTcpPort(int port);
+
+private:
+    struct SceneEntry;
+    struct RenderJob;
+    class RenderTileTask;
+    class ConnectionTask;
+
+    RenderService(const RenderService&);
+    RenderService& operator=(const RenderService&);
+
+    /* Returns scene with given ID, building it if necessary. Callers
+     * asking for a scene which is being built wait for it to finish.
+     * Returns NULL if there is no scene with that ID, or it could not be
+     * loaded (in which case loading it is tried again next time). */
+    SceneEntry* getScene(const std::string& sceneId);
+    /* Wait until the scene's geometry can be set up for the given settings
+     * without disturbing other jobs, then register job with the scene. */
+    void beginJob(SceneEntry* entry, const RenderSettings& settings);
+    void endJob(SceneEntry* entry);
+
+    /* Accept connections on listening socket until shut down. */
+    void serve();
+    /* Read and answer requests sent over connection until it is closed. */
+    void handleConnection(int connection);
+    /* Render job and stream its tiles back to client. Returns false if
+     * the connection failed. */
+    bool handleRender(int connection, const protocol::RenderRequest& request);
+    void requestShutdown();
+
+    threading::ThreadPool* pool;
+    // Whether TRACE and SHUTDOWN are accepted. Only set before serving.
+    bool acceptsControlCommands;
+
+    // Guards everything below
+    threading::Mutex mutex;
+    int listener;
+    // Signalled when a connection has closed
+    threading::Condition connectionClosed;
+    // Signalled when a scene has been built, or failed to build
+    threading::Condition sceneLoaded;
+    std::map<std::string, SceneEntry*> scenes;
+    std::string compiledSceneFilename;
+    std::set<int> connections;
+    unsigned int activeJobs;
+    bool stopping;
+
+};
+
+}
+
+#endif
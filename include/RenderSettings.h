@@ -0,0 +1,93 @@
+#ifndef DW_RAYTRACER_RENDERSETTINGS_H
+#define DW_RAYTRACER_RENDERSETTINGS_H
+
+#include <string>
+#include "Colour.h"
+
+namespace raytracer {
+
+/* Colour given to pixels whose rays do not hit anything. */
+static const Colour BACKGROUND_COLOUR(0.2f, 0.2f, 0.2f);
+
+enum SamplingMethod
+{
+    SINGLESAMPLING = 0,
+    UNIFORM_MULTISAMPLING,
+    RANDOM_MULTISAMPLING
+};
+
+/* Acceleration structure the terrain is stored in (see Accelerator.h).
+ * AUTO_ACCELERATOR picks whichever of the others, built with whichever
+ * parameters, traces the terrain fastest (see AcceleratorTuning.h). */
+enum AcceleratorType
+{
+    FLAT_ACCELERATOR = 0,
+    OCTREE_ACCELERATOR,
+    BVH_ACCELERATOR,
+    GRID_ACCELERATOR,
+    AUTO_ACCELERATOR
+};
+static const unsigned int NUM_ACCELERATOR_TYPES = 5;
+
+/* Every setting which can be changed when rendering the demo scene.
+ * The defaults match the initial state of the GUI. */
+struct RenderSettings
+{
+    // Size of output image in pixels
+    int width;
+    int height;
+    // Determines the sampling method used and how many samples are taken
+    SamplingMethod samplingMethod;
+    unsigned int numSamples;
+    // Index of scene camera and terrain to use
+    unsigned int cameraIndex;
+    unsigned int terrainIndex;
+    // Geometric optimisation
+    AcceleratorType accelerator;
+    bool showOctree;
+    // Effects
+    bool localIllumination;
+    bool reflectionRefraction;
+    bool shadows;
+    // Bit i is set if the scene's i-th light is enabled
+    unsigned int enabledLights;
+
+    RenderSettings() : width(1000), height(1000),
+        samplingMethod(SINGLESAMPLING), numSamples(2),
+        cameraIndex(0), terrainIndex(0), accelerator(OCTREE_ACCELERATOR), showOctree(false),
+        localIllumination(true), reflectionRefraction(true), shadows(true),
+        enabledLights(~0u)
+    {
+    }
+};
+
+/* Number of primary rays cast through each pixel with the given settings. */
+unsigned int samplesPerPixel(const RenderSettings& settings);
+
+/* Name of accelerator type, as used in settings (e.g. "bvh"). */
+const char* acceleratorName(AcceleratorType type);
+
+/* Change a single setting, given by name and textual value (as used on
+ * the command line and in job files). Returns false if the setting does
+ * not exist or the value is invalid. Recognised settings are:
+ *     width, height      - positive integers
+ *     sampling           - single, uniform or random
+ *     samples            - positive integer
+ *     camera             - camera number, starting from 1
+ *     terrain            - terrain number (from 1) or varied, shallow, peaks
+ *     accelerator        - flat, octree, bvh, grid or auto
+ *     octree             - on or off (same as accelerator=octree or flat)
+ *     show-octree, local, reflect, shadows - on or off
+ *     lights             - all, none or light numbers joined by '+' (e.g. 1+2) */
+bool setRenderSetting(RenderSettings& settings, const std::string& name,
+    const std::string& value);
+/* Parse whitespace-separated list of name=value pairs, applying each one
+ * to 'settings'. Returns false if any of the pairs are invalid. */
+bool parseRenderSettings(const std::string& text, RenderSettings& settings);
+/* Return canonical textual representation of settings, which can be
+ * parsed back using parseRenderSettings(). */
+std::string formatRenderSettings(const RenderSettings& settings);
+
+}
+
+#endif
@@ -2,34 +2,85 @@
 #define DW_RAYTRACER_RESOURCEMANAGER_H
 
 #include <map>
+#include <cstddef>
 #include "Image.h"
 #include "Mesh.h"
 #include "Texture.h"
+#include "Threading.h"
+#include "MemoryReport.h"
 
 namespace raytracer {
 
+/* Kinds of resource the resource manager keeps. */
+enum ResourceType
+{
+	IMAGE_RESOURCE = 0,
+	MESH_RESOURCE,
+	TEXTURE_RESOURCE
+};
+static const unsigned int NUM_RESOURCE_TYPES = 3;
+
+/* Owns the images, meshes and textures scenes are built from, each found
+ * using the ID it was created with. Every method may be called from
+ * several threads at once.
+ *
+ * Images are reference counted. Each ID an image is stored under, each
+ * texture created from it and each acquireImage() holds a reference, and
+ * the image is deleted once the last one is released. Images loaded from
+ * files with the same contents are only decoded once, and shared.
+ *
+ * If a memory budget is set for images, the least recently used images
+ * which were loaded from a file, and are not referenced by a texture or by
+ * acquireImage(), are freed whenever loading another image exceeds it.
+ * They are decoded again when next asked for, so pointers to them must
+ * not be kept: use acquireImage() instead. */
 class ResourceManager
 {
 
 public:
+	ResourceManager();
 	virtual~ ResourceManager();
 	
+	/* Load image from TGA file. Returns NULL if it could not be loaded. */
 	Image* createImage(const std::string imageID,
 		const std::string& imageFilename);
+	/* Add an image which has already been loaded. The resource manager
+	 * takes ownership of it. */
+	Image* addImage(const std::string& imageID, Image* image);
 	Mesh* createMesh(const std::string& meshID,
 		const std::vector<Vertex>& vertices,
 		const Material& material);
 	Texture* createTexture(const std::string textureID,
 		const std::string& imageID);
 		
+	/* Resources are deleted once removed, so must no longer be in use
+	 * (except images still referenced elsewhere). */
 	bool removeImage(const std::string& imageID);
 	bool removeMesh(const std::string& meshID);
 	bool removeTexture(const std::string& TextureID);
 	
-	Image* getImage(const std::string& imageID) const;
+	Image* getImage(const std::string& imageID);
 	Mesh* getMesh(const std::string& meshID) const;
 	Texture* getTexture(const std::string& textureID) const;
+
+	/* Get image and keep it loaded until releaseImage() is called with
+	 * the same ID, even if the ID is removed in the meantime. */
+	Image* acquireImage(const std::string& imageID);
+	void releaseImage(const std::string& imageID);
 	
+	/* Bytes used by all resources of the given type. */
+	size_t memoryUsed(ResourceType type) const;
+	/* Free unreferenced images (see above) while images use more than
+	 * the given number of bytes. Zero means there is no budget. */
+	void setImageMemoryBudget(size_t bytes);
+	size_t getImageMemoryBudget() const;
+	/* Add each resource to the report: images to the "images" subsystem
+	 * (under all their IDs, counted once however many they have), meshes
+	 * to "meshes" and textures to "textures". Images freed to keep within
+	 * the budget, and the pixels of images stored elsewhere (e.g. in a
+	 * compiled scene), are not counted. */
+	void reportMemory(MemoryReport& report) const;
+
 	void clearImages();
 	void clearMeshes();
 	void clearTextures();
@@ -39,15 +90,51 @@ public:
 	static ResourceManager* getInstance();
 	
 private:
-	typedef std::map<std::string, Image*> ImageTable;
+	/* An image, which may be stored under several IDs. */
+	struct ImageRecord
+	{
+		Image* image; // NULL if freed to keep within the memory budget
+		std::string filename; // empty if not loaded from a file
+		std::string contentHash; // hash of the file's contents, if any
+		unsigned int references; // IDs, textures and acquireImage() calls
+		unsigned int pins; // references which stop the image being freed
+		unsigned long lastUsed;
+	};
+	typedef std::map<std::string, ImageRecord*> ImageTable;
 	typedef std::map<std::string, Mesh*> MeshTable;
 	typedef std::map<std::string, Texture*> TextureTable;
 	
+	ResourceManager(const ResourceManager&);
+	ResourceManager& operator=(const ResourceManager&);
+
+	/* These must be called with the mutex held. */
+	ImageRecord* findImage(const std::string& imageID) const;
+	/* Store record under ID, replacing any image already there. */
+	void storeImage(const std::string& imageID, ImageRecord* record);
+	/* Decode record's image again if it was freed, and mark it used. */
+	Image* useImage(ImageRecord* record);
+	void releaseImage(ImageRecord* record);
+	bool eraseMesh(const std::string& meshID);
+	bool eraseTexture(const std::string& textureID);
+	/* Free unpinned images, other than 'keep', until within budget. */
+	void enforceImageBudget(const ImageRecord* keep);
+
 	static ResourceManager* instance;
 
+	mutable threading::Mutex mutex;
 	ImageTable images;
+	// Images loaded from files, by hash of the file's contents
+	std::map<std::string, ImageRecord*> imagesByContent;
+	// Texture which references each image, so it can be released
+	std::map<Texture*, ImageRecord*> textureImages;
+	// Images referenced by acquireImage(), by the ID they were acquired with
+	std::multimap<std::string, ImageRecord*> acquiredImages;
 	MeshTable meshes;
 	TextureTable textures;
+
+	size_t imageBytes;
+	size_t imageMemoryBudget;
+	unsigned long useCounter;
 	
 };
 
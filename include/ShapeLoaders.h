@@ -2,6 +2,9 @@
 #define DW_RAYTRACER_SHAPELOADERS_H
 
 #include "Shape.h"
+#include "Mesh.h"
+#include "Octree.h"
+#include "Accelerator.h"
 
 namespace raytracer {
 
@@ -15,6 +18,40 @@ namespace shapeloaders
         float cellWidth, float maxHeight, const Vector3& offset,
         Texture* texture = NULL, bool useOctree = true);
 
+    /* Vertices and triangles of a terrain, before any shapes are created
+     * for them. Each triangle is three consecutive indices into
+     * 'vertices'. */
+    struct TerrainGeometry
+    {
+        VertexList vertices;
+        std::vector<unsigned int> triangles;
+        AABB boundingBox;
+    };
+
+    /* The two halves of getTerrainFromHeightmap(). The first computes the
+     * terrain's geometry from the heightmap, returning false if it could
+     * not be loaded. The second creates the terrain's shapes. */
+    bool buildTerrainGeometry(const std::string& filename, float cellWidth,
+        float maxHeight, const Vector3& offset, TerrainGeometry& geometry);
+    /* As above, using a heightmap which has already been loaded. */
+    bool buildTerrainGeometry(const Image* heightMap, float cellWidth,
+        float maxHeight, const Vector3& offset, TerrainGeometry& geometry);
+    Shape* createTerrain(const TerrainGeometry& geometry, Texture* texture,
+        bool useOctree);
+    /* Create the terrain's triangles as a store which accelerators can be
+     * built over (see Accelerator.h). */
+    PrimitiveStore* createTerrainPrimitives(const TerrainGeometry& geometry,
+        Texture* texture);
+    /* Build the octree createTerrain() would store the terrain in, and
+     * write its nodes to 'nodes' (see Octree::flatten()). No shapes are
+     * kept, so nothing needs freeing afterwards. */
+    void buildTerrainOctree(const TerrainGeometry& geometry,
+        std::vector<FlatOctreeNode>& nodes);
+    /* Box containing any terrain built from a heightmap of the given size,
+     * which can be found without building the terrain. */
+    AABB getTerrainBounds(int width, int height, float cellWidth, float maxHeight,
+        const Vector3& offset);
+
     /* Load a textured sky box with the specified size.
      * 'skyBoxTextures' should contain exactly SIX elements,
      * with correspond to the textures of the six faces of
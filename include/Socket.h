@@ -0,0 +1,50 @@
+#ifndef DW_RAYTRACER_SOCKET_H
+#define DW_RAYTRACER_SOCKET_H
+
+#include <string>
+#include <cstddef>
+
+namespace raytracer {
+
+/* Helpers for communicating over stream sockets. Functions which create
+ * sockets return a file descriptor, or -1 on failure. */
+namespace net
+{
+
+    /* Create socket at the given path which listens for local connections.
+     * Any existing file at the path is removed first. */
+    int listenOnUnixSocket(const std::string& path);
+    int connectToUnixSocket(const std::string& path);
+    /* Listen for TCP connections on the given port of every interface. */
+    int listenOnTcpPort(int port);
+    int connectToTcpHost(const std::string& host, int port);
+    /* Connect to "host:port" over TCP, or to a Unix domain socket if the
+     * address contains a '/'. */
+    int connectToAddress(const std::string& address);
+    /* Wait for a client to connect to a listening socket. */
+    int acceptConnection(int listener);
+    void closeSocket(int socket);
+    /* Stop any further sending or receiving on the socket. Threads blocked
+     * reading from it return immediately. */
+    void shutdownSocket(int socket);
+    /* Make receives on the socket fail if no data arrives for the given
+     * number of seconds. Zero waits forever. */
+    bool setReceiveTimeout(int socket, double seconds);
+
+    /* Send/receive exactly 'size' bytes. Return false if the connection
+     * was closed or an error occurred. */
+    bool sendAll(int socket, const void* data, size_t size);
+    bool receiveAll(int socket, void* data, size_t size);
+    /* Send line of text, appending the newline. */
+    bool sendLine(int socket, const std::string& line);
+    /* Receive line of text, without the newline. Lines longer than
+     * MAX_LINE_LENGTH are rejected. */
+    bool receiveLine(int socket, std::string& line);
+
+    static const size_t MAX_LINE_LENGTH = 4096;
+
+}
+
+}
+
+#endif
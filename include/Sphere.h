@@ -4,6 +4,7 @@
 #include "Shape.h"
 #include "Ray.h"
 #include "Colour.h"
+#include "AABB.h"
 
 namespace raytracer {
 
@@ -14,6 +15,11 @@ public:
     Sphere(const Vector3& centre, float radius, Material* material = NULL);
 
     const Vector3& getCentre() const;
+    void setCentre(const Vector3& newCentre);
+    float getRadius() const;
+    void setRadius(float newRadius);
+    /* Smallest box which contains the sphere. */
+    AABB getBoundingBox() const;
     bool hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const;
     bool shadowHit(const Ray& ray, float tMin, float tMax, float time, const Shape*& occludingShape) const;
 
@@ -2,6 +2,8 @@
 #define DW_RAYTRACER_TGAWRITER_H
 
 #include <string>
+#include <fstream>
+#include <vector>
 #include "Image.h"
 
 namespace raytracer {
@@ -9,7 +11,52 @@ namespace raytracer {
 namespace tga
 {
     Image* readTGAFile(const std::string& filename);
-    void writeTGAFile(const std::string& filename, const Image& image);
+    /* Write image to a 24-bit TGA file. If 'compress' is true, the pixel
+     * data is run-length encoded (TGA type 10). Returns false if the file
+     * could not be written. */
+    bool writeTGAFile(const std::string& filename, const Image& image,
+        bool compress = false);
+
+    /* Writes a TGA file incrementally, one band of scanlines at a time.
+     * This allows an image to be saved while it is still being rendered,
+     * without the entire image having to be kept in memory. Rows must be
+     * appended from top to bottom. */
+    class StreamWriter
+    {
+
+    public:
+        StreamWriter();
+        ~StreamWriter();
+
+        /* Create file and write header for image with given dimensions.
+         * Returns false if the file could not be opened. */
+        bool open(const std::string& filename, int width, int height,
+            bool compress = false);
+        /* Append rows [firstRow, firstRow + numRows) of 'band' to the file
+         * as the next scanlines of the image. 'band' must be as wide as the
+         * image being written. Returns false if the rows could not be written. */
+        bool writeRows(const Image& band, int firstRow, int numRows);
+        /* Flush remaining data and close the file. If fewer rows than the
+         * image's height have been written, the rest are filled with black
+         * so the file is still valid. */
+        bool close();
+
+        bool isOpen() const;
+        int rowsWritten() const;
+
+    private:
+        /* Write contents of encoding buffer to file and empty buffer. */
+        bool flushBuffer();
+
+        std::ofstream file;
+        int width;
+        int height;
+        bool compress;
+        int numRowsWritten;
+        // Encoded pixel data waiting to be written to the file
+        std::vector<unsigned char> buffer;
+
+    };
 }
 
 }
@@ -18,13 +18,22 @@ class TerrainHeightTexture : public Texture
 
 public:
 	TerrainHeightTexture(Image* lowTex, Image* medTex, Image* highTex, Image* vHighTex);
-    const Colour& getTexel(float u, float v) const;
+    Colour getTexel(float u, float v) const;
     /* Updates the weights of each texture image. */
     void updateWeights(float height);
+    /* Return texel blended using weights for the given height, without
+     * changing the texture's stored weights. Unlike updateWeights() and
+     * getTexel(), this is safe to call from several threads at once. */
+    Colour getTexelAtHeight(float u, float v, float height) const;
 	
 private:
 	static const unsigned int NUM_TEXTURES = 4;
 
+	/* Compute weights of each texture image for the given height. */
+	static void computeWeights(float height, float weights[NUM_TEXTURES]);
+	/* Blend texels of each image using the given weights. */
+	Colour blendTexels(float u, float v, const float weights[NUM_TEXTURES]) const;
+
 	Image* sourceImages[NUM_TEXTURES];
 	float imageWeights[NUM_TEXTURES];
 		
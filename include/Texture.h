@@ -12,7 +12,7 @@ class Texture
 public:
 	virtual ~Texture() { }
 
-    virtual const Colour& getTexel(float u, float v) const = 0;
+    virtual Colour getTexel(float u, float v) const = 0;
 	
 };
 
@@ -23,7 +23,7 @@ class ImageTexture : public Texture
 public:
     ImageTexture(Image* sourceImage);
 
-    const Colour& getTexel(float u, float v) const;
+    Colour getTexel(float u, float v) const;
 
 private:
     Image* sourceImage;
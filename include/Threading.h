@@ -0,0 +1,179 @@
+#ifndef DW_RAYTRACER_THREADING_H
+#define DW_RAYTRACER_THREADING_H
+
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+namespace raytracer {
+
+/* Thin wrappers around POSIX threads, used by the non-GUI parts of the
+ * program (the GUI uses Qt's threads). */
+namespace threading
+{
+
+    class Mutex
+    {
+
+    public:
+        Mutex();
+        ~Mutex();
+
+        void lock();
+        void unlock();
+
+    private:
+        friend class Condition;
+
+        // Mutexes cannot be copied
+        Mutex(const Mutex&);
+        Mutex& operator=(const Mutex&);
+
+        pthread_mutex_t mutex;
+
+    };
+
+    /* Locks mutex for as long as the object is in scope. */
+    class ScopedLock
+    {
+
+    public:
+        explicit ScopedLock(Mutex& mutex) : mutex(mutex) { mutex.lock(); }
+        ~ScopedLock() { mutex.unlock(); }
+
+    private:
+        ScopedLock(const ScopedLock&);
+        ScopedLock& operator=(const ScopedLock&);
+
+        Mutex& mutex;
+
+    };
+
+    class Condition
+    {
+
+    public:
+        Condition();
+        ~Condition();
+
+        /* Given mutex must be locked by the calling thread. */
+        void wait(Mutex& mutex);
+        /* As wait(), but gives up after the given number of seconds.
+         * Returns false if it timed out. */
+        bool waitFor(Mutex& mutex, double seconds);
+        void signal();
+        void broadcast();
+
+    private:
+        Condition(const Condition&);
+        Condition& operator=(const Condition&);
+
+        pthread_cond_t condition;
+
+    };
+
+    /* Unit of work which can be executed on another thread. */
+    class Task
+    {
+
+    public:
+        virtual ~Task() { }
+        virtual void run() = 0;
+
+    };
+
+    /* Run task on a new, detached thread. The task is deleted once it has
+     * finished running. Returns false if the thread could not be created. */
+    bool runDetached(Task* task);
+    /* Number of processors available to the program. */
+    unsigned int numProcessors();
+
+    /* Fixed set of threads which execute queued tasks in the order they
+     * were added. */
+    class ThreadPool
+    {
+
+    public:
+        /* If 'numThreads' is zero, one thread per processor is created.
+         * Threads are shown in traces (see Tracing.h) with the given name,
+         * which must be a string literal. */
+        explicit ThreadPool(unsigned int numThreads = 0,
+            const char* threadName = "pool thread");
+        /* Waits for queued tasks to finish, then stops every thread. */
+        ~ThreadPool();
+
+        /* Queue task to be run. The pool takes ownership of the task and
+         * deletes it once it has run. */
+        void addTask(Task* task);
+        unsigned int numThreads() const;
+
+    private:
+        ThreadPool(const ThreadPool&);
+        ThreadPool& operator=(const ThreadPool&);
+
+        static void* workerMain(void* pool);
+
+        Mutex mutex;
+        Condition tasksAvailable;
+        std::deque<Task*> tasks;
+        std::vector<pthread_t> threads;
+        bool stopping;
+        const char* threadName;
+
+    };
+
+    /* Runs tasks on a thread pool, each only once the tasks it depends on
+     * have finished (e.g. a texture is only created once its image has been
+     * decoded). Tasks hand back what they produce through pointers given to
+     * them when they are created, which may be read once wait() has returned
+     * for the task. */
+    class TaskGraph
+    {
+
+    public:
+        /* Identifies a task added to the graph. */
+        typedef unsigned int Handle;
+
+        /* If 'numThreads' is zero, one thread per processor is created. */
+        explicit TaskGraph(unsigned int numThreads = 0);
+        /* Waits for every task to finish. */
+        ~TaskGraph();
+
+        /* Queue task to be run once every task in 'dependencies' has
+         * finished. The graph takes ownership of the task and deletes it
+         * once it has run. */
+        Handle addTask(Task* task, const std::vector<Handle>& dependencies = std::vector<Handle>());
+        /* Wait for task to finish. */
+        void wait(Handle handle);
+        void waitAll();
+
+    private:
+        class GraphTask;
+        struct Node
+        {
+            Task* task;
+            unsigned int unfinishedDependencies;
+            std::vector<Handle> dependents;
+            bool finished;
+        };
+
+        TaskGraph(const TaskGraph&);
+        TaskGraph& operator=(const TaskGraph&);
+
+        /* Called once a task has run, to queue the tasks waiting for it. */
+        void taskFinished(Handle handle);
+
+        Mutex mutex;
+        Condition taskFinishedCondition;
+        std::vector<Node> nodes;
+        unsigned int numUnfinished;
+        // Declared last so its threads stop before anything they use is destroyed
+        ThreadPool pool;
+
+    };
+
+}
+
+}
+
+#endif
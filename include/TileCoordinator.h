@@ -0,0 +1,82 @@
+#ifndef DW_RAYTRACER_TILECOORDINATOR_H
+#define DW_RAYTRACER_TILECOORDINATOR_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+#include "RenderSettings.h"
+#include "TileRenderer.h"
+#include "Framebuffer.h"
+
+namespace raytracer {
+
+/* Splits renders into tiles and hands them out to worker processes,
+ * which may be on other machines. Workers are render daemons (see
+ * RenderService.h), each with its own copy of the scene, and are
+ * addressed as "host:port" or by the path of a Unix domain socket.
+ *
+ * Each worker is given one tile at a time, so fast workers end up
+ * rendering more tiles than slow ones. If a worker fails or stops
+ * responding, its tile is given to another worker. Once there are no
+ * tiles left to hand out, idle workers also render copies of tiles
+ * which are taking much longer than expected, and the first copy to
+ * finish is used. How long each tile took is remembered, so later
+ * renders of the same size hand out the most expensive tiles first. */
+class TileCoordinator
+{
+
+public:
+    /* Statistics about the last render. */
+    struct Statistics
+    {
+        unsigned int tilesRendered;
+        // Number of times a tile was given to another worker, either
+        // because its worker failed or because it was taking too long
+        unsigned int tilesReissued;
+        unsigned int workersFailed;
+        // Tiles rendered by each worker, in the order the workers were given
+        std::vector<unsigned int> tilesPerWorker;
+        uint64_t primaryRays;
+        uint64_t reflectedRays;
+        uint64_t refractedRays;
+        uint64_t shadowRays;
+
+        Statistics();
+    };
+
+    static const int DEFAULT_TILE_SIZE = 32;
+    static const double DEFAULT_TILE_TIMEOUT;
+
+    TileCoordinator(const std::vector<std::string>& workerAddresses,
+        int tileSize = DEFAULT_TILE_SIZE);
+
+    /* Seconds to wait for a worker to return a tile before giving up on
+     * that worker. */
+    void setTileTimeout(double seconds);
+
+    /* Render image described by 'settings' into 'target'. Returns false
+     * if some tiles could not be rendered because every worker failed. */
+    bool render(const RenderSettings& settings, Framebuffer* target);
+    const Statistics& lastRenderStatistics() const;
+
+private:
+    class WorkerTask;
+    struct RenderState;
+
+    /* Hand out and collect tiles using connection to one worker until
+     * the render is finished or the worker fails. */
+    void runWorker(RenderState* state, unsigned int workerIndex);
+
+    std::vector<std::string> workerAddresses;
+    int tileSize;
+    double tileTimeout;
+    Statistics statistics;
+    // Seconds each tile took during the last render, for each image size
+    std::map<std::pair<int, int>, std::vector<double> > tileCosts;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef DW_RAYTRACER_TILEDEPENDENCIES_H
+#define DW_RAYTRACER_TILEDEPENDENCIES_H
+
+#include <vector>
+#include <cstddef>
+#include "AABB.h"
+#include "Raytracer.h"
+#include "Framebuffer.h"
+#include "RenderSettings.h"
+#include "TileRenderer.h"
+
+namespace raytracer {
+
+/* Records which parts of the scene the rays of each tile of an image
+ * passed through, including reflected, refracted and shadow rays. After
+ * part of the scene changes (e.g. a sphere moves or its material changes),
+ * only the tiles whose rays passed through the changed part need to be
+ * rendered again.
+ *
+ * Space is split into a grid of cubic cells. Each tile has Bloom filters
+ * holding the cells its rays crossed, so it takes the same small amount of
+ * memory however many rays were cast. A filter may report a cell the tile
+ * never touched, which only costs an unneeded re-render, but never misses
+ * one it did touch. Shadow rays have a filter of their own, since changing
+ * the material of a shape does not change the shadows it casts. */
+class TileDependencies
+{
+
+public:
+    static const float DEFAULT_CELL_SIZE;
+    static const int DEFAULT_TILE_SIZE = 32;
+    /* Size of each of a tile's filters. Must be a power of two. */
+    static const unsigned int DEFAULT_FILTER_BITS = 16384;
+
+    /* Rays are only tracked inside 'bounds', which should contain every
+     * shape in the scene. */
+    TileDependencies(const AABB& bounds, float cellSize = DEFAULT_CELL_SIZE,
+        unsigned int filterBits = DEFAULT_FILTER_BITS);
+
+    /* Forget everything recorded, then track the tiles of an image with
+     * the given settings. */
+    void reset(const RenderSettings& settings, int tileSize = DEFAULT_TILE_SIZE);
+    const RenderSettings& getSettings() const;
+    const TileList& getTiles() const;
+
+    /* Forget what tile's rays passed through, before it is rendered again. */
+    void clearTile(unsigned int tileIndex);
+    /* Record that a ray of the tile covered the segment from start to end. */
+    void recordSegment(unsigned int tileIndex, const Vector3& start, const Vector3& end,
+        bool shadowRay);
+    /* Indices of the tiles whose rays may have passed through any of the
+     * regions. Shadow rays are only considered if 'shapesChanged' is true,
+     * rather than just the materials of shapes in the regions. */
+    std::vector<unsigned int> affectedTiles(const std::vector<AABB>& regions,
+        bool shapesChanged) const;
+
+    size_t memoryUsed() const;
+
+private:
+    /* Clip segment to the tracked bounds. Returns false if it lies
+     * entirely outside them. */
+    bool clipToBounds(Vector3& start, Vector3& end) const;
+    /* Grid coordinate of the cell containing a point along one axis. */
+    int cellCoordinate(float position, float boundsMin) const;
+    /* Bits of a tile's filter set for a cell. */
+    void cellBits(int x, int y, int z, unsigned int& first, unsigned int& second) const;
+
+    AABB bounds;
+    float cellSize;
+    unsigned int filterBits;
+    unsigned int wordsPerFilter;
+
+    RenderSettings settings;
+    TileList tiles;
+    // Filters of every tile, one after another. Each tile's filter for
+    // shadow rays follows the one for all other rays.
+    std::vector<unsigned int> filters;
+
+};
+
+/* Render every tile of the image described by the dependencies' settings,
+ * recording what each tile's rays passed through. The renderer must already
+ * be configured for those settings. */
+void renderTrackedTiles(Raytracer* renderer, TileDependencies* dependencies,
+    Framebuffer* target);
+/* Render again only the tiles of an image rendered by renderTrackedTiles()
+ * which may have changed now the scene has changed inside the given regions.
+ * The regions should cover where changed shapes were before and where they
+ * are now. 'shapesChanged' is false if only materials changed (see
+ * TileDependencies::affectedTiles()). Returns the number of tiles rendered. */
+unsigned int renderAffectedTiles(Raytracer* renderer, TileDependencies* dependencies,
+    const std::vector<AABB>& changedRegions, bool shapesChanged, Framebuffer* target);
+
+}
+
+#endif
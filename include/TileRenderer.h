@@ -0,0 +1,56 @@
+#ifndef DW_RAYTRACER_TILERENDERER_H
+#define DW_RAYTRACER_TILERENDERER_H
+
+#include <vector>
+#include "Raytracer.h"
+#include "Framebuffer.h"
+#include "RenderSettings.h"
+#include "AccumulationBuffer.h"
+#include "GBuffer.h"
+
+namespace raytracer {
+
+/* Rectangular region of an image, in pixels. */
+struct Tile
+{
+    int x, y;
+    int width, height;
+
+    Tile() : x(0), y(0), width(0), height(0) { }
+    Tile(int x, int y, int width, int height) :
+        x(x), y(y), width(width), height(height)
+    {
+    }
+
+    int area() const { return width * height; }
+};
+
+typedef std::vector<Tile> TileList;
+
+/* Split region into tiles no larger than tileSize x tileSize, ordered
+ * from left to right, top to bottom. */
+TileList splitIntoTiles(const Tile& region, int tileSize);
+
+/* Render every pixel in the tile of the image described by 'settings'.
+ * Pixel (x, y) of the image is written to (x - targetX, y - targetY)
+ * in the target framebuffer, so tiles can be rendered into their own
+ * small image or straight into the full image. If a G-buffer prepared
+ * for the same render is given, surfaces cached in it are shaded rather
+ * than traced again, and any which are not cached yet are added to it. */
+void renderTile(Raytracer* renderer, const RenderSettings& settings,
+    const Tile& tile, Framebuffer* target, int targetX = 0, int targetY = 0,
+    GBuffer* gbuffer = NULL);
+
+/* Take every sample still needed by the pixels in the tile, adding them
+ * to the buffer. The image rendered is the one described by the buffer's
+ * settings. The G-buffer is used as in renderTile(). */
+void accumulateTile(Raytracer* renderer, AccumulationBuffer* buffer, const Tile& tile,
+    GBuffer* gbuffer = NULL);
+/* Take a single sample of pixel (x, y), using the G-buffer (if given) as
+ * in renderTile(). Returns false if nothing was hit. */
+bool renderSample(Raytracer* renderer, const RenderSettings& settings, int x, int y,
+    unsigned int sampleIndex, GBuffer* gbuffer, Colour& result);
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef DW_RAYTRACER_TRACING_H
+#define DW_RAYTRACER_TRACING_H
+
+#include <stdint.h>
+#include <string>
+#include "Common.h"
+
+namespace raytracer {
+
+/* Timeline of what each thread was doing and when: which tiles it rendered,
+ * which images it decoded, which accelerators it built and so on. Unlike
+ * the stage timers in Profiling.h, which add up where time goes, this shows
+ * how work was spread over time and threads, so idle threads, uneven
+ * sharing of work and slow tiles can be seen. Events are written out in
+ * Chrome's trace format, for chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Tracing is off until enable() is called. While it is off, each event
+ * costs a single load and branch, so events are left in normal builds.
+ * Each thread writes its events to its own ring buffer without locking,
+ * overwriting its oldest events once the buffer is full. */
+namespace tracing
+{
+
+    static const unsigned int DEFAULT_EVENTS_PER_THREAD = 65536;
+
+    extern bool tracingEnabled;
+
+    inline bool enabled()
+    {
+        return __atomic_load_n(&tracingEnabled, __ATOMIC_RELAXED);
+    }
+
+    /* Start recording events. Threads which record their first event from
+     * now on get room for 'eventsPerThread' events. */
+    void enable(unsigned int eventsPerThread = DEFAULT_EVENTS_PER_THREAD);
+    /* Stop recording events, keeping those already recorded. */
+    void disable();
+    /* Name the calling thread is shown with (e.g. "render thread"). Must be
+     * a string literal, or otherwise outlive the program's threads. */
+    void setThreadName(const char* name);
+
+    /* Record that the calling thread spent the cycles (see
+     * common::cycleCount()) from 'begin' to 'end' doing 'name'. 'detail'
+     * may be NULL; if 'hasPosition' is true, (x, y) is shown with the event
+     * (e.g. the tile rendered). Names and details must outlive the trace. */
+    void record(const char* name, const char* detail, bool hasPosition, int x, int y,
+        uint64_t begin, uint64_t end);
+    /* Number of events recorded and still held by the ring buffers. */
+    uint64_t eventCount();
+    /* Write every event held to a file in Chrome's JSON trace format.
+     * Threads may keep recording meanwhile, but events of a thread whose
+     * buffer is full can then be overwritten as they are written out.
+     * Returns false if the file could not be written. */
+    bool writeChromeTrace(const std::string& filename);
+
+    /* Records the time from its creation to its destruction as an event
+     * of the calling thread, if tracing was enabled when it was created. */
+    class ScopedEvent
+    {
+
+    public:
+        explicit ScopedEvent(const char* name, const char* detail = NULL) :
+            name(name), detail(detail), hasPosition(false), x(0), y(0),
+            start(enabled() ? common::cycleCount() : 0)
+        {
+        }
+
+        ScopedEvent(const char* name, int x, int y) :
+            name(name), detail(NULL), hasPosition(true), x(x), y(y),
+            start(enabled() ? common::cycleCount() : 0)
+        {
+        }
+
+        ~ScopedEvent()
+        {
+            if (start != 0)
+                record(name, detail, hasPosition, x, y, start, common::cycleCount());
+        }
+
+    private:
+        ScopedEvent(const ScopedEvent&);
+        ScopedEvent& operator=(const ScopedEvent&);
+
+        const char* name;
+        const char* detail;
+        bool hasPosition;
+        int x, y;
+        uint64_t start; // zero if tracing was disabled
+
+    };
+
+}
+
+}
+
+#endif
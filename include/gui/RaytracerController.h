@@ -6,13 +6,20 @@
 #include <QTimer>
 #include "gui/RaytracerWindow.h"
 #include "gui/RendererWorker.h"
-#include "gui/DemoScene.h"
+#include "DemoScene.h"
 #include "Raytracer.h"
+#include "AccumulationBuffer.h"
+#include "GBuffer.h"
 
 namespace raytracer { namespace gui {
 
 /* How long the canvas waits before drawing itself (in milliseconds). */
 static const unsigned int CANVAS_UPDATE_INTERVAL = 1000;
+/* How often the render's progress is saved, if checkpoints are enabled (in
+ * seconds). */
+static const double CHECKPOINT_INTERVAL = 30.0;
+/* Most samples a pixel is given by a render with a time budget. */
+static const unsigned int BUDGET_MAX_SAMPLES = 64;
 
 class RaytracerController : public QObject
 {
@@ -20,17 +27,22 @@ class RaytracerController : public QObject
 	Q_OBJECT
 	
 public:
-	RaytracerController(RaytracerWindow* window, DemoScene* scene);
+	/* If a checkpoint filename is given, the render's progress is saved to
+	 * it, so it can be resumed after the program is closed. */
+	RaytracerController(RaytracerWindow* window, DemoScene* scene,
+		const std::string& checkpointFilename = "");
 	virtual ~RaytracerController();
 
 public slots:
 	void renderStarted();
 	void renderFinished();
 	void saveImage();
+	/* Show how much memory the scene, canvas and render buffers use. */
+	void showMemoryUsage();
 
 	void samplingMethodChanged(int newIndex);
 	void localIlluminationChanged(int newState);
-	void useOctreeChanged(int newState);
+	void acceleratorChanged(int newIndex);
 	void renderButtonPressed();
 
 	/* Called periodically to ensure interface represents most recent program state. */
@@ -53,8 +65,18 @@ private:
 	// Thread and worker used to perform raytracing
 	QThread* workerThread;
 	RendererWorker* worker;
+	// Every sample taken by the current (or last) render
+	AccumulationBuffer accumulation;
+	// File the accumulation buffer is saved to, empty if it is not saved
+	std::string checkpointFilename;
+	// Surfaces hit by primary rays, so changing only the lights or
+	// effects doesn't need every primary ray to be traced again
+	GBuffer gbuffer;
 	// Timer with periodically tells the canvas widget to redraw its content
 	QTimer* updateTimer;
+	// Samples per pixel achieved by the last render with a time budget,
+	// shown in the status bar once it has finished
+	std::string budgetSummary;
 	
 };
 
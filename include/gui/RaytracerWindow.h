@@ -39,6 +39,8 @@ public:
 	QMenu* fileMenu;
 		QAction* quitAction;
 		QAction* saveAction;
+	QMenu* viewMenu;
+		QAction* memoryAction;
 	QScrollArea* canvasScrollArea;
 		CanvasWidget* canvasWidget;
 	QDockWidget* toolboxDock;
@@ -57,6 +59,9 @@ public:
 						QSpinBox* widthBox;
 						QLabel* xLabel;
 						QSpinBox* heightBox;
+					QBoxLayout* rayRowFourLayout;
+						QLabel* timeBudgetLabel;
+						QSpinBox* timeBudget; // in seconds, 0 if off
 			QGroupBox* effectsSettings;
 				QBoxLayout* effectsSettingsLayout;
 					QCheckBox* localIlluminationSwitch;
@@ -74,7 +79,9 @@ public:
 						QComboBox* viewpoint;
 			QGroupBox* geometricOptSettings;
 				QBoxLayout* geometricOptSettingsLayout;
-					QCheckBox* useOctree;
+					QBoxLayout* acceleratorRowLayout;
+						QLabel* acceleratorLabel;
+						QComboBox* accelerator;
 					QCheckBox* showOctree;
 			QPushButton* renderButton;
 	
@@ -2,33 +2,43 @@
 #define DW_RAYTRACER_GUI_RENDERERTHREADWORKER_H
 
 #include <QObject>
+#include <string>
 #include "Raytracer.h"
-#include "Image.h"
+#include "Framebuffer.h"
+#include "AccumulationBuffer.h"
+#include "GBuffer.h"
+#include "BudgetedRenderer.h"
 
 namespace raytracer { namespace gui {
 
-enum SamplingMethod
-{
-	SINGLESAMPLING = 0,
-	UNIFORM_MULTISAMPLING,
-	RANDOM_MULTISAMPLING
-};
-
 class RendererWorker : public QObject
 {
 
 	Q_OBJECT
 
 public:
-	RendererWorker(Raytracer* renderer, Image* canvas);
-	
-	/* Getters/setters for sampling method. */
-	void setSamplingMethod(SamplingMethod newMethod);
-	void setNumSamples(unsigned int newNumSamples);
-	/* Retrieves information on sampling method. */
-	SamplingMethod getSamplingMethod() const;
-	unsigned int getNumSamples() const;
+	/* Samples are added to 'accumulation', which also determines the
+	 * image being rendered (size and sampling). Pixels which already have
+	 * all their samples are not traced again, so a stopped render can be
+	 * resumed by rendering with the same buffer. */
+	RendererWorker(Raytracer* renderer, Framebuffer* canvas,
+		AccumulationBuffer* accumulation);
 	
+	/* Save accumulation buffer to the given file every 'interval' seconds,
+	 * and when the render stops, with the key of the scene rendered (see
+	 * AccumulationBuffer::save()). An empty filename disables checkpoints. */
+	void setCheckpoint(const std::string& filename, const std::string& sceneKey,
+		double interval);
+	/* Shade surfaces cached in the G-buffer instead of tracing primary
+	 * rays again, and cache any surfaces which aren't. The G-buffer must
+	 * have been prepared for the render. NULL disables caching. */
+	void setGBuffer(GBuffer* gbuffer);
+	/* Render for about 'seconds' with a BudgetedRenderer, rather than
+	 * taking every sample the accumulation buffer needs. The buffer must
+	 * use random multisampling. Zero disables the budget. */
+	void setTimeBudget(double seconds);
+	/* What the last render with a time budget achieved. */
+	const BudgetReport& getBudgetReport() const;
 	
 public slots:
 	void render();
@@ -40,22 +50,26 @@ signals:
 	void error(QString error);
 	
 private:
-	typedef bool (RendererWorker::*PixelRenderingMethod)(int, int, unsigned int, unsigned int, Colour&);
+	/* Write checkpoint file, if checkpoints are enabled. */
+	void saveCheckpoint();
+	/* Render with a time budget, showing the whole image as it improves. */
+	void renderBudgeted();
 
-	bool renderSinglesamplePixel(int i, int j, unsigned int canvasWidth,
-		unsigned int canvasHeight, Colour& result);
-	bool renderUniformMultisamplePixel(int i, int j, unsigned int canvasWidth,
-		unsigned int canvasHeight, Colour& result);
-	bool renderRandomMultisamplePixel(int i, int j, unsigned int canvasWidth,
-		unsigned int canvasHeight, Colour& result);
-	
 	Raytracer* renderer;
-	Image* canvas;
+	Framebuffer* canvas;
+	AccumulationBuffer* accumulation;
+	GBuffer* gbuffer;
 	bool rendering; // if true, worker will render
 	
-	// Determines the sampling method used and how many samples are tkaen	
-	SamplingMethod samplingMethod;
-	unsigned int numSamples;
+	double timeBudget; // in seconds, 0 if there is none
+	// Lives as long as the worker, so stop() can be called from another
+	// thread at any time
+	BudgetedRenderer budgetedRenderer;
+	BudgetReport budgetReport;
+	
+	std::string checkpointFilename;
+	std::string checkpointSceneKey;
+	double checkpointInterval; // in seconds
 
 };
 
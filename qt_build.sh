@@ -1,7 +1,13 @@
 #!/bin/sh
 
+# Run with PROFILING=1 (when generating the project) to show where rendering
+# time goes in the status bar
+DEFINES="DW_RAYTRACER_GUI_ENABLED"
+if [ -n "$PROFILING" ] ; then
+	DEFINES="$DEFINES DW_RAYTRACER_PROFILING_ENABLED"
+fi
 if [ "$1" = "project" ] ; then
-	qmake-qt4 -project "DEFINES += DW_RAYTRACER_GUI_ENABLED"
+	qmake-qt4 -project "DEFINES += $DEFINES" "LIBS += -lpthread"
 fi
 qmake-qt4
 make
@@ -0,0 +1,282 @@
+#include "Accelerator.h"
+#include "BVHAccelerator.h"
+#include "GridAccelerator.h"
+#include "AcceleratorTuning.h"
+#include "Common.h"
+#include "RayCost.h"
+#include <algorithm>
+#include <sstream>
+
+using namespace raytracer;
+
+PrimitiveStore::PrimitiveStore(const ShapeList& primitives,
+    const std::vector<AABB>& primitiveBounds, const AABB& boundingBox, Arena* arena) :
+    arena(arena), primitives(primitives), primitiveBounds(primitiveBounds),
+    boundingBox(boundingBox)
+{
+}
+
+PrimitiveStore::~PrimitiveStore()
+{
+    if (arena)
+        delete arena;
+    else
+        for (unsigned int i = 0; (i < primitives.size()); i++)
+            delete primitives[i];
+}
+
+unsigned int PrimitiveStore::size() const
+{
+    return primitives.size();
+}
+
+const ShapeList& PrimitiveStore::getPrimitives() const
+{
+    return primitives;
+}
+
+const std::vector<AABB>& PrimitiveStore::getPrimitiveBounds() const
+{
+    return primitiveBounds;
+}
+
+const AABB& PrimitiveStore::getBoundingBox() const
+{
+    return boundingBox;
+}
+
+size_t PrimitiveStore::memoryUsed() const
+{
+    size_t bytes = sizeof(PrimitiveStore) + (primitives.capacity() * sizeof(Shape*)) +
+        (primitiveBounds.capacity() * sizeof(AABB));
+    if (arena)
+        bytes += arena->memoryUsed();
+    return bytes;
+}
+
+AcceleratorParameters::AcceleratorParameters() :
+    octreeNodeCapacity(Octree::OCTREE_NODE_CAPACITY), octreeMaxDepth(0),
+    bvhLeafPrimitives(BVHAccelerator::MAX_LEAF_PRIMITIVES),
+    gridCellsPerPrimitive(GridAccelerator::CELLS_PER_PRIMITIVE)
+{
+}
+
+std::string raytracer::formatAcceleratorConfiguration(AcceleratorType type,
+    const AcceleratorParameters& parameters)
+{
+    std::stringstream ss;
+    ss << acceleratorName(type);
+    switch (type)
+    {
+    case OCTREE_ACCELERATOR:
+        ss << " node-capacity=" << parameters.octreeNodeCapacity << " max-depth=";
+        if (parameters.octreeMaxDepth > 0)
+            ss << parameters.octreeMaxDepth;
+        else
+            ss << "none";
+        break;
+    case BVH_ACCELERATOR:
+        ss << " leaf-primitives=" << parameters.bvhLeafPrimitives;
+        break;
+    case GRID_ACCELERATOR:
+        ss << " cells-per-primitive=" << parameters.gridCellsPerPrimitive;
+        break;
+    default:
+        break;
+    }
+    return ss.str();
+}
+
+Accelerator::Accelerator(const PrimitiveStore* primitives,
+    const AcceleratorParameters& parameters) :
+    primitives(primitives), parameters(parameters), buildSeconds(0.0)
+{
+}
+
+Accelerator* Accelerator::build(AcceleratorType type, const PrimitiveStore* primitives,
+    const AcceleratorParameters& parameters)
+{
+    double start = common::wallClockSeconds();
+    Accelerator* accelerator = NULL;
+    switch (type)
+    {
+    case OCTREE_ACCELERATOR:
+        accelerator = new OctreeAccelerator(primitives, parameters);
+        break;
+    case BVH_ACCELERATOR:
+        accelerator = new BVHAccelerator(primitives, parameters);
+        break;
+    case GRID_ACCELERATOR:
+        accelerator = new GridAccelerator(primitives, parameters);
+        break;
+    case AUTO_ACCELERATOR:
+        accelerator = buildTunedAccelerator(primitives,
+            overheadProbeRays(primitives->getBoundingBox()));
+        break;
+    default:
+        accelerator = new FlatAccelerator(primitives);
+        break;
+    }
+    accelerator->setBuildSeconds(common::wallClockSeconds() - start);
+    return accelerator;
+}
+
+const PrimitiveStore* Accelerator::getPrimitives() const
+{
+    return primitives;
+}
+
+const AcceleratorParameters& Accelerator::getParameters() const
+{
+    return parameters;
+}
+
+double Accelerator::getBuildSeconds() const
+{
+    return buildSeconds;
+}
+
+void Accelerator::setBuildSeconds(double seconds)
+{
+    buildSeconds = seconds;
+}
+
+FlatAccelerator::FlatAccelerator(const PrimitiveStore* primitives) :
+    Accelerator(primitives, AcceleratorParameters())
+{
+    const AABB& box = primitives->getBoundingBox();
+    centre = box.bounds[0] + ((box.bounds[1] - box.bounds[0]) / 2);
+}
+
+AcceleratorType FlatAccelerator::getType() const
+{
+    return FLAT_ACCELERATOR;
+}
+
+size_t FlatAccelerator::memoryUsed() const
+{
+    return sizeof(FlatAccelerator);
+}
+
+AcceleratorStatistics FlatAccelerator::statistics() const
+{
+    // A single leaf holding every primitive
+    AcceleratorStatistics result(primitives->getBoundingBox());
+    result.addNode(primitives->getBoundingBox(), 0, true, primitives->size());
+    result.memoryBytes = memoryUsed();
+    return result;
+}
+
+const Vector3& FlatAccelerator::getCentre() const
+{
+    return centre;
+}
+
+bool FlatAccelerator::hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const
+{
+    raycost::countNodeVisit();
+    if (!primitives->getBoundingBox().intersects(ray, tMin, tMax))
+        return false;
+    const ShapeList& shapes = primitives->getPrimitives();
+    bool isAHit = false;
+    for (unsigned int i = 0; (i < shapes.size()); i++)
+    {
+        // Keep tMax up-to-date so only the closest hit is kept
+        if (shapes[i]->hit(ray, tMin, tMax, 0.0f, record))
+        {
+            tMax = record.t;
+            isAHit = true;
+        }
+    }
+    return isAHit;
+}
+
+bool FlatAccelerator::shadowHit(const Ray& ray, float tMin, float tMax, float time,
+    const Shape*& occludingShape) const
+{
+    raycost::countNodeVisit();
+    if (!primitives->getBoundingBox().intersects(ray, tMin, tMax))
+        return false;
+    const ShapeList& shapes = primitives->getPrimitives();
+    for (unsigned int i = 0; (i < shapes.size()); i++)
+        if (shapes[i]->shadowHit(ray, tMin, tMax, 0.0f, occludingShape))
+            return true;
+    return false;
+}
+
+OctreeAccelerator::OctreeAccelerator(const PrimitiveStore* primitives,
+    const AcceleratorParameters& parameters) : Accelerator(primitives, parameters),
+    arena(new Arena())
+{
+    octree = new (*arena) Octree(primitives->getBoundingBox(), arena,
+        parameters.octreeNodeCapacity, parameters.octreeMaxDepth);
+    const ShapeList& shapes = primitives->getPrimitives();
+    for (unsigned int i = 0; (i < shapes.size()); i++)
+        octree->insert(shapes[i]);
+    octree->fitBounds(shapes, primitives->getPrimitiveBounds());
+}
+
+OctreeAccelerator::OctreeAccelerator(const PrimitiveStore* primitives, Arena* arena,
+    Octree* octree) : Accelerator(primitives, AcceleratorParameters()), arena(arena),
+    octree(octree)
+{
+}
+
+OctreeAccelerator::~OctreeAccelerator()
+{
+    delete arena; // frees every node of the octree
+}
+
+OctreeAccelerator* OctreeAccelerator::fromFlattened(const PrimitiveStore* primitives,
+    const FlatOctreeNode* nodes, unsigned int numNodes)
+{
+    // Room for every node in one block
+    Arena* arena = new Arena(std::max(numNodes * sizeof(Octree), Arena::DEFAULT_BLOCK_SIZE));
+    Octree* octree = Octree::fromFlattened(nodes, numNodes, primitives->getPrimitives(), arena);
+    if (!octree)
+    {
+        delete arena;
+        return NULL;
+    }
+    return new OctreeAccelerator(primitives, arena, octree);
+}
+
+Octree* OctreeAccelerator::getOctree() const
+{
+    return octree;
+}
+
+AcceleratorType OctreeAccelerator::getType() const
+{
+    return OCTREE_ACCELERATOR;
+}
+
+size_t OctreeAccelerator::memoryUsed() const
+{
+    return sizeof(OctreeAccelerator) + arena->memoryUsed();
+}
+
+AcceleratorStatistics OctreeAccelerator::statistics() const
+{
+    AcceleratorStatistics result(primitives->getBoundingBox());
+    octree->addStatistics(result);
+    result.memoryBytes = memoryUsed();
+    return result;
+}
+
+const Vector3& OctreeAccelerator::getCentre() const
+{
+    return octree->getCentre();
+}
+
+bool OctreeAccelerator::hit(const Ray& ray, float tMin, float tMax, float time,
+    HitRecord& record) const
+{
+    return octree->hit(ray, tMin, tMax, time, record);
+}
+
+bool OctreeAccelerator::shadowHit(const Ray& ray, float tMin, float tMax, float time,
+    const Shape*& occludingShape) const
+{
+    return octree->shadowHit(ray, tMin, tMax, time, occludingShape);
+}
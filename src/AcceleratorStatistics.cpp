@@ -0,0 +1,95 @@
+#include "AcceleratorStatistics.h"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+using namespace raytracer;
+
+const unsigned int AcceleratorStatistics::MAX_COUNTED_OCCUPANCY;
+
+/* Costs of visiting a node and of testing a primitive, relative to each
+ * other, used for the SAH cost. */
+static const double SAH_TRAVERSAL_COST = 1.0;
+static const double SAH_INTERSECTION_COST = 1.0;
+
+float raytracer::surfaceArea(const AABB& box)
+{
+    Vector3 extent = box.bounds[1] - box.bounds[0];
+    return 2.0f * ((extent.x * extent.y) + (extent.y * extent.z) + (extent.z * extent.x));
+}
+
+AcceleratorStatistics::AcceleratorStatistics(const AABB& rootBounds) : numNodes(0),
+    numLeaves(0), leafOccupancy(MAX_COUNTED_OCCUPANCY + 1, 0), maxLeafPrimitives(0),
+    primitiveReferences(0), memoryBytes(0), sahCost(0.0), rootArea(surfaceArea(rootBounds))
+{
+}
+
+void AcceleratorStatistics::addNode(const AABB& bounds, unsigned int depth, bool isLeaf,
+    unsigned int numPrimitives)
+{
+    numNodes++;
+    if (depth >= nodesAtDepth.size())
+        nodesAtDepth.resize(depth + 1, 0);
+    nodesAtDepth[depth]++;
+    // Chance of a ray which crosses the root's box crossing this node's box
+    double probability = (rootArea > 0.0f) ?
+        std::min(1.0, static_cast<double>(surfaceArea(bounds)) / rootArea) : 1.0;
+    sahCost += probability * SAH_TRAVERSAL_COST;
+    if (isLeaf)
+    {
+        numLeaves++;
+        leafOccupancy[std::min(numPrimitives, MAX_COUNTED_OCCUPANCY)]++;
+        maxLeafPrimitives = std::max(maxLeafPrimitives, numPrimitives);
+        primitiveReferences += numPrimitives;
+        sahCost += probability * numPrimitives * SAH_INTERSECTION_COST;
+    }
+}
+
+unsigned int AcceleratorStatistics::maxDepth() const
+{
+    return (nodesAtDepth.empty()) ? 0 : nodesAtDepth.size() - 1;
+}
+
+double AcceleratorStatistics::meanLeafPrimitives() const
+{
+    return (numLeaves > 0) ? static_cast<double>(primitiveReferences) / numLeaves : 0.0;
+}
+
+std::string AcceleratorStatistics::format(const std::string& indent) const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    ss << indent << numNodes << " nodes (" << numLeaves << " leaves), depth "
+        << maxDepth() << ", " << meanLeafPrimitives() << " primitives per leaf (max "
+        << maxLeafPrimitives << "), " << (memoryBytes / 1024.0) << " KB, SAH cost "
+        << sahCost << "\n";
+    ss << indent << "nodes at each depth:";
+    for (unsigned int i = 0; (i < nodesAtDepth.size()); i++)
+        ss << " " << nodesAtDepth[i];
+    ss << "\n" << indent << "leaves by primitives held:";
+    for (unsigned int i = 0; (i < leafOccupancy.size()); i++)
+    {
+        if (leafOccupancy[i] > 0)
+            ss << " " << i << ((i == MAX_COUNTED_OCCUPANCY) ? "+" : "") << ":"
+                << leafOccupancy[i];
+    }
+    ss << "\n";
+    return ss.str();
+}
+
+std::string AcceleratorStatistics::formatJSON() const
+{
+    std::stringstream ss;
+    ss << "{\"nodes\": " << numNodes << ", \"leaves\": " << numLeaves
+        << ", \"maxDepth\": " << maxDepth() << ", \"meanLeafPrimitives\": "
+        << meanLeafPrimitives() << ", \"maxLeafPrimitives\": " << maxLeafPrimitives
+        << ", \"memoryBytes\": " << memoryBytes << ", \"sahCost\": " << sahCost
+        << ", \"nodesAtDepth\": [";
+    for (unsigned int i = 0; (i < nodesAtDepth.size()); i++)
+        ss << ((i > 0) ? ", " : "") << nodesAtDepth[i];
+    ss << "], \"leafOccupancy\": [";
+    for (unsigned int i = 0; (i < leafOccupancy.size()); i++)
+        ss << ((i > 0) ? ", " : "") << leafOccupancy[i];
+    ss << "]}";
+    return ss.str();
+}
@@ -0,0 +1,132 @@
+#include "AcceleratorTuning.h"
+#include "Raytracer.h"
+#include "Common.h"
+#include "Tracing.h"
+
+using namespace raytracer;
+
+/* Times each candidate traces the probe rays, keeping the fastest, so a
+ * candidate is not let down by the odd interruption. */
+static const unsigned int TUNING_PASSES = 3;
+
+// Parameters tried for each type. The flat accelerator is not tried, as it
+// is only ever fastest for a handful of primitives.
+static const unsigned int TUNED_OCTREE_CAPACITIES[] = { 4, 8, 16, 32 };
+static const unsigned int TUNED_OCTREE_MAX_DEPTHS[] = { 0, 6, 8 };
+static const unsigned int TUNED_BVH_LEAF_PRIMITIVES[] = { 1, 2, 4, 8 };
+static const float TUNED_GRID_CELLS_PER_PRIMITIVE[] = { 0.5f, 1.0f, 2.0f, 4.0f };
+static const unsigned int NUM_TUNED_OCTREE_CAPACITIES =
+    sizeof(TUNED_OCTREE_CAPACITIES) / sizeof(TUNED_OCTREE_CAPACITIES[0]);
+static const unsigned int NUM_TUNED_OCTREE_MAX_DEPTHS =
+    sizeof(TUNED_OCTREE_MAX_DEPTHS) / sizeof(TUNED_OCTREE_MAX_DEPTHS[0]);
+static const unsigned int NUM_TUNED_BVH_LEAF_PRIMITIVES =
+    sizeof(TUNED_BVH_LEAF_PRIMITIVES) / sizeof(TUNED_BVH_LEAF_PRIMITIVES[0]);
+static const unsigned int NUM_TUNED_GRID_CELLS_PER_PRIMITIVE =
+    sizeof(TUNED_GRID_CELLS_PER_PRIMITIVE) / sizeof(TUNED_GRID_CELLS_PER_PRIMITIVE[0]);
+
+std::vector<AcceleratorConfiguration> raytracer::tuningCandidates()
+{
+    std::vector<AcceleratorConfiguration> candidates;
+    for (unsigned int i = 0; (i < NUM_TUNED_OCTREE_CAPACITIES); i++)
+    {
+        for (unsigned int j = 0; (j < NUM_TUNED_OCTREE_MAX_DEPTHS); j++)
+        {
+            AcceleratorParameters parameters;
+            parameters.octreeNodeCapacity = TUNED_OCTREE_CAPACITIES[i];
+            parameters.octreeMaxDepth = TUNED_OCTREE_MAX_DEPTHS[j];
+            candidates.push_back(AcceleratorConfiguration(OCTREE_ACCELERATOR, parameters));
+        }
+    }
+    for (unsigned int i = 0; (i < NUM_TUNED_BVH_LEAF_PRIMITIVES); i++)
+    {
+        AcceleratorParameters parameters;
+        parameters.bvhLeafPrimitives = TUNED_BVH_LEAF_PRIMITIVES[i];
+        candidates.push_back(AcceleratorConfiguration(BVH_ACCELERATOR, parameters));
+    }
+    for (unsigned int i = 0; (i < NUM_TUNED_GRID_CELLS_PER_PRIMITIVE); i++)
+    {
+        AcceleratorParameters parameters;
+        parameters.gridCellsPerPrimitive = TUNED_GRID_CELLS_PER_PRIMITIVE[i];
+        candidates.push_back(AcceleratorConfiguration(GRID_ACCELERATOR, parameters));
+    }
+    return candidates;
+}
+
+/* Cycles taken by the fastest pass of tracing every probe ray. */
+uint64_t timeProbeRays(const Accelerator* accelerator, const std::vector<Ray>& probeRays)
+{
+    uint64_t fastest = 0;
+    for (unsigned int pass = 0; (pass < TUNING_PASSES); pass++)
+    {
+        uint64_t start = common::cycleCount();
+        for (unsigned int i = 0; (i < probeRays.size()); i++)
+        {
+            HitRecord record;
+            accelerator->hit(probeRays[i], 0.00001f, MAX_RAY_DISTANCE, 0.0f, record);
+        }
+        uint64_t cycles = common::cycleCount() - start;
+        if (pass == 0 || cycles < fastest)
+            fastest = cycles;
+    }
+    return fastest;
+}
+
+Accelerator* raytracer::buildTunedAccelerator(const PrimitiveStore* primitives,
+    const std::vector<Ray>& probeRays)
+{
+    if (probeRays.empty())
+        return new OctreeAccelerator(primitives);
+    std::vector<AcceleratorConfiguration> candidates = tuningCandidates();
+    Accelerator* fastest = NULL;
+    uint64_t fastestCycles = 0;
+    for (unsigned int i = 0; (i < candidates.size()); i++)
+    {
+        tracing::ScopedEvent event("try accelerator", acceleratorName(candidates[i].type));
+        Accelerator* accelerator = Accelerator::build(candidates[i].type, primitives,
+            candidates[i].parameters);
+        uint64_t cycles = timeProbeRays(accelerator, probeRays);
+        if (!fastest || cycles < fastestCycles)
+        {
+            delete fastest;
+            fastest = accelerator;
+            fastestCycles = cycles;
+        }
+        else
+        {
+            delete accelerator;
+        }
+    }
+    return fastest;
+}
+
+void raytracer::addCameraProbeRays(Camera camera, unsigned int raysPerSide,
+    std::vector<Ray>& rays)
+{
+    for (unsigned int y = 0; (y < raysPerSide); y++)
+    {
+        for (unsigned int x = 0; (x < raysPerSide); x++)
+        {
+            rays.push_back(camera.getRayToPixel((x + 0.5f) / raysPerSide,
+                (y + 0.5f) / raysPerSide));
+        }
+    }
+}
+
+std::vector<Ray> raytracer::overheadProbeRays(const AABB& box, unsigned int raysPerSide)
+{
+    // The scene's up axis is y
+    Vector3 direction = Vector3(0.5f, -1.0f, 0.3f).normalise();
+    Vector3 extent = box.bounds[1] - box.bounds[0];
+    float distance = extent.length() + 1.0f;
+    std::vector<Ray> rays;
+    for (unsigned int z = 0; (z < raysPerSide); z++)
+    {
+        for (unsigned int x = 0; (x < raysPerSide); x++)
+        {
+            Vector3 target = box.bounds[0] + Vector3(extent.x * (x + 0.5f) / raysPerSide,
+                0.0f, extent.z * (z + 0.5f) / raysPerSide);
+            rays.push_back(Ray(target - (direction * distance), direction));
+        }
+    }
+    return rays;
+}
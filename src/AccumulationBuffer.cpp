@@ -0,0 +1,199 @@
+#include "AccumulationBuffer.h"
+#include <fstream>
+#include <cstdio>
+
+using namespace raytracer;
+
+/* Identifies checkpoint files written by AccumulationBuffer. */
+static const unsigned int CHECKPOINT_MAGIC = 0x43415744; // "DWAC"
+static const unsigned int CHECKPOINT_VERSION = 2;
+
+struct CheckpointHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    int width;
+    int height;
+    // Length of the render settings and of the scene key, stored as text
+    // after the header in that order
+    unsigned int settingsLength;
+    unsigned int sceneKeyLength;
+};
+
+/* Settings with the number of samples removed, so settings can be
+ * compared without it. */
+static std::string settingsWithoutSamples(RenderSettings settings)
+{
+    settings.numSamples = 0;
+    return formatRenderSettings(settings);
+}
+
+AccumulationBuffer::AccumulationBuffer() : numPixelsComplete(0)
+{
+    settings.width = 0;
+    settings.height = 0;
+}
+
+void AccumulationBuffer::reset(const RenderSettings& newSettings)
+{
+    settings = newSettings;
+    AccumulatedPixel empty = { 0.0f, 0.0f, 0.0f, 0, 0 };
+    pixels.assign(static_cast<size_t>(settings.width) * settings.height, empty);
+    numPixelsComplete = 0;
+}
+
+bool AccumulationBuffer::canContinue(const RenderSettings& newSettings) const
+{
+    if (pixels.empty() || settingsWithoutSamples(settings) != settingsWithoutSamples(newSettings))
+        return false;
+    // Grid positions depend on the number of samples, random ones don't
+    return (settings.samplingMethod == RANDOM_MULTISAMPLING ||
+        settings.numSamples == newSettings.numSamples);
+}
+
+void AccumulationBuffer::continueWith(const RenderSettings& newSettings)
+{
+    settings = newSettings;
+    countCompletePixels();
+}
+
+const RenderSettings& AccumulationBuffer::getSettings() const
+{
+    return settings;
+}
+
+int AccumulationBuffer::getWidth() const
+{
+    return settings.width;
+}
+
+int AccumulationBuffer::getHeight() const
+{
+    return settings.height;
+}
+
+unsigned int AccumulationBuffer::pixelIndex(int x, int y) const
+{
+    return (y * settings.width) + x;
+}
+
+void AccumulationBuffer::addSample(int x, int y, const Colour& colour, bool hit)
+{
+    AccumulatedPixel& pixel = pixels[pixelIndex(x, y)];
+    if (hit)
+    {
+        pixel.r += colour.r;
+        pixel.g += colour.g;
+        pixel.b += colour.b;
+        pixel.hits++;
+    }
+    pixel.samples++;
+    if (pixel.samples == samplesPerPixel(settings))
+        numPixelsComplete++;
+}
+
+unsigned int AccumulationBuffer::samplesTaken(int x, int y) const
+{
+    return pixels[pixelIndex(x, y)].samples;
+}
+
+unsigned int AccumulationBuffer::samplesNeeded(int x, int y) const
+{
+    unsigned int required = samplesPerPixel(settings);
+    unsigned int taken = samplesTaken(x, y);
+    return (taken < required) ? (required - taken) : 0;
+}
+
+unsigned int AccumulationBuffer::pixelsComplete() const
+{
+    return numPixelsComplete;
+}
+
+bool AccumulationBuffer::isComplete() const
+{
+    return (numPixelsComplete == pixels.size());
+}
+
+size_t AccumulationBuffer::memoryUsed() const
+{
+    return pixels.capacity() * sizeof(AccumulatedPixel);
+}
+
+void AccumulationBuffer::countCompletePixels()
+{
+    unsigned int required = samplesPerPixel(settings);
+    numPixelsComplete = 0;
+    for (unsigned int i = 0; (i < pixels.size()); i++)
+        if (pixels[i].samples >= required)
+            numPixelsComplete++;
+}
+
+Colour AccumulationBuffer::resolve(int x, int y) const
+{
+    const AccumulatedPixel& pixel = pixels[pixelIndex(x, y)];
+    if (pixel.hits == 0)
+        return BACKGROUND_COLOUR;
+    return Colour(pixel.r, pixel.g, pixel.b) / pixel.hits;
+}
+
+void AccumulationBuffer::resolveInto(Framebuffer* target) const
+{
+    for (int y = 0; (y < settings.height); y++)
+        for (int x = 0; (x < settings.width); x++)
+            if (samplesTaken(x, y) > 0)
+                target->set(x, y, resolve(x, y));
+}
+
+bool AccumulationBuffer::save(const std::string& filename, const std::string& sceneKey) const
+{
+    // Write to temporary file first, then move it over the old checkpoint
+    std::string temporaryFilename = filename + ".tmp";
+    std::ofstream file(temporaryFilename.c_str(), std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    std::string settingsText = formatRenderSettings(settings);
+    CheckpointHeader header = { CHECKPOINT_MAGIC, CHECKPOINT_VERSION,
+        settings.width, settings.height, static_cast<unsigned int>(settingsText.size()),
+        static_cast<unsigned int>(sceneKey.size()) };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(settingsText.c_str(), settingsText.size());
+    file.write(sceneKey.c_str(), sceneKey.size());
+    if (!pixels.empty())
+        file.write(reinterpret_cast<const char*>(&pixels[0]),
+            pixels.size() * sizeof(AccumulatedPixel));
+    file.close();
+    if (file.fail())
+        return false;
+    return (rename(temporaryFilename.c_str(), filename.c_str()) == 0);
+}
+
+bool AccumulationBuffer::load(const std::string& filename, const std::string& sceneKey)
+{
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    CheckpointHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION ||
+        header.width <= 0 || header.height <= 0 || header.settingsLength > 4096 ||
+        header.sceneKeyLength != sceneKey.size())
+        return false;
+    std::string settingsText(header.settingsLength, ' ');
+    std::string loadedSceneKey(header.sceneKeyLength, ' ');
+    RenderSettings loadedSettings;
+    if (!file.read(&settingsText[0], header.settingsLength) ||
+        !parseRenderSettings(settingsText, loadedSettings) ||
+        loadedSettings.width != header.width || loadedSettings.height != header.height ||
+        !file.read(&loadedSceneKey[0], header.sceneKeyLength) || loadedSceneKey != sceneKey)
+        return false;
+    std::vector<AccumulatedPixel> loadedPixels(
+        static_cast<size_t>(header.width) * header.height);
+    if (!file.read(reinterpret_cast<char*>(&loadedPixels[0]),
+        loadedPixels.size() * sizeof(AccumulatedPixel)))
+        return false;
+
+    settings = loadedSettings;
+    pixels.swap(loadedPixels);
+    countCompletePixels();
+    return true;
+}
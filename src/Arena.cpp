@@ -0,0 +1,82 @@
+#include "Arena.h"
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+using namespace raytracer;
+
+const size_t Arena::DEFAULT_BLOCK_SIZE;
+const size_t Arena::HUGE_PAGE_SIZE;
+
+Arena::Arena(size_t blockSize, bool useHugePages) : blockSize(blockSize),
+    useHugePages(useHugePages), next(NULL), end(NULL), bytesReserved(0)
+{
+}
+
+Arena::~Arena()
+{
+    for (unsigned int i = 0; (i < blocks.size()); i++)
+        free(blocks[i]);
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment)
+{
+    // Round up to the next multiple of the alignment, which is a power of two
+    size_t address = reinterpret_cast<size_t>(next);
+    size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+    if (!next || padding + bytes > static_cast<size_t>(end - next))
+    {
+        // New blocks are aligned to at least 16 bytes
+        if (!addBlock(bytes + alignment))
+            return NULL;
+        address = reinterpret_cast<size_t>(next);
+        padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+    }
+    void* pointer = next + padding;
+    next += padding + bytes;
+    return pointer;
+}
+
+size_t Arena::memoryUsed() const
+{
+    return bytesReserved;
+}
+
+bool Arena::addBlock(size_t bytes)
+{
+    size_t size = (bytes > blockSize) ? bytes : blockSize;
+    size_t alignment = 16;
+    bool hugePages = (useHugePages && size >= HUGE_PAGE_SIZE);
+    if (hugePages)
+    {
+        // Whole huge pages only, so none is shared with another allocation
+        size = ((size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE;
+        alignment = HUGE_PAGE_SIZE;
+    }
+    void* block = NULL;
+    if (posix_memalign(&block, alignment, size) != 0)
+        return false;
+#ifdef MADV_HUGEPAGE
+    // Only a hint, which is ignored if huge pages are disabled
+    if (hugePages)
+        madvise(block, size, MADV_HUGEPAGE);
+#endif
+    blocks.push_back(block);
+    next = static_cast<char*>(block);
+    end = next + size;
+    bytesReserved += size;
+    return true;
+}
+
+void* operator new(size_t bytes, raytracer::Arena& arena)
+{
+    void* pointer = arena.allocate(bytes);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void operator delete(void*, raytracer::Arena&)
+{
+    // Memory is freed along with the arena
+}
@@ -0,0 +1,220 @@
+#include "BVHAccelerator.h"
+#include "RayCost.h"
+#include <algorithm>
+
+using namespace raytracer;
+
+/* Deepest a tree is allowed to be, which bounds the size of the stack
+ * used to walk it. */
+static const unsigned int MAX_BVH_DEPTH = 64;
+
+/* Orders primitives by the centre of their bounding box along an axis. */
+class CentreOnAxisLess
+{
+
+public:
+    CentreOnAxisLess(const std::vector<AABB>& bounds, int axis) : bounds(bounds), axis(axis)
+    {
+    }
+
+    bool operator()(unsigned int a, unsigned int b) const
+    {
+        return centre(a) < centre(b);
+    }
+
+    float centre(unsigned int primitive) const
+    {
+        return bounds[primitive].bounds[0][axis] +
+            bounds[primitive].bounds[1][axis];
+    }
+
+private:
+    const std::vector<AABB>& bounds;
+    int axis;
+
+};
+
+/* True for primitives whose centre is before a split position. */
+class CentreBefore
+{
+
+public:
+    CentreBefore(const CentreOnAxisLess& centres, float split) : centres(centres), split(split)
+    {
+    }
+
+    bool operator()(unsigned int primitive) const
+    {
+        return centres.centre(primitive) < split;
+    }
+
+private:
+    CentreOnAxisLess centres;
+    float split;
+
+};
+
+BVHAccelerator::BVHAccelerator(const PrimitiveStore* primitives,
+    const AcceleratorParameters& parameters) : Accelerator(primitives, parameters),
+    maxLeafPrimitives(std::max(parameters.bvhLeafPrimitives, 1u))
+{
+    order.resize(primitives->size());
+    for (unsigned int i = 0; (i < order.size()); i++)
+        order[i] = i;
+    nodes.reserve(2 * ((order.size() / maxLeafPrimitives) + 1));
+    if (!order.empty())
+        buildNode(0, order.size(), 0);
+    const AABB& box = (nodes.empty()) ? primitives->getBoundingBox() : nodes[0].bounds;
+    centre = box.bounds[0] + ((box.bounds[1] - box.bounds[0]) / 2);
+}
+
+unsigned int BVHAccelerator::buildNode(unsigned int start, unsigned int end, unsigned int depth)
+{
+    const std::vector<AABB>& primitiveBounds = primitives->getPrimitiveBounds();
+    unsigned int index = nodes.size();
+    nodes.push_back(Node());
+    // Find box around primitives, and around their centres
+    AABB bounds = primitiveBounds[order[start]];
+    Vector3 centreMin = (bounds.bounds[0] + bounds.bounds[1]) * 0.5f;
+    AABB centreBounds(centreMin, centreMin);
+    for (unsigned int i = start + 1; (i < end); i++)
+    {
+        const AABB& box = primitiveBounds[order[i]];
+        bounds.expand(box);
+        Vector3 boxCentre = (box.bounds[0] + box.bounds[1]) * 0.5f;
+        centreBounds.expand(AABB(boxCentre, boxCentre));
+    }
+    nodes[index].bounds = bounds;
+
+    unsigned int count = end - start;
+    if (count <= maxLeafPrimitives || depth + 1 >= MAX_BVH_DEPTH)
+    {
+        nodes[index].index = start;
+        nodes[index].numPrimitives = count;
+        return index;
+    }
+
+    // Split at middle of longest axis of the centres. If every primitive
+    // ends up on one side, split them in half instead.
+    Vector3 extent = centreBounds.bounds[1] - centreBounds.bounds[0];
+    int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : ((extent.y > extent.z) ? 1 : 2);
+    CentreOnAxisLess centres(primitiveBounds, axis);
+    float split = centreBounds.bounds[0][axis] + centreBounds.bounds[1][axis];
+    unsigned int middle = std::partition(order.begin() + start, order.begin() + end,
+        CentreBefore(centres, split)) - order.begin();
+    if (middle == start || middle == end)
+    {
+        middle = start + (count / 2);
+        std::nth_element(order.begin() + start, order.begin() + middle, order.begin() + end, centres);
+    }
+    buildNode(start, middle, depth + 1);
+    unsigned int secondChild = buildNode(middle, end, depth + 1);
+    nodes[index].index = secondChild;
+    nodes[index].numPrimitives = 0;
+    return index;
+}
+
+AcceleratorType BVHAccelerator::getType() const
+{
+    return BVH_ACCELERATOR;
+}
+
+size_t BVHAccelerator::memoryUsed() const
+{
+    return sizeof(BVHAccelerator) + (nodes.capacity() * sizeof(Node)) +
+        (order.capacity() * sizeof(unsigned int));
+}
+
+AcceleratorStatistics BVHAccelerator::statistics() const
+{
+    AcceleratorStatistics result((nodes.empty()) ? primitives->getBoundingBox() : nodes[0].bounds);
+    if (!nodes.empty())
+        addNodeStatistics(0, 0, result);
+    result.memoryBytes = memoryUsed();
+    return result;
+}
+
+void BVHAccelerator::addNodeStatistics(unsigned int index, unsigned int depth,
+    AcceleratorStatistics& statistics) const
+{
+    const Node& node = nodes[index];
+    statistics.addNode(node.bounds, depth, (node.numPrimitives > 0), node.numPrimitives);
+    if (node.numPrimitives == 0)
+    {
+        addNodeStatistics(index + 1, depth + 1, statistics);
+        addNodeStatistics(node.index, depth + 1, statistics);
+    }
+}
+
+const Vector3& BVHAccelerator::getCentre() const
+{
+    return centre;
+}
+
+bool BVHAccelerator::hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const
+{
+    if (nodes.empty())
+        return false;
+    const ShapeList& shapes = primitives->getPrimitives();
+    bool isAHit = false;
+    unsigned int stack[MAX_BVH_DEPTH + 1];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+        raycost::countNodeVisit();
+        // tMax shrinks as closer hits are found, so later boxes are culled
+        if (!node.bounds.intersects(ray, tMin, tMax))
+            continue;
+        if (node.numPrimitives > 0)
+        {
+            for (unsigned int i = 0; (i < node.numPrimitives); i++)
+            {
+                if (shapes[order[node.index + i]]->hit(ray, tMin, tMax, time, record))
+                {
+                    tMax = record.t;
+                    isAHit = true;
+                }
+            }
+        }
+        else
+        {
+            unsigned int firstChild = (&node - &nodes[0]) + 1;
+            stack[stackSize++] = node.index;
+            stack[stackSize++] = firstChild;
+        }
+    }
+    return isAHit;
+}
+
+bool BVHAccelerator::shadowHit(const Ray& ray, float tMin, float tMax, float time,
+    const Shape*& occludingShape) const
+{
+    if (nodes.empty())
+        return false;
+    const ShapeList& shapes = primitives->getPrimitives();
+    unsigned int stack[MAX_BVH_DEPTH + 1];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+        raycost::countNodeVisit();
+        if (!node.bounds.intersects(ray, tMin, tMax))
+            continue;
+        if (node.numPrimitives > 0)
+        {
+            for (unsigned int i = 0; (i < node.numPrimitives); i++)
+                if (shapes[order[node.index + i]]->shadowHit(ray, tMin, tMax, time, occludingShape))
+                    return true;
+        }
+        else
+        {
+            unsigned int firstChild = (&node - &nodes[0]) + 1;
+            stack[stackSize++] = node.index;
+            stack[stackSize++] = firstChild;
+        }
+    }
+    return false;
+}
@@ -1,4 +1,6 @@
 #include "BoundingShape.h"
+#include "RayCost.h"
+#include <algorithm>
 
 using namespace raytracer;
 
@@ -28,11 +30,20 @@ void BoundingShape::addShape(Shape* newShape)
 
 bool BoundingShape::removeShape(Shape* shapeToRemove)
 {
-	children.erase( std::remove(children.begin(), children.end(), shapeToRemove), children.end() );
+	ShapeList::iterator newEnd = std::remove(children.begin(), children.end(), shapeToRemove);
+	bool removed = (newEnd != children.end());
+	children.erase(newEnd, children.end());
+	return removed;
+}
+
+unsigned int BoundingShape::numShapes() const
+{
+	return children.size();
 }
 
 bool BoundingShape::hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const
 {
+    raycost::countNodeVisit();
     // First check if ray intersects with the bounding box
     if (!boundingBox.intersects(ray, tMin, tMax))
         return false;
@@ -55,6 +66,7 @@ bool BoundingShape::hit(const Ray& ray, float tMin, float tMax, float time, HitR
 bool BoundingShape::shadowHit(const Ray& ray, float tMin, float tMax,
     float time, const Shape*& occludingShape) const
 {
+    raycost::countNodeVisit();
     // First check if ray intersects with the bounding box
     if (!boundingBox.intersects(ray, tMin, tMax))
         return false;
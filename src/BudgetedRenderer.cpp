@@ -0,0 +1,310 @@
+#include "BudgetedRenderer.h"
+#include "Common.h"
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+using namespace raytracer;
+
+/* Variance added to every tile's, so tiles whose pre-pass samples happened
+ * to agree are still given some samples. */
+static const double BUDGET_VARIANCE_FLOOR = 1e-4;
+/* Halvings of the range searched for the scale of the samples given to each
+ * tile. */
+static const unsigned int BUDGET_ALLOCATION_STEPS = 50;
+
+BudgetReport::BudgetReport() :
+    budgetSeconds(0.0),
+    seconds(0.0),
+    prePassSeconds(0.0),
+    rounds(0),
+    allocations(0),
+    stopped(false),
+    meanSamples(0.0),
+    minSamples(0),
+    maxSamples(0),
+    tilesAcross(0)
+{
+}
+
+std::string BudgetReport::format(const std::string& indent) const
+{
+    std::stringstream ss;
+    ss << indent << "budget " << budgetSeconds << " s: took " << seconds
+        << " s (pre-pass " << prePassSeconds << " s), " << meanSamples
+        << " samples per pixel (min " << minSamples << ", max " << maxSamples
+        << "), " << rounds << " rounds, " << allocations << " allocations"
+        << (stopped ? ", stopped" : "");
+    return ss.str();
+}
+
+std::string BudgetReport::formatJSON() const
+{
+    std::stringstream ss;
+    ss << "{\"budgetSeconds\": " << budgetSeconds << ", \"seconds\": " << seconds
+        << ", \"prePassSeconds\": " << prePassSeconds << ", \"rounds\": " << rounds
+        << ", \"allocations\": " << allocations << ", \"stopped\": "
+        << (stopped ? "true" : "false") << ", \"meanSamples\": " << meanSamples
+        << ", \"minSamples\": " << minSamples << ", \"maxSamples\": " << maxSamples
+        << ", \"tileSize\": " << BudgetedRenderer::TILE_SIZE << ", \"tilesAcross\": "
+        << tilesAcross << ", \"tileSamples\": [";
+    for (unsigned int i = 0; (i < tileSamples.size()); i++)
+        ss << ((i > 0) ? ", " : "") << tileSamples[i];
+    ss << "]}";
+    return ss.str();
+}
+
+BudgetedRenderer::BudgetedRenderer(Raytracer* renderer, AccumulationBuffer* buffer,
+    GBuffer* gbuffer) :
+    renderer(renderer),
+    buffer(buffer),
+    gbuffer(gbuffer),
+    stopping(false)
+{
+}
+
+bool BudgetedRenderer::render(double budgetSeconds, Framebuffer* target,
+    BudgetReport& report)
+{
+    const RenderSettings& settings = buffer->getSettings();
+    if (settings.samplingMethod != RANDOM_MULTISAMPLING)
+        return false;
+    double start = common::wallClockSeconds();
+    double deadline = start + budgetSeconds;
+
+    TileList tileList = splitIntoTiles(Tile(0, 0, settings.width, settings.height),
+        TILE_SIZE);
+    tiles.clear();
+    for (unsigned int i = 0; (i < tileList.size()); i++)
+    {
+        TileState state;
+        state.tile = tileList[i];
+        state.seconds = 0.0;
+        state.samples = 0;
+        state.varianceSum = 0.0;
+        state.variancePixels = 0;
+        state.samplesTaken = 0;
+        state.samplesTarget = 0;
+        tiles.push_back(state);
+    }
+
+    // Pre-pass: a sample of every pixel at a time, so a budget too small
+    // for the whole pre-pass still leaves an image
+    std::vector<float> firstLuminance(settings.width * settings.height, -1.0f);
+    bool timeLeft = true;
+    for (unsigned int pass = 0; (pass < PRE_PASS_SAMPLES && timeLeft); pass++)
+    {
+        for (unsigned int i = 0; (i < tiles.size() && timeLeft); i++)
+        {
+            timeLeft = (!stopRequested() && common::wallClockSeconds() < deadline);
+            if (timeLeft)
+                sampleTile(tiles[i], &firstLuminance, target);
+        }
+    }
+    report.prePassSeconds = common::wallClockSeconds() - start;
+
+    // Give each tile the samples it was allocated a pass at a time, sharing
+    // out the time left again after each pass
+    report.rounds = 0;
+    report.allocations = 0;
+    bool progressed = true;
+    while (timeLeft && progressed)
+    {
+        allocateSamples(deadline - common::wallClockSeconds());
+        report.allocations++;
+        progressed = false;
+        for (unsigned int i = 0; (i < tiles.size() && timeLeft); i++)
+        {
+            TileState& state = tiles[i];
+            if (state.samplesTaken >= state.samplesTarget)
+                continue;
+            double now = common::wallClockSeconds();
+            timeLeft = (!stopRequested() && now < deadline);
+            // Tiles which would finish after the deadline are left for
+            // cheaper ones
+            if (timeLeft && now + expectedPassSeconds(state) <= deadline)
+            {
+                sampleTile(state, NULL, target);
+                progressed = true;
+            }
+        }
+        if (progressed)
+            report.rounds++;
+    }
+
+    report.budgetSeconds = budgetSeconds;
+    report.seconds = common::wallClockSeconds() - start;
+    report.stopped = stopRequested();
+    report.tilesAcross = (settings.width + TILE_SIZE - 1) / TILE_SIZE;
+    report.tileSamples.clear();
+    for (unsigned int i = 0; (i < tiles.size()); i++)
+        report.tileSamples.push_back(tiles[i].samplesTaken);
+    double totalSamples = 0.0;
+    report.minSamples = 0;
+    report.maxSamples = 0;
+    for (int y = 0; (y < settings.height); y++)
+    {
+        for (int x = 0; (x < settings.width); x++)
+        {
+            unsigned int samples = buffer->samplesTaken(x, y);
+            totalSamples += samples;
+            report.minSamples = (x == 0 && y == 0) ? samples :
+                std::min(report.minSamples, samples);
+            report.maxSamples = std::max(report.maxSamples, samples);
+        }
+    }
+    unsigned int numPixels = settings.width * settings.height;
+    report.meanSamples = (numPixels > 0) ? (totalSamples / numPixels) : 0.0;
+    return true;
+}
+
+void BudgetedRenderer::stop()
+{
+    __atomic_store_n(&stopping, true, __ATOMIC_RELAXED);
+}
+
+void BudgetedRenderer::resume()
+{
+    __atomic_store_n(&stopping, false, __ATOMIC_RELAXED);
+}
+
+void BudgetedRenderer::setGBuffer(GBuffer* newGBuffer)
+{
+    gbuffer = newGBuffer;
+}
+
+bool BudgetedRenderer::stopRequested() const
+{
+    return __atomic_load_n(&stopping, __ATOMIC_RELAXED);
+}
+
+void BudgetedRenderer::sampleTile(TileState& state, std::vector<float>* firstLuminance,
+    Framebuffer* target)
+{
+    const RenderSettings& settings = buffer->getSettings();
+    const Tile& tile = state.tile;
+    double start = common::wallClockSeconds();
+    unsigned int fewestSamples = settings.numSamples;
+    for (int y = tile.y; (y < tile.y + tile.height); y++)
+    {
+        for (int x = tile.x; (x < tile.x + tile.width); x++)
+        {
+            unsigned int sample = buffer->samplesTaken(x, y);
+            if (sample < settings.numSamples)
+            {
+                Colour colour;
+                bool hit = renderSample(renderer, settings, x, y, sample, gbuffer, colour);
+                buffer->addSample(x, y, colour, hit);
+                state.samples++;
+                sample++;
+
+                if (firstLuminance)
+                {
+                    // Variance of a pixel's luminance from two samples is
+                    // half their squared difference
+                    const Colour& seen = hit ? colour : BACKGROUND_COLOUR;
+                    float luminance = (0.2126f * seen.r) + (0.7152f * seen.g) +
+                        (0.0722f * seen.b);
+                    float& first = (*firstLuminance)[(y * settings.width) + x];
+                    if (first < 0.0f)
+                        first = luminance;
+                    else
+                    {
+                        double difference = luminance - first;
+                        state.varianceSum += 0.5 * difference * difference;
+                        state.variancePixels++;
+                    }
+                }
+            }
+            fewestSamples = std::min(fewestSamples, sample);
+            if (target)
+                target->set(x, y, buffer->resolve(x, y));
+        }
+    }
+    state.seconds += common::wallClockSeconds() - start;
+    state.samplesTaken = fewestSamples;
+}
+
+double BudgetedRenderer::expectedPassSeconds(const TileState& state) const
+{
+    if (state.samples > 0)
+        return (state.seconds / state.samples) * state.tile.area();
+
+    // Tiles which had every sample before the render started have not been
+    // timed, so use the average of those which have
+    double seconds = 0.0;
+    uint64_t samples = 0;
+    for (unsigned int i = 0; (i < tiles.size()); i++)
+    {
+        seconds += tiles[i].seconds;
+        samples += tiles[i].samples;
+    }
+    return (samples > 0) ? ((seconds / samples) * state.tile.area()) : 0.0;
+}
+
+void BudgetedRenderer::allocateSamples(double remainingSeconds)
+{
+    const RenderSettings& settings = buffer->getSettings();
+    unsigned int maxSamples = settings.numSamples;
+
+    // Tiles whose variance was not measured (e.g. because the pre-pass ran
+    // out of time) are given the average of those which were
+    double varianceSum = 0.0;
+    unsigned int variancePixels = 0;
+    for (unsigned int i = 0; (i < tiles.size()); i++)
+    {
+        varianceSum += tiles[i].varianceSum;
+        variancePixels += tiles[i].variancePixels;
+    }
+    double meanVariance = (variancePixels > 0) ? (varianceSum / variancePixels) : 1.0;
+
+    // Each tile gets scale * weight samples per pixel, where the weight is
+    // its standard deviation over the square root of its cost
+    std::vector<double> costs(tiles.size());
+    std::vector<double> weights(tiles.size());
+    double fullCost = 0.0;
+    double smallestWeight = 0.0;
+    for (unsigned int i = 0; (i < tiles.size()); i++)
+    {
+        const TileState& state = tiles[i];
+        double variance = (state.variancePixels > 0) ?
+            (state.varianceSum / state.variancePixels) : meanVariance;
+        costs[i] = std::max(expectedPassSeconds(state), 1e-9);
+        weights[i] = std::sqrt(variance + BUDGET_VARIANCE_FLOOR) / std::sqrt(costs[i]);
+        smallestWeight = (i == 0) ? weights[i] : std::min(smallestWeight, weights[i]);
+        fullCost += costs[i] * (maxSamples - std::min(maxSamples, state.samplesTaken));
+    }
+    if (fullCost <= remainingSeconds)
+    {
+        for (unsigned int i = 0; (i < tiles.size()); i++)
+            tiles[i].samplesTarget = maxSamples;
+        return;
+    }
+
+    // Time taken grows with the scale, so find the largest scale whose
+    // samples fit in the time left
+    double low = 0.0;
+    double high = maxSamples / smallestWeight;
+    for (unsigned int step = 0; (step < BUDGET_ALLOCATION_STEPS); step++)
+    {
+        double scale = 0.5 * (low + high);
+        double cost = 0.0;
+        for (unsigned int i = 0; (i < tiles.size()); i++)
+        {
+            double samples = std::min<double>(maxSamples, scale * weights[i]);
+            cost += costs[i] * std::max(0.0, samples - tiles[i].samplesTaken);
+        }
+        if (cost <= remainingSeconds)
+            low = scale;
+        else
+            high = scale;
+    }
+    // Round up, so the last of the time is still used when less than a
+    // sample of each tile is left; render() stops at the deadline anyway
+    for (unsigned int i = 0; (i < tiles.size()); i++)
+    {
+        double samples = std::min<double>(maxSamples, std::ceil(low * weights[i]));
+        tiles[i].samplesTarget = std::max(tiles[i].samplesTaken,
+            static_cast<unsigned int>(samples));
+    }
+}
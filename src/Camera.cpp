@@ -1,4 +1,5 @@
 #include "Camera.h"
+#include "Profiling.h"
 
 using namespace raytracer;
 
@@ -15,6 +16,7 @@ Camera::Camera(const Vector3& position, const Vector3& direction, const Vector3&
 
 Ray Camera::getRayToPixel(float pixelX, float pixelY)
 {
+    PROFILE_STAGE(RAY_GENERATION);
     // Compute position of point on screen to render
     Vector3 target = cornerPoint + (acrossVec * pixelX) + (upVec * pixelY);
     if (orthographic) // orthographic projection
@@ -31,6 +33,21 @@ Ray Camera::getRayToPixel(float pixelX, float pixelY)
     }
 }
 
+const Vector3& Camera::getPosition() const
+{
+    return position;
+}
+
+const Rect& Camera::getViewingRectangle() const
+{
+    return viewingRect;
+}
+
+float Camera::getDistance() const
+{
+    return distance;
+}
+
 bool Camera::isOrthographic() const
 {
     return orthographic;
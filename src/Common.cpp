@@ -1,5 +1,7 @@
 #include "Common.h"
 #include <cstdlib>
+#include <cstdio>
+#include <sys/time.h>
 
 using namespace raytracer;
 
@@ -17,3 +19,61 @@ float common::randomFloat(float min, float max)
     randomNumber += min;
     return randomNumber;
 }
+
+double common::wallClockSeconds()
+{
+    timeval time;
+    gettimeofday(&time, NULL);
+    return time.tv_sec + (time.tv_usec / 1000000.0);
+}
+
+/* Count cycles over a short interval of wall-clock time. */
+double measureCyclesPerSecond()
+{
+    static const double CALIBRATION_SECONDS = 0.05;
+    double startSeconds = common::wallClockSeconds();
+    uint64_t startCycles = common::cycleCount();
+    double elapsed = 0.0;
+    while (elapsed < CALIBRATION_SECONDS)
+        elapsed = common::wallClockSeconds() - startSeconds;
+    return (common::cycleCount() - startCycles) / elapsed;
+}
+
+double common::cyclesPerSecond()
+{
+    static const double rate = measureCyclesPerSecond();
+    return rate;
+}
+
+std::string common::escapeJSON(const std::string& text)
+{
+    std::string escaped;
+    for (unsigned int i = 0; (i < text.size()); i++)
+    {
+        char c = text[i];
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (c == '\n')
+        {
+            escaped += "\\n";
+        }
+        else if (c == '\t')
+        {
+            escaped += "\\t";
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+            escaped += code;
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
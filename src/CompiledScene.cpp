@@ -0,0 +1,342 @@
+#include "CompiledScene.h"
+#include "Common.h"
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace raytracer;
+
+/* Identifies files written by CompiledScene. */
+static const uint32_t COMPILED_SCENE_MAGIC = 0x43535744; // "DWSC"
+/* Every section of the file starts at a multiple of this many bytes, so
+ * the floats and integers stored in it can be read where they are mapped. */
+static const uint64_t SECTION_ALIGNMENT = 16;
+static const unsigned int RESOURCE_HASH_LENGTH = 32;
+
+/* File starts with the header, followed by an entry for each image and
+ * each terrain. The entries give the offsets of each image's pixels and
+ * each terrain's vertices, triangle indices and octree nodes. */
+struct CompiledScene::Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t signature;
+    uint64_t fileSize;
+    // Sizes of the structures stored, so files written by a build which
+    // lays them out differently are not used
+    uint32_t colourSize;
+    uint32_t vertexSize;
+    uint32_t nodeSize;
+    uint32_t numImages;
+    uint32_t numTerrains;
+    uint32_t padding;
+    char resourceHash[RESOURCE_HASH_LENGTH]; // null-terminated
+    uint64_t imagesOffset;
+    uint64_t terrainsOffset;
+};
+
+struct CompiledScene::ImageEntry
+{
+    int32_t width; // zero if the image could not be loaded
+    int32_t height;
+    uint64_t pixelsOffset;
+};
+
+struct CompiledScene::TerrainEntry
+{
+    uint32_t numVertices; // zero if the terrain could not be loaded
+    uint32_t numIndices;
+    uint32_t numNodes;
+    uint32_t padding;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+    uint64_t nodesOffset;
+};
+
+/* Offset of the section which follows one ending at 'end'. */
+static uint64_t alignSection(uint64_t end)
+{
+    return (end + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+}
+
+/* Write section of file which starts at 'offset', first padding the file
+ * with zeros from 'position' (the number of bytes written so far). */
+static void writeSection(std::ofstream& file, uint64_t& position, uint64_t offset,
+    const void* data, uint64_t length)
+{
+    static const char zeros[SECTION_ALIGNMENT] = { 0 };
+    while (position < offset)
+    {
+        uint64_t padding = std::min(offset - position, SECTION_ALIGNMENT);
+        file.write(zeros, padding);
+        position += padding;
+    }
+    if (length > 0)
+        file.write(static_cast<const char*>(data), length);
+    position += length;
+}
+
+CompiledScene::CompiledScene(const char* data, size_t size) : data(data), size(size)
+{
+}
+
+CompiledScene::~CompiledScene()
+{
+    munmap(const_cast<char*>(data), size);
+}
+
+CompiledScene* CompiledScene::open(const std::string& filename, uint64_t signature)
+{
+    int file = ::open(filename.c_str(), O_RDONLY);
+    if (file < 0)
+        return NULL;
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(Header)))
+    {
+        close(file);
+        return NULL;
+    }
+    void* mapping = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+    close(file); // mapping stays valid after file is closed
+    if (mapping == MAP_FAILED)
+        return NULL;
+
+    CompiledScene* scene = new CompiledScene(static_cast<const char*>(mapping), status.st_size);
+    if (!scene->isValid() || scene->header()->signature != signature)
+    {
+        delete scene;
+        return NULL;
+    }
+    const char* hash = scene->header()->resourceHash;
+    scene->resourceHash.assign(hash, std::find(hash, hash + RESOURCE_HASH_LENGTH, '\0'));
+    return scene;
+}
+
+bool CompiledScene::write(const std::string& filename, uint64_t signature,
+    const std::string& resourceHash, const std::vector<Image*>& images,
+    const std::vector<shapeloaders::TerrainGeometry>& terrains,
+    const std::vector<std::vector<FlatOctreeNode> >& octrees)
+{
+    if (resourceHash.size() >= RESOURCE_HASH_LENGTH)
+        return false;
+    // Work out where every section goes before writing anything
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = COMPILED_SCENE_MAGIC;
+    header.version = VERSION;
+    header.signature = signature;
+    header.colourSize = sizeof(Colour);
+    header.vertexSize = sizeof(Vertex);
+    header.nodeSize = sizeof(FlatOctreeNode);
+    header.numImages = images.size();
+    header.numTerrains = terrains.size();
+    strcpy(header.resourceHash, resourceHash.c_str());
+    header.imagesOffset = alignSection(sizeof(Header));
+    header.terrainsOffset = alignSection(header.imagesOffset + (images.size() * sizeof(ImageEntry)));
+    uint64_t end = header.terrainsOffset + (terrains.size() * sizeof(TerrainEntry));
+
+    std::vector<ImageEntry> imageEntries(images.size());
+    for (unsigned int i = 0; (i < images.size()); i++)
+    {
+        ImageEntry& entry = imageEntries[i];
+        memset(&entry, 0, sizeof(entry));
+        if (images[i])
+        {
+            entry.width = images[i]->getWidth();
+            entry.height = images[i]->getHeight();
+        }
+        entry.pixelsOffset = alignSection(end);
+        end = entry.pixelsOffset + (static_cast<uint64_t>(entry.width) * entry.height * sizeof(Colour));
+    }
+    std::vector<TerrainEntry> terrainEntries(terrains.size());
+    for (unsigned int i = 0; (i < terrains.size()); i++)
+    {
+        TerrainEntry& entry = terrainEntries[i];
+        memset(&entry, 0, sizeof(entry));
+        const shapeloaders::TerrainGeometry& terrain = terrains[i];
+        entry.numVertices = terrain.vertices.size();
+        entry.numIndices = terrain.triangles.size();
+        entry.numNodes = (i < octrees.size()) ? octrees[i].size() : 0;
+        const AABB& bounds = terrain.boundingBox;
+        float boundsMin[3] = { bounds.bounds[0].x, bounds.bounds[0].y, bounds.bounds[0].z };
+        float boundsMax[3] = { bounds.bounds[1].x, bounds.bounds[1].y, bounds.bounds[1].z };
+        memcpy(entry.boundsMin, boundsMin, sizeof(boundsMin));
+        memcpy(entry.boundsMax, boundsMax, sizeof(boundsMax));
+        entry.verticesOffset = alignSection(end);
+        entry.indicesOffset = alignSection(entry.verticesOffset + (entry.numVertices * sizeof(Vertex)));
+        entry.nodesOffset = alignSection(entry.indicesOffset + (entry.numIndices * sizeof(uint32_t)));
+        end = entry.nodesOffset + (entry.numNodes * sizeof(FlatOctreeNode));
+    }
+    header.fileSize = end;
+
+    // Write to temporary file first, then move it over the old one. Processes
+    // which have the old file mapped keep using it until they unmap it.
+    std::string temporaryFilename = filename + ".tmp";
+    std::ofstream file(temporaryFilename.c_str(), std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    uint64_t position = 0;
+    writeSection(file, position, 0, &header, sizeof(header));
+    if (!imageEntries.empty())
+        writeSection(file, position, header.imagesOffset, &imageEntries[0],
+            imageEntries.size() * sizeof(ImageEntry));
+    if (!terrainEntries.empty())
+        writeSection(file, position, header.terrainsOffset, &terrainEntries[0],
+            terrainEntries.size() * sizeof(TerrainEntry));
+    for (unsigned int i = 0; (i < images.size()); i++)
+    {
+        const ImageEntry& entry = imageEntries[i];
+        if (images[i])
+            writeSection(file, position, entry.pixelsOffset, images[i]->getPixels(),
+                static_cast<uint64_t>(entry.width) * entry.height * sizeof(Colour));
+    }
+    for (unsigned int i = 0; (i < terrains.size()); i++)
+    {
+        const TerrainEntry& entry = terrainEntries[i];
+        if (entry.numVertices > 0)
+            writeSection(file, position, entry.verticesOffset, &terrains[i].vertices[0],
+                entry.numVertices * sizeof(Vertex));
+        if (entry.numIndices > 0)
+            writeSection(file, position, entry.indicesOffset, &terrains[i].triangles[0],
+                entry.numIndices * sizeof(uint32_t));
+        if (entry.numNodes > 0)
+            writeSection(file, position, entry.nodesOffset, &octrees[i][0],
+                entry.numNodes * sizeof(FlatOctreeNode));
+    }
+    // Pad file to its full size, in case the last sections were empty
+    writeSection(file, position, header.fileSize, NULL, 0);
+    file.close();
+    if (file.fail())
+        return false;
+    return (rename(temporaryFilename.c_str(), filename.c_str()) == 0);
+}
+
+unsigned int CompiledScene::numImages() const
+{
+    return header()->numImages;
+}
+
+unsigned int CompiledScene::numTerrains() const
+{
+    return header()->numTerrains;
+}
+
+const std::string& CompiledScene::getResourceHash() const
+{
+    return resourceHash;
+}
+
+void CompiledScene::reportMemory(MemoryReport& report) const
+{
+    uint64_t counted = 0;
+    for (unsigned int i = 0; (i < numImages()); i++)
+    {
+        const ImageEntry& entry = imageEntries()[i];
+        uint64_t bytes = static_cast<uint64_t>(entry.width) * entry.height * sizeof(Colour);
+        report.add("compiled scene", "image " + common::toString(i), bytes, true);
+        counted += bytes;
+    }
+    for (unsigned int i = 0; (i < numTerrains()); i++)
+    {
+        const TerrainEntry& entry = terrainEntries()[i];
+        uint64_t geometryBytes = (static_cast<uint64_t>(entry.numVertices) * sizeof(Vertex)) +
+            (static_cast<uint64_t>(entry.numIndices) * sizeof(uint32_t));
+        uint64_t octreeBytes = static_cast<uint64_t>(entry.numNodes) * sizeof(FlatOctreeNode);
+        report.add("compiled scene", "terrain " + common::toString(i) + " geometry",
+            geometryBytes, true);
+        report.add("compiled scene", "terrain " + common::toString(i) + " octree",
+            octreeBytes, true);
+        counted += geometryBytes + octreeBytes;
+    }
+    report.add("compiled scene", "headers and padding", size - counted, true);
+}
+
+Image* CompiledScene::createImage(unsigned int index) const
+{
+    if (index >= numImages())
+        return NULL;
+    const ImageEntry& entry = imageEntries()[index];
+    if (entry.width <= 0 || entry.height <= 0)
+        return NULL;
+    return new Image(entry.width, entry.height,
+        reinterpret_cast<const Colour*>(data + entry.pixelsOffset));
+}
+
+bool CompiledScene::getTerrain(unsigned int index, shapeloaders::TerrainGeometry& geometry,
+    const FlatOctreeNode*& nodes, unsigned int& numNodes) const
+{
+    if (index >= numTerrains())
+        return false;
+    const TerrainEntry& entry = terrainEntries()[index];
+    if (entry.numVertices == 0)
+        return false;
+    const Vertex* vertices = reinterpret_cast<const Vertex*>(data + entry.verticesOffset);
+    const uint32_t* indices = reinterpret_cast<const uint32_t*>(data + entry.indicesOffset);
+    for (unsigned int i = 0; (i < entry.numIndices); i++)
+        if (indices[i] >= entry.numVertices)
+            return false;
+    geometry.vertices.assign(vertices, vertices + entry.numVertices);
+    geometry.triangles.assign(indices, indices + entry.numIndices);
+    geometry.boundingBox = AABB(
+        Vector3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]),
+        Vector3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]));
+    nodes = reinterpret_cast<const FlatOctreeNode*>(data + entry.nodesOffset);
+    numNodes = entry.numNodes;
+    return true;
+}
+
+bool CompiledScene::sectionInFile(uint64_t offset, uint64_t length) const
+{
+    return (offset % SECTION_ALIGNMENT == 0 && offset <= size && length <= size - offset);
+}
+
+bool CompiledScene::isValid() const
+{
+    const Header* h = header();
+    if (h->magic != COMPILED_SCENE_MAGIC || h->version != VERSION || h->fileSize != size ||
+        h->colourSize != sizeof(Colour) || h->vertexSize != sizeof(Vertex) ||
+        h->nodeSize != sizeof(FlatOctreeNode))
+        return false;
+    if (!sectionInFile(h->imagesOffset, static_cast<uint64_t>(h->numImages) * sizeof(ImageEntry)) ||
+        !sectionInFile(h->terrainsOffset, static_cast<uint64_t>(h->numTerrains) * sizeof(TerrainEntry)))
+        return false;
+    for (unsigned int i = 0; (i < h->numImages); i++)
+    {
+        const ImageEntry& entry = imageEntries()[i];
+        if (entry.width < 0 || entry.height < 0 || !sectionInFile(entry.pixelsOffset,
+            static_cast<uint64_t>(entry.width) * entry.height * sizeof(Colour)))
+            return false;
+    }
+    for (unsigned int i = 0; (i < h->numTerrains); i++)
+    {
+        const TerrainEntry& entry = terrainEntries()[i];
+        if (entry.numIndices % 3 != 0 ||
+            !sectionInFile(entry.verticesOffset, static_cast<uint64_t>(entry.numVertices) * sizeof(Vertex)) ||
+            !sectionInFile(entry.indicesOffset, static_cast<uint64_t>(entry.numIndices) * sizeof(uint32_t)) ||
+            !sectionInFile(entry.nodesOffset, static_cast<uint64_t>(entry.numNodes) * sizeof(FlatOctreeNode)))
+            return false;
+    }
+    return true;
+}
+
+const CompiledScene::Header* CompiledScene::header() const
+{
+    return reinterpret_cast<const Header*>(data);
+}
+
+const CompiledScene::ImageEntry* CompiledScene::imageEntries() const
+{
+    return reinterpret_cast<const ImageEntry*>(data + header()->imagesOffset);
+}
+
+const CompiledScene::TerrainEntry* CompiledScene::terrainEntries() const
+{
+    return reinterpret_cast<const TerrainEntry*>(data + header()->terrainsOffset);
+}
@@ -0,0 +1,96 @@
+#include "ContentHash.h"
+#include <fstream>
+#include <cstdio>
+#include <sys/stat.h>
+
+using namespace raytracer;
+
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+ContentHash::ContentHash() : hash(FNV_OFFSET_BASIS)
+{
+}
+
+void ContentHash::addBytes(const void* data, size_t length)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; (i < length); i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+}
+
+void ContentHash::addInt(int value)
+{
+    addBytes(&value, sizeof(value));
+}
+
+void ContentHash::addFloat(float value)
+{
+    // Make sure both zeros hash the same
+    if (value == 0.0f)
+        value = 0.0f;
+    addBytes(&value, sizeof(value));
+}
+
+void ContentHash::addString(const std::string& value)
+{
+    // Include length so consecutive strings can't run into each other
+    addInt(value.size());
+    addBytes(value.data(), value.size());
+}
+
+void ContentHash::addVector(const Vector3& value)
+{
+    addFloat(value.x);
+    addFloat(value.y);
+    addFloat(value.z);
+}
+
+void ContentHash::addColour(const Colour& value)
+{
+    addFloat(value.r);
+    addFloat(value.g);
+    addFloat(value.b);
+}
+
+bool ContentHash::addFile(const std::string& filename)
+{
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    char buffer[65536];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+        addBytes(buffer, file.gcount());
+    return file.eof();
+}
+
+bool ContentHash::addFileStatus(const std::string& filename)
+{
+    struct stat status;
+    if (stat(filename.c_str(), &status) != 0)
+    {
+        addInt(-1);
+        return false;
+    }
+    uint64_t size = status.st_size;
+    uint64_t modified = status.st_mtime;
+    addBytes(&size, sizeof(size));
+    addBytes(&modified, sizeof(modified));
+    return true;
+}
+
+uint64_t ContentHash::value() const
+{
+    return hash;
+}
+
+std::string ContentHash::toHex() const
+{
+    char digits[17];
+    snprintf(digits, sizeof(digits), "%08x%08x", static_cast<unsigned int>(hash >> 32),
+        static_cast<unsigned int>(hash & 0xffffffff));
+    return digits;
+}
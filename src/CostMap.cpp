@@ -0,0 +1,176 @@
+#include "CostMap.h"
+#include "TGA.h"
+#include "Common.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+using namespace raytracer;
+
+static const char* METRIC_NAMES[] = { "nodes", "tests", "shadow-rays",
+    "secondary-rays", "time" };
+
+// Colours of the false colour ramp, from no work to the most work
+static const Colour COST_RAMP[] = { Colour(0.0f, 0.0f, 0.0f), Colour(0.0f, 0.0f, 1.0f),
+    Colour(0.0f, 1.0f, 0.0f), Colour(1.0f, 1.0f, 0.0f), Colour(1.0f, 0.0f, 0.0f) };
+static const int COST_RAMP_SIZE = 5;
+// Share of pixels below the top of the ramp, so a few very costly pixels
+// (e.g. one which waited for a page of the scene to load) do not leave the
+// rest of the image dark
+static const float FALSE_COLOUR_PERCENTILE = 0.99f;
+
+__thread RayCost* raycost::activeCost = NULL;
+
+/* Colour of the ramp at 'position', between 0 and 1. */
+static Colour costRampColour(float position)
+{
+    position = std::max(0.0f, std::min(position, 1.0f)) * (COST_RAMP_SIZE - 1);
+    int index = std::min(static_cast<int>(position), COST_RAMP_SIZE - 2);
+    float blend = position - index;
+    return (COST_RAMP[index] * (1.0f - blend)) + (COST_RAMP[index + 1] * blend);
+}
+
+CostMap::CostMap(int width, int height) :
+    values(static_cast<size_t>(width) * height * NUM_METRICS, 0.0f), width(width),
+    height(height)
+{
+}
+
+const char* CostMap::metricName(Metric metric)
+{
+    return METRIC_NAMES[metric];
+}
+
+int CostMap::getWidth() const
+{
+    return width;
+}
+
+int CostMap::getHeight() const
+{
+    return height;
+}
+
+float CostMap::get(int x, int y, Metric metric) const
+{
+    return values[(((static_cast<size_t>(y) * width) + x) * NUM_METRICS) + metric];
+}
+
+void CostMap::set(int x, int y, Metric metric, float value)
+{
+    values[(((static_cast<size_t>(y) * width) + x) * NUM_METRICS) + metric] = value;
+}
+
+float CostMap::maximum(Metric metric) const
+{
+    float result = 0.0f;
+    for (size_t i = metric; (i < values.size()); i += NUM_METRICS)
+        result = std::max(result, values[i]);
+    return result;
+}
+
+float CostMap::mean(Metric metric) const
+{
+    double sum = 0.0;
+    for (size_t i = metric; (i < values.size()); i += NUM_METRICS)
+        sum += values[i];
+    size_t numPixels = values.size() / NUM_METRICS;
+    return (numPixels > 0) ? static_cast<float>(sum / numPixels) : 0.0f;
+}
+
+float CostMap::percentile(Metric metric, float fraction) const
+{
+    std::vector<float> sorted;
+    sorted.reserve(values.size() / NUM_METRICS);
+    for (size_t i = metric; (i < values.size()); i += NUM_METRICS)
+        sorted.push_back(values[i]);
+    if (sorted.empty())
+        return 0.0f;
+    size_t index = std::min(static_cast<size_t>(fraction * sorted.size()), sorted.size() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+Image* CostMap::falseColour(Metric metric) const
+{
+    Image* image = new Image(width, height);
+    float scale = percentile(metric, FALSE_COLOUR_PERCENTILE);
+    if (scale <= 0.0f)
+        scale = maximum(metric);
+    scale = (scale > 0.0f) ? (1.0f / scale) : 0.0f;
+    for (int y = 0; (y < height); y++)
+    {
+        for (int x = 0; (x < width); x++)
+            image->set(x, y, costRampColour(get(x, y, metric) * scale));
+    }
+    return image;
+}
+
+bool CostMap::writePFM(const std::string& filename, Metric metric) const
+{
+    std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!file)
+        return false;
+    // Negative scale means little-endian; rows are stored bottom to top,
+    // as in the TGA files written for images
+    file << "Pf\n" << width << " " << height << "\n-1.0\n";
+    std::vector<float> row(width);
+    for (int y = 0; (y < height); y++)
+    {
+        for (int x = 0; (x < width); x++)
+            row[x] = get(x, y, metric);
+        file.write(reinterpret_cast<const char*>(&row[0]), width * sizeof(float));
+    }
+    return file.good();
+}
+
+bool CostMap::writeAll(const std::string& prefix) const
+{
+    bool success = true;
+    for (unsigned int i = 0; (i < NUM_METRICS); i++)
+    {
+        Metric metric = static_cast<Metric>(i);
+        std::string filename = prefix + "-" + METRIC_NAMES[i];
+        Image* image = falseColour(metric);
+        success = tga::writeTGAFile(filename + ".tga", *image) && success;
+        delete image;
+        success = writePFM(filename + ".pfm", metric) && success;
+    }
+    return success;
+}
+
+void raytracer::renderCostedTile(Raytracer* renderer, const RenderSettings& settings,
+    const Tile& tile, Framebuffer* target, CostMap* costs)
+{
+    double microsecondsPerCycle = 1e6 / common::cyclesPerSecond();
+    for (int y = tile.y; (y < tile.y + tile.height); y++)
+    {
+        for (int x = tile.x; (x < tile.x + tile.width); x++)
+        {
+            RayCost cost;
+            uint64_t shadowRays = renderer->shadowRays();
+            uint64_t secondaryRays = renderer->reflectedRays() + renderer->refractedRays();
+            uint64_t start = common::cycleCount();
+            Colour colour;
+            bool hit = false;
+            {
+                raycost::ScopedCounter counter(&cost);
+                hit = renderer->renderPixel(x, y, settings.width, settings.height,
+                    settings.samplingMethod, settings.numSamples, colour);
+            }
+            uint64_t elapsed = common::cycleCount() - start;
+            if (!hit)
+                colour = BACKGROUND_COLOUR;
+            target->set(x, y, colour);
+
+            costs->set(x, y, CostMap::NODES_VISITED, static_cast<float>(cost.nodesVisited));
+            costs->set(x, y, CostMap::PRIMITIVE_TESTS, static_cast<float>(cost.primitiveTests));
+            costs->set(x, y, CostMap::SHADOW_RAYS,
+                static_cast<float>(renderer->shadowRays() - shadowRays));
+            costs->set(x, y, CostMap::SECONDARY_RAYS, static_cast<float>(
+                renderer->reflectedRays() + renderer->refractedRays() - secondaryRays));
+            costs->set(x, y, CostMap::PIXEL_TIME,
+                static_cast<float>(elapsed * microsecondsPerCycle));
+        }
+    }
+}
@@ -0,0 +1,690 @@
+#include "DemoScene.h"
+#include "TGA.h"
+#include "Threading.h"
+#include "AcceleratorTuning.h"
+#include "Tracing.h"
+#include "Triangle.h"
+
+using namespace raytracer;
+
+/* Version of the renderer's output, included in render cache keys. Change it
+ * whenever the renderer changes how images look, so renders cached by older
+ * versions are not used. */
+static const int RENDER_CACHE_VERSION = 3;
+
+/* Every image the scene loads, with the ID it has in the resource manager. */
+static const char* const SCENE_IMAGES[][2] = {
+	{ "terrainImage1", "resources/terrain_dirt.tga" },
+	{ "terrainImage2", "resources/terrain_grass.tga" },
+	{ "terrainImage3", "resources/terrain_rock.tga" },
+	{ "terrainImage4", "resources/terrain_snow.tga" },
+	{ "skyboxFront", "resources/miramar_ft.tga" },
+	{ "skyboxRight", "resources/miramar_rt.tga" },
+	{ "skyboxBack", "resources/miramar_bk.tga" },
+	{ "skyboxLeft", "resources/miramar_lf.tga" },
+	{ "skyboxUp", "resources/miramar_up.tga" },
+	{ "skyboxDown", "resources/miramar_dn.tga" },
+	{ "heightmap1", "resources/heightmap.tga" },
+	{ "heightmap2", "resources/heightmap2.tga" },
+	{ "heightmap3", "resources/heightmap3.tga" }
+};
+static const unsigned int NUM_SCENE_IMAGES = sizeof(SCENE_IMAGES) / sizeof(SCENE_IMAGES[0]);
+/* Index of the first sky box image in SCENE_IMAGES. The images before it
+ * are the terrain's textures. */
+static const unsigned int FIRST_SKYBOX_IMAGE = 4;
+/* Index of the first heightmap in SCENE_IMAGES. There is one terrain for
+ * each heightmap. */
+static const unsigned int FIRST_HEIGHTMAP = 10;
+static const unsigned int NUM_TERRAINS = NUM_SCENE_IMAGES - FIRST_HEIGHTMAP;
+/* Rays cast across each camera's view to time the candidates for the
+ * automatically picked terrain accelerator, per side. */
+static const unsigned int PROBE_RAYS_PER_SIDE = 24;
+
+/* Offset which centres a terrain built from the heightmap on the origin. */
+static Vector3 terrainOffset(const Image* heightmap)
+{
+	return Vector3(-((common::TERRAIN_CELL_SIZE * heightmap->getWidth()) / 2.0f),
+		0.0f, -((common::TERRAIN_CELL_SIZE * heightmap->getHeight()) / 2.0f));
+}
+
+/* Returns true if every image the scene needs was loaded, printing the files
+ * of any which were not (e.g. because resources/ is not in the current
+ * directory). The terrain's textures are not needed, as TerrainHeightTexture
+ * skips those which are missing. */
+static bool sceneImagesLoaded(const std::vector<Image*>& images)
+{
+	bool loaded = true;
+	for (unsigned int i = 0; (i < NUM_SCENE_IMAGES); i++)
+	{
+		if (!images[i])
+		{
+			std::cerr << "Could not load " << SCENE_IMAGES[i][1] << std::endl;
+			if (i >= FIRST_SKYBOX_IMAGE)
+				loaded = false;
+		}
+	}
+	return loaded;
+}
+
+/* Identifies the resources a compiled scene is built from. Only the size and
+ * modification time of each file is used, so it is quick to compute. */
+static uint64_t compiledSceneSignature()
+{
+	ContentHash hash;
+	for (unsigned int i = 0; (i < NUM_SCENE_IMAGES); i++)
+	{
+		hash.addString(SCENE_IMAGES[i][1]);
+		hash.addFileStatus(SCENE_IMAGES[i][1]);
+	}
+	hash.addFloat(common::TERRAIN_CELL_SIZE);
+	hash.addFloat(common::TERRAIN_MAX_HEIGHT);
+	return hash.value();
+}
+
+/* Loads the triangles of a terrain the first time they are needed, from
+ * its compiled scene if it has one. Shared by every accelerator built over
+ * the terrain, which may be built at the same time by different renders. */
+class TerrainLoader
+{
+
+public:
+	TerrainLoader(const std::string& heightmapID, Texture* texture,
+		const CompiledScene* compiledScene, unsigned int terrainIndex) :
+		heightmapID(heightmapID), texture(texture),
+		compiledScene(compiledScene), terrainIndex(terrainIndex), loaded(false),
+		primitives(NULL), octreeNodes(NULL), numOctreeNodes(0)
+	{
+	}
+
+	/* Returns NULL if the terrain could not be loaded. */
+	const PrimitiveStore* getPrimitives()
+	{
+		threading::ScopedLock lock(mutex);
+		if (loaded)
+			return primitives;
+		loaded = true;
+		shapeloaders::TerrainGeometry geometry;
+		bool success = false;
+		if (compiledScene)
+		{
+			success = compiledScene->getTerrain(terrainIndex, geometry, octreeNodes,
+				numOctreeNodes);
+		}
+		else
+		{
+			// Heightmap may have been freed to stay within the resource
+			// manager's memory budget, in which case it is decoded again
+			ResourceManager* resourceManager = ResourceManager::getInstance();
+			Image* heightmap = resourceManager->acquireImage(heightmapID);
+			success = heightmap && shapeloaders::buildTerrainGeometry(heightmap,
+				common::TERRAIN_CELL_SIZE, common::TERRAIN_MAX_HEIGHT,
+				terrainOffset(heightmap), geometry);
+			resourceManager->releaseImage(heightmapID);
+		}
+		if (success)
+			primitives = shapeloaders::createTerrainPrimitives(geometry, texture);
+		return primitives;
+	}
+
+	/* Accelerator using the octree compiled with the terrain, or NULL if
+	 * there isn't one. */
+	Accelerator* createCompiledOctree()
+	{
+		if (!getPrimitives() || !octreeNodes)
+			return NULL;
+		return OctreeAccelerator::fromFlattened(primitives, octreeNodes, numOctreeNodes);
+	}
+
+private:
+	std::string heightmapID;
+	Texture* texture;
+	const CompiledScene* compiledScene;
+	unsigned int terrainIndex;
+
+	threading::Mutex mutex;
+	bool loaded;
+	PrimitiveStore* primitives;
+	const FlatOctreeNode* octreeNodes;
+	unsigned int numOctreeNodes;
+
+};
+
+/* Builds an accelerator over a terrain's triangles. The automatically
+ * picked accelerator is tuned on rays from the scene's cameras. */
+class TerrainAcceleratorBuilder : public ShapeBuilder
+{
+
+public:
+	TerrainAcceleratorBuilder(TerrainLoader* loader, AcceleratorType type,
+		const std::vector<Ray>& probeRays = std::vector<Ray>()) :
+		loader(loader), type(type), probeRays(probeRays)
+	{
+	}
+
+	virtual Shape* build()
+	{
+		tracing::ScopedEvent event("build accelerator", acceleratorName(type));
+		const PrimitiveStore* primitives = loader->getPrimitives();
+		if (!primitives)
+			return NULL;
+		if (type == AUTO_ACCELERATOR)
+		{
+			double start = common::wallClockSeconds();
+			Accelerator* accelerator = buildTunedAccelerator(primitives, probeRays);
+			accelerator->setBuildSeconds(common::wallClockSeconds() - start);
+			return accelerator;
+		}
+		// Use the compiled octree, unless it is invalid
+		if (type == OCTREE_ACCELERATOR)
+		{
+			double start = common::wallClockSeconds();
+			Accelerator* accelerator = loader->createCompiledOctree();
+			if (accelerator)
+			{
+				accelerator->setBuildSeconds(common::wallClockSeconds() - start);
+				return accelerator;
+			}
+		}
+		return Accelerator::build(type, primitives);
+	}
+
+private:
+	TerrainLoader* loader;
+	AcceleratorType type;
+	std::vector<Ray> probeRays;
+
+};
+
+/* Builds lines which show the octree of a terrain, building the terrain
+ * too if it has not been already. */
+class OctreeLinesBuilder : public ShapeBuilder
+{
+
+public:
+	OctreeLinesBuilder(const LazyShape* terrain, const AABB& boundary) :
+		terrain(terrain), boundary(boundary)
+	{
+	}
+
+	virtual Shape* build()
+	{
+		OctreeAccelerator* accelerator = dynamic_cast<OctreeAccelerator*>(terrain->getShape());
+		if (!accelerator)
+			return NULL;
+		LineList lines = accelerator->getOctree()->getBoundingLines();
+		ShapeList lineShapes = generateLines(lines, 0.4f, NULL);
+		return new BoundingShape(lineShapes, boundary);
+	}
+
+private:
+	const LazyShape* terrain;
+	AABB boundary;
+
+};
+
+/* Loads an image into the resource manager while the scene loads, keeping
+ * it loaded until it is released. */
+class ImageLoadTask : public threading::Task
+{
+
+public:
+	ImageLoadTask(const char* imageID, const char* filename, Image** image) :
+		imageID(imageID), filename(filename), image(image)
+	{
+	}
+
+	virtual void run()
+	{
+		tracing::ScopedEvent event("decode image", filename);
+		ResourceManager* resourceManager = ResourceManager::getInstance();
+		resourceManager->createImage(imageID, filename);
+		*image = resourceManager->acquireImage(imageID);
+	}
+
+private:
+	// Names of images in SCENE_IMAGES, which are string literals
+	const char* imageID;
+	const char* filename;
+	Image** image;
+
+};
+
+/* Computes the geometry of a terrain to compile, once its heightmap has
+ * been decoded. */
+class TerrainGeometryTask : public threading::Task
+{
+
+public:
+	TerrainGeometryTask(Image* const* heightmap, shapeloaders::TerrainGeometry* geometry) :
+		heightmap(heightmap), geometry(geometry)
+	{
+	}
+
+	virtual void run()
+	{
+		tracing::ScopedEvent event("build terrain geometry");
+		if (*heightmap)
+			shapeloaders::buildTerrainGeometry(*heightmap, common::TERRAIN_CELL_SIZE,
+				common::TERRAIN_MAX_HEIGHT, terrainOffset(*heightmap), *geometry);
+	}
+
+private:
+	Image* const* heightmap;
+	shapeloaders::TerrainGeometry* geometry;
+
+};
+
+/* Builds the octree of a terrain to compile, once its geometry has been
+ * computed. */
+class TerrainOctreeTask : public threading::Task
+{
+
+public:
+	TerrainOctreeTask(const shapeloaders::TerrainGeometry* geometry,
+		std::vector<FlatOctreeNode>* nodes) : geometry(geometry), nodes(nodes)
+	{
+	}
+
+	virtual void run()
+	{
+		tracing::ScopedEvent event("build terrain octree");
+		if (!geometry->vertices.empty())
+			shapeloaders::buildTerrainOctree(*geometry, *nodes);
+	}
+
+private:
+	const shapeloaders::TerrainGeometry* geometry;
+	std::vector<FlatOctreeNode>* nodes;
+
+};
+
+DemoScene raytracer::constructDemoScene(const std::string& compiledSceneFilename)
+{
+    tracing::ScopedEvent event("load scene");
+    /// Load resources, from compiled scene if there is an up-to-date one
+    ResourceManager* resourceManager = ResourceManager::getInstance();
+    uint64_t signature = compiledSceneSignature();
+    CompiledScene* compiledScene = NULL;
+    if (!compiledSceneFilename.empty())
+        compiledScene = CompiledScene::open(compiledSceneFilename, signature);
+    if (compiledScene && (compiledScene->numImages() != NUM_SCENE_IMAGES ||
+        compiledScene->numTerrains() != NUM_TERRAINS))
+    {
+        delete compiledScene;
+        compiledScene = NULL;
+    }
+    std::vector<Image*> images(NUM_SCENE_IMAGES);
+    std::string resourceHash; // hash of every file loaded
+    bool imagesLoaded = false;
+    if (compiledScene)
+    {
+        for (unsigned int i = 0; (i < NUM_SCENE_IMAGES); i++)
+        {
+            resourceManager->addImage(SCENE_IMAGES[i][0], compiledScene->createImage(i));
+            images[i] = resourceManager->acquireImage(SCENE_IMAGES[i][0]);
+        }
+        resourceHash = compiledScene->getResourceHash();
+        imagesLoaded = sceneImagesLoaded(images);
+    }
+    else
+    {
+        // Decode every image at once. If the scene is being compiled, each
+        // terrain is built as soon as its heightmap has been decoded.
+        threading::TaskGraph loader;
+        std::vector<threading::TaskGraph::Handle> imageTasks(NUM_SCENE_IMAGES);
+        for (unsigned int i = 0; (i < NUM_SCENE_IMAGES); i++)
+            imageTasks[i] = loader.addTask(new ImageLoadTask(SCENE_IMAGES[i][0],
+                SCENE_IMAGES[i][1], &images[i]));
+        std::vector<shapeloaders::TerrainGeometry> terrainGeometry(NUM_TERRAINS);
+        std::vector<std::vector<FlatOctreeNode> > terrainOctrees(NUM_TERRAINS);
+        for (unsigned int i = 0; (!compiledSceneFilename.empty() && i < NUM_TERRAINS); i++)
+        {
+            std::vector<threading::TaskGraph::Handle> dependencies(1,
+                imageTasks[FIRST_HEIGHTMAP + i]);
+            dependencies[0] = loader.addTask(new TerrainGeometryTask(
+                &images[FIRST_HEIGHTMAP + i], &terrainGeometry[i]), dependencies);
+            loader.addTask(new TerrainOctreeTask(&terrainGeometry[i], &terrainOctrees[i]),
+                dependencies);
+        }
+        // Hash the files while they are decoded
+        ContentHash hash;
+        for (unsigned int i = 0; (i < NUM_SCENE_IMAGES); i++)
+        {
+            hash.addString(SCENE_IMAGES[i][1]);
+            hash.addFile(SCENE_IMAGES[i][1]);
+        }
+        resourceHash = hash.toHex();
+        loader.waitAll();
+        imagesLoaded = sceneImagesLoaded(images);
+        if (imagesLoaded && !compiledSceneFilename.empty())
+        {
+            tracing::ScopedEvent writeEvent("write compiled scene");
+            if (!CompiledScene::write(compiledSceneFilename, signature, resourceHash, images,
+                terrainGeometry, terrainOctrees))
+                std::cerr << "Could not write compiled scene to " << compiledSceneFilename
+                    << std::endl;
+        }
+    }
+    if (!imagesLoaded)
+    {
+        for (unsigned int i = 0; (i < NUM_SCENE_IMAGES); i++)
+            if (images[i])
+                resourceManager->releaseImage(SCENE_IMAGES[i][0]);
+        delete compiledScene;
+        DemoScene failed;
+        failed.renderer = NULL;
+        failed.compiledScene = NULL;
+        return failed;
+    }
+    Texture* terrainTexture = new TerrainHeightTexture( // multitexture for terrain
+	    images[0], images[1], images[2], images[3]);
+    std::vector<Texture*> skyBoxTextures(6);
+    skyBoxTextures[0] = resourceManager->createTexture("skyboxFrontTexture", "skyboxFront");
+    skyBoxTextures[1] = resourceManager->createTexture("skyboxRightTexture", "skyboxRight");
+	skyBoxTextures[2] = resourceManager->createTexture("skyboxBackTexture", "skyboxBack");
+	skyBoxTextures[3] = resourceManager->createTexture("skyboxLeftTexture", "skyboxLeft");
+	skyBoxTextures[4] = resourceManager->createTexture("skyboxUpTexture", "skyboxUp");
+	skyBoxTextures[5] = resourceManager->createTexture("skyboxDownTexture", "skyboxDown");
+    // Define scene
+    AABB sceneBoundary(Vector3(-1000, -1000, -1000), Vector3(1000, 1000, 1000));
+    std::vector<Sphere*> spheres;
+    spheres.push_back(new Sphere(Vector3(0.0f, 8.0f, -25.0f), 2.0f,
+        new Material(0.5f, 1.2f, 0.5f, 20.0f, Material::NO_REFLECTION,
+        Material::NO_REFRACTION, Colour(0.4f, 0.4f, 0.8f), NULL)
+    ));
+    spheres.push_back(new Sphere(Vector3(-4.0f, 10.0f, -20.0f), 2.0f,
+        new Material(0.5f, 3.0f, 1.0f, 20.0f, 1.0f,
+        Material::NO_REFRACTION, Colour(), NULL)
+    ));
+    spheres.push_back(new Sphere(Vector3(0.0f, 5.0f, -15.0f), 2.0f,
+        new Material(0.5f, 1.2f, 0.5f, 20.0f, 0.5f,
+            1.6666, Colour(0.8f, 0.2f, 0.2f), NULL)
+    ));
+    spheres.push_back(new Sphere(Vector3(3.0f, 5.0f, -26.5f), 1.0f,
+        new Material(5.0f, 0.0f, 0.0f, 0.0f, 0.4f,
+        Material::NO_REFRACTION, Colour(0.9f, 0.65f, 0.0f), NULL)
+    ));
+    ShapeList shapes(spheres.begin(), spheres.end());
+    // Load skybox
+    shapes.push_back(shapeloaders::getSkyBox(common::SKYBOX_SIZE, skyBoxTextures));
+
+	// Define all possible viewpoints
+	std::vector<Camera> cameras;
+	cameras.reserve(3);
+	cameras.push_back(Camera(
+        Vector3(0, 5.0f, 0), Vector3(0, 0, -1), Vector3(0, 1, 0),
+        Rect(-100, 100, -100, 100), 200, false));
+	cameras.push_back(Camera(
+        Vector3(-10, 3.0f, -10.0f), Vector3(1, 0.2f, -1), Vector3(0, 1, 0),
+        Rect(-100, 100, -100, 100), 200, false));        
+	cameras.push_back(Camera(
+        Vector3(5.0f, 30.0f, -50.0f), Vector3(0.0f, -0.6f, 1), Vector3(0, 1, 0),
+        Rect(-100, 100, -100, 100), 200, false));
+        
+    // Terrain is only built when a ray first reaches it, since each
+    // render only uses one of the variants
+	std::vector<Ray> probeRays;
+	for (unsigned int i = 0; (i < cameras.size()); i++)
+		addCameraProbeRays(cameras[i], PROBE_RAYS_PER_SIDE, probeRays);
+    ShapeList terrainVariants;
+    ShapeList octreeLines;
+	std::vector<std::string> terrainNames;
+	terrainNames.push_back("Varied");
+	terrainNames.push_back("Low/Shallow");
+	terrainNames.push_back("High Peaks");
+    for (unsigned int i = 0; (i < NUM_TERRAINS); i++)
+    {
+		Image* heightmap = images[FIRST_HEIGHTMAP + i];
+		AABB bounds = shapeloaders::getTerrainBounds(heightmap->getWidth(),
+			heightmap->getHeight(), common::TERRAIN_CELL_SIZE,
+			common::TERRAIN_MAX_HEIGHT, terrainOffset(heightmap));
+		// Every accelerator over the terrain shares its triangles
+		TerrainLoader* loader = new TerrainLoader(SCENE_IMAGES[FIRST_HEIGHTMAP + i][0],
+			terrainTexture, compiledScene, i);
+		for (unsigned int type = 0; (type < NUM_ACCELERATOR_TYPES); type++)
+		{
+			AcceleratorType acceleratorType = static_cast<AcceleratorType>(type);
+			terrainVariants.push_back(new LazyShape(bounds, new TerrainAcceleratorBuilder(
+				loader, acceleratorType, (acceleratorType == AUTO_ACCELERATOR) ?
+				probeRays : std::vector<Ray>())));
+		}
+        // Test shapes (lines of the terrain's octree)
+        const LazyShape* octreeTerrain = static_cast<const LazyShape*>(
+            terrainVariants[(i * NUM_ACCELERATOR_TYPES) + OCTREE_ACCELERATOR]);
+        octreeLines.push_back(new LazyShape(sceneBoundary,
+            new OctreeLinesBuilder(octreeTerrain, sceneBoundary)));
+    }
+	// Terrain texture keeps its images for as long as the scene exists. The
+	// rest are kept by the sky box textures or loaded again when needed.
+	for (unsigned int i = FIRST_SKYBOX_IMAGE; (i < NUM_SCENE_IMAGES); i++)
+		resourceManager->releaseImage(SCENE_IMAGES[i][0]);
+
+	// Create renderer to render scene
+	Raytracer* renderer = new Raytracer(cameras[0]);
+    renderer->setRootShape(new BoundingShape(shapes, sceneBoundary));
+    // Add light sources 
+    std::vector<PointLight> pointLights;
+    pointLights.push_back(PointLight(
+        Vector3(-100, 70, 100),
+        Colour(0.2f, 0.2f, 0.2f),
+        Colour(0.4f, 0.4f, 0.4f),
+        Colour(1.0f, 1.0f, 1.0f)
+    ));
+    pointLights.push_back(PointLight(
+        Vector3(3.0f, 5.0f, -26.5f),
+        Colour(0.0f, 0.0f, 0.0f),
+        Colour(0.6f, 0.76f, 0.0f),
+        Colour(1.0f, 0.3f, 0.0f)
+    ));
+    // Disable test shapes at start
+    renderer->showTestShapes(false);
+    
+	// Return the entire scene
+	DemoScene scene = { renderer, cameras, terrainVariants, terrainNames,
+		octreeLines, pointLights, spheres, sceneBoundary, resourceHash, compiledScene };
+	return scene;
+}
+
+bool raytracer::applyRenderSettings(DemoScene& scene, const RenderSettings& settings)
+{
+	return applySceneGeometry(scene, settings) &&
+		configureRenderer(scene, settings, scene.renderer);
+}
+
+bool raytracer::applySceneGeometry(DemoScene& scene, const RenderSettings& settings)
+{
+	if (settings.terrainIndex >= scene.terrainNames.size())
+		return false;
+
+	// Based on accelerator and terrain, pick which terrain to render
+	Shape* terrain = scene.terrainVariants[
+		(settings.terrainIndex * NUM_ACCELERATOR_TYPES) + settings.accelerator];
+	BoundingShape* root = dynamic_cast<BoundingShape*>(scene.renderer->getRootShape());
+	if (root)
+	{
+		// Be sure to remove all terrain from the root of the scene
+		// so only one terrain is rendered at a time
+		for (unsigned int i = 0; (i < scene.terrainVariants.size()); i++)
+			root->removeShape(scene.terrainVariants[i]);
+		// If terrain shape was found from user's selection
+		if (terrain)
+			root->addShape(terrain);
+	}
+	return true;
+}
+
+bool raytracer::configureRenderer(const DemoScene& scene, const RenderSettings& settings,
+	Raytracer* renderer)
+{
+	if (settings.cameraIndex >= scene.cameras.size() ||
+		settings.terrainIndex >= scene.terrainNames.size())
+		return false;
+
+	// Assign chosen camera
+	*renderer->getCamera() = scene.cameras[settings.cameraIndex];
+	// Configure effects settings
+	renderer->enableLocalIllumination(settings.localIllumination);
+	renderer->enableReflectionAndRefraction(settings.reflectionRefraction);
+	renderer->enableShadows(settings.shadows);
+
+	// Octree can only be visualised if it's being used. If so, set
+	// octree lines for the terrain being rendered now
+	renderer->showTestShapes(settings.accelerator == OCTREE_ACCELERATOR && settings.showOctree);
+	if (renderer->showingTestShapes())
+		renderer->setRootTestShape(scene.octreeLines[settings.terrainIndex], false);
+
+	/* Clear all lights from the scene, then add the ones which are enabled. */
+	renderer->removeAllLights();
+	for (unsigned int i = 0; (i < scene.lights.size()); i++)
+		if (settings.enabledLights & (1u << i))
+			renderer->addLight(scene.lights[i]);
+
+	return true;
+}
+
+std::string raytracer::terrainSelectionKey(const RenderSettings& settings)
+{
+	return common::toString(settings.terrainIndex) + "-" + acceleratorName(settings.accelerator);
+}
+
+const Accelerator* raytracer::builtTerrainAccelerator(const DemoScene& scene,
+	const RenderSettings& settings)
+{
+	if (settings.terrainIndex >= scene.terrainNames.size())
+		return NULL;
+	const LazyShape* terrain = static_cast<const LazyShape*>(scene.terrainVariants[
+		(settings.terrainIndex * NUM_ACCELERATOR_TYPES) + settings.accelerator]);
+	if (!terrain->isBuilt())
+		return NULL;
+	return dynamic_cast<const Accelerator*>(terrain->getShape());
+}
+
+const Accelerator* raytracer::terrainAccelerator(const DemoScene& scene,
+	const RenderSettings& settings)
+{
+	if (settings.terrainIndex >= scene.terrainNames.size())
+		return NULL;
+	const LazyShape* terrain = static_cast<const LazyShape*>(scene.terrainVariants[
+		(settings.terrainIndex * NUM_ACCELERATOR_TYPES) + settings.accelerator]);
+	return dynamic_cast<const Accelerator*>(terrain->getShape());
+}
+
+void raytracer::reportSceneMemory(const DemoScene& scene, MemoryReport& report)
+{
+	ResourceManager::getInstance()->reportMemory(report);
+	for (unsigned int terrain = 0; (terrain < scene.terrainNames.size()); terrain++)
+	{
+		const std::string& name = scene.terrainNames[terrain];
+		const PrimitiveStore* primitives = NULL;
+		for (unsigned int type = 0; (type < NUM_ACCELERATOR_TYPES); type++)
+		{
+			const LazyShape* variant = static_cast<const LazyShape*>(
+				scene.terrainVariants[(terrain * NUM_ACCELERATOR_TYPES) + type]);
+			const Accelerator* accelerator = (variant->isBuilt()) ?
+				dynamic_cast<const Accelerator*>(variant->getShape()) : NULL;
+			if (!accelerator)
+				continue;
+			std::string variantName = name + " " + acceleratorName(
+				static_cast<AcceleratorType>(type));
+			if (accelerator->getType() != static_cast<AcceleratorType>(type))
+				variantName += std::string(" (") + acceleratorName(accelerator->getType()) + ")";
+			report.add("accelerators", variantName, accelerator->memoryUsed());
+			primitives = accelerator->getPrimitives();
+		}
+		// Every accelerator over the terrain shares its triangles
+		if (primitives)
+			report.add("terrain", name + " triangles", primitives->memoryUsed());
+
+		const LazyShape* lines = static_cast<const LazyShape*>(scene.octreeLines[terrain]);
+		const BoundingShape* lineShapes = (lines->isBuilt()) ?
+			dynamic_cast<const BoundingShape*>(lines->getShape()) : NULL;
+		if (lineShapes)
+			report.add("octree lines", name, sizeof(BoundingShape) +
+				(lineShapes->numShapes() * (sizeof(Triangle) + sizeof(Shape*))));
+	}
+	for (unsigned int i = 0; (i < scene.spheres.size()); i++)
+		report.add("shapes", "sphere " + common::toString(i), sizeof(Sphere) + sizeof(Material));
+	if (scene.compiledScene)
+		scene.compiledScene->reportMemory(report);
+}
+
+static void addMaterialToHash(ContentHash& hash, const Material* material)
+{
+	hash.addInt(material != NULL);
+	if (!material)
+		return;
+	hash.addFloat(material->ambientIntensity());
+	hash.addFloat(material->diffuseIntensity());
+	hash.addFloat(material->specularIntensity());
+	hash.addFloat(material->specularExponent());
+	hash.addFloat(material->reflectivity());
+	hash.addFloat(material->refractiveIndex());
+	hash.addColour(material->getColour());
+	// Textures are loaded from files, which are already in the hash
+	hash.addInt(material->getTexture() != NULL);
+}
+
+/* Add the constants the terrain and sky box are built with, the spheres
+ * and their materials, and the camera the settings pick. */
+static void addGeometryToHash(ContentHash& hash, const DemoScene& scene,
+	const RenderSettings& settings)
+{
+	hash.addFloat(common::TERRAIN_CELL_SIZE);
+	hash.addFloat(common::TERRAIN_MAX_HEIGHT);
+	hash.addFloat(common::SKYBOX_SIZE);
+	for (unsigned int i = 0; (i < scene.spheres.size()); i++)
+	{
+		hash.addVector(scene.spheres[i]->getCentre());
+		hash.addFloat(scene.spheres[i]->getRadius());
+		addMaterialToHash(hash, scene.spheres[i]->getMaterial());
+	}
+	if (settings.cameraIndex < scene.cameras.size())
+	{
+		const Camera& camera = scene.cameras[settings.cameraIndex];
+		hash.addVector(camera.getPosition());
+		hash.addVector(camera.getBasisX());
+		hash.addVector(camera.getBasisY());
+		hash.addVector(camera.getBasisZ());
+		hash.addFloat(camera.getDistance());
+		const Rect& rect = camera.getViewingRectangle();
+		hash.addFloat(rect.left);
+		hash.addFloat(rect.right);
+		hash.addFloat(rect.top);
+		hash.addFloat(rect.bottom);
+		hash.addInt(camera.isOrthographic());
+	}
+}
+
+std::string raytracer::renderCacheKey(const DemoScene& scene, const RenderSettings& settings)
+{
+	ContentHash hash;
+	hash.addInt(RENDER_CACHE_VERSION);
+	hash.addString(scene.resourceHash);
+	hash.addString(formatRenderSettings(settings));
+	addGeometryToHash(hash, scene, settings);
+	for (unsigned int i = 0; (i < scene.lights.size()); i++)
+	{
+		if (!(settings.enabledLights & (1u << i)))
+			continue;
+		hash.addVector(scene.lights[i].getPosition());
+		hash.addColour(scene.lights[i].getAmbient());
+		hash.addColour(scene.lights[i].getDiffuse());
+		hash.addColour(scene.lights[i].getSpecular());
+	}
+	return hash.toHex();
+}
+
+std::string raytracer::primaryRayGeometryHash(const DemoScene& scene, const RenderSettings& settings)
+{
+	ContentHash hash;
+	hash.addString(scene.resourceHash);
+	addGeometryToHash(hash, scene, settings);
+	return hash.toHex();
+}
+
+std::string raytracer::checkpointKey(const DemoScene& scene, const RenderSettings& settings)
+{
+	RenderSettings keySettings = settings;
+	keySettings.numSamples = 0;
+	return renderCacheKey(scene, keySettings);
+}
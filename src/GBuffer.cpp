@@ -0,0 +1,119 @@
+#include "GBuffer.h"
+
+using namespace raytracer;
+
+/* State of each cached sample. */
+static const unsigned char SURFACE_NOT_CACHED = 0;
+static const unsigned char SURFACE_MISSED = 1; // ray hit nothing
+static const unsigned char SURFACE_OBJECT_HIT = 2;
+static const unsigned char SURFACE_TEST_SHAPE_HIT = 4;
+
+/* Settings with those which don't change what primary rays hit (lights
+ * and effects) reset, so two renders with the same key can share surfaces. */
+static std::string primaryRayKey(RenderSettings settings)
+{
+    RenderSettings defaults;
+    settings.enabledLights = defaults.enabledLights;
+    settings.localIllumination = defaults.localIllumination;
+    settings.reflectionRefraction = defaults.reflectionRefraction;
+    settings.shadows = defaults.shadows;
+    return formatRenderSettings(settings);
+}
+
+GBuffer::GBuffer(size_t maxBytes) : maxBytes(maxBytes), width(0), height(0),
+    samplesPerPixel(0), numCached(0)
+{
+}
+
+bool GBuffer::prepare(const RenderSettings& settings, const std::string& sceneKey)
+{
+    std::string key = primaryRayKey(settings) + "\n" + sceneKey;
+    if (key == geometryKey)
+        return true;
+    clear();
+    size_t numSamples = static_cast<size_t>(settings.width) * settings.height
+        * raytracer::samplesPerPixel(settings);
+    if (numSamples * sizeof(CachedSurface) > maxBytes)
+        return false;
+
+    CachedSurface empty;
+    empty.shape = NULL;
+    empty.material = NULL;
+    empty.state = SURFACE_NOT_CACHED;
+    surfaces.assign(numSamples, empty);
+    geometryKey = key;
+    width = settings.width;
+    height = settings.height;
+    samplesPerPixel = raytracer::samplesPerPixel(settings);
+    return true;
+}
+
+void GBuffer::clear()
+{
+    // Swap with empty vector to release memory
+    std::vector<CachedSurface>().swap(surfaces);
+    geometryKey.clear();
+    width = height = 0;
+    samplesPerPixel = 0;
+    numCached = 0;
+}
+
+long GBuffer::sampleIndex(int x, int y, unsigned int sample) const
+{
+    if (x < 0 || x >= width || y < 0 || y >= height || sample >= samplesPerPixel)
+        return -1;
+    return ((static_cast<long>(y) * width) + x) * samplesPerPixel + sample;
+}
+
+bool GBuffer::lookup(int x, int y, unsigned int sample, SurfaceHit& hit) const
+{
+    long index = sampleIndex(x, y, sample);
+    if (index < 0 || surfaces[index].state == SURFACE_NOT_CACHED)
+        return false;
+    const CachedSurface& surface = surfaces[index];
+    hit.objectHit = (surface.state & SURFACE_OBJECT_HIT) != 0;
+    hit.testShapeHit = (surface.state & SURFACE_TEST_SHAPE_HIT) != 0;
+    hit.record = HitRecord();
+    hit.record.pointOfIntersection = surface.point;
+    hit.record.normal = surface.normal;
+    hit.record.texCoord = surface.texCoord;
+    hit.record.hitShape = surface.shape;
+    hit.rayDirection = surface.rayDirection;
+    hit.material = surface.material;
+    hit.objectColour = surface.objectColour;
+    return true;
+}
+
+void GBuffer::store(int x, int y, unsigned int sample, const SurfaceHit* hit)
+{
+    long index = sampleIndex(x, y, sample);
+    if (index < 0)
+        return;
+    CachedSurface& surface = surfaces[index];
+    if (surface.state == SURFACE_NOT_CACHED)
+        numCached++;
+    if (!hit)
+    {
+        surface.state = SURFACE_MISSED;
+        return;
+    }
+    surface.point = hit->record.pointOfIntersection;
+    surface.normal = hit->record.normal;
+    surface.texCoord = hit->record.texCoord;
+    surface.shape = hit->record.hitShape;
+    surface.rayDirection = hit->rayDirection;
+    surface.material = hit->material;
+    surface.objectColour = hit->objectColour;
+    surface.state = (hit->objectHit ? SURFACE_OBJECT_HIT : 0) |
+        (hit->testShapeHit ? SURFACE_TEST_SHAPE_HIT : 0);
+}
+
+unsigned int GBuffer::samplesCached() const
+{
+    return numCached;
+}
+
+size_t GBuffer::memoryUsed() const
+{
+    return surfaces.size() * sizeof(CachedSurface);
+}
@@ -0,0 +1,231 @@
+#include "GridAccelerator.h"
+#include "RayCost.h"
+#include <algorithm>
+#include <cmath>
+#include <float.h>
+
+using namespace raytracer;
+
+const float GridAccelerator::CELLS_PER_PRIMITIVE = 2.0f;
+
+GridAccelerator::GridAccelerator(const PrimitiveStore* primitives,
+    const AcceleratorParameters& parameters) : Accelerator(primitives, parameters)
+{
+    const std::vector<AABB>& primitiveBounds = primitives->getPrimitiveBounds();
+    // Grid covers the primitives tightly, rather than the store's box
+    bounds = primitives->getBoundingBox();
+    if (!primitiveBounds.empty())
+    {
+        bounds = primitiveBounds[0];
+        for (unsigned int i = 1; (i < primitiveBounds.size()); i++)
+            bounds.expand(primitiveBounds[i]);
+    }
+    centre = bounds.bounds[0] + ((bounds.bounds[1] - bounds.bounds[0]) / 2);
+
+    // Pick cubic cells so there are about gridCellsPerPrimitive cells for
+    // each primitive. Flat boxes (e.g. terrain) get one layer of cells along
+    // their thin axis.
+    Vector3 extent = bounds.bounds[1] - bounds.bounds[0];
+    float extents[3] = { extent.x, extent.y, extent.z };
+    float largest = std::max(extents[0], std::max(extents[1], extents[2]));
+    float targetCells = std::max(1.0f, primitiveBounds.size() * parameters.gridCellsPerPrimitive);
+    float area = 1.0f;
+    int dimensions = 0;
+    for (int axis = 0; (axis < 3); axis++)
+    {
+        if (extents[axis] > largest * 0.01f)
+        {
+            area *= extents[axis];
+            dimensions++;
+        }
+    }
+    float cellEdge = (dimensions > 0) ? pow(area / targetCells, 1.0f / dimensions) : 1.0f;
+    for (int axis = 0; (axis < 3); axis++)
+    {
+        int cells = (cellEdge > 0.0f) ? static_cast<int>(extents[axis] / cellEdge) : 1;
+        resolution[axis] = std::max(1, std::min(cells, static_cast<int>(MAX_RESOLUTION)));
+        cellSize[axis] = std::max(extents[axis] / resolution[axis], FLT_EPSILON);
+    }
+
+    // Count primitives overlapping each cell, then list them
+    unsigned int numCells = resolution[0] * resolution[1] * resolution[2];
+    cellStart.assign(numCells + 1, 0);
+    for (int pass = 0; (pass < 2); pass++)
+    {
+        std::vector<unsigned int> cellFilled;
+        if (pass == 1)
+        {
+            for (unsigned int i = 0; (i < numCells); i++)
+                cellStart[i + 1] += cellStart[i];
+            cellPrimitives.resize(cellStart[numCells]);
+            cellFilled.assign(cellStart.begin(), cellStart.end() - 1);
+        }
+        for (unsigned int p = 0; (p < primitiveBounds.size()); p++)
+        {
+            int minCell[3], maxCell[3];
+            for (int axis = 0; (axis < 3); axis++)
+            {
+                minCell[axis] = cellCoordinate(primitiveBounds[p].bounds[0][axis], axis);
+                maxCell[axis] = cellCoordinate(primitiveBounds[p].bounds[1][axis], axis);
+            }
+            for (int z = minCell[2]; (z <= maxCell[2]); z++)
+            {
+                for (int y = minCell[1]; (y <= maxCell[1]); y++)
+                {
+                    for (int x = minCell[0]; (x <= maxCell[0]); x++)
+                    {
+                        unsigned int cell = x + (resolution[0] * (y + (resolution[1] * z)));
+                        if (pass == 0)
+                            cellStart[cell + 1]++;
+                        else
+                            cellPrimitives[cellFilled[cell]++] = p;
+                    }
+                }
+            }
+        }
+    }
+}
+
+int GridAccelerator::cellCoordinate(float position, int axis) const
+{
+    int cell = static_cast<int>(floor((position - bounds.bounds[0][axis]) / cellSize[axis]));
+    return std::max(0, std::min(cell, resolution[axis] - 1));
+}
+
+AcceleratorType GridAccelerator::getType() const
+{
+    return GRID_ACCELERATOR;
+}
+
+size_t GridAccelerator::memoryUsed() const
+{
+    return sizeof(GridAccelerator) + ((cellStart.capacity() + cellPrimitives.capacity())
+        * sizeof(unsigned int));
+}
+
+AcceleratorStatistics GridAccelerator::statistics() const
+{
+    // The grid is a root whose children are the cells
+    AcceleratorStatistics result(bounds);
+    result.addNode(bounds, 0, false);
+    for (int z = 0; (z < resolution[2]); z++)
+    {
+        for (int y = 0; (y < resolution[1]); y++)
+        {
+            for (int x = 0; (x < resolution[0]); x++)
+            {
+                Vector3 cellMin = bounds.bounds[0] +
+                    Vector3(x * cellSize[0], y * cellSize[1], z * cellSize[2]);
+                AABB cell(cellMin, cellMin + Vector3(cellSize[0], cellSize[1], cellSize[2]));
+                unsigned int index = x + (resolution[0] * (y + (resolution[1] * z)));
+                result.addNode(cell, 1, true, cellStart[index + 1] - cellStart[index]);
+            }
+        }
+    }
+    result.memoryBytes = memoryUsed();
+    return result;
+}
+
+const Vector3& GridAccelerator::getCentre() const
+{
+    return centre;
+}
+
+bool GridAccelerator::traverse(const Ray& ray, float tMin, float tMax, float time,
+    HitRecord* record, const Shape** occludingShape) const
+{
+    const Vector3& origin = ray.origin();
+    const Vector3& direction = ray.direction();
+    const Vector3& inverseDirection = ray.inverseDirection();
+    float origin3[3] = { origin.x, origin.y, origin.z };
+    float direction3[3] = { direction.x, direction.y, direction.z };
+    float inverse3[3] = { inverseDirection.x, inverseDirection.y, inverseDirection.z };
+    float min3[3] = { bounds.bounds[0].x, bounds.bounds[0].y, bounds.bounds[0].z };
+    float max3[3] = { bounds.bounds[1].x, bounds.bounds[1].y, bounds.bounds[1].z };
+
+    // Find where the ray enters and leaves the grid
+    float tEnter = tMin;
+    float tExit = tMax;
+    for (int axis = 0; (axis < 3); axis++)
+    {
+        if (direction3[axis] == 0.0f)
+        {
+            if (origin3[axis] < min3[axis] || origin3[axis] > max3[axis])
+                return false;
+            continue;
+        }
+        float t0 = (min3[axis] - origin3[axis]) * inverse3[axis];
+        float t1 = (max3[axis] - origin3[axis]) * inverse3[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tEnter = std::max(tEnter, t0);
+        tExit = std::min(tExit, t1);
+        if (tEnter > tExit)
+            return false;
+    }
+
+    int cell[3];
+    int step[3];
+    float tNext[3]; // distance along ray at which the next cell is entered
+    float tDelta[3]; // distance along ray taken to cross a whole cell
+    for (int axis = 0; (axis < 3); axis++)
+    {
+        cell[axis] = cellCoordinate(origin3[axis] + (direction3[axis] * tEnter), axis);
+        if (direction3[axis] == 0.0f)
+        {
+            step[axis] = 0;
+            tNext[axis] = FLT_MAX;
+            tDelta[axis] = FLT_MAX;
+            continue;
+        }
+        step[axis] = (direction3[axis] > 0.0f) ? 1 : -1;
+        float boundary = min3[axis] + ((cell[axis] + (step[axis] > 0 ? 1 : 0)) * cellSize[axis]);
+        tNext[axis] = (boundary - origin3[axis]) * inverse3[axis];
+        tDelta[axis] = cellSize[axis] * fabs(inverse3[axis]);
+    }
+
+    const ShapeList& shapes = primitives->getPrimitives();
+    bool isAHit = false;
+    while (true)
+    {
+        unsigned int index = cell[0] + (resolution[0] * (cell[1] + (resolution[1] * cell[2])));
+        raycost::countNodeVisit();
+        for (unsigned int i = cellStart[index]; (i < cellStart[index + 1]); i++)
+        {
+            const Shape* shape = shapes[cellPrimitives[i]];
+            if (occludingShape)
+            {
+                if (shape->shadowHit(ray, tMin, tMax, time, *occludingShape))
+                    return true;
+            }
+            else if (shape->hit(ray, tMin, tMax, time, *record))
+            {
+                tMax = record->t;
+                isAHit = true;
+            }
+        }
+        // A hit in this cell is closer than anything in later cells. Hits
+        // beyond this cell (by primitives spanning several cells) may not
+        // be, so carry on until the ray reaches the cell they are in.
+        int axis = (tNext[0] < tNext[1]) ? ((tNext[0] < tNext[2]) ? 0 : 2) : ((tNext[1] < tNext[2]) ? 1 : 2);
+        float cellExit = tNext[axis];
+        if ((isAHit && tMax <= cellExit) || cellExit > tExit)
+            break;
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= resolution[axis])
+            break;
+        tNext[axis] += tDelta[axis];
+    }
+    return isAHit;
+}
+
+bool GridAccelerator::hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const
+{
+    return traverse(ray, tMin, tMax, time, &record, NULL);
+}
+
+bool GridAccelerator::shadowHit(const Ray& ray, float tMin, float tMax, float time,
+    const Shape*& occludingShape) const
+{
+    return traverse(ray, tMin, tMax, time, NULL, &occludingShape);
+}
@@ -1,5 +1,6 @@
 #include "Image.h"
 #include <cmath>
+#include <algorithm>
 
 using namespace raytracer;
 
@@ -7,56 +8,78 @@ Image::Image(int width, int height, const Colour& background)
     : width(width), height(height)
 {
     // Allocate fixed-size array to store pixels
-    pixels.resize(width); // number of rows
-    for (unsigned int i = 0; (i < pixels.size()); i++)
+    storage.resize(static_cast<size_t>(width) * height);
+    pixels = (storage.empty()) ? NULL : &storage[0];
+    clear(background);
+}
+
+Image::Image(int width, int height, const Colour* externalPixels)
+    : pixels(externalPixels), width(width), height(height)
+{
+}
+
+Image::Image(const Image& other) : storage(other.storage), pixels(other.pixels),
+    width(other.width), height(other.height)
+{
+    // Point to this image's own copy of the pixels, if it has one
+    if (!storage.empty())
+        pixels = &storage[0];
+}
+
+Image& Image::operator=(const Image& other)
+{
+    if (this != &other)
     {
-        pixels[i].resize(height); // number of columns
+        storage = other.storage;
+        pixels = (storage.empty()) ? other.pixels : &storage[0];
+        width = other.width;
+        height = other.height;
     }
-    clear(background);
+    return *this;
 }
 
 void Image::clear(const Colour& colour)
 {
-    for (int x = 0; (x < width); x++)
-        for (int y = 0; (y < height); y++)
-            pixels[x][y] = colour;
+    std::fill(storage.begin(), storage.end(), colour);
 }
 
 bool Image::set(int x, int y, const Colour& colour)
 {
     if (x < 0 || x >= width) return false;
     if (y < 0 || y >= height) return false;
-    pixels[x][y] = colour;
+    if (storage.empty()) return false; // pixels stored externally
+    storage[(y * width) + x] = colour;
     return true;
 }
 
 void Image::setWidth(int newWidth)
 {
-	if (newWidth <= 0)
-		return;
-	pixels.resize(newWidth);
-	width = newWidth;
+	resize(newWidth, height);
 }
 
 void Image::setHeight(int newHeight)
 {
-	if (newHeight <= 0)
-		return;
-	// For every column, change height
-    for (unsigned int i = 0; (i < pixels.size()); i++)
-        pixels[i].resize(newHeight);
-    height = newHeight;
+	resize(width, newHeight);
 }
 
 void Image::resize(int newWidth, int newHeight)
 {
-	setWidth(newWidth);
-	setHeight(newHeight);
+	if (newWidth <= 0 || newHeight <= 0)
+		return;
+	// Copy the pixels both sizes share into new storage. New pixels are black.
+	std::vector<Colour> newStorage(static_cast<size_t>(newWidth) * newHeight);
+	for (int y = 0; (y < std::min(height, newHeight)); y++)
+		for (int x = 0; (x < std::min(width, newWidth)); x++)
+			newStorage[(y * newWidth) + x] = pixels[(y * width) + x];
+	storage.swap(newStorage);
+	pixels = &storage[0];
+	width = newWidth;
+	height = newHeight;
 }
 
 const Colour& Image::get(int x, int y) const
 {
-    return pixels[x][y];
+    return pixels[(y * width) + x];
 }
 
 int Image::getWidth() const
@@ -68,3 +91,13 @@ int Image::getHeight() const
 {
     return height;
 }
+
+const Colour* Image::getPixels() const
+{
+    return pixels;
+}
+
+size_t Image::memoryUsed() const
+{
+    return storage.size() * sizeof(Colour);
+}
@@ -0,0 +1,121 @@
+#include "ImageComparison.h"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace raytracer;
+
+const double ImageError::MAX_PSNR = 100.0;
+const int ImageError::SSIM_WINDOW_SIZE;
+
+/* Constants which keep SSIM stable where windows are almost flat, for
+ * values in [0, 1]. */
+static const double SSIM_C1 = 0.01 * 0.01;
+static const double SSIM_C2 = 0.03 * 0.03;
+
+float clampedChannel(float value)
+{
+    return std::min(1.0f, std::max(0.0f, value));
+}
+
+/* Luminance of every pixel of a framebuffer, row by row. */
+std::vector<float> clampedLuminance(const Framebuffer& image)
+{
+    int width = image.getWidth();
+    int height = image.getHeight();
+    std::vector<float> luminance(width * height);
+    for (int y = 0; (y < height); y++)
+    {
+        for (int x = 0; (x < width); x++)
+        {
+            const Colour& colour = image.get(x, y);
+            luminance[(y * width) + x] = (0.2126f * clampedChannel(colour.r)) +
+                (0.7152f * clampedChannel(colour.g)) + (0.0722f * clampedChannel(colour.b));
+        }
+    }
+    return luminance;
+}
+
+/* SSIM of the window of the given size whose top left is (x, y). */
+double windowSSIM(const std::vector<float>& a, const std::vector<float>& b, int width,
+    int x, int y, int windowWidth, int windowHeight)
+{
+    double sumA = 0.0, sumB = 0.0, sumAA = 0.0, sumBB = 0.0, sumAB = 0.0;
+    for (int j = y; (j < y + windowHeight); j++)
+    {
+        for (int i = x; (i < x + windowWidth); i++)
+        {
+            double valueA = a[(j * width) + i];
+            double valueB = b[(j * width) + i];
+            sumA += valueA;
+            sumB += valueB;
+            sumAA += valueA * valueA;
+            sumBB += valueB * valueB;
+            sumAB += valueA * valueB;
+        }
+    }
+    double n = windowWidth * windowHeight;
+    double meanA = sumA / n;
+    double meanB = sumB / n;
+    double varianceA = (sumAA / n) - (meanA * meanA);
+    double varianceB = (sumBB / n) - (meanB * meanB);
+    double covariance = (sumAB / n) - (meanA * meanB);
+    return (((2.0 * meanA * meanB) + SSIM_C1) * ((2.0 * covariance) + SSIM_C2)) /
+        (((meanA * meanA) + (meanB * meanB) + SSIM_C1) * (varianceA + varianceB + SSIM_C2));
+}
+
+bool raytracer::compareImages(const Framebuffer& image, const Framebuffer& reference,
+    ImageError& error)
+{
+    int width = image.getWidth();
+    int height = image.getHeight();
+    if (width != reference.getWidth() || height != reference.getHeight() ||
+        width <= 0 || height <= 0)
+        return false;
+
+    double sumSquares = 0.0;
+    double maxError = 0.0;
+    for (int y = 0; (y < height); y++)
+    {
+        for (int x = 0; (x < width); x++)
+        {
+            const Colour& colour = image.get(x, y);
+            const Colour& expected = reference.get(x, y);
+            double differences[3] = {
+                clampedChannel(colour.r) - clampedChannel(expected.r),
+                clampedChannel(colour.g) - clampedChannel(expected.g),
+                clampedChannel(colour.b) - clampedChannel(expected.b)
+            };
+            for (unsigned int i = 0; (i < 3); i++)
+            {
+                sumSquares += differences[i] * differences[i];
+                maxError = std::max(maxError, std::fabs(differences[i]));
+            }
+        }
+    }
+    error.rmse = std::sqrt(sumSquares / (3.0 * width * height));
+    error.psnr = (error.rmse > 0.0) ?
+        std::min(ImageError::MAX_PSNR, -20.0 * std::log10(error.rmse)) : ImageError::MAX_PSNR;
+    error.maxError = maxError;
+
+    // Windows overlap by half, and images smaller than a window are
+    // compared as a single window
+    std::vector<float> luminance = clampedLuminance(image);
+    std::vector<float> referenceLuminance = clampedLuminance(reference);
+    int windowWidth = std::min(ImageError::SSIM_WINDOW_SIZE, width);
+    int windowHeight = std::min(ImageError::SSIM_WINDOW_SIZE, height);
+    int step = std::max(1, ImageError::SSIM_WINDOW_SIZE / 2);
+    double sumSSIM = 0.0;
+    unsigned int windows = 0;
+    for (int y = 0; (y + windowHeight <= height); y += step)
+    {
+        for (int x = 0; (x + windowWidth <= width); x += step)
+        {
+            sumSSIM += windowSSIM(luminance, referenceLuminance, width, x, y,
+                windowWidth, windowHeight);
+            windows++;
+        }
+    }
+    error.ssim = sumSSIM / windows;
+    return true;
+}
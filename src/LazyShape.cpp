@@ -0,0 +1,59 @@
+#include "LazyShape.h"
+
+using namespace raytracer;
+using namespace raytracer::threading;
+
+LazyShape::LazyShape(const AABB& boundingBox, ShapeBuilder* builder) :
+    boundingBox(boundingBox), builder(builder), shape(NULL), built(0)
+{
+    centre = boundingBox.bounds[0] + ((boundingBox.bounds[1] - boundingBox.bounds[0]) / 2);
+}
+
+LazyShape::~LazyShape()
+{
+    delete shape;
+    delete builder;
+}
+
+bool LazyShape::isBuilt() const
+{
+    // Acquire ordering, so once the flag is seen to be set, so is
+    // everything written while building the shape
+    return (__atomic_load_n(&built, __ATOMIC_ACQUIRE) != 0);
+}
+
+Shape* LazyShape::getShape() const
+{
+    if (isBuilt())
+        return shape;
+    ScopedLock lock(mutex);
+    // Another thread may have built it while this one waited for the lock
+    if (!built)
+    {
+        shape = builder->build();
+        __atomic_store_n(&built, 1, __ATOMIC_RELEASE);
+    }
+    return shape;
+}
+
+const Vector3& LazyShape::getCentre() const
+{
+    return centre;
+}
+
+bool LazyShape::hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const
+{
+    if (!boundingBox.intersects(ray, tMin, tMax))
+        return false;
+    Shape* builtShape = getShape();
+    return (builtShape && builtShape->hit(ray, tMin, tMax, time, record));
+}
+
+bool LazyShape::shadowHit(const Ray& ray, float tMin, float tMax, float time,
+    const Shape*& occludingShape) const
+{
+    if (!boundingBox.intersects(ray, tMin, tMax))
+        return false;
+    Shape* builtShape = getShape();
+    return (builtShape && builtShape->shadowHit(ray, tMin, tMax, time, occludingShape));
+}
@@ -0,0 +1,270 @@
+#include "MappedImage.h"
+#include "Image.h"
+#include "TGA.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace raytracer;
+
+/* Identifies files created by MappedImage. */
+static const unsigned int MAPPED_IMAGE_MAGIC = 0x42465744; // "DWFB"
+static const unsigned int MAPPED_IMAGE_VERSION = 1;
+/* Pixel data starts this many bytes into the file, so it is page aligned. */
+static const size_t MAPPED_IMAGE_HEADER_SIZE = 4096;
+
+struct MappedImageHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    int width;
+    int height;
+    int tileSize;
+};
+
+/* Returned by get() for out of bounds pixels. */
+static const Colour OUT_OF_BOUNDS_COLOUR;
+
+MappedImage::MappedImage() : fd(-1), mapping(NULL), mappingSize(0),
+    pixels(NULL), width(0), height(0), tileSize(0), tilesX(0), tilesY(0)
+{
+}
+
+MappedImage::~MappedImage()
+{
+    close();
+}
+
+bool MappedImage::create(const std::string& filename, int width, int height,
+    int tileSize)
+{
+    close();
+    if (width <= 0 || height <= 0 || tileSize <= 0)
+        return false;
+
+    int newFd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (newFd < 0)
+        return false;
+    // Size the file to hold every tile. Pages that are never written
+    // to are not allocated on disk.
+    size_t tilesAcross = (width + tileSize - 1) / tileSize;
+    size_t tilesDown = (height + tileSize - 1) / tileSize;
+    size_t pixelBytes = tilesAcross * tilesDown * tileSize * tileSize * sizeof(Colour);
+    if (ftruncate(newFd, MAPPED_IMAGE_HEADER_SIZE + pixelBytes) != 0)
+    {
+        ::close(newFd);
+        return false;
+    }
+    MappedImageHeader header = { MAPPED_IMAGE_MAGIC, MAPPED_IMAGE_VERSION,
+        width, height, tileSize };
+    if (pwrite(newFd, &header, sizeof(header), 0) != sizeof(header))
+    {
+        ::close(newFd);
+        return false;
+    }
+    return mapFile(newFd);
+}
+
+bool MappedImage::open(const std::string& filename)
+{
+    close();
+    int newFd = ::open(filename.c_str(), O_RDWR);
+    if (newFd < 0)
+        return false;
+    return mapFile(newFd);
+}
+
+bool MappedImage::mapFile(int fileDescriptor)
+{
+    MappedImageHeader header;
+    struct stat fileInfo;
+    if (pread(fileDescriptor, &header, sizeof(header), 0) != sizeof(header) ||
+        header.magic != MAPPED_IMAGE_MAGIC ||
+        header.version != MAPPED_IMAGE_VERSION ||
+        fstat(fileDescriptor, &fileInfo) != 0)
+    {
+        ::close(fileDescriptor);
+        return false;
+    }
+
+    // Reject headers which are corrupt, or describe more tiles than the
+    // file holds (e.g. it was truncated). The size is found in floating
+    // point, so huge dimensions cannot overflow it.
+    size_t size = fileInfo.st_size;
+    bool valid = (header.width > 0 && header.height > 0 && header.tileSize > 0 &&
+        size >= MAPPED_IMAGE_HEADER_SIZE);
+    if (valid)
+    {
+        size_t tilesAcross = (static_cast<size_t>(header.width) + header.tileSize - 1) /
+            header.tileSize;
+        size_t tilesDown = (static_cast<size_t>(header.height) + header.tileSize - 1) /
+            header.tileSize;
+        double pixelBytes = static_cast<double>(tilesAcross) * tilesDown *
+            header.tileSize * header.tileSize * sizeof(Colour);
+        valid = (pixelBytes <= static_cast<double>(size - MAPPED_IMAGE_HEADER_SIZE));
+    }
+    if (!valid)
+    {
+        ::close(fileDescriptor);
+        return false;
+    }
+
+    void* address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        fileDescriptor, 0);
+    if (address == MAP_FAILED)
+    {
+        ::close(fileDescriptor);
+        return false;
+    }
+    fd = fileDescriptor;
+    mapping = static_cast<unsigned char*>(address);
+    mappingSize = size;
+    pixels = reinterpret_cast<Colour*>(mapping + MAPPED_IMAGE_HEADER_SIZE);
+    width = header.width;
+    height = header.height;
+    tileSize = header.tileSize;
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+    return true;
+}
+
+void MappedImage::close()
+{
+    if (mapping)
+    {
+        msync(mapping, mappingSize, MS_SYNC);
+        munmap(mapping, mappingSize);
+    }
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+    mapping = NULL;
+    mappingSize = 0;
+    pixels = NULL;
+    width = height = tileSize = tilesX = tilesY = 0;
+}
+
+bool MappedImage::isOpen() const
+{
+    return (mapping != NULL);
+}
+
+bool MappedImage::set(int x, int y, const Colour& colour)
+{
+    if (x < 0 || x >= width) return false;
+    if (y < 0 || y >= height) return false;
+    pixels[pixelIndex(x, y)] = colour;
+    return true;
+}
+
+const Colour& MappedImage::get(int x, int y) const
+{
+    if (x < 0 || x >= width || y < 0 || y >= height)
+        return OUT_OF_BOUNDS_COLOUR;
+    return pixels[pixelIndex(x, y)];
+}
+
+int MappedImage::getWidth() const
+{
+    return width;
+}
+
+int MappedImage::getHeight() const
+{
+    return height;
+}
+
+int MappedImage::getTileSize() const
+{
+    return tileSize;
+}
+
+int MappedImage::getTilesX() const
+{
+    return tilesX;
+}
+
+int MappedImage::getTilesY() const
+{
+    return tilesY;
+}
+
+size_t MappedImage::pixelIndex(int x, int y) const
+{
+    // Find which tile the pixel is in, then where the pixel is in that tile
+    size_t tileIndex = static_cast<size_t>(y / tileSize) * tilesX + (x / tileSize);
+    size_t offsetInTile = static_cast<size_t>(y % tileSize) * tileSize + (x % tileSize);
+    return (tileIndex * tileSize * tileSize) + offsetInTile;
+}
+
+void MappedImage::flushTile(int tileX, int tileY)
+{
+    if (!mapping || tileX < 0 || tileX >= tilesX || tileY < 0 || tileY >= tilesY)
+        return;
+    size_t tileBytes = static_cast<size_t>(tileSize) * tileSize * sizeof(Colour);
+    size_t tileIndex = static_cast<size_t>(tileY) * tilesX + tileX;
+    flushRange(tileIndex * tileBytes, tileBytes);
+}
+
+void MappedImage::rowsFinished(int firstRow, int numRows)
+{
+    if (!mapping)
+        return;
+    int lastRow = firstRow + numRows - 1;
+    for (int tileY = firstRow / tileSize; (tileY < tilesY); tileY++)
+    {
+        // A row of tiles is finished when its bottom row has been rendered
+        int tileLastRow = std::min(height, (tileY + 1) * tileSize) - 1;
+        if (tileLastRow > lastRow)
+            break;
+        if (tileLastRow < firstRow)
+            continue;
+        // Tiles in the same row are contiguous, so flush them all at once
+        size_t tileBytes = static_cast<size_t>(tileSize) * tileSize * sizeof(Colour);
+        flushRange(static_cast<size_t>(tileY) * tilesX * tileBytes, tilesX * tileBytes);
+    }
+}
+
+void MappedImage::flushRange(size_t start, size_t length)
+{
+    // msync() and madvise() operate on whole pages, so only touch the
+    // pages which lie entirely inside the range
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t begin = MAPPED_IMAGE_HEADER_SIZE + start;
+    size_t end = begin + length;
+    begin = ((begin + pageSize - 1) / pageSize) * pageSize;
+    end = (end / pageSize) * pageSize;
+    if (end <= begin)
+        return;
+    msync(mapping + begin, end - begin, MS_SYNC);
+    // Drop pages from this process and from the page cache
+    madvise(mapping + begin, end - begin, MADV_DONTNEED);
+    posix_fadvise(fd, begin, end - begin, POSIX_FADV_DONTNEED);
+}
+
+bool MappedImage::writeTGA(const std::string& filename, bool compress)
+{
+    if (!mapping)
+        return false;
+    tga::StreamWriter writer;
+    if (!writer.open(filename, width, height, compress))
+        return false;
+    // Copy one row of tiles at a time into a band and stream it out
+    Image band(width, tileSize);
+    for (int tileY = 0; (tileY < tilesY); tileY++)
+    {
+        int firstRow = tileY * tileSize;
+        int rows = std::min(tileSize, height - firstRow);
+        for (int y = 0; (y < rows); y++)
+            for (int x = 0; (x < width); x++)
+                band.set(x, y, get(x, firstRow + y));
+        if (!writer.writeRows(band, 0, rows))
+            return false;
+        // Reading the tiles paged them back in, so evict them again
+        rowsFinished(firstRow, rows);
+    }
+    return writer.close();
+}
@@ -0,0 +1,122 @@
+#include "MemoryReport.h"
+#include "Common.h"
+#include <sstream>
+#include <iomanip>
+
+using namespace raytracer;
+
+/* Size in bytes, KB or MB, whichever is the largest unit it has one of. */
+static std::string formatMemorySize(size_t bytes)
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    if (bytes >= 1024 * 1024)
+        ss << (bytes / (1024.0 * 1024.0)) << " MB";
+    else if (bytes >= 1024)
+        ss << (bytes / 1024.0) << " KB";
+    else
+        ss << bytes << " B";
+    return ss.str();
+}
+
+void MemoryReport::add(const std::string& subsystem, const std::string& resource,
+    size_t bytes, bool mapped)
+{
+    for (unsigned int i = 0; (i < entries.size()); i++)
+    {
+        Entry& entry = entries[i];
+        if (entry.subsystem == subsystem && entry.resource == resource &&
+            entry.mapped == mapped)
+        {
+            entry.bytes += bytes;
+            return;
+        }
+    }
+    Entry entry = { subsystem, resource, bytes, mapped };
+    entries.push_back(entry);
+}
+
+const std::vector<MemoryReport::Entry>& MemoryReport::getEntries() const
+{
+    return entries;
+}
+
+std::vector<std::string> MemoryReport::getSubsystems() const
+{
+    std::vector<std::string> subsystems;
+    for (unsigned int i = 0; (i < entries.size()); i++)
+    {
+        bool found = false;
+        for (unsigned int j = 0; (j < subsystems.size() && !found); j++)
+            found = (subsystems[j] == entries[i].subsystem);
+        if (!found)
+            subsystems.push_back(entries[i].subsystem);
+    }
+    return subsystems;
+}
+
+size_t MemoryReport::totalBytes(const std::string& subsystem, bool mapped) const
+{
+    size_t bytes = 0;
+    for (unsigned int i = 0; (i < entries.size()); i++)
+    {
+        if (entries[i].mapped == mapped &&
+            (subsystem.empty() || entries[i].subsystem == subsystem))
+            bytes += entries[i].bytes;
+    }
+    return bytes;
+}
+
+std::string MemoryReport::format(const std::string& indent, bool resources) const
+{
+    std::stringstream ss;
+    ss << indent << "memory: " << formatMemorySize(totalBytes()) << " allocated, "
+        << formatMemorySize(totalBytes("", true)) << " mapped from files\n";
+    std::vector<std::string> subsystems = getSubsystems();
+    for (unsigned int i = 0; (i < subsystems.size()); i++)
+    {
+        size_t mappedBytes = totalBytes(subsystems[i], true);
+        ss << indent << "  " << subsystems[i] << ": " << formatMemorySize(
+            totalBytes(subsystems[i]));
+        if (mappedBytes > 0)
+            ss << " (" << formatMemorySize(mappedBytes) << " mapped)";
+        ss << "\n";
+        for (unsigned int j = 0; (resources && j < entries.size()); j++)
+        {
+            const Entry& entry = entries[j];
+            if (entry.subsystem == subsystems[i])
+                ss << indent << "    " << entry.resource << ": "
+                    << formatMemorySize(entry.bytes) << (entry.mapped ? " mapped" : "") << "\n";
+        }
+    }
+    return ss.str();
+}
+
+std::string MemoryReport::formatJSON() const
+{
+    std::stringstream ss;
+    ss << "{\"allocatedBytes\": " << totalBytes() << ", \"mappedBytes\": "
+        << totalBytes("", true) << ", \"subsystems\": {";
+    std::vector<std::string> subsystems = getSubsystems();
+    for (unsigned int i = 0; (i < subsystems.size()); i++)
+    {
+        ss << ((i > 0) ? ", " : "") << "\"" << common::escapeJSON(subsystems[i])
+            << "\": {\"allocatedBytes\": " << totalBytes(subsystems[i])
+            << ", \"mappedBytes\": " << totalBytes(subsystems[i], true)
+            << ", \"resources\": [";
+        bool first = true;
+        for (unsigned int j = 0; (j < entries.size()); j++)
+        {
+            const Entry& entry = entries[j];
+            if (entry.subsystem != subsystems[i])
+                continue;
+            ss << (first ? "" : ", ") << "{\"name\": \"" << common::escapeJSON(entry.resource)
+                << "\", \"bytes\": " << entry.bytes << ", \"mapped\": "
+                << (entry.mapped ? "true" : "false") << "}";
+            first = false;
+        }
+        ss << "]}";
+    }
+    ss << "}}";
+    return ss.str();
+}
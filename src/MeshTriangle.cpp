@@ -1,5 +1,7 @@
 #include "MeshTriangle.h"
 #include "Intersection.h"
+#include "Profiling.h"
+#include "RayCost.h"
 
 using namespace raytracer;
 
@@ -33,8 +35,16 @@ const Vector3& MeshTriangle::getCentre() const
     return centrePoint;
 }
 
+const Vertex& MeshTriangle::getVertex(unsigned int index) const
+{
+    const int indices[3] = { v1, v2, v3 };
+    return mesh->getVertices()[indices[index]];
+}
+
 bool MeshTriangle::hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const
 {
+    PROFILE_STAGE(PRIMITIVE_TESTS);
+    raycost::countPrimitiveTest();
     // Retrieve points from mesh
     const VertexList& vertices = mesh->getVertices();
     const Vertex& p1 = vertices[v1];
@@ -49,6 +59,8 @@ bool MeshTriangle::hit(const Ray& ray, float tMin, float tMax, float time, HitRe
 
 bool MeshTriangle::shadowHit(const Ray& ray, float tMin, float tMax, float time, const Shape*& occludingShape) const
 {
+    PROFILE_STAGE(PRIMITIVE_TESTS);
+    raycost::countPrimitiveTest();
     // Retrieve points from mesh
     const VertexList& vertices = mesh->getVertices();
     const Vertex& p1 = vertices[v1];
@@ -1,11 +1,18 @@
 #include "Octree.h"
+#include "RayCost.h"
+#include <map>
+#include <new>
+#include <algorithm>
+#include <cfloat>
 
 using namespace raytracer;
 
-Octree::Octree(const AABB& boundary) : boundary(boundary), numShapes(0), numChildren(0)
+Octree::Octree(const AABB& boundary, Arena* arena, unsigned int nodeCapacity,
+    unsigned int maxDepth) : boundary(boundary), hitBounds(boundary), shapes(NULL),
+    numShapes(0), shapeCapacity(0), numChildren(0), nodeCapacity(std::max(nodeCapacity, 1u)),
+    depth(0), maxDepth(maxDepth), arena(arena)
 {
-    // Initialise all shapes and child nodes to NULL
-    clearShapes();
+    // Initialise all child nodes to NULL
     for (int i = 0; (i < MAX_CHILDREN); i++)
         children[i] = NULL;
     // Compute centre point of bounding box
@@ -15,19 +22,50 @@ Octree::Octree(const AABB& boundary) : boundary(boundary), numShapes(0), numChil
 Octree::~Octree()
 {
     clearChildren();
+    if (!arena)
+        delete[] shapes;
 }
 
 void Octree::clearShapes()
 {
-    for (int i = 0; (i < OCTREE_NODE_CAPACITY); i++)
+    for (unsigned int i = 0; (i < shapeCapacity); i++)
         shapes[i] = NULL;
     numShapes = 0;
 }
 
+void Octree::reserveShapes(unsigned int capacity)
+{
+    if (capacity <= shapeCapacity)
+        return;
+    // Leaves at the deepest level keep growing, so double their room
+    capacity = std::max(capacity, std::max(nodeCapacity, shapeCapacity * 2));
+    Shape** newShapes = NULL;
+    if (arena)
+    {
+        newShapes = static_cast<Shape**>(arena->allocate(capacity * sizeof(Shape*),
+            sizeof(Shape*)));
+        if (!newShapes)
+            throw std::bad_alloc();
+    }
+    else
+    {
+        newShapes = new Shape*[capacity];
+    }
+    std::fill(newShapes, newShapes + capacity, static_cast<Shape*>(NULL));
+    std::copy(shapes, shapes + numShapes, newShapes);
+    // Room in an arena is freed along with it
+    if (!arena)
+        delete[] shapes;
+    shapes = newShapes;
+    shapeCapacity = capacity;
+}
+
 void Octree::clearChildren()
 {
-    for (int i = 0; (i < MAX_CHILDREN); i++)
-        delete children[i];
+    // Children in an arena are freed along with it
+    if (!arena)
+        for (int i = 0; (i < MAX_CHILDREN); i++)
+            delete children[i];
     for (int i = 0; (i < MAX_CHILDREN); i++)
         children[i] = NULL;
 }
@@ -39,9 +77,13 @@ bool Octree::insert(Shape* shape)
     {
         return false;
     }
-    // If there is more space to put shapes in this node, add the shape
-    else if (numShapes < OCTREE_NODE_CAPACITY)
+    // If this node has not been split and there is more space to put shapes
+    // in it, or it cannot be split any further, add the shape. Once split,
+    // shapes only go to the children.
+    else if (numChildren == 0 &&
+        (numShapes < nodeCapacity || (maxDepth > 0 && depth >= maxDepth)))
     {
+        reserveShapes(numShapes + 1);
         shapes[numShapes] = shape;
         numShapes++;
         return true;
@@ -61,6 +103,40 @@ bool Octree::insert(Shape* shape)
     }
 }
 
+void Octree::fitBounds(const ShapeList& shapeList, const std::vector<AABB>& shapeBounds)
+{
+    std::map<const Shape*, unsigned int> shapeIndices;
+    for (unsigned int i = 0; (i < shapeList.size()); i++)
+        shapeIndices[shapeList[i]] = i;
+    fitBounds(shapeIndices, shapeBounds);
+}
+
+bool Octree::fitBounds(const std::map<const Shape*, unsigned int>& shapeIndices,
+    const std::vector<AABB>& shapeBounds)
+{
+    // Start from an empty box, which no ray intersects
+    hitBounds = AABB(Vector3(FLT_MAX, FLT_MAX, FLT_MAX), Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+    bool holdsShapes = false;
+    for (unsigned int i = 0; (i < numChildren); i++)
+    {
+        if (children[i]->fitBounds(shapeIndices, shapeBounds))
+        {
+            hitBounds.expand(children[i]->hitBounds);
+            holdsShapes = true;
+        }
+    }
+    for (unsigned int i = 0; (i < numShapes); i++)
+    {
+        std::map<const Shape*, unsigned int>::const_iterator it = shapeIndices.find(shapes[i]);
+        if (it != shapeIndices.end())
+        {
+            hitBounds.expand(shapeBounds[it->second]);
+            holdsShapes = true;
+        }
+    }
+    return holdsShapes;
+}
+
 void Octree::subdivide()
 {
     // Construct AABBs for each of the children (all same size)
@@ -78,7 +154,12 @@ void Octree::subdivide()
     };
     // Create the eight children
     for (unsigned int i = 0; (i < MAX_CHILDREN); i++)
-        children[i] = new Octree(childrenBoundaries[i]);
+    {
+        children[i] = (arena) ?
+            new (*arena) Octree(childrenBoundaries[i], arena, nodeCapacity, maxDepth) :
+            new Octree(childrenBoundaries[i], NULL, nodeCapacity, maxDepth);
+        children[i]->depth = depth + 1;
+    }
     numChildren = MAX_CHILDREN;
     // For all the shapes currently in this node, move them to one of the children
     unsigned int shapesMoved = 0;
@@ -111,6 +192,114 @@ LineList Octree::getBoundingLines()
     return lines;
 }
 
+unsigned int Octree::numNodes() const
+{
+    unsigned int count = 1;
+    for (unsigned int i = 0; (i < numChildren); i++)
+        count += children[i]->numNodes();
+    return count;
+}
+
+void Octree::addStatistics(AcceleratorStatistics& statistics) const
+{
+    // Nodes which hold no shapes are counted by their region, as their
+    // box is empty
+    bool empty = (hitBounds.bounds[0].x > hitBounds.bounds[1].x);
+    statistics.addNode(empty ? boundary : hitBounds, depth, (numChildren == 0), numShapes);
+    for (unsigned int i = 0; (i < numChildren); i++)
+        children[i]->addStatistics(statistics);
+}
+
+bool Octree::flatten(const ShapeList& shapeList, std::vector<FlatOctreeNode>& nodes) const
+{
+    std::map<const Shape*, unsigned int> shapeIndices;
+    for (unsigned int i = 0; (i < shapeList.size()); i++)
+        shapeIndices[shapeList[i]] = i;
+
+    // Nodes are added breadth first, so each node's children end up next
+    // to each other. 'queue[i]' is the octree node written to nodes[first + i].
+    unsigned int first = nodes.size();
+    std::vector<const Octree*> queue(1, this);
+    for (unsigned int i = 0; (i < queue.size()); i++)
+    {
+        const Octree* node = queue[i];
+        FlatOctreeNode flatNode;
+        flatNode.boundary = node->boundary;
+        flatNode.hitBounds = node->hitBounds;
+        flatNode.firstChild = -1;
+        if (node->numChildren > 0)
+        {
+            flatNode.firstChild = first + queue.size();
+            for (unsigned int c = 0; (c < node->numChildren); c++)
+                queue.push_back(node->children[c]);
+        }
+        if (node->numShapes > FlatOctreeNode::MAX_SHAPES)
+        {
+            nodes.resize(first);
+            return false;
+        }
+        flatNode.numShapes = node->numShapes;
+        for (unsigned int s = 0; (s < FlatOctreeNode::MAX_SHAPES); s++)
+            flatNode.shapes[s] = (s < node->numShapes) ? shapeIndices[node->shapes[s]] : 0;
+        nodes.push_back(flatNode);
+    }
+    return true;
+}
+
+Octree* Octree::fromFlattened(const FlatOctreeNode* nodes, unsigned int numNodes,
+    const ShapeList& shapeList, Arena* arena)
+{
+    if (numNodes == 0)
+        return NULL;
+    // Check nodes form a tree, with the children of each node stored in
+    // the order flatten() writes them
+    unsigned int nextChild = 1;
+    for (unsigned int i = 0; (i < numNodes); i++)
+    {
+        const FlatOctreeNode& node = nodes[i];
+        if (node.numShapes > FlatOctreeNode::MAX_SHAPES)
+            return NULL;
+        for (unsigned int s = 0; (s < node.numShapes); s++)
+            if (node.shapes[s] >= shapeList.size())
+                return NULL;
+        if (node.firstChild >= 0)
+        {
+            if (static_cast<unsigned int>(node.firstChild) != nextChild ||
+                nextChild + MAX_CHILDREN > numNodes)
+                return NULL;
+            nextChild += MAX_CHILDREN;
+        }
+    }
+    if (nextChild != numNodes)
+        return NULL;
+
+    std::vector<Octree*> octrees(numNodes);
+    for (unsigned int i = 0; (i < numNodes); i++)
+        octrees[i] = (arena) ? new (*arena) Octree(nodes[i].boundary, arena) :
+            new Octree(nodes[i].boundary);
+    for (unsigned int i = 0; (i < numNodes); i++)
+    {
+        Octree* octree = octrees[i];
+        octree->hitBounds = nodes[i].hitBounds;
+        if (nodes[i].firstChild >= 0)
+        {
+            // Parents come before their children, so have their depth already
+            for (unsigned int c = 0; (c < MAX_CHILDREN); c++)
+            {
+                octree->children[c] = octrees[nodes[i].firstChild + c];
+                octree->children[c]->depth = octree->depth + 1;
+            }
+            octree->numChildren = MAX_CHILDREN;
+        }
+        if (nodes[i].numShapes > 0)
+            octree->reserveShapes(nodes[i].numShapes);
+        for (unsigned int s = 0; (s < nodes[i].numShapes); s++)
+            octree->shapes[s] = shapeList[nodes[i].shapes[s]];
+        octree->numShapes = nodes[i].numShapes;
+    }
+    return octrees[0];
+}
+
 const Vector3& Octree::getCentre() const
 {
     return centre;
@@ -118,8 +307,9 @@ const Vector3& Octree::getCentre() const
 
 bool Octree::hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const
 {
-    // First check if ray intersects with the bounding box of this node
-    if (!boundary.intersects(ray, tMin, tMax))
+    raycost::countNodeVisit();
+    // First check if ray intersects with the box around this node's shapes
+    if (!hitBounds.intersects(ray, tMin, tMax))
         return false;
 
     bool isAHit = false;
@@ -134,15 +324,12 @@ bool Octree::hit(const Ray& ray, float tMin, float tMax, float time, HitRecord&
             isAHit = true;
         }
     }
-    if (!isAHit)
+    for (unsigned int i = 0; (i < numShapes); i++)
     {
-        for (int i = 0; (i < numShapes); i++)
+        if (shapes[i]->hit(ray, tMin, tMax, 0.0f, record))
         {
-            if (shapes[i]->hit(ray, tMin, tMax, 0.0f, record))
-            {
-                tMax = record.t;
-                isAHit = true;
-            }
+            tMax = record.t;
+            isAHit = true;
         }
     }
     return isAHit;
@@ -150,11 +337,15 @@ bool Octree::hit(const Ray& ray, float tMin, float tMax, float time, HitRecord&
 
 bool Octree::shadowHit(const Ray& ray, float tMin, float tMax, float time, const Shape*& occludingShape) const
 {
-    if (!boundary.intersects(ray, tMin, tMax))
+    raycost::countNodeVisit();
+    if (!hitBounds.intersects(ray, tMin, tMax))
         return false;
     for (int i = 0; (i < numChildren); i++)
         if (children[i]->shadowHit(ray, tMin, tMax, 0.0f, occludingShape))
             return true;
+    for (unsigned int i = 0; (i < numShapes); i++)
+        if (shapes[i]->shadowHit(ray, tMin, tMax, 0.0f, occludingShape))
+            return true;
     return false;
 }
 
@@ -0,0 +1,138 @@
+#include "Profiling.h"
+#include "Threading.h"
+#include <pthread.h>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+using namespace raytracer;
+
+static const char* STAGE_NAMES[] = { "ray generation", "traversal", "primitive tests",
+    "texture lookups", "local illumination", "secondary rays" };
+
+__thread profiling::StageCounters* profiling::threadCounters = NULL;
+__thread profiling::ScopedTimer* profiling::ScopedTimer::currentTimer = NULL;
+
+/* Counters of threads which are running, and of those which have exited,
+ * whose blocks are reused by new threads. */
+static threading::Mutex countersMutex;
+static std::vector<profiling::StageCounters*> runningCounters;
+static std::vector<profiling::StageCounters*> freeCounters;
+static profiling::StageCounters exitedCounters;
+static pthread_key_t countersKey;
+static pthread_once_t countersKeyOnce = PTHREAD_ONCE_INIT;
+
+/* Called when a thread which has counters exits. */
+static void releaseThreadCounters(void* data)
+{
+    profiling::StageCounters* counters = static_cast<profiling::StageCounters*>(data);
+    threading::ScopedLock lock(countersMutex);
+    for (unsigned int i = 0; (i < profiling::NUM_STAGES); i++)
+    {
+        exitedCounters.cycles[i] += counters->cycles[i];
+        exitedCounters.calls[i] += counters->calls[i];
+    }
+    runningCounters.erase(std::find(runningCounters.begin(), runningCounters.end(), counters));
+    freeCounters.push_back(counters);
+}
+
+static void createCountersKey()
+{
+    pthread_key_create(&countersKey, releaseThreadCounters);
+}
+
+/* Add counters read while their thread may be writing to them. */
+static void addCounters(profiling::StageCounters& sum, const profiling::StageCounters& counters)
+{
+    for (unsigned int i = 0; (i < profiling::NUM_STAGES); i++)
+    {
+        sum.cycles[i] += __atomic_load_n(&counters.cycles[i], __ATOMIC_RELAXED);
+        sum.calls[i] += __atomic_load_n(&counters.calls[i], __ATOMIC_RELAXED);
+    }
+}
+
+const char* profiling::stageName(Stage stage)
+{
+    return STAGE_NAMES[stage];
+}
+
+profiling::StageCounters::StageCounters()
+{
+    std::fill(cycles, cycles + NUM_STAGES, 0);
+    std::fill(calls, calls + NUM_STAGES, 0);
+}
+
+uint64_t profiling::StageCounters::totalCycles() const
+{
+    uint64_t total = 0;
+    for (unsigned int i = 0; (i < NUM_STAGES); i++)
+        total += cycles[i];
+    return total;
+}
+
+profiling::StageCounters* profiling::createThreadCounters()
+{
+    pthread_once(&countersKeyOnce, createCountersKey);
+    threading::ScopedLock lock(countersMutex);
+    StageCounters* counters = NULL;
+    if (freeCounters.empty())
+    {
+        counters = new StageCounters();
+    }
+    else
+    {
+        counters = freeCounters.back();
+        freeCounters.pop_back();
+        *counters = StageCounters();
+    }
+    runningCounters.push_back(counters);
+    pthread_setspecific(countersKey, counters);
+    threadCounters = counters;
+    return counters;
+}
+
+profiling::StageCounters profiling::totals()
+{
+    threading::ScopedLock lock(countersMutex);
+    StageCounters sum = exitedCounters;
+    for (unsigned int i = 0; (i < runningCounters.size()); i++)
+        addCounters(sum, *runningCounters[i]);
+    return sum;
+}
+
+void profiling::reset()
+{
+    threading::ScopedLock lock(countersMutex);
+    exitedCounters = StageCounters();
+    for (unsigned int i = 0; (i < runningCounters.size()); i++)
+        *runningCounters[i] = StageCounters();
+}
+
+std::string profiling::formatBreakdown(const StageCounters& counters)
+{
+    double secondsPerCycle = 1.0 / common::cyclesPerSecond();
+    uint64_t total = std::max<uint64_t>(counters.totalCycles(), 1);
+    std::stringstream ss;
+    ss << std::fixed;
+    for (unsigned int i = 0; (i < NUM_STAGES); i++)
+    {
+        ss << "    " << std::left << std::setw(20) << STAGE_NAMES[i] << std::right
+            << std::setprecision(3) << std::setw(10) << (counters.cycles[i] * secondsPerCycle)
+            << " s " << std::setprecision(1) << std::setw(6)
+            << (100.0 * counters.cycles[i] / total) << "% " << std::setw(14)
+            << counters.calls[i] << " calls\n";
+    }
+    return ss.str();
+}
+
+std::string profiling::formatSummary(const StageCounters& counters)
+{
+    uint64_t total = std::max<uint64_t>(counters.totalCycles(), 1);
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(0);
+    for (unsigned int i = 0; (i < NUM_STAGES); i++)
+        ss << ((i > 0) ? ", " : "") << STAGE_NAMES[i] << " "
+            << (100.0 * counters.cycles[i] / total) << "%";
+    return ss.str();
+}
@@ -0,0 +1,134 @@
+#include "RayLog.h"
+#include <fstream>
+
+using namespace raytracer;
+
+/* Identifies ray log files written by RayLog. */
+static const unsigned int RAY_LOG_MAGIC = 0x4c525744; // "DWRL"
+static const unsigned int RAY_LOG_VERSION = 1;
+
+static const char* const RAY_QUERY_TYPE_NAMES[NUM_RAY_QUERY_TYPES] = {
+    "primary", "reflected", "refracted", "shadow"
+};
+
+struct RayLogHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    // Length of the render settings, stored as text after the header
+    unsigned int settingsLength;
+    unsigned int padding;
+    uint64_t numQueries;
+};
+
+const char* raytracer::rayQueryTypeName(RayQueryType type)
+{
+    return (type < NUM_RAY_QUERY_TYPES) ? RAY_QUERY_TYPE_NAMES[type] : "unknown";
+}
+
+Ray RayQuery::ray() const
+{
+    return Ray(Vector3(origin[0], origin[1], origin[2]),
+        Vector3(direction[0], direction[1], direction[2]));
+}
+
+RayLog::RayLog()
+{
+}
+
+void RayLog::reset(const RenderSettings& newSettings)
+{
+    settings = newSettings;
+    queries.clear();
+}
+
+void RayLog::record(RayQueryType type, const Ray& ray, float tMin, float tMax,
+    bool hit, float t)
+{
+    RayQuery query;
+    const Vector3& origin = ray.origin();
+    const Vector3& direction = ray.direction();
+    query.origin[0] = origin.x;
+    query.origin[1] = origin.y;
+    query.origin[2] = origin.z;
+    query.direction[0] = direction.x;
+    query.direction[1] = direction.y;
+    query.direction[2] = direction.z;
+    query.tMin = tMin;
+    query.tMax = tMax;
+    query.t = (hit && type != SHADOW_QUERY) ? t : 0.0f;
+    query.type = type;
+    query.hit = hit;
+    query.padding[0] = query.padding[1] = 0;
+    queries.push_back(query);
+}
+
+const RenderSettings& RayLog::getSettings() const
+{
+    return settings;
+}
+
+const std::vector<RayQuery>& RayLog::getQueries() const
+{
+    return queries;
+}
+
+uint64_t RayLog::count(RayQueryType type) const
+{
+    uint64_t total = 0;
+    for (unsigned int i = 0; (i < queries.size()); i++)
+        if (queries[i].type == type)
+            total++;
+    return total;
+}
+
+bool RayLog::save(const std::string& filename) const
+{
+    std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    std::string settingsText = formatRenderSettings(settings);
+    RayLogHeader header = { RAY_LOG_MAGIC, RAY_LOG_VERSION,
+        static_cast<unsigned int>(settingsText.size()), 0, queries.size() };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(settingsText.c_str(), settingsText.size());
+    if (!queries.empty())
+        file.write(reinterpret_cast<const char*>(&queries[0]),
+            queries.size() * sizeof(RayQuery));
+    file.close();
+    return !file.fail();
+}
+
+bool RayLog::load(const std::string& filename)
+{
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    RayLogHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != RAY_LOG_MAGIC || header.version != RAY_LOG_VERSION ||
+        header.settingsLength > 4096)
+        return false;
+    std::string settingsText(header.settingsLength, ' ');
+    RenderSettings loadedSettings;
+    if (!file.read(&settingsText[0], header.settingsLength) ||
+        !parseRenderSettings(settingsText, loadedSettings))
+        return false;
+    // Check the file is long enough before allocating space for the queries
+    std::streampos start = file.tellg();
+    file.seekg(0, std::ios::end);
+    if (static_cast<uint64_t>(file.tellg() - start) != header.numQueries * sizeof(RayQuery))
+        return false;
+    file.seekg(start);
+    std::vector<RayQuery> loadedQueries(header.numQueries);
+    if (!loadedQueries.empty() && !file.read(reinterpret_cast<char*>(&loadedQueries[0]),
+        loadedQueries.size() * sizeof(RayQuery)))
+        return false;
+    for (unsigned int i = 0; (i < loadedQueries.size()); i++)
+        if (loadedQueries[i].type >= NUM_RAY_QUERY_TYPES)
+            return false;
+
+    settings = loadedSettings;
+    queries.swap(loadedQueries);
+    return true;
+}
@@ -1,6 +1,7 @@
 #include "Raytracer.h"
 #include "TerrainHeightTexture.h"
 #include "Common.h"
+#include "Profiling.h"
 #include <cmath>
 #include <cfloat>
 #include <algorithm>
@@ -8,16 +9,32 @@
 using namespace raytracer;
 
 Raytracer::Raytracer(const Camera& camera) :
-    rootShape(NULL), rootTestShape(NULL), testShapesEnabled(false), camera(camera),
-	localIllumEnabled(true), reflectRefractEnabled(true), shadowsEnabled(true)
+    rootShape(NULL), rootTestShape(NULL), testShapesEnabled(false), ownsShapes(true),
+    camera(camera), localIllumEnabled(true), reflectRefractEnabled(true), shadowsEnabled(true),
+    rayObserver(NULL), rayLog(NULL)
+{
+    resetRayCount();
+}
+
+Raytracer::Raytracer(const Raytracer& other) :
+    rootShape(other.rootShape), lights(other.lights), camera(other.camera),
+    rootTestShape(other.rootTestShape), testShapesEnabled(other.testShapesEnabled),
+    ownsShapes(false), defaultMaterial(other.defaultMaterial),
+    localIllumEnabled(other.localIllumEnabled),
+    reflectRefractEnabled(other.reflectRefractEnabled),
+    shadowsEnabled(other.shadowsEnabled), rayObserver(NULL),
+    rayLog(NULL)
 {
     resetRayCount();
 }
 
 Raytracer::~Raytracer()
 {
-    delete rootShape;
-    delete rootTestShape;
+    if (ownsShapes)
+    {
+        delete rootShape;
+        delete rootTestShape;
+    }
 }
 
 bool Raytracer::raytrace(float x, float y, Colour& result)
@@ -26,7 +43,7 @@ bool Raytracer::raytrace(float x, float y, Colour& result)
     Ray ray = camera.getRayToPixel(x, y);
     // Perform a recursive raytrace
     HitRecord record;
-    bool isAHit = recursiveTrace(ray, record, 0);
+    bool isAHit = recursiveTrace(ray, PRIMARY_QUERY, record, 0);
     // If the ray hit an object, store resultant colour in OUT parameter
     if (isAHit)
         result = record.colour;
@@ -54,7 +71,7 @@ bool Raytracer::uniformMultisample(float minX, float minY, float maxX,
 			float sampleY = minY + (y * stepY);
 		    Ray sampleRay = camera.getRayToPixel(sampleX, sampleY);
 		    HitRecord record;
-		    bool isHit = recursiveTrace(sampleRay, record, 0);
+		    bool isHit = recursiveTrace(sampleRay, PRIMARY_QUERY, record, 0);
 		    if (isHit)
 		    {
 		        sum += record.colour;
@@ -82,7 +99,7 @@ bool Raytracer::randomMultisample(float minX, float minY, float maxX, float maxY
     	float sampleY = common::randomFloat(minY, maxY);
         Ray sampleRay = camera.getRayToPixel(sampleX, sampleY);
         HitRecord record;
-        bool isHit = recursiveTrace(sampleRay, record, 0);
+        bool isHit = recursiveTrace(sampleRay, PRIMARY_QUERY, record, 0);
         if (isHit)
         {
             sum += record.colour;
@@ -97,6 +114,75 @@ bool Raytracer::randomMultisample(float minX, float minY, float maxX, float maxY
     return (hits > 0);
 }
 
+bool Raytracer::renderPixel(int i, int j, int imageWidth, int imageHeight,
+    SamplingMethod samplingMethod, unsigned int numSamples, Colour& result)
+{
+    // Define RANGE of viewing plane the pixel covers
+    float minX = static_cast<float>(i) / imageWidth;
+    float minY = static_cast<float>(j) / imageHeight;
+    float maxX = static_cast<float>(i + 1) / imageWidth;
+    float maxY = static_cast<float>(j + 1) / imageHeight;
+    switch (samplingMethod)
+    {
+    case UNIFORM_MULTISAMPLING:
+        return uniformMultisample(minX, minY, maxX, maxY, numSamples, result);
+    case RANDOM_MULTISAMPLING:
+        return randomMultisample(minX, minY, maxX, maxY, numSamples, result);
+    default:
+        // Convert pixel coordinates (i, j) to viewing plane coordinates (x, y)
+        // Note that this gets the pixel CENTRE due to 0.5f
+        float x = (static_cast<float>(i) + 0.5f) / imageWidth;
+        float y = (static_cast<float>(j) + 0.5f) / imageHeight;
+        return raytrace(x, y, result);
+    }
+}
+
+bool Raytracer::renderPixelSample(int i, int j, int imageWidth, int imageHeight,
+    SamplingMethod samplingMethod, unsigned int numSamples,
+    unsigned int sampleIndex, Colour& result)
+{
+    SurfaceHit hit;
+    if (!tracePixelSample(i, j, imageWidth, imageHeight, samplingMethod, numSamples,
+        sampleIndex, hit))
+        return false;
+    result = shadeSurface(hit);
+    return true;
+}
+
+bool Raytracer::tracePixelSample(int i, int j, int imageWidth, int imageHeight,
+    SamplingMethod samplingMethod, unsigned int numSamples,
+    unsigned int sampleIndex, SurfaceHit& hit)
+{
+    float minX = static_cast<float>(i) / imageWidth;
+    float minY = static_cast<float>(j) / imageHeight;
+    float maxX = static_cast<float>(i + 1) / imageWidth;
+    float maxY = static_cast<float>(j + 1) / imageHeight;
+    float x = 0, y = 0;
+    if (samplingMethod == UNIFORM_MULTISAMPLING && sampleIndex < numSamples * numSamples)
+    {
+        // Same grid position, in the same order, as uniformMultisample()
+        x = minX + (sampleIndex / numSamples) * ((maxX - minX) / numSamples);
+        y = minY + (sampleIndex % numSamples) * ((maxY - minY) / numSamples);
+    }
+    else if (samplingMethod == SINGLESAMPLING && sampleIndex == 0)
+    {
+        x = (static_cast<float>(i) + 0.5f) / imageWidth;
+        y = (static_cast<float>(j) + 0.5f) / imageHeight;
+    }
+    else
+    {
+        x = common::randomFloat(minX, maxX);
+        y = common::randomFloat(minY, maxY);
+    }
+    numPrimaryRays++;
+    return findSurface(camera.getRayToPixel(x, y), PRIMARY_QUERY, hit);
+}
+
+Colour Raytracer::shadeSurface(const SurfaceHit& hit)
+{
+    return shadeSurface(hit, 0);
+}
+
 void Raytracer::setRootShape(Shape* newRoot, bool deletePrevious)
 {
     if (deletePrevious)
@@ -146,27 +232,49 @@ void Raytracer::showTestShapes(bool show)
  * http://www.cs.jhu.edu/~cohen/RendTech99/Lectures/Ray_Tracing.bw.pdf
  * https://github.com/jelmervdl/raytracer/blob/master/scene.cpp
 */
-bool Raytracer::recursiveTrace(const Ray& ray, HitRecord& record, int depth)
+bool Raytracer::recursiveTrace(const Ray& ray, RayQueryType type, HitRecord& record,
+    int depth)
 {
     // Ensure recursive raytracer does not exceed maximum depth
     if (depth > MAX_TRACE_DEPTH) return false;
+
+    SurfaceHit hit;
+    if (!findSurface(ray, type, hit))
+        return false;
+    record = hit.record;
+    record.colour = shadeSurface(hit, depth);
+    return true;
+}
+
+bool Raytracer::findSurface(const Ray& ray, RayQueryType type, SurfaceHit& hit)
+{
+    hit.objectHit = false;
+    hit.testShapeHit = false;
     if (!rootShape) return false;
+    hit.rayDirection = ray.direction();
 
     // If test shapes are enabled, be sure to test intersection with those as well
     float maxDistance = MAX_RAY_DISTANCE;
-    bool testHit = false;
-    if (testShapesEnabled)
+    HitRecord& record = hit.record;
     {
-        testHit = rootTestShape->hit(ray, 0.0001f, maxDistance, 0.0f, record);
-        if (testHit)
+        PROFILE_STAGE(TRAVERSAL);
+        if (testShapesEnabled)
         {
-            record.colour = TEST_SHAPE_COLOUR;
-            maxDistance = record.t;
+            hit.testShapeHit = rootTestShape->hit(ray, 0.0001f, maxDistance, 0.0f, record);
+            if (hit.testShapeHit)
+                maxDistance = record.t;
         }
+
+        hit.objectHit = rootShape->hit(ray, 0.00001f, maxDistance, 0.0f, record);
+    }
+    if (rayLog)
+        rayLog->record(type, ray, 0.00001f, maxDistance, hit.objectHit, record.t);
+    if (rayObserver)
+    {
+        float distance = (hit.objectHit || hit.testShapeHit) ? record.t : MAX_RAY_DISTANCE;
+        rayObserver->raySegment(ray.origin(), ray.origin() + (ray.direction() * distance), false);
     }
-   
-    bool objectHit = rootShape->hit(ray, 0.00001f, maxDistance, 0.0f, record);   
-    if (objectHit)
+    if (hit.objectHit)
     {
 		// Get hit object's material and derive source object colour from it
 		const Material* material = record.hitShape->getMaterial();
@@ -174,6 +282,7 @@ bool Raytracer::recursiveTrace(const Ray& ray, HitRecord& record, int depth)
 		if (material)
 		    if (material->getTexture())
 		    {
+		    	PROFILE_STAGE(TEXTURE_LOOKUPS);
 		    	Texture* texture = material->getTexture();
 		    	// If the texture is a multitexture, use HEIGHT (Y)of point of intersection
 		    	// to determine the weightings of each image.
@@ -181,14 +290,18 @@ bool Raytracer::recursiveTrace(const Ray& ray, HitRecord& record, int depth)
 		    	if (terrainTexture)
 		    	{
 			    	// height (y) is normalised by the maximum height of terrain
-			    	// before using it to update terrain texture weights
+			    	// before using it to compute terrain texture weights
 			    	// NOTE: 0.75 coefficient used on max height to produce
 			    	// weights which give better looking terrain
 			    	float normalisedHeight = (record.pointOfIntersection.y / (common::TERRAIN_MAX_HEIGHT * 0.75));
-		    		terrainTexture->updateWeights(normalisedHeight);
+			    	objectColour = terrainTexture->getTexelAtHeight(
+			    		record.texCoord.x, record.texCoord.y, normalisedHeight);
 		    	}
-		    	// Now get the texture's textel at the given texture coordinates
-			    objectColour = texture->getTexel(record.texCoord.x, record.texCoord.y);
+		    	else
+		    	{
+		    		// Get the texture's textel at the given texture coordinates
+			    	objectColour = texture->getTexel(record.texCoord.x, record.texCoord.y);
+			    }
 		    }
 		    else
 		    {
@@ -198,24 +311,33 @@ bool Raytracer::recursiveTrace(const Ray& ray, HitRecord& record, int depth)
 		{
 		    material = &defaultMaterial;
 		}
-        // Compute contributions of different physical phenoma to final colour
-        Colour localColour, reflectedRefractedColour;
-        if (localIllumEnabled)
-	        localColour = localIllumination(material, objectColour, record);
-	    else // if not enbled, just use object's colour directly
-	    	localColour = objectColour;
-	    if (reflectRefractEnabled)
-        	reflectedRefractedColour = reflectionAndRefraction(ray.direction(), record, depth);
-        // Combine computed colours into one
-        record.colour = (LOCAL_ILLUMINATION_WEIGHT * localColour)
-            + (REFLECTED_REFRACTED_WEIGHT * reflectedRefractedColour);
+		hit.material = material;
+		hit.objectColour = objectColour;
     }
 
-    return (testHit || objectHit);
+    return (hit.testShapeHit || hit.objectHit);
+}
+
+Colour Raytracer::shadeSurface(const SurfaceHit& hit, int depth)
+{
+    if (!hit.objectHit)
+        return TEST_SHAPE_COLOUR;
+    // Compute contributions of different physical phenoma to final colour
+    Colour localColour, reflectedRefractedColour;
+    if (localIllumEnabled)
+        localColour = localIllumination(hit.material, hit.objectColour, hit.record);
+    else // if not enbled, just use object's colour directly
+    	localColour = hit.objectColour;
+    if (reflectRefractEnabled)
+    	reflectedRefractedColour = reflectionAndRefraction(hit.rayDirection, hit.record, depth);
+    // Combine computed colours into one
+    return (LOCAL_ILLUMINATION_WEIGHT * localColour)
+        + (REFLECTED_REFRACTED_WEIGHT * reflectedRefractedColour);
 }
 
 Colour Raytracer::localIllumination(const Material* material, const Colour& objectColour, const HitRecord& record)
 {
+    PROFILE_STAGE(LOCAL_ILLUMINATION);
     Colour localColour;
     // Add illumination to object for each light source in the scene
     for (int i = 0; (i < lights.size()); i++)
@@ -237,10 +359,19 @@ Colour Raytracer::localIllumination(const Material* material, const Colour& obje
 
 		    // Store shape which the ray hit!
 		    const Shape* occludingShape = NULL;
-		    bool shadowHit = rootShape->shadowHit(lightRay, 0.00001f,
-		        distanceFromLightToPoint - SHADOW_RAY_DISTANCE_THRESHOLD,
-		        0.0f, occludingShape);
+		    bool shadowHit = false;
+		    {
+		        PROFILE_STAGE(TRAVERSAL);
+		        shadowHit = rootShape->shadowHit(lightRay, 0.00001f,
+		            distanceFromLightToPoint - SHADOW_RAY_DISTANCE_THRESHOLD,
+		            0.0f, occludingShape);
+		    }
 		    numShadowRays++;
+		    if (rayLog)
+		        rayLog->record(SHADOW_QUERY, lightRay, 0.00001f,
+		            distanceFromLightToPoint - SHADOW_RAY_DISTANCE_THRESHOLD, shadowHit, 0.0f);
+		    if (rayObserver)
+		        rayObserver->raySegment(lightPos, record.pointOfIntersection, true);
 		    // If another object has blocked light reaching current object, don't add light contribution!
 		    if (shadowHit)
 		        if (record.hitShape != occludingShape)
@@ -267,6 +398,8 @@ Colour Raytracer::localIllumination(const Material* material, const Colour& obje
 
 Colour Raytracer::reflectionAndRefraction(const Vector3& rayDirection, const HitRecord& record, int depth)
 {
+    // Rays traced recursively are timed by their own stages
+    PROFILE_STAGE(SECONDARY_RAYS);
     // Retrieve material properties
     const Material* material = record.hitShape->getMaterial();
     float reflectivity = material->reflectivity();
@@ -307,7 +440,7 @@ Colour Raytracer::reflectionAndRefraction(const Vector3& rayDirection, const Hit
         Ray reflectedRay(record.pointOfIntersection, record.normal);
         // Cast reflected ray and store resultant colour
         HitRecord reflectRecord;
-        if (recursiveTrace(reflectedRay, reflectRecord, depth + 1))
+        if (recursiveTrace(reflectedRay, REFLECTED_QUERY, reflectRecord, depth + 1))
             reflectedColour = reflectRecord.colour;
         numReflectedRays++;
     }
@@ -324,7 +457,7 @@ Colour Raytracer::reflectionAndRefraction(const Vector3& rayDirection, const Hit
         {
             // Cast refracted ray and store resultant colour
             HitRecord refractionRecord;
-            if (recursiveTrace(refractedRay, refractionRecord, depth + 1))
+            if (recursiveTrace(refractedRay, REFRACTED_QUERY, refractionRecord, depth + 1))
                 refractedColour = refractionRecord.colour;
         }
         numRefractedRays++;
@@ -400,27 +533,27 @@ void Raytracer::enableShadows(bool enabled)
 	shadowsEnabled = enabled;
 }
 
-unsigned int Raytracer::primaryRays() const
+uint64_t Raytracer::primaryRays() const
 {
     return numPrimaryRays;
 }
 
-unsigned int Raytracer::reflectedRays() const
+uint64_t Raytracer::reflectedRays() const
 {
     return numReflectedRays;
 }
 
-unsigned int Raytracer::refractedRays() const
+uint64_t Raytracer::refractedRays() const
 {
     return numRefractedRays;
 }
 
-unsigned int Raytracer::shadowRays() const
+uint64_t Raytracer::shadowRays() const
 {
     return numShadowRays;
 }
 
-unsigned int Raytracer::totalRays() const
+uint64_t Raytracer::totalRays() const
 {
     return numPrimaryRays + numReflectedRays + numRefractedRays + numShadowRays;
 }
@@ -432,3 +565,13 @@ void Raytracer::resetRayCount()
     numRefractedRays = 0;
     numShadowRays = 0;
 }
+
+void Raytracer::setRayObserver(RayObserver* observer)
+{
+    rayObserver = observer;
+}
+
+void Raytracer::setRayLog(RayLog* log)
+{
+    rayLog = log;
+}
@@ -0,0 +1,171 @@
+#include "RenderCache.h"
+#include "TileRenderer.h"
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+
+using namespace raytracer;
+
+/* Identifies files written by RenderCache. */
+static const unsigned int CACHE_MAGIC = 0x43525744; // "DWRC"
+static const unsigned int CACHE_VERSION = 2;
+
+struct CacheHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    int width;
+    int height;
+    int tileSize;
+    unsigned int numTiles;
+    // Time and rays taken to render every tile stored
+    double seconds;
+    uint64_t primaryRays;
+    uint64_t reflectedRays;
+    uint64_t refractedRays;
+    uint64_t shadowRays;
+};
+
+/* Header, then one byte per tile which is non-zero if the tile is stored,
+ * then every pixel of the image as (r, g, b) floats, row by row. Pixels of
+ * tiles which are not stored are zero. */
+struct RenderCache::Entry
+{
+    CacheHeader header;
+    std::vector<unsigned char> tilesStored;
+    std::vector<float> pixels;
+};
+
+RenderCache::RenderCache(const std::string& directory) : directory(directory)
+{
+    // Renders still work if the directory cannot be made, but are not kept
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+        std::cerr << "Could not create render cache directory " << directory << ": "
+            << strerror(errno) << std::endl;
+}
+
+std::string RenderCache::filenameForKey(const std::string& key) const
+{
+    return directory + "/" + key + ".dwrc";
+}
+
+bool RenderCache::readEntry(const std::string& filename, const RenderSettings& settings,
+    Entry& entry) const
+{
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    CacheHeader& header = entry.header;
+    unsigned int numTiles = static_cast<unsigned int>(splitIntoTiles(
+        Tile(0, 0, settings.width, settings.height), TILE_SIZE).size());
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != CACHE_MAGIC || header.version != CACHE_VERSION ||
+        header.width != settings.width || header.height != settings.height ||
+        header.tileSize != TILE_SIZE || header.numTiles != numTiles)
+        return false;
+    entry.tilesStored.resize(numTiles);
+    entry.pixels.resize(static_cast<size_t>(settings.width) * settings.height * 3);
+    return file.read(reinterpret_cast<char*>(&entry.tilesStored[0]), numTiles) &&
+        file.read(reinterpret_cast<char*>(&entry.pixels[0]), entry.pixels.size() * sizeof(float));
+}
+
+bool RenderCache::writeEntry(const std::string& filename, const Entry& entry) const
+{
+    // Write to temporary file first, so readers never see half an entry
+    std::string temporaryFilename = filename + ".tmp";
+    std::ofstream file(temporaryFilename.c_str(), std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    file.write(reinterpret_cast<const char*>(&entry.header), sizeof(entry.header));
+    file.write(reinterpret_cast<const char*>(&entry.tilesStored[0]), entry.tilesStored.size());
+    file.write(reinterpret_cast<const char*>(&entry.pixels[0]),
+        entry.pixels.size() * sizeof(float));
+    file.close();
+    // Don't leave a partly written file behind (e.g. when the disk is full)
+    if (file.fail() || rename(temporaryFilename.c_str(), filename.c_str()) != 0)
+    {
+        remove(temporaryFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+unsigned int RenderCache::lookup(const std::string& key, const RenderSettings& settings,
+    Framebuffer* target, std::vector<bool>& cachedTiles,
+    protocol::RenderSummary& summary) const
+{
+    TileList tiles = splitIntoTiles(Tile(0, 0, settings.width, settings.height), TILE_SIZE);
+    cachedTiles.assign(tiles.size(), false);
+    Entry entry;
+    if (!readEntry(filenameForKey(key), settings, entry))
+        return 0;
+
+    unsigned int numCached = 0;
+    for (unsigned int i = 0; (i < tiles.size()); i++)
+    {
+        if (!entry.tilesStored[i])
+            continue;
+        const Tile& tile = tiles[i];
+        for (int y = tile.y; (y < tile.y + tile.height); y++)
+        {
+            for (int x = tile.x; (x < tile.x + tile.width); x++)
+            {
+                const float* pixel = &entry.pixels[((static_cast<size_t>(y) * settings.width) + x) * 3];
+                target->set(x, y, Colour(pixel[0], pixel[1], pixel[2]));
+            }
+        }
+        cachedTiles[i] = true;
+        numCached++;
+    }
+    summary.seconds = entry.header.seconds;
+    summary.primaryRays = entry.header.primaryRays;
+    summary.reflectedRays = entry.header.reflectedRays;
+    summary.refractedRays = entry.header.refractedRays;
+    summary.shadowRays = entry.header.shadowRays;
+    return numCached;
+}
+
+bool RenderCache::store(const std::string& key, const RenderSettings& settings,
+    const Framebuffer& image, const std::vector<bool>& renderedTiles,
+    const protocol::RenderSummary& summary)
+{
+    TileList tiles = splitIntoTiles(Tile(0, 0, settings.width, settings.height), TILE_SIZE);
+    std::string filename = filenameForKey(key);
+    Entry entry;
+    if (!readEntry(filename, settings, entry))
+    {
+        CacheHeader header = { CACHE_MAGIC, CACHE_VERSION, settings.width, settings.height,
+            TILE_SIZE, static_cast<unsigned int>(tiles.size()), 0.0, 0, 0, 0, 0 };
+        entry.header = header;
+        entry.tilesStored.assign(tiles.size(), 0);
+        entry.pixels.assign(static_cast<size_t>(settings.width) * settings.height * 3, 0.0f);
+    }
+
+    for (unsigned int i = 0; (i < tiles.size() && i < renderedTiles.size()); i++)
+    {
+        if (!renderedTiles[i])
+            continue;
+        const Tile& tile = tiles[i];
+        for (int y = tile.y; (y < tile.y + tile.height); y++)
+        {
+            for (int x = tile.x; (x < tile.x + tile.width); x++)
+            {
+                const Colour& colour = image.get(x, y);
+                float* pixel = &entry.pixels[((static_cast<size_t>(y) * settings.width) + x) * 3];
+                pixel[0] = colour.r;
+                pixel[1] = colour.g;
+                pixel[2] = colour.b;
+            }
+        }
+        entry.tilesStored[i] = 1;
+    }
+    entry.header.seconds += summary.seconds;
+    entry.header.primaryRays += summary.primaryRays;
+    entry.header.reflectedRays += summary.reflectedRays;
+    entry.header.refractedRays += summary.refractedRays;
+    entry.header.shadowRays += summary.shadowRays;
+    return writeEntry(filename, entry);
+}
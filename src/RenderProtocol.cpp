@@ -0,0 +1,145 @@
+#include "RenderProtocol.h"
+#include "Socket.h"
+#include <sstream>
+#include <vector>
+#include <cstdio>
+
+using namespace raytracer;
+using namespace raytracer::protocol;
+
+/* Largest tile which can be sent in one message. */
+static const int MAX_TILE_AREA = MAX_TILE_SIZE * MAX_TILE_SIZE;
+
+std::string protocol::formatRenderRequest(const RenderRequest& request)
+{
+    std::stringstream ss;
+    ss << "RENDER scene=" << request.sceneId << " tile=" << request.tileSize;
+    if (request.region.area() > 0)
+    {
+        ss << " region=" << request.region.x << "," << request.region.y
+            << "," << request.region.width << "," << request.region.height;
+    }
+    ss << " " << formatRenderSettings(request.settings);
+    return ss.str();
+}
+
+bool protocol::parseRenderRequest(const std::string& line, RenderRequest& request)
+{
+    std::stringstream stream(line);
+    std::string word;
+    if (!(stream >> word) || word != "RENDER")
+        return false;
+    while (stream >> word)
+    {
+        size_t separator = word.find('=');
+        if (separator == std::string::npos)
+            return false;
+        std::string name = word.substr(0, separator);
+        std::string value = word.substr(separator + 1);
+        if (name == "scene")
+        {
+            request.sceneId = value;
+        }
+        else if (name == "tile")
+        {
+            if (sscanf(value.c_str(), "%d", &request.tileSize) != 1 ||
+                request.tileSize <= 0 || request.tileSize > MAX_TILE_SIZE)
+                return false;
+        }
+        else if (name == "region")
+        {
+            Tile& region = request.region;
+            if (sscanf(value.c_str(), "%d,%d,%d,%d", &region.x, &region.y,
+                &region.width, &region.height) != 4)
+                return false;
+        }
+        else if (!setRenderSetting(request.settings, name, value))
+        {
+            return false;
+        }
+    }
+    const RenderSettings& settings = request.settings;
+    if (settings.width > MAX_IMAGE_SIZE || settings.height > MAX_IMAGE_SIZE)
+        return false;
+    // Default to the whole image, and make sure region is inside it.
+    // Written so that nothing can overflow.
+    Tile& region = request.region;
+    if (region.width == 0 && region.height == 0)
+        region = Tile(0, 0, settings.width, settings.height);
+    if (region.x < 0 || region.y < 0 || region.width <= 0 || region.height <= 0 ||
+        region.x > settings.width - region.width || region.y > settings.height - region.height)
+        return false;
+    int tilesAcross = (region.width + request.tileSize - 1) / request.tileSize;
+    int tilesDown = (region.height + request.tileSize - 1) / request.tileSize;
+    return (tilesAcross * tilesDown <= MAX_TILES_PER_REQUEST);
+}
+
+std::string protocol::formatRenderSummary(const RenderSummary& summary)
+{
+    std::stringstream ss;
+    ss << "DONE " << summary.seconds << " " << summary.primaryRays << " "
+        << summary.reflectedRays << " " << summary.refractedRays << " "
+        << summary.shadowRays;
+    return ss.str();
+}
+
+bool protocol::parseRenderSummary(const std::string& line, RenderSummary& summary)
+{
+    std::stringstream stream(line);
+    std::string word;
+    return (stream >> word) && (word == "DONE") &&
+        (stream >> summary.seconds >> summary.primaryRays >> summary.reflectedRays
+            >> summary.refractedRays >> summary.shadowRays);
+}
+
+bool protocol::sendTile(int socket, const Tile& tile, const Framebuffer& source,
+    int sourceX, int sourceY)
+{
+    std::stringstream header;
+    header << "TILE " << tile.x << " " << tile.y << " " << tile.width << " " << tile.height;
+    if (!net::sendLine(socket, header.str()))
+        return false;
+    // Pack pixels into one buffer so they are sent in a single call
+    std::vector<float> pixels;
+    pixels.reserve(tile.area() * 3);
+    for (int y = tile.y; (y < tile.y + tile.height); y++)
+    {
+        for (int x = tile.x; (x < tile.x + tile.width); x++)
+        {
+            const Colour& colour = source.get(x - sourceX, y - sourceY);
+            pixels.push_back(colour.r);
+            pixels.push_back(colour.g);
+            pixels.push_back(colour.b);
+        }
+    }
+    return pixels.empty() || net::sendAll(socket, &pixels[0], pixels.size() * sizeof(float));
+}
+
+bool protocol::receiveTilePixels(int socket, const Tile& tile, Framebuffer* target,
+    int targetX, int targetY)
+{
+    if (tile.width <= 0 || tile.height <= 0 || tile.area() > MAX_TILE_AREA)
+        return false;
+    std::vector<float> pixels(tile.area() * 3);
+    if (!net::receiveAll(socket, &pixels[0], pixels.size() * sizeof(float)))
+        return false;
+    unsigned int index = 0;
+    for (int y = tile.y; (y < tile.y + tile.height); y++)
+    {
+        for (int x = tile.x; (x < tile.x + tile.width); x++)
+        {
+            target->set(x - targetX, y - targetY,
+                Colour(pixels[index], pixels[index + 1], pixels[index + 2]));
+            index += 3;
+        }
+    }
+    return true;
+}
+
+bool protocol::parseTileHeader(const std::string& line, Tile& tile)
+{
+    std::stringstream stream(line);
+    std::string word;
+    return (stream >> word) && (word == "TILE") &&
+        (stream >> tile.x >> tile.y >> tile.width >> tile.height);
+}
@@ -0,0 +1,416 @@
+#include "RenderService.h"
+#include "Socket.h"
+#include "TileRenderer.h"
+#include "Image.h"
+#include "Tracing.h"
+#include <deque>
+#include <sstream>
+#include <iostream>
+#include <unistd.h>
+
+using namespace raytracer;
+using namespace raytracer::threading;
+
+/* Scene kept in memory by the service, along with what is needed to
+ * share it between concurrent jobs. */
+struct RenderService::SceneEntry
+{
+    DemoScene scene;
+    Mutex mutex;
+    // Signalled when there are no jobs rendering the scene
+    Condition idle;
+    // Geometry the scene is currently set up for (see terrainSelectionKey())
+    std::string activeGeometry;
+    unsigned int activeJobs;
+    // Set once the scene has been built (see getScene())
+    bool loaded;
+
+    SceneEntry() : activeJobs(0), loaded(false) { }
+};
+
+/* A render in progress. Tiles are rendered by the thread pool and queued
+ * here until the connection thread sends them to the client. */
+struct RenderService::RenderJob
+{
+    struct FinishedTile
+    {
+        Tile tile;
+        Image* image; // NULL if the job was cancelled before it was rendered
+    };
+
+    RenderSettings settings;
+    // Configured for this job. Each tile is rendered with its own copy.
+    Raytracer* renderer;
+
+    Mutex mutex;
+    Condition tileFinished;
+    std::deque<FinishedTile> finishedTiles;
+    // Set if the client disconnected, so remaining tiles are skipped
+    bool cancelled;
+    uint64_t primaryRays;
+    uint64_t reflectedRays;
+    uint64_t refractedRays;
+    uint64_t shadowRays;
+
+    RenderJob() : renderer(NULL), cancelled(false), primaryRays(0),
+        reflectedRays(0), refractedRays(0), shadowRays(0)
+    {
+    }
+};
+
+class RenderService::RenderTileTask : public Task
+{
+
+public:
+    RenderTileTask(RenderJob* job, const Tile& tile) : job(job), tile(tile) { }
+
+    virtual void run()
+    {
+        RenderJob::FinishedTile finished;
+        finished.tile = tile;
+        finished.image = NULL;
+
+        job->mutex.lock();
+        bool cancelled = job->cancelled;
+        job->mutex.unlock();
+        Raytracer renderer(*job->renderer);
+        if (!cancelled)
+        {
+            finished.image = new Image(tile.width, tile.height);
+            renderTile(&renderer, job->settings, tile, finished.image, tile.x, tile.y);
+        }
+
+        ScopedLock lock(job->mutex);
+        job->finishedTiles.push_back(finished);
+        job->primaryRays += renderer.primaryRays();
+        job->reflectedRays += renderer.reflectedRays();
+        job->refractedRays += renderer.refractedRays();
+        job->shadowRays += renderer.shadowRays();
+        job->tileFinished.signal();
+    }
+
+private:
+    RenderJob* job;
+    Tile tile;
+
+};
+
+class RenderService::ConnectionTask : public Task
+{
+
+public:
+    ConnectionTask(RenderService* service, int connection) :
+        service(service), connection(connection)
+    {
+    }
+
+    virtual void run()
+    {
+        tracing::setThreadName("connection thread");
+        service->handleConnection(connection);
+    }
+
+private:
+    RenderService* service;
+    int connection;
+
+};
+
+RenderService::RenderService(unsigned int numThreads) :
+    pool(new ThreadPool(numThreads, "render thread")), acceptsControlCommands(false),
+    listener(-1), activeJobs(0), stopping(false)
+{
+}
+
+RenderService::~RenderService()
+{
+    // Disconnect clients and wait for their threads to finish
+    mutex.lock();
+    stopping = true;
+    for (std::set<int>::iterator it = connections.begin(); (it != connections.end()); it++)
+        net::shutdownSocket(*it);
+    while (!connections.empty())
+        connectionClosed.wait(mutex);
+    mutex.unlock();
+
+    delete pool;
+    for (std::map<std::string, SceneEntry*>::iterator it = scenes.begin();
+        (it != scenes.end()); it++)
+    {
+        delete it->second->scene.renderer;
+        delete it->second->scene.compiledScene;
+        delete it->second;
+    }
+}
+
+bool RenderService::preloadScene(const std::string& sceneId)
+{
+    return (getScene(sceneId) != NULL);
+}
+
+void RenderService::setCompiledSceneFilename(const std::string& filename)
+{
+    ScopedLock lock(mutex);
+    compiledSceneFilename = filename;
+}
+
+RenderService::SceneEntry* RenderService::getScene(const std::string& sceneId)
+{
+    mutex.lock();
+    std::map<std::string, SceneEntry*>::iterator it = scenes.find(sceneId);
+    // Another connection is building the scene, so wait for it
+    while (it != scenes.end() && !it->second->loaded)
+    {
+        sceneLoaded.wait(mutex);
+        it = scenes.find(sceneId);
+    }
+    if (it != scenes.end() || sceneId != "demo")
+    {
+        // The demo scene is the only one the program knows how to build
+        SceneEntry* found = (it != scenes.end()) ? it->second : NULL;
+        mutex.unlock();
+        return found;
+    }
+    SceneEntry* entry = new SceneEntry();
+    scenes[sceneId] = entry;
+    std::string filename = compiledSceneFilename;
+    mutex.unlock();
+
+    // Built without the lock held, so connections using other scenes or
+    // asking for STATUS are not held up by it
+    double start = common::wallClockSeconds();
+    DemoScene scene = constructDemoScene(filename);
+
+    ScopedLock lock(mutex);
+    sceneLoaded.broadcast();
+    if (!scene.renderer)
+    {
+        std::cerr << "Could not load scene '" << sceneId << "'" << std::endl;
+        scenes.erase(sceneId);
+        delete entry;
+        return NULL;
+    }
+    entry->scene = scene;
+    entry->loaded = true;
+    std::cout << "Loaded scene '" << sceneId << "' in "
+        << (common::wallClockSeconds() - start) << " seconds" << std::endl;
+    return entry;
+}
+
+void RenderService::beginJob(SceneEntry* entry, const RenderSettings& settings)
+{
+    std::string geometry = terrainSelectionKey(settings);
+    ScopedLock lock(entry->mutex);
+    // Jobs needing different terrain must wait for those rendering now
+    while (entry->activeJobs > 0 && entry->activeGeometry != geometry)
+        entry->idle.wait(entry->mutex);
+    if (entry->activeGeometry != geometry)
+    {
+        applySceneGeometry(entry->scene, settings);
+        entry->activeGeometry = geometry;
+    }
+    entry->activeJobs++;
+}
+
+void RenderService::endJob(SceneEntry* entry)
+{
+    ScopedLock lock(entry->mutex);
+    entry->activeJobs--;
+    if (entry->activeJobs == 0)
+        entry->idle.broadcast();
+}
+
+bool RenderService::serveUnixSocket(const std::string& path)
+{
+    listener = net::listenOnUnixSocket(path);
+    if (listener < 0)
+        return false;
+    acceptsControlCommands = true;
+    std::cout << "Listening on " << path << " with " << pool->numThreads()
+        << " render threads" << std::endl;
+    serve();
+    unlink(path.c_str());
+    return true;
+}
+
+bool RenderService::serveTcpPort(int port)
+{
+    listener = net::listenOnTcpPort(port);
+    if (listener < 0)
+        return false;
+    acceptsControlCommands = false;
+    std::cout << "Listening on port " << port << " with " << pool->numThreads()
+        << " render threads" << std::endl;
+    serve();
+    return true;
+}
+
+void RenderService::serve()
+{
+    // Only this thread changes 'listener', so it can be read without the lock
+    while (true)
+    {
+        int connection = net::acceptConnection(listener);
+        ScopedLock lock(mutex);
+        if (stopping)
+        {
+            net::closeSocket(connection);
+            break;
+        }
+        if (connection < 0)
+            continue;
+        connections.insert(connection);
+        if (!runDetached(new ConnectionTask(this, connection)))
+        {
+            connections.erase(connection);
+            net::closeSocket(connection);
+        }
+    }
+    ScopedLock lock(mutex);
+    net::closeSocket(listener);
+    listener = -1;
+}
+
+void RenderService::requestShutdown()
+{
+    // Wakes serve() up, which is waiting for a connection
+    ScopedLock lock(mutex);
+    stopping = true;
+    net::shutdownSocket(listener);
+}
+
+void RenderService::handleConnection(int connection)
+{
+    std::string line;
+    while (net::receiveLine(connection, line))
+    {
+        std::string command = line.substr(0, line.find(' '));
+        bool ok = true;
+        if (command == "RENDER")
+        {
+            protocol::RenderRequest request;
+            if (!protocol::parseRenderRequest(line, request))
+                ok = net::sendLine(connection, "ERROR invalid render request");
+            else
+                ok = handleRender(connection, request);
+        }
+        else if (command == "STATUS")
+        {
+            std::stringstream status;
+            mutex.lock();
+            status << "STATUS threads=" << pool->numThreads() << " jobs=" << activeJobs
+                << " connections=" << connections.size() << " scenes=";
+            bool first = true;
+            for (std::map<std::string, SceneEntry*>::iterator it = scenes.begin();
+                (it != scenes.end()); it++)
+            {
+                if (!it->second->loaded)
+                    continue;
+                status << (first ? "" : ",") << it->first;
+                first = false;
+            }
+            mutex.unlock();
+            ok = net::sendLine(connection, status.str());
+        }
+        else if ((command == "TRACE" || command == "SHUTDOWN") && !acceptsControlCommands)
+        {
+            ok = net::sendLine(connection, "ERROR " + command + " is only accepted over a Unix domain socket");
+        }
+        else if (command == "TRACE")
+        {
+            std::string filename = (line.size() > command.size() + 1) ?
+                line.substr(command.size() + 1) : "";
+            if (filename.empty() || !tracing::writeChromeTrace(filename))
+                ok = net::sendLine(connection, "ERROR could not write trace to " + filename);
+            else
+                ok = net::sendLine(connection, "OK " + common::toString(tracing::eventCount()));
+        }
+        else if (command == "SHUTDOWN")
+        {
+            net::sendLine(connection, "OK");
+            requestShutdown();
+            break;
+        }
+        else
+        {
+            ok = net::sendLine(connection, "ERROR unknown command " + command);
+        }
+        if (!ok)
+            break;
+    }
+
+    net::closeSocket(connection);
+    ScopedLock lock(mutex);
+    connections.erase(connection);
+    connectionClosed.broadcast();
+}
+
+bool RenderService::handleRender(int connection, const protocol::RenderRequest& request)
+{
+    SceneEntry* entry = getScene(request.sceneId);
+    if (!entry)
+        return net::sendLine(connection, "ERROR unknown scene, or could not load it: " + request.sceneId);
+
+    tracing::ScopedEvent event("render job");
+    double start = common::wallClockSeconds();
+    beginJob(entry, request.settings);
+    RenderJob job;
+    job.settings = request.settings;
+    job.renderer = new Raytracer(*entry->scene.renderer);
+    if (!configureRenderer(entry->scene, request.settings, job.renderer))
+    {
+        delete job.renderer;
+        endJob(entry);
+        return net::sendLine(connection, "ERROR scene has no such camera or terrain");
+    }
+    mutex.lock();
+    activeJobs++;
+    mutex.unlock();
+
+    TileList tiles = splitIntoTiles(request.region, request.tileSize);
+    bool connected = net::sendLine(connection, "OK " + common::toString(tiles.size()));
+    if (!connected)
+        job.cancelled = true;
+    for (unsigned int i = 0; (i < tiles.size()); i++)
+        pool->addTask(new RenderTileTask(&job, tiles[i]));
+
+    // Send tiles as they finish. Every tile must be collected, even if the
+    // client has gone, since the tasks refer to the job.
+    for (unsigned int i = 0; (i < tiles.size()); i++)
+    {
+        job.mutex.lock();
+        while (job.finishedTiles.empty())
+            job.tileFinished.wait(job.mutex);
+        RenderJob::FinishedTile finished = job.finishedTiles.front();
+        job.finishedTiles.pop_front();
+        job.mutex.unlock();
+
+        if (connected && finished.image)
+        {
+            connected = protocol::sendTile(connection, finished.tile, *finished.image,
+                finished.tile.x, finished.tile.y);
+            if (!connected)
+            {
+                ScopedLock lock(job.mutex);
+                job.cancelled = true;
+            }
+        }
+        delete finished.image;
+    }
+
+    delete job.renderer;
+    endJob(entry);
+    mutex.lock();
+    activeJobs--;
+    mutex.unlock();
+
+    if (!connected)
+        return false;
+    protocol::RenderSummary summary;
+    summary.seconds = common::wallClockSeconds() - start;
+    summary.primaryRays = job.primaryRays;
+    summary.reflectedRays = job.reflectedRays;
+    summary.refractedRays = job.refractedRays;
+    summary.shadowRays = job.shadowRays;
+    return net::sendLine(connection, protocol::formatRenderSummary(summary));
+}
@@ -0,0 +1,208 @@
+#include "RenderSettings.h"
+#include <sstream>
+#include <cstdlib>
+
+using namespace raytracer;
+
+/* Maximum number of lights which can be toggled (bits in enabledLights). */
+static const unsigned int MAX_LIGHTS = 32;
+static const unsigned int ALL_LIGHTS = ~0u;
+
+static const char* SAMPLING_METHOD_NAMES[] = { "single", "uniform", "random" };
+static const char* TERRAIN_NAMES[] = { "varied", "shallow", "peaks" };
+static const char* ACCELERATOR_NAMES[] = { "flat", "octree", "bvh", "grid", "auto" };
+
+/* Parse positive integer. Returns false if string is not one. */
+bool parsePositiveInteger(const std::string& value, int& result)
+{
+    char* end = NULL;
+    long parsed = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || parsed <= 0 || parsed > 1000000)
+        return false;
+    result = static_cast<int>(parsed);
+    return true;
+}
+
+bool parseSwitch(const std::string& value, bool& result)
+{
+    if (value == "on" || value == "true" || value == "1")
+        result = true;
+    else if (value == "off" || value == "false" || value == "0")
+        result = false;
+    else
+        return false;
+    return true;
+}
+
+/* Parse list of light numbers separated by '+' (e.g. "1+2"), or one of
+ * the special values "all" and "none". */
+bool parseLights(const std::string& value, unsigned int& result)
+{
+    if (value == "all")
+    {
+        result = ALL_LIGHTS;
+        return true;
+    }
+    else if (value == "none")
+    {
+        result = 0;
+        return true;
+    }
+    unsigned int lights = 0;
+    std::stringstream stream(value);
+    std::string lightNumber;
+    while (std::getline(stream, lightNumber, '+'))
+    {
+        int number = 0;
+        if (!parsePositiveInteger(lightNumber, number) || number > static_cast<int>(MAX_LIGHTS))
+            return false;
+        lights |= (1u << (number - 1));
+    }
+    result = lights;
+    return (lights != 0);
+}
+
+bool raytracer::setRenderSetting(RenderSettings& settings,
+    const std::string& name, const std::string& value)
+{
+    int number = 0;
+    if (name == "width" || name == "height" || name == "samples" || name == "camera")
+    {
+        if (!parsePositiveInteger(value, number))
+            return false;
+        if (name == "width") settings.width = number;
+        else if (name == "height") settings.height = number;
+        else if (name == "samples") settings.numSamples = number;
+        else settings.cameraIndex = number - 1;
+        return true;
+    }
+    else if (name == "sampling")
+    {
+        for (unsigned int i = 0; (i < 3); i++)
+        {
+            if (value == SAMPLING_METHOD_NAMES[i])
+            {
+                settings.samplingMethod = static_cast<SamplingMethod>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+    else if (name == "terrain")
+    {
+        for (unsigned int i = 0; (i < 3); i++)
+        {
+            if (value == TERRAIN_NAMES[i])
+            {
+                settings.terrainIndex = i;
+                return true;
+            }
+        }
+        if (!parsePositiveInteger(value, number))
+            return false;
+        settings.terrainIndex = number - 1;
+        return true;
+    }
+    else if (name == "accelerator")
+    {
+        for (unsigned int i = 0; (i < NUM_ACCELERATOR_TYPES); i++)
+        {
+            if (value == ACCELERATOR_NAMES[i])
+            {
+                settings.accelerator = static_cast<AcceleratorType>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+    else if (name == "octree")
+    {
+        bool useOctree = false;
+        if (!parseSwitch(value, useOctree))
+            return false;
+        settings.accelerator = (useOctree) ? OCTREE_ACCELERATOR : FLAT_ACCELERATOR;
+        return true;
+    }
+    else if (name == "show-octree")
+        return parseSwitch(value, settings.showOctree);
+    else if (name == "local")
+        return parseSwitch(value, settings.localIllumination);
+    else if (name == "reflect")
+        return parseSwitch(value, settings.reflectionRefraction);
+    else if (name == "shadows")
+        return parseSwitch(value, settings.shadows);
+    else if (name == "lights")
+        return parseLights(value, settings.enabledLights);
+    return false;
+}
+
+bool raytracer::parseRenderSettings(const std::string& text, RenderSettings& settings)
+{
+    std::stringstream stream(text);
+    std::string pair;
+    while (stream >> pair)
+    {
+        size_t separator = pair.find('=');
+        if (separator == std::string::npos)
+            return false;
+        if (!setRenderSetting(settings, pair.substr(0, separator), pair.substr(separator + 1)))
+            return false;
+    }
+    return true;
+}
+
+const char* raytracer::acceleratorName(AcceleratorType type)
+{
+    return ACCELERATOR_NAMES[type];
+}
+
+unsigned int raytracer::samplesPerPixel(const RenderSettings& settings)
+{
+    switch (settings.samplingMethod)
+    {
+    case UNIFORM_MULTISAMPLING:
+        return settings.numSamples * settings.numSamples;
+    case RANDOM_MULTISAMPLING:
+        return settings.numSamples;
+    default:
+        return 1;
+    }
+}
+
+std::string raytracer::formatRenderSettings(const RenderSettings& settings)
+{
+    std::stringstream ss;
+    ss << "width=" << settings.width
+        << " height=" << settings.height
+        << " sampling=" << SAMPLING_METHOD_NAMES[settings.samplingMethod]
+        << " samples=" << settings.numSamples
+        << " camera=" << (settings.cameraIndex + 1)
+        << " terrain=" << (settings.terrainIndex + 1)
+        << " accelerator=" << ACCELERATOR_NAMES[settings.accelerator]
+        << " show-octree=" << (settings.showOctree ? "on" : "off")
+        << " local=" << (settings.localIllumination ? "on" : "off")
+        << " reflect=" << (settings.reflectionRefraction ? "on" : "off")
+        << " shadows=" << (settings.shadows ? "on" : "off");
+    ss << " lights=";
+    if (settings.enabledLights == ALL_LIGHTS)
+    {
+        ss << "all";
+    }
+    else if (settings.enabledLights == 0)
+    {
+        ss << "none";
+    }
+    else
+    {
+        bool first = true;
+        for (unsigned int i = 0; (i < MAX_LIGHTS); i++)
+        {
+            if (settings.enabledLights & (1u << i))
+            {
+                ss << (first ? "" : "+") << (i + 1);
+                first = false;
+            }
+        }
+    }
+    return ss.str();
+}
@@ -1,21 +1,87 @@
 #include "ResourceManager.h"
 #include "TGA.h"
+#include "ContentHash.h"
+#include <set>
 
 using namespace raytracer;
+using namespace raytracer::threading;
+
+ResourceManager::ResourceManager() : imageBytes(0), imageMemoryBudget(0), useCounter(0)
+{
+}
 
 ResourceManager::~ResourceManager()
 {
 	clearAll();
+	if (instance == this)
+		instance = NULL;
 }
 
 Image* ResourceManager::createImage(const std::string imageID,
 	const std::string& imageFilename)
 {
-	ImageTable::const_iterator it = images.find(imageID);
-	if (it != images.end())
+	// Files are hashed and decoded without the lock held, so many
+	// images can be loaded at once
+	ContentHash hash;
+	if (!hash.addFile(imageFilename))
+	{
 		removeImage(imageID);
+		return NULL;
+	}
+	std::string contentHash = hash.toHex();
+	{
+		ScopedLock lock(mutex);
+		std::map<std::string, ImageRecord*>::iterator it = imagesByContent.find(contentHash);
+		if (it != imagesByContent.end())
+		{
+			storeImage(imageID, it->second);
+			return useImage(it->second);
+		}
+	}
+
 	Image* image = tga::readTGAFile(imageFilename);
-	images.insert( std::pair<std::string, Image*>(imageID, image) );
+	if (!image)
+	{
+		removeImage(imageID);
+		return NULL;
+	}
+	ScopedLock lock(mutex);
+	// Another thread may have loaded the same file in the meantime
+	std::map<std::string, ImageRecord*>::iterator it = imagesByContent.find(contentHash);
+	if (it != imagesByContent.end())
+	{
+		delete image;
+		storeImage(imageID, it->second);
+		return useImage(it->second);
+	}
+	ImageRecord* record = new ImageRecord();
+	record->image = image;
+	record->filename = imageFilename;
+	record->contentHash = contentHash;
+	record->references = 0;
+	record->pins = 0;
+	record->lastUsed = 0;
+	imagesByContent[contentHash] = record;
+	imageBytes += image->memoryUsed();
+	storeImage(imageID, record);
+	useImage(record);
+	enforceImageBudget(record);
+	return image;
+}
+
+Image* ResourceManager::addImage(const std::string& imageID, Image* image)
+{
+	ImageRecord* record = new ImageRecord();
+	record->image = image;
+	record->references = 0;
+	record->pins = 0;
+	record->lastUsed = 0;
+	ScopedLock lock(mutex);
+	if (image)
+		imageBytes += image->memoryUsed();
+	storeImage(imageID, record);
+	useImage(record);
+	enforceImageBudget(record);
 	return image;
 }
 
@@ -23,11 +89,10 @@ Mesh* ResourceManager::createMesh(const std::string& meshID,
 	const std::vector<Vertex>& vertices,
 	const Material& material)
 {
+	ScopedLock lock(mutex);
 	// Check if mesh already exists. If so, remove the mesh
 	// to make way for the new one
-	MeshTable::const_iterator it = meshes.find(meshID);
-	if (it != meshes.end())
-		removeMesh(meshID);
+	eraseMesh(meshID);
 	// Create mesh
 	Mesh* mesh = new Mesh(vertices, material);
 	// Insert mesh into table so it can be retrieved later
@@ -38,25 +103,32 @@ Mesh* ResourceManager::createMesh(const std::string& meshID,
 Texture* ResourceManager::createTexture(const std::string textureID,
 	const std::string& imageID)
 {
+	ScopedLock lock(mutex);
 	// If specified image has not been loaded, return null
-	Image* texImage = getImage(imageID);
+	ImageRecord* record = findImage(imageID);
+	Image* texImage = (record) ? useImage(record) : NULL;
 	if (!texImage)
 		return NULL;
 
-	TextureTable::const_iterator texIt = textures.find(imageID);
-	if (texIt != textures.end())
-		removeTexture(textureID);
+	eraseTexture(textureID);
 	Texture* texture = new ImageTexture(texImage);
 	textures.insert( std::pair<std::string, Texture*>(textureID, texture) );
+	// Texture keeps image loaded for as long as it exists
+	record->references++;
+	record->pins++;
+	textureImages[texture] = record;
 	return texture;
 }
 	
 bool ResourceManager::removeImage(const std::string& imageID)
 {
+	ScopedLock lock(mutex);
 	ImageTable::iterator it = images.find(imageID);
 	if (it != images.end())
 	{
+		ImageRecord* record = it->second;
 		images.erase(it);
+		releaseImage(record);
 		return true;
 	}
 	else
@@ -67,43 +139,26 @@ bool ResourceManager::removeImage(const std::string& imageID)
 
 bool ResourceManager::removeMesh(const std::string& meshID)
 {
-	MeshTable::iterator it = meshes.find(meshID);
-	if (it != meshes.end())
-	{
-		meshes.erase(it);
-		return true;
-	}
-	else
-	{	
-		return false;
-	}
+	ScopedLock lock(mutex);
+	return eraseMesh(meshID);
 }
 
 bool ResourceManager::removeTexture(const std::string& textureID)
 {
-	TextureTable::iterator it = textures.find(textureID);
-	if (it != textures.end())
-	{
-		textures.erase(it);
-		return true;
-	}
-	else
-	{	
-		return false;
-	}
+	ScopedLock lock(mutex);
+	return eraseTexture(textureID);
 }
 
-Image* ResourceManager::getImage(const std::string& imageID) const
+Image* ResourceManager::getImage(const std::string& imageID)
 {
-	ImageTable::const_iterator it = images.find(imageID);
-	if (it != images.end())
-		return it->second;
-	else
-		return NULL;
+	ScopedLock lock(mutex);
+	ImageRecord* record = findImage(imageID);
+	return (record) ? useImage(record) : NULL;
 }
 
 Mesh* ResourceManager::getMesh(const std::string& meshID) const
 {
+	ScopedLock lock(mutex);
 	MeshTable::const_iterator it = meshes.find(meshID);
 	if (it != meshes.end())
 		return it->second;
@@ -113,6 +168,7 @@ Mesh* ResourceManager::getMesh(const std::string& meshID) const
 
 Texture* ResourceManager::getTexture(const std::string& textureID) const
 {
+	ScopedLock lock(mutex);
 	TextureTable::const_iterator it = textures.find(textureID);
 	if (it != textures.end())
 		return it->second;
@@ -120,15 +176,138 @@ Texture* ResourceManager::getTexture(const std::string& textureID) const
 		return NULL;
 }
 
+Image* ResourceManager::acquireImage(const std::string& imageID)
+{
+	ScopedLock lock(mutex);
+	ImageRecord* record = findImage(imageID);
+	if (!record)
+		return NULL;
+	record->references++;
+	record->pins++;
+	acquiredImages.insert( std::pair<std::string, ImageRecord*>(imageID, record) );
+	return useImage(record);
+}
+
+void ResourceManager::releaseImage(const std::string& imageID)
+{
+	ScopedLock lock(mutex);
+	std::multimap<std::string, ImageRecord*>::iterator it = acquiredImages.find(imageID);
+	if (it == acquiredImages.end())
+		return;
+	ImageRecord* record = it->second;
+	acquiredImages.erase(it);
+	record->pins--;
+	releaseImage(record);
+}
+
+size_t ResourceManager::memoryUsed(ResourceType type) const
+{
+	ScopedLock lock(mutex);
+	size_t bytes = 0;
+	switch (type)
+	{
+	case IMAGE_RESOURCE:
+		bytes = imageBytes;
+		break;
+	case MESH_RESOURCE:
+		for (MeshTable::const_iterator it = meshes.begin(); (it != meshes.end()); it++)
+			bytes += sizeof(Mesh) + (it->second->getVertices().capacity() * sizeof(Vertex));
+		break;
+	case TEXTURE_RESOURCE:
+		bytes = textures.size() * sizeof(ImageTexture);
+		break;
+	}
+	return bytes;
+}
+
+void ResourceManager::reportMemory(MemoryReport& report) const
+{
+	ScopedLock lock(mutex);
+	// Name each image after every ID it is stored or acquired under
+	std::map<const ImageRecord*, std::string> imageNames;
+	std::vector<const ImageRecord*> records;
+	for (ImageTable::const_iterator it = images.begin(); (it != images.end()); it++)
+	{
+		std::string& name = imageNames[it->second];
+		if (name.empty())
+			records.push_back(it->second);
+		name += (name.empty() ? "" : "/") + it->first;
+	}
+	for (std::multimap<std::string, ImageRecord*>::const_iterator it = acquiredImages.begin();
+		(it != acquiredImages.end()); it++)
+	{
+		// Only those no longer stored under the ID they were acquired with
+		if (findImage(it->first) == it->second)
+			continue;
+		std::string& name = imageNames[it->second];
+		if (name.empty())
+			records.push_back(it->second);
+		name += (name.empty() ? "" : "/") + it->first + " (removed)";
+	}
+	// and those only kept by a texture
+	for (TextureTable::const_iterator it = textures.begin(); (it != textures.end()); it++)
+	{
+		std::map<Texture*, ImageRecord*>::const_iterator image = textureImages.find(it->second);
+		if (image != textureImages.end() && imageNames[image->second].empty())
+		{
+			records.push_back(image->second);
+			imageNames[image->second] = "image of " + it->first;
+		}
+	}
+	for (unsigned int i = 0; (i < records.size()); i++)
+	{
+		if (records[i]->image)
+			report.add("images", imageNames[records[i]],
+				sizeof(Image) + records[i]->image->memoryUsed());
+	}
+	for (MeshTable::const_iterator it = meshes.begin(); (it != meshes.end()); it++)
+		report.add("meshes", it->first, sizeof(Mesh) +
+			(it->second->getVertices().capacity() * sizeof(Vertex)));
+	for (TextureTable::const_iterator it = textures.begin(); (it != textures.end()); it++)
+		report.add("textures", it->first, sizeof(ImageTexture));
+}
+
+void ResourceManager::setImageMemoryBudget(size_t bytes)
+{
+	ScopedLock lock(mutex);
+	imageMemoryBudget = bytes;
+	enforceImageBudget(NULL);
+}
+
+size_t ResourceManager::getImageMemoryBudget() const
+{
+	ScopedLock lock(mutex);
+	return imageMemoryBudget;
+}
+
 void ResourceManager::clearImages()
 {
+	ScopedLock lock(mutex);
+	// Records may be referenced from several places, so only delete each once
+	std::set<ImageRecord*> records;
 	for (ImageTable::iterator it = images.begin(); (it != images.end()); it++)
-		delete it->second;
+		records.insert(it->second);
+	for (std::map<Texture*, ImageRecord*>::iterator it = textureImages.begin();
+		(it != textureImages.end()); it++)
+		records.insert(it->second);
+	for (std::multimap<std::string, ImageRecord*>::iterator it = acquiredImages.begin();
+		(it != acquiredImages.end()); it++)
+		records.insert(it->second);
+	for (std::set<ImageRecord*>::iterator it = records.begin(); (it != records.end()); it++)
+	{
+		delete (*it)->image;
+		delete *it;
+	}
 	images.clear();
+	imagesByContent.clear();
+	textureImages.clear();
+	acquiredImages.clear();
+	imageBytes = 0;
 }
 
 void ResourceManager::clearMeshes()
 {
+	ScopedLock lock(mutex);
 	for (MeshTable::iterator it = meshes.begin(); (it != meshes.end()); it++)
 		delete it->second;
 	meshes.clear();
@@ -136,22 +315,141 @@ void ResourceManager::clearMeshes()
 
 void ResourceManager::clearTextures()
 {
-	for (TextureTable::iterator it = textures.begin(); (it != textures.end()); it++)
-		delete it->second;
-	textures.clear();
+	ScopedLock lock(mutex);
+	while (!textures.empty())
+		eraseTexture(textures.begin()->first);
 }
 
 void ResourceManager::clearAll()
 {
+	clearTextures();
 	clearImages();
 	clearMeshes();
-	clearTextures();
 }
 
+ResourceManager::ImageRecord* ResourceManager::findImage(const std::string& imageID) const
+{
+	ImageTable::const_iterator it = images.find(imageID);
+	if (it != images.end())
+		return it->second;
+	else
+		return NULL;
+}
+
+void ResourceManager::storeImage(const std::string& imageID, ImageRecord* record)
+{
+	ImageTable::iterator it = images.find(imageID);
+	if (it != images.end())
+	{
+		if (it->second == record)
+			return;
+		ImageRecord* previous = it->second;
+		images.erase(it);
+		releaseImage(previous);
+	}
+	images.insert( std::pair<std::string, ImageRecord*>(imageID, record) );
+	record->references++;
+}
+
+Image* ResourceManager::useImage(ImageRecord* record)
+{
+	record->lastUsed = ++useCounter;
+	// Decode image again if it was freed. This is rare, so the lock
+	// is simply kept held while it happens.
+	if (!record->image && !record->filename.empty())
+	{
+		record->image = tga::readTGAFile(record->filename);
+		if (record->image)
+		{
+			imageBytes += record->image->memoryUsed();
+			enforceImageBudget(record);
+		}
+	}
+	return record->image;
+}
+
+void ResourceManager::releaseImage(ImageRecord* record)
+{
+	record->references--;
+	if (record->references > 0)
+		return;
+	if (record->image)
+		imageBytes -= record->image->memoryUsed();
+	delete record->image;
+	if (!record->contentHash.empty())
+		imagesByContent.erase(record->contentHash);
+	delete record;
+}
+
+void ResourceManager::enforceImageBudget(const ImageRecord* keep)
+{
+	if (imageMemoryBudget == 0)
+		return;
+	while (imageBytes > imageMemoryBudget)
+	{
+		// Free the least recently used image which can be loaded again
+		ImageRecord* leastRecent = NULL;
+		for (ImageTable::iterator it = images.begin(); (it != images.end()); it++)
+		{
+			ImageRecord* record = it->second;
+			if (record != keep && record->image && record->pins == 0 &&
+				!record->filename.empty() &&
+				(!leastRecent || record->lastUsed < leastRecent->lastUsed))
+				leastRecent = record;
+		}
+		if (!leastRecent)
+			break;
+		imageBytes -= leastRecent->image->memoryUsed();
+		delete leastRecent->image;
+		leastRecent->image = NULL;
+	}
+}
+
+bool ResourceManager::eraseMesh(const std::string& meshID)
+{
+	MeshTable::iterator it = meshes.find(meshID);
+	if (it != meshes.end())
+	{
+		delete it->second;
+		meshes.erase(it);
+		return true;
+	}
+	else
+	{	
+		return false;
+	}
+}
+
+bool ResourceManager::eraseTexture(const std::string& textureID)
+{
+	TextureTable::iterator it = textures.find(textureID);
+	if (it != textures.end())
+	{
+		std::map<Texture*, ImageRecord*>::iterator imageIt = textureImages.find(it->second);
+		if (imageIt != textureImages.end())
+		{
+			imageIt->second->pins--;
+			releaseImage(imageIt->second);
+			textureImages.erase(imageIt);
+		}
+		delete it->second;
+		textures.erase(it);
+		return true;
+	}
+	else
+	{	
+		return false;
+	}
+}
+
+/* Held while the singleton instance is created. */
+static Mutex instanceMutex;
+
 ResourceManager* ResourceManager::instance = NULL;
 ResourceManager* ResourceManager::getInstance()
 {
     // Lazy initialisation of singleton instance
+    ScopedLock lock(instanceMutex);
     if (!instance)
         instance = new ResourceManager();
     return instance;
@@ -1,4 +1,5 @@
 #include <sstream>
+#include <algorithm>
 #include <float.h>
 #include "ShapeLoaders.h"
 #include "BoundingShape.h"
@@ -18,115 +19,224 @@ static const float MATERIAL_REFRACTIVE_INDEX = 0.0f;
 /* Generate unique ID for mesh. */
 std::string generateMeshID()
 {
+	// Meshes may be created by several threads at once
 	static unsigned int idCount = 0;
-	idCount++;
+	unsigned int id = __atomic_add_fetch(&idCount, 1, __ATOMIC_RELAXED);
 	
 	std::stringstream ss;
-	ss << "generated-mesh-" << idCount;
+	ss << "generated-mesh-" << id;
 	return ss.str();
 }
 
 /* Compute height at given point on terrain grid using heightmap. */
-float getHeight(Image* image, int x, int y, float maxHeight)
+float getHeight(const Image* image, int x, int y, float maxHeight)
 {
     return image->get(x, y).r * maxHeight;
 }
 
-Shape* shapeloaders::getTerrainFromHeightmap(const std::string& filename,
-    float cellSize, float maxHeight, const Vector3& offset, Texture* texture,
-    bool useOctree)
+bool shapeloaders::buildTerrainGeometry(const std::string& filename, float cellSize,
+    float maxHeight, const Vector3& offset, TerrainGeometry& geometry)
 {
     Image* heightMap = tga::readTGAFile(filename);
-    if (heightMap)
+    bool success = buildTerrainGeometry(heightMap, cellSize, maxHeight, offset, geometry);
+    delete heightMap; // no longer need height map
+    return success;
+}
+
+bool shapeloaders::buildTerrainGeometry(const Image* heightMap, float cellSize,
+    float maxHeight, const Vector3& offset, TerrainGeometry& geometry)
+{
+    if (!heightMap)
+        return false;
+
+    int width = heightMap->getWidth();
+    int height = heightMap->getHeight();
+    // Keep track of minimum and maximum vertex positions for heightmap's bounding box
+    Vector3 minPoint(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vector3 maxPoint(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    // Construct mesh using heightmap's pixels as points on grid
+    VertexList& vertices = geometry.vertices;
+    vertices.clear();
+    vertices.reserve(width * height);
+    for (int y = 0; (y < height); y++)
     {
-        int width = heightMap->getWidth();
-        int height = heightMap->getHeight();
-        // Keep track of minimum and maximum vertex positions for heightmap's bounding box
-        Vector3 minPoint(FLT_MIN, FLT_MIN, FLT_MIN);
-        Vector3 maxPoint(FLT_MAX, FLT_MAX, FLT_MAX);
-        // Construct mesh using heightmap's pixels as points on grid
-        VertexList vertices;
-        vertices.reserve(width * height);
-        for (int y = 0; (y < height); y++)
+        for (int x = 0; (x < width); x++)
         {
-            for (int x = 0; (x < width); x++)
-            {
-                Vertex vert;
-                // Compute position of next point in terrain grid
-                float pointHeight = getHeight(heightMap, x, y, maxHeight);
-                vert.position = Vector3(x * cellSize, pointHeight, y * cellSize);
-                vert.position += offset;
-                // Update min and max points
-                if (vert.position.x < minPoint.x) minPoint.x = vert.position.x;
-                if (vert.position.y < minPoint.y) minPoint.y = vert.position.y;
-                if (vert.position.z < minPoint.z) minPoint.z = vert.position.z;
-                if (vert.position.x > maxPoint.x) maxPoint.x = vert.position.x;
-                if (vert.position.y > maxPoint.y) maxPoint.y = vert.position.y;
-                if (vert.position.z > maxPoint.z) maxPoint.z = vert.position.z;
-
-                // Vertices in mesh grid alternate having 0 and 1 for tex coords
-			    float texX = ((x % 2) != 0) ? 0.0f : 1.0f;
-			    float texY = ((y % 2) != 0) ? 0.0f : 1.0f;
-                vert.texCoord = Vector2(texX, texY);
-                // Compute normal vector using central differencing
-                float hLeft, hRight, hDown, hUp;
-                if (x > 0) hLeft = getHeight(heightMap, x - 1, y, maxHeight);
-                else hLeft = pointHeight;
-                if (x < (width - 1)) hRight = getHeight(heightMap, x + 1, y, maxHeight);
-                else hRight = pointHeight;
-                if (y > 0) hDown = getHeight(heightMap, x, y - 1, maxHeight);
-                else hDown = pointHeight;
-                if (y < (height - 1)) hUp = getHeight(heightMap, x, y + 1, maxHeight);
-                else hUp = pointHeight;
-                vert.normal = Vector3((hLeft - hRight), (hDown - hUp), 2.0f).normalise();
-
-                vertices.push_back(vert);
-            }
+            Vertex vert;
+            // Compute position of next point in terrain grid
+            float pointHeight = getHeight(heightMap, x, y, maxHeight);
+            vert.position = Vector3(x * cellSize, pointHeight, y * cellSize);
+            vert.position += offset;
+            // Update min and max points
+            if (vert.position.x < minPoint.x) minPoint.x = vert.position.x;
+            if (vert.position.y < minPoint.y) minPoint.y = vert.position.y;
+            if (vert.position.z < minPoint.z) minPoint.z = vert.position.z;
+            if (vert.position.x > maxPoint.x) maxPoint.x = vert.position.x;
+            if (vert.position.y > maxPoint.y) maxPoint.y = vert.position.y;
+            if (vert.position.z > maxPoint.z) maxPoint.z = vert.position.z;
+
+            // Vertices in mesh grid alternate having 0 and 1 for tex coords
+            float texX = ((x % 2) != 0) ? 0.0f : 1.0f;
+            float texY = ((y % 2) != 0) ? 0.0f : 1.0f;
+            vert.texCoord = Vector2(texX, texY);
+            // Compute normal vector using central differencing
+            float hLeft, hRight, hDown, hUp;
+            if (x > 0) hLeft = getHeight(heightMap, x - 1, y, maxHeight);
+            else hLeft = pointHeight;
+            if (x < (width - 1)) hRight = getHeight(heightMap, x + 1, y, maxHeight);
+            else hRight = pointHeight;
+            if (y > 0) hDown = getHeight(heightMap, x, y - 1, maxHeight);
+            else hDown = pointHeight;
+            if (y < (height - 1)) hUp = getHeight(heightMap, x, y + 1, maxHeight);
+            else hUp = pointHeight;
+            vert.normal = Vector3((hLeft - hRight), (hDown - hUp), 2.0f).normalise();
+
+            vertices.push_back(vert);
         }
-        delete heightMap; // no longer need height map
-
-        // Material only has ambient and diffuse (no specular or reflection!)
-        Material material(2.0f, 1.0f, 0.0f, 0.0f, Material::NO_REFLECTION,
-            Material::NO_REFRACTION, Colour(0.2f, 0.7f, 0.2f), texture);
-        // Construct mesh to hold the terrain's vertices
-        ResourceManager* resourceManager = ResourceManager::getInstance();
-        Mesh* mesh = resourceManager->createMesh(generateMeshID(), vertices, material);
-        // Create triangles to represent the terrain
-        ShapeList triangles;
-        triangles.reserve((width - 1) * (height - 1) * 2);
-        for (int x = 0; (x < width - 1); x++)
+    }
+
+    // Two triangles for each cell of the grid
+    std::vector<unsigned int>& triangles = geometry.triangles;
+    triangles.clear();
+    triangles.reserve((width - 1) * (height - 1) * 6);
+    for (int x = 0; (x < width - 1); x++)
+    {
+        for (int y = 0; (y < height - 1); y++)
         {
-            for (int y = 0; (y < height - 1); y++)
-            {
-                int offset = (y * width) + x;
-                Shape* tri1 = new MeshTriangle(mesh, offset, offset + height, offset + 1);
-                Shape* tri2 = new MeshTriangle(mesh, offset + height, offset + height + 1, offset + 1);
-                triangles.push_back(tri1);
-                triangles.push_back(tri2);
-            }
+            unsigned int offset = (y * width) + x;
+            unsigned int cell[6] = { offset, offset + height, offset + 1,
+                offset + height, offset + height + 1, offset + 1 };
+            triangles.insert(triangles.end(), cell, cell + 6);
         }
+    }
+    geometry.boundingBox = AABB(minPoint, maxPoint);
+    return true;
+}
+
+/* Create mesh holding the terrain's vertices and a triangle for each
+ * triangle of the terrain. Triangles are created in the arena if one is
+ * given. */
+static ShapeList createTerrainTriangles(const shapeloaders::TerrainGeometry& geometry,
+    Texture* texture, Arena* arena = NULL)
+{
+    // Material only has ambient and diffuse (no specular or reflection!)
+    Material material(2.0f, 1.0f, 0.0f, 0.0f, Material::NO_REFLECTION,
+        Material::NO_REFRACTION, Colour(0.2f, 0.7f, 0.2f), texture);
+    // Construct mesh to hold the terrain's vertices
+    ResourceManager* resourceManager = ResourceManager::getInstance();
+    Mesh* mesh = resourceManager->createMesh(generateMeshID(), geometry.vertices, material);
+    // Create triangles to represent the terrain
+    ShapeList triangles;
+    triangles.reserve(geometry.triangles.size() / 3);
+    for (unsigned int i = 0; (i + 2 < geometry.triangles.size()); i += 3)
+    {
+        if (arena)
+            triangles.push_back(new (*arena) MeshTriangle(mesh, geometry.triangles[i],
+                geometry.triangles[i + 1], geometry.triangles[i + 2]));
+        else
+            triangles.push_back(new MeshTriangle(mesh, geometry.triangles[i],
+                geometry.triangles[i + 1], geometry.triangles[i + 2]));
+    }
+    return triangles;
+}
 
-		// If flag to use an Octree to store the terrain was specified,
-		// then build the octree!
-	    AABB boundingBox(minPoint, maxPoint);
-		if (useOctree)
-		{
-		    Octree* octree = new Octree(boundingBox);
-		    for (unsigned int i = 0; (i < triangles.size()); i++)
-		        octree->insert(triangles[i]);
-		    return octree;
-		}
-		// Otherwise, just put all the triangles in a flat bounding shape
-		else
-		{
-			BoundingShape* terrain = new BoundingShape(triangles, boundingBox);
-			return terrain;
-		}
+/* Box around each triangle of the terrain, in the order createTerrainTriangles()
+ * creates them. */
+static std::vector<AABB> terrainTriangleBounds(
+    const shapeloaders::TerrainGeometry& geometry)
+{
+    std::vector<AABB> triangleBounds;
+    triangleBounds.reserve(geometry.triangles.size() / 3);
+    for (unsigned int i = 0; (i + 2 < geometry.triangles.size()); i += 3)
+    {
+        const Vector3& a = geometry.vertices[geometry.triangles[i]].position;
+        const Vector3& b = geometry.vertices[geometry.triangles[i + 1]].position;
+        const Vector3& c = geometry.vertices[geometry.triangles[i + 2]].position;
+        triangleBounds.push_back(AABB(
+            Vector3(std::min(a.x, std::min(b.x, c.x)), std::min(a.y, std::min(b.y, c.y)),
+                std::min(a.z, std::min(b.z, c.z))),
+            Vector3(std::max(a.x, std::max(b.x, c.x)), std::max(a.y, std::max(b.y, c.y)),
+                std::max(a.z, std::max(b.z, c.z)))));
     }
+    return triangleBounds;
+}
+
+Shape* shapeloaders::createTerrain(const TerrainGeometry& geometry, Texture* texture,
+    bool useOctree)
+{
+    ShapeList triangles = createTerrainTriangles(geometry, texture);
+    // If flag to use an Octree to store the terrain was specified,
+    // then build the octree!
+    if (useOctree)
+    {
+        Octree* octree = new Octree(geometry.boundingBox);
+        for (unsigned int i = 0; (i < triangles.size()); i++)
+            octree->insert(triangles[i]);
+        octree->fitBounds(triangles, terrainTriangleBounds(geometry));
+        return octree;
+    }
+    // Otherwise, just put all the triangles in a flat bounding shape
     else
     {
-        return NULL;
+        AABB boundingBox = geometry.boundingBox;
+        BoundingShape* terrain = new BoundingShape(triangles, boundingBox);
+        return terrain;
+    }
+}
+
+void shapeloaders::buildTerrainOctree(const TerrainGeometry& geometry,
+    std::vector<FlatOctreeNode>& nodes)
+{
+    // Triangles only need positions to be put in the octree, so use a
+    // temporary mesh rather than one owned by the resource manager. The
+    // triangles and octree nodes are freed all at once with the arena.
+    Mesh mesh(geometry.vertices, Material());
+    Arena arena;
+    ShapeList triangles;
+    triangles.reserve(geometry.triangles.size() / 3);
+    for (unsigned int i = 0; (i + 2 < geometry.triangles.size()); i += 3)
+    {
+        triangles.push_back(new (arena) MeshTriangle(&mesh, geometry.triangles[i],
+            geometry.triangles[i + 1], geometry.triangles[i + 2]));
     }
+    Octree* octree = new (arena) Octree(geometry.boundingBox, &arena);
+    for (unsigned int i = 0; (i < triangles.size()); i++)
+        octree->insert(triangles[i]);
+    octree->fitBounds(triangles, terrainTriangleBounds(geometry));
+    octree->flatten(triangles, nodes);
+}
+
+AABB shapeloaders::getTerrainBounds(int width, int height, float cellSize,
+    float maxHeight, const Vector3& offset)
+{
+    // Heights are between zero and the maximum height (see getHeight()). The
+    // box is grown slightly so rays grazing its edges are not missed.
+    Vector3 extent((width - 1) * cellSize, maxHeight, (height - 1) * cellSize);
+    Vector3 margin(cellSize * 0.01f, cellSize * 0.01f, cellSize * 0.01f);
+    return AABB(offset - margin, offset + extent + margin);
+}
+
+PrimitiveStore* shapeloaders::createTerrainPrimitives(const TerrainGeometry& geometry,
+    Texture* texture)
+{
+    // Triangles are kept together in one block, in the order they are
+    // created, which large terrains ask to be backed by huge pages
+    size_t numTriangles = geometry.triangles.size() / 3;
+    Arena* arena = new Arena(std::max(numTriangles * sizeof(MeshTriangle),
+        Arena::DEFAULT_BLOCK_SIZE), true);
+    ShapeList triangles = createTerrainTriangles(geometry, texture, arena);
+    return new PrimitiveStore(triangles, terrainTriangleBounds(geometry),
+        geometry.boundingBox, arena);
+}
+
+Shape* shapeloaders::getTerrainFromHeightmap(const std::string& filename,
+    float cellSize, float maxHeight, const Vector3& offset, Texture* texture,
+    bool useOctree)
+{
+    TerrainGeometry geometry;
+    if (!buildTerrainGeometry(filename, cellSize, maxHeight, offset, geometry))
+        return NULL;
+    return createTerrain(geometry, texture, useOctree);
 }
 
 /* Function here purely to make getSkyBox() code more readable. */
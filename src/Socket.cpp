@@ -0,0 +1,209 @@
+#include "Socket.h"
+#include "Common.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <cstdlib>
+
+using namespace raytracer;
+
+/* Fill in address structure for Unix domain socket path. */
+static bool makeUnixAddress(const std::string& path, sockaddr_un& address)
+{
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    return true;
+}
+
+int net::listenOnUnixSocket(const std::string& path)
+{
+    sockaddr_un address;
+    if (!makeUnixAddress(path, address))
+        return -1;
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return -1;
+    // Remove socket file left behind by previous run
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0)
+    {
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+int net::connectToUnixSocket(const std::string& path)
+{
+    sockaddr_un address;
+    if (!makeUnixAddress(path, address))
+        return -1;
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0)
+        return -1;
+    if (connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        close(connection);
+        return -1;
+    }
+    return connection;
+}
+
+int net::listenOnTcpPort(int port)
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0)
+        return -1;
+    // Allow port to be reused straight away after a restart
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0)
+    {
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+int net::connectToTcpHost(const std::string& host, int port)
+{
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = NULL;
+    std::string service = common::toString(port);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0)
+        return -1;
+    int connection = -1;
+    for (addrinfo* address = addresses; (address && connection < 0); address = address->ai_next)
+    {
+        connection = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (connection >= 0 && connect(connection, address->ai_addr, address->ai_addrlen) != 0)
+        {
+            close(connection);
+            connection = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (connection >= 0)
+    {
+        // Requests are small and sent one at a time, so don't delay them
+        int noDelay = 1;
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    }
+    return connection;
+}
+
+int net::connectToAddress(const std::string& address)
+{
+    if (address.find('/') != std::string::npos)
+        return connectToUnixSocket(address);
+    size_t separator = address.rfind(':');
+    if (separator == std::string::npos)
+        return -1;
+    return connectToTcpHost(address.substr(0, separator),
+        atoi(address.substr(separator + 1).c_str()));
+}
+
+int net::acceptConnection(int listener)
+{
+    while (true)
+    {
+        int connection = accept(listener, NULL, NULL);
+        if (connection >= 0 || errno != EINTR)
+            return connection;
+    }
+}
+
+void net::closeSocket(int socket)
+{
+    if (socket >= 0)
+        close(socket);
+}
+
+void net::shutdownSocket(int socket)
+{
+    if (socket >= 0)
+        shutdown(socket, SHUT_RDWR);
+}
+
+bool net::setReceiveTimeout(int socket, double seconds)
+{
+    timeval timeout;
+    timeout.tv_sec = static_cast<long>(seconds);
+    timeout.tv_usec = static_cast<long>((seconds - timeout.tv_sec) * 1000000);
+    return (setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0);
+}
+
+bool net::sendAll(int socket, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        // MSG_NOSIGNAL stops the process being killed if the peer has gone
+        ssize_t sent = send(socket, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool net::receiveAll(int socket, void* data, size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    while (size > 0)
+    {
+        ssize_t received = recv(socket, bytes, size, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+bool net::sendLine(int socket, const std::string& line)
+{
+    std::string data = line + "\n";
+    return sendAll(socket, data.c_str(), data.size());
+}
+
+bool net::receiveLine(int socket, std::string& line)
+{
+    // Lines are read one byte at a time so no binary data following
+    // the line is consumed by accident
+    line.clear();
+    char c = 0;
+    while (line.size() < MAX_LINE_LENGTH)
+    {
+        if (!receiveAll(socket, &c, 1))
+            return false;
+        if (c == '\n')
+            return true;
+        line += c;
+    }
+    return false;
+}
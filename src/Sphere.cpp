@@ -1,4 +1,6 @@
 #include "Sphere.h"
+#include "Profiling.h"
+#include "RayCost.h"
 #include <cmath>
 
 using namespace raytracer;
@@ -14,8 +16,31 @@ const Vector3& Sphere::getCentre() const
     return centre;
 }
 
+void Sphere::setCentre(const Vector3& newCentre)
+{
+    centre = newCentre;
+}
+
+float Sphere::getRadius() const
+{
+    return radius;
+}
+
+void Sphere::setRadius(float newRadius)
+{
+    radius = newRadius;
+}
+
+AABB Sphere::getBoundingBox() const
+{
+    Vector3 extent(radius, radius, radius);
+    return AABB(centre - extent, centre + extent);
+}
+
 bool Sphere::hit(const Ray& ray, float tMin, float tMax, float /*time*/, HitRecord& record) const
 {
+    PROFILE_STAGE(PRIMITIVE_TESTS);
+    raycost::countPrimitiveTest();
     Vector3 temp = ray.origin() - centre;
 
     // Solve quadratic equation to check for intersection
@@ -61,6 +86,8 @@ bool Sphere::hit(const Ray& ray, float tMin, float tMax, float /*time*/, HitReco
 bool Sphere::shadowHit(const Ray& ray, float tMin, float tMax,
     float /*time*/, const Shape*& occludingShape) const
 {
+    PROFILE_STAGE(PRIMITIVE_TESTS);
+    raycost::countPrimitiveTest();
     Vector3 temp = ray.origin() - centre;
 
     double a = ray.direction().dot(ray.direction());
@@ -2,6 +2,7 @@
 #include <fstream>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 
 using namespace raytracer;
 
@@ -229,39 +230,203 @@ Image* tga::readTGAFile(const std::string& filename)
     return image;
 }
 
-void tga::writeTGAFile(const std::string& filename, const Image& image)
+/* Size of the buffer encoded pixel data is collected in before being
+ * written to the file. Writing in large blocks avoids the overhead of
+ * many small writes. */
+static const unsigned int WRITE_BUFFER_SIZE = 1 << 20;
+/* Number of rows encoded at a time when writing a full image. */
+static const int WRITE_BAND_HEIGHT = 64;
+/* Maximum number of pixels a single RLE or raw packet can hold. */
+static const int MAX_PACKET_LENGTH = 128;
+
+/* Convert colour to 8-bit TGA colour, clamping each component first
+ * so over-exposed pixels saturate instead of wrapping around. */
+static TGAColour toClampedTGAColour(const Colour& colour)
+{
+    Colour clamped = colour;
+    clamped.clamp();
+    return toTGAColour(clamped);
+}
+
+inline bool sameTGAColour(const TGAColour& a, const TGAColour& b)
 {
-    std::ofstream imageFile(filename.c_str(), std::ios::out | std::ios::binary);
-    // Write TGA header and write it
- 	imageFile.put(0);
-   	imageFile.put(0);
-   	// Data format (uncompressed RGB)
-   	imageFile.put(2);
-   	imageFile.put(0); imageFile.put(0);
-   	imageFile.put(0); imageFile.put(0);
-   	imageFile.put(0);
-   	// X and Y origin
-   	imageFile.put(0); 	imageFile.put(0);
-   	imageFile.put(0); 	imageFile.put(0);
-   	// Image dimensions
-   	int width = image.getWidth();
-   	int height = image.getHeight();
-   	imageFile.put((width & 0x00FF));
-   	imageFile.put((width & 0xFF00) / 256);
-   	imageFile.put((height & 0x00FF));
-   	imageFile.put((height & 0xFF00) / 256);
-   	// 24 bits per pixel
-   	imageFile.put(24);
-   	imageFile.put(topLeft);
-
-    // Write uncompressed RGB pixel data
-    TGAColour temp;
-    for (int y = 0; (y < height); y++)
+    return (a.b == b.b && a.g == b.g && a.r == b.r);
+}
+
+inline void appendTGAColour(std::vector<unsigned char>& buffer, const TGAColour& colour)
+{
+    buffer.push_back(colour.b);
+    buffer.push_back(colour.g);
+    buffer.push_back(colour.r);
+}
+
+/* Encode row 'y' of the given image and append it to 'buffer'. Packets
+ * never cross scanlines, as recommended by the TGA specification. */
+static void encodeRow(const Image& image, int y, bool compress,
+    std::vector<TGAColour>& row, std::vector<unsigned char>& buffer)
+{
+    int width = image.getWidth();
+    for (int x = 0; (x < width); x++)
+        row[x] = toClampedTGAColour(image.get(x, y));
+
+    if (!compress)
     {
         for (int x = 0; (x < width); x++)
+            appendTGAColour(buffer, row[x]);
+        return;
+    }
+
+    int x = 0;
+    while (x < width)
+    {
+        // Count how many times the current pixel is repeated
+        int runLength = 1;
+        while (x + runLength < width && runLength < MAX_PACKET_LENGTH &&
+            sameTGAColour(row[x + runLength], row[x]))
         {
-            temp = toTGAColour(image.get(x, y));
-            imageFile.write(reinterpret_cast<char*>(&temp), sizeof(TGAColour));
+            runLength++;
         }
+        if (runLength > 1)
+        {
+            // Run-length packet (high bit set, followed by one colour)
+            buffer.push_back(static_cast<unsigned char>(0x80 | (runLength - 1)));
+            appendTGAColour(buffer, row[x]);
+            x += runLength;
+        }
+        else
+        {
+            // Raw packet containing every pixel up to the start of the next run
+            int rawLength = 1;
+            while (x + rawLength < width && rawLength < MAX_PACKET_LENGTH)
+            {
+                if (x + rawLength + 1 < width &&
+                    sameTGAColour(row[x + rawLength], row[x + rawLength + 1]))
+                {
+                    break;
+                }
+                rawLength++;
+            }
+            buffer.push_back(static_cast<unsigned char>(rawLength - 1));
+            for (int i = 0; (i < rawLength); i++)
+                appendTGAColour(buffer, row[x + i]);
+            x += rawLength;
+        }
+    }
+}
+
+bool tga::writeTGAFile(const std::string& filename, const Image& image,
+    bool compress)
+{
+    StreamWriter writer;
+    if (!writer.open(filename, image.getWidth(), image.getHeight(), compress))
+        return false;
+    // Encode image in bands so the encoding buffer stays small
+    int height = image.getHeight();
+    for (int y = 0; (y < height); y += WRITE_BAND_HEIGHT)
+    {
+        int rows = std::min(WRITE_BAND_HEIGHT, height - y);
+        if (!writer.writeRows(image, y, rows))
+            return false;
+    }
+    return writer.close();
+}
+
+tga::StreamWriter::StreamWriter() : width(0), height(0), compress(false),
+    numRowsWritten(0)
+{
+}
+
+tga::StreamWriter::~StreamWriter()
+{
+    close();
+}
+
+bool tga::StreamWriter::open(const std::string& filename, int width,
+    int height, bool compress)
+{
+    close();
+    // TGA stores dimensions as 16-bit values
+    if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF)
+        return false;
+    file.open(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    this->width = width;
+    this->height = height;
+    this->compress = compress;
+    numRowsWritten = 0;
+    buffer.clear();
+    buffer.reserve(WRITE_BUFFER_SIZE + (width * 4));
+
+    // Construct TGA header and write it in one go
+    unsigned char header[18];
+    memset(header, 0, sizeof(header));
+    // Data format (uncompressed or RLE compressed RGB)
+    header[2] = (compress) ? TGA_CompressedTrueColour : TGA_TrueColour;
+    // Image dimensions (X and Y origin are left as zero)
+    header[12] = (width & 0x00FF);
+    header[13] = (width & 0xFF00) / 256;
+    header[14] = (height & 0x00FF);
+    header[15] = (height & 0xFF00) / 256;
+    // 24 bits per pixel, first row in file is top of the image
+    header[16] = 24;
+    header[17] = topLeft;
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    return file.good();
+}
+
+bool tga::StreamWriter::writeRows(const Image& band, int firstRow, int numRows)
+{
+    if (!file.is_open() || band.getWidth() != width)
+        return false;
+    if (firstRow < 0 || firstRow + numRows > band.getHeight())
+        return false;
+    // Never write more rows than the header says the image has
+    numRows = std::min(numRows, height - numRowsWritten);
+
+    std::vector<TGAColour> row(width);
+    for (int y = firstRow; (y < firstRow + numRows); y++)
+    {
+        encodeRow(band, y, compress, row, buffer);
+        if (buffer.size() >= WRITE_BUFFER_SIZE && !flushBuffer())
+            return false;
+    }
+    numRowsWritten += numRows;
+    return flushBuffer();
+}
+
+bool tga::StreamWriter::close()
+{
+    if (!file.is_open())
+        return true;
+    // Pad out any rows which were never written with black
+    if (numRowsWritten < height)
+    {
+        Image blankRow(width, 1);
+        while (numRowsWritten < height)
+            writeRows(blankRow, 0, 1);
+    }
+    bool success = flushBuffer();
+    file.close();
+    return success;
+}
+
+bool tga::StreamWriter::isOpen() const
+{
+    return file.is_open();
+}
+
+int tga::StreamWriter::rowsWritten() const
+{
+    return numRowsWritten;
+}
+
+bool tga::StreamWriter::flushBuffer()
+{
+    if (!buffer.empty())
+    {
+        file.write(reinterpret_cast<const char*>(&buffer[0]), buffer.size());
+        buffer.clear();
     }
+    return file.good();
 }
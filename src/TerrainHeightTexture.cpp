@@ -17,17 +17,35 @@ TerrainHeightTexture::TerrainHeightTexture(Image* lowTex, Image* medTex,
 		imageWeights[i] = weight;
 }
 
-const Colour& TerrainHeightTexture::getTexel(float u, float v) const
+Colour TerrainHeightTexture::getTexel(float u, float v) const
 {
-	// Compute which pixel to make from each texture
-    int width = sourceImages[0]->getWidth();
-    int height = sourceImages[0]->getHeight();	
-    int pixelX = static_cast<int>(u * width) % width;
-    int pixelY = static_cast<int>(v * height) % height;	
-	// Retrieve weighted colours from each image, summing them together
+	return blendTexels(u, v, imageWeights);
+}
+
+Colour TerrainHeightTexture::getTexelAtHeight(float u, float v, float height) const
+{
+	float weights[NUM_TEXTURES];
+	computeWeights(height, weights);
+	return blendTexels(u, v, weights);
+}
+
+Colour TerrainHeightTexture::blendTexels(float u, float v,
+	const float weights[NUM_TEXTURES]) const
+{
+	// Retrieve weighted colours from each image, summing them together.
+	// Images which failed to load are skipped.
 	Colour sum;
 	for (unsigned int i = 0; (i < NUM_TEXTURES); i++)
-		sum += imageWeights[i] * sourceImages[i]->get(pixelX, pixelY);
+	{
+		if (!sourceImages[i])
+			continue;
+		// Compute which pixel to take from the texture
+		int width = sourceImages[i]->getWidth();
+		int height = sourceImages[i]->getHeight();
+		int pixelX = static_cast<int>(u * width) % width;
+		int pixelY = static_cast<int>(v * height) % height;
+		sum += weights[i] * sourceImages[i]->get(pixelX, pixelY);
+	}
 	return sum;
 }
 
@@ -39,16 +57,21 @@ float saturate(float val)
 }
 
 void TerrainHeightTexture::updateWeights(float height)
+{
+	computeWeights(height, imageWeights);
+}
+
+void TerrainHeightTexture::computeWeights(float height, float weights[NUM_TEXTURES])
 {
 	// Compute weights of each image based on height
-	imageWeights[0] = saturate(1.0f - fabs(height - 0.0f) / 0.2f);
-	imageWeights[1] = saturate(1.0f - fabs(height - 0.3f) / 0.25f);
-	imageWeights[2] = saturate(1.0f - fabs(height - 0.6f) / 0.25f);
-	imageWeights[3] = saturate(1.0f - fabs(height - 0.9f) / 0.25f);
+	weights[0] = saturate(1.0f - fabs(height - 0.0f) / 0.2f);
+	weights[1] = saturate(1.0f - fabs(height - 0.3f) / 0.25f);
+	weights[2] = saturate(1.0f - fabs(height - 0.6f) / 0.25f);
+	weights[3] = saturate(1.0f - fabs(height - 0.9f) / 0.25f);
 	// Normalise weightings so they all sum up to 1
 	float totalWeight = 0.0f;
 	for (unsigned int i = 0; (i < NUM_TEXTURES); i++)
-		totalWeight += imageWeights[i];
+		totalWeight += weights[i];
 	for (unsigned int i = 0; (i < NUM_TEXTURES); i++)
-		imageWeights[i] /= totalWeight;
+		weights[i] /= totalWeight;
 }
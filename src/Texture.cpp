@@ -6,7 +6,7 @@ ImageTexture::ImageTexture(Image* sourceImage) : sourceImage(sourceImage)
 {
 }
 
-const Colour& ImageTexture::getTexel(float u, float v) const
+Colour ImageTexture::getTexel(float u, float v) const
 {
     // Convert UV coordinates into pixel coordinates on source image
     int width = sourceImage->getWidth();
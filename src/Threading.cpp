@@ -0,0 +1,239 @@
+#include "Threading.h"
+#include "Tracing.h"
+#include <unistd.h>
+#include <sys/time.h>
+
+using namespace raytracer;
+using namespace raytracer::threading;
+
+Mutex::Mutex()
+{
+    pthread_mutex_init(&mutex, NULL);
+}
+
+Mutex::~Mutex()
+{
+    pthread_mutex_destroy(&mutex);
+}
+
+void Mutex::lock()
+{
+    pthread_mutex_lock(&mutex);
+}
+
+void Mutex::unlock()
+{
+    pthread_mutex_unlock(&mutex);
+}
+
+Condition::Condition()
+{
+    pthread_cond_init(&condition, NULL);
+}
+
+Condition::~Condition()
+{
+    pthread_cond_destroy(&condition);
+}
+
+void Condition::wait(Mutex& mutex)
+{
+    pthread_cond_wait(&condition, &mutex.mutex);
+}
+
+bool Condition::waitFor(Mutex& mutex, double seconds)
+{
+    timeval now;
+    gettimeofday(&now, NULL);
+    long wholeSeconds = static_cast<long>(seconds);
+    long nanoseconds = (now.tv_usec * 1000L) +
+        static_cast<long>((seconds - wholeSeconds) * 1e9);
+    timespec deadline;
+    deadline.tv_sec = now.tv_sec + wholeSeconds + (nanoseconds / 1000000000L);
+    deadline.tv_nsec = nanoseconds % 1000000000L;
+    return (pthread_cond_timedwait(&condition, &mutex.mutex, &deadline) == 0);
+}
+
+void Condition::signal()
+{
+    pthread_cond_signal(&condition);
+}
+
+void Condition::broadcast()
+{
+    pthread_cond_broadcast(&condition);
+}
+
+/* Entry point of threads started by runDetached(). */
+static void* runDetachedTask(void* taskPointer)
+{
+    Task* task = static_cast<Task*>(taskPointer);
+    task->run();
+    delete task;
+    return NULL;
+}
+
+bool threading::runDetached(Task* task)
+{
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, runDetachedTask, task) != 0)
+        return false;
+    pthread_detach(thread);
+    return true;
+}
+
+unsigned int threading::numProcessors()
+{
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return (processors > 0) ? static_cast<unsigned int>(processors) : 1;
+}
+
+ThreadPool::ThreadPool(unsigned int numThreads, const char* threadName) :
+    stopping(false), threadName(threadName)
+{
+    if (numThreads == 0)
+        numThreads = numProcessors();
+    threads.reserve(numThreads);
+    for (unsigned int i = 0; (i < numThreads); i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, workerMain, this) == 0)
+            threads.push_back(thread);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    mutex.lock();
+    stopping = true;
+    tasksAvailable.broadcast();
+    mutex.unlock();
+    for (unsigned int i = 0; (i < threads.size()); i++)
+        pthread_join(threads[i], NULL);
+}
+
+void ThreadPool::addTask(Task* task)
+{
+    ScopedLock lock(mutex);
+    tasks.push_back(task);
+    tasksAvailable.signal();
+}
+
+unsigned int ThreadPool::numThreads() const
+{
+    return threads.size();
+}
+
+void* ThreadPool::workerMain(void* poolPointer)
+{
+    ThreadPool* pool = static_cast<ThreadPool*>(poolPointer);
+    tracing::setThreadName(pool->threadName);
+    while (true)
+    {
+        Task* task = NULL;
+        pool->mutex.lock();
+        while (pool->tasks.empty() && !pool->stopping)
+            pool->tasksAvailable.wait(pool->mutex);
+        // Only stop once every queued task has been run
+        if (pool->tasks.empty())
+        {
+            pool->mutex.unlock();
+            break;
+        }
+        task = pool->tasks.front();
+        pool->tasks.pop_front();
+        pool->mutex.unlock();
+
+        task->run();
+        delete task;
+    }
+    return NULL;
+}
+
+/* Runs a task of a graph, then lets the graph know it has finished. */
+class TaskGraph::GraphTask : public Task
+{
+
+public:
+    GraphTask(TaskGraph* graph, Handle handle, Task* task) :
+        graph(graph), handle(handle), task(task)
+    {
+    }
+
+    virtual void run()
+    {
+        task->run();
+        delete task;
+        graph->taskFinished(handle);
+    }
+
+private:
+    TaskGraph* graph;
+    Handle handle;
+    Task* task;
+
+};
+
+TaskGraph::TaskGraph(unsigned int numThreads) : numUnfinished(0), pool(numThreads)
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+    waitAll();
+}
+
+TaskGraph::Handle TaskGraph::addTask(Task* task, const std::vector<Handle>& dependencies)
+{
+    ScopedLock lock(mutex);
+    Handle handle = nodes.size();
+    Node node;
+    node.task = task;
+    node.unfinishedDependencies = 0;
+    node.finished = false;
+    nodes.push_back(node);
+    numUnfinished++;
+    for (unsigned int i = 0; (i < dependencies.size()); i++)
+    {
+        Node& dependency = nodes[dependencies[i]];
+        if (!dependency.finished)
+        {
+            dependency.dependents.push_back(handle);
+            nodes[handle].unfinishedDependencies++;
+        }
+    }
+    if (nodes[handle].unfinishedDependencies == 0)
+        pool.addTask(new GraphTask(this, handle, task));
+    return handle;
+}
+
+void TaskGraph::wait(Handle handle)
+{
+    ScopedLock lock(mutex);
+    while (!nodes[handle].finished)
+        taskFinishedCondition.wait(mutex);
+}
+
+void TaskGraph::waitAll()
+{
+    ScopedLock lock(mutex);
+    while (numUnfinished > 0)
+        taskFinishedCondition.wait(mutex);
+}
+
+void TaskGraph::taskFinished(Handle handle)
+{
+    ScopedLock lock(mutex);
+    Node& node = nodes[handle];
+    node.finished = true;
+    numUnfinished--;
+    // Queue tasks which were only waiting for this one
+    for (unsigned int i = 0; (i < node.dependents.size()); i++)
+    {
+        Node& dependent = nodes[node.dependents[i]];
+        dependent.unfinishedDependencies--;
+        if (dependent.unfinishedDependencies == 0)
+            pool.addTask(new GraphTask(this, node.dependents[i], dependent.task));
+    }
+    taskFinishedCondition.broadcast();
+}
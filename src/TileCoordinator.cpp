@@ -0,0 +1,304 @@
+#include "TileCoordinator.h"
+#include "RenderProtocol.h"
+#include "Threading.h"
+#include "Socket.h"
+#include "Image.h"
+#include "Common.h"
+#include "Tracing.h"
+#include <deque>
+#include <algorithm>
+#include <cstdio>
+
+using namespace raytracer;
+using namespace raytracer::threading;
+
+const double TileCoordinator::DEFAULT_TILE_TIMEOUT = 120.0;
+
+/* A tile is considered to be taking too long, and given to an idle worker
+ * as well, once it has taken this many times longer than expected. */
+static const double STRAGGLER_FACTOR = 3.0;
+/* Tiles are never reissued for being slow before this many seconds. */
+static const double MIN_STRAGGLER_SECONDS = 0.5;
+/* How often idle workers check for slow tiles. */
+static const double IDLE_POLL_SECONDS = 0.05;
+
+TileCoordinator::Statistics::Statistics() : tilesRendered(0), tilesReissued(0),
+    workersFailed(0), primaryRays(0), reflectedRays(0), refractedRays(0), shadowRays(0)
+{
+}
+
+/* Progress of a render, shared by every worker thread. */
+struct TileCoordinator::RenderState
+{
+    struct TileState
+    {
+        Tile tile;
+        bool finished;
+        unsigned int workersRendering;
+        double startTime; // when the tile was first handed out
+        double seconds; // how long the tile took to render
+    };
+
+    const RenderSettings* settings;
+    Framebuffer* target;
+    std::vector<TileState> tiles;
+
+    Mutex mutex;
+    // Signalled whenever a tile finishes or a worker fails
+    Condition changed;
+    // Indices of tiles not yet handed out to any worker
+    std::deque<unsigned int> pending;
+    unsigned int tilesLeft;
+    // Average seconds taken to render one pixel, over finished tiles
+    double secondsPerPixel;
+    unsigned int pixelsMeasured;
+    // Connections to workers, so they can be stopped once done
+    std::vector<int> connections;
+    Statistics statistics;
+};
+
+class TileCoordinator::WorkerTask : public Task
+{
+
+public:
+    WorkerTask(TileCoordinator* coordinator, RenderState* state, unsigned int workerIndex) :
+        coordinator(coordinator), state(state), workerIndex(workerIndex)
+    {
+    }
+
+    virtual void run()
+    {
+        coordinator->runWorker(state, workerIndex);
+    }
+
+private:
+    TileCoordinator* coordinator;
+    RenderState* state;
+    unsigned int workerIndex;
+
+};
+
+TileCoordinator::TileCoordinator(const std::vector<std::string>& workerAddresses,
+    int tileSize) : workerAddresses(workerAddresses), tileSize(tileSize),
+    tileTimeout(DEFAULT_TILE_TIMEOUT)
+{
+}
+
+void TileCoordinator::setTileTimeout(double seconds)
+{
+    tileTimeout = seconds;
+}
+
+const TileCoordinator::Statistics& TileCoordinator::lastRenderStatistics() const
+{
+    return statistics;
+}
+
+/* Orders tile indices from the most to the least expensive. */
+struct MoreExpensiveTile
+{
+    const std::vector<double>* costs;
+
+    bool operator()(unsigned int a, unsigned int b) const
+    {
+        return (*costs)[a] > (*costs)[b];
+    }
+};
+
+bool TileCoordinator::render(const RenderSettings& settings, Framebuffer* target)
+{
+    RenderState state;
+    state.settings = &settings;
+    state.target = target;
+    state.secondsPerPixel = 0;
+    state.pixelsMeasured = 0;
+    state.statistics.tilesPerWorker.resize(workerAddresses.size(), 0);
+    state.connections.resize(workerAddresses.size(), -1);
+
+    TileList tiles = splitIntoTiles(Tile(0, 0, settings.width, settings.height), tileSize);
+    state.tiles.resize(tiles.size());
+    for (unsigned int i = 0; (i < tiles.size()); i++)
+    {
+        state.tiles[i].tile = tiles[i];
+        state.tiles[i].finished = false;
+        state.tiles[i].workersRendering = 0;
+        state.tiles[i].startTime = 0;
+        state.tiles[i].seconds = 0;
+        state.pending.push_back(i);
+    }
+    state.tilesLeft = tiles.size();
+    // If an image of this size has been rendered before, hand out the tiles
+    // which took longest first so they don't hold up the end of the render
+    std::pair<int, int> imageSize(settings.width, settings.height);
+    std::map<std::pair<int, int>, std::vector<double> >::iterator costs = tileCosts.find(imageSize);
+    if (costs != tileCosts.end() && costs->second.size() == tiles.size())
+    {
+        MoreExpensiveTile order;
+        order.costs = &costs->second;
+        std::stable_sort(state.pending.begin(), state.pending.end(), order);
+    }
+
+    if (!workerAddresses.empty())
+    {
+        // Destroying the pool waits for every worker to finish
+        ThreadPool pool(workerAddresses.size(), "worker connection");
+        for (unsigned int i = 0; (i < workerAddresses.size()); i++)
+            pool.addTask(new WorkerTask(this, &state, i));
+    }
+
+    statistics = state.statistics;
+    if (state.tilesLeft > 0)
+        return false;
+    std::vector<double>& measuredCosts = tileCosts[imageSize];
+    measuredCosts.resize(tiles.size());
+    for (unsigned int i = 0; (i < tiles.size()); i++)
+        measuredCosts[i] = state.tiles[i].seconds;
+    return true;
+}
+
+/* Send request for one tile to a worker and receive the result into
+ * 'image'. Returns false if the worker failed. */
+static bool requestTile(int connection, const RenderSettings& settings, const Tile& tile,
+    Image& image, protocol::RenderSummary& summary)
+{
+    protocol::RenderRequest request;
+    request.settings = settings;
+    request.region = tile;
+    request.tileSize = std::max(tile.width, tile.height);
+    std::string line;
+    int numTiles = 0;
+    Tile received;
+    return net::sendLine(connection, protocol::formatRenderRequest(request)) &&
+        net::receiveLine(connection, line) &&
+        sscanf(line.c_str(), "OK %d", &numTiles) == 1 && numTiles == 1 &&
+        net::receiveLine(connection, line) &&
+        protocol::parseTileHeader(line, received) &&
+        received.x == tile.x && received.y == tile.y &&
+        received.width == tile.width && received.height == tile.height &&
+        protocol::receiveTilePixels(connection, tile, &image, tile.x, tile.y) &&
+        net::receiveLine(connection, line) &&
+        protocol::parseRenderSummary(line, summary);
+}
+
+void TileCoordinator::runWorker(RenderState* state, unsigned int workerIndex)
+{
+    int connection = net::connectToAddress(workerAddresses[workerIndex]);
+    bool working = (connection >= 0) && net::setReceiveTimeout(connection, tileTimeout);
+    state->mutex.lock();
+    state->connections[workerIndex] = connection;
+    state->mutex.unlock();
+
+    while (working)
+    {
+        // Pick tile to render next
+        state->mutex.lock();
+        int tileIndex = -1;
+        while (tileIndex < 0 && state->tilesLeft > 0)
+        {
+            while (!state->pending.empty() && tileIndex < 0)
+            {
+                unsigned int index = state->pending.front();
+                state->pending.pop_front();
+                if (!state->tiles[index].finished)
+                    tileIndex = index;
+            }
+            if (tileIndex >= 0)
+                break;
+            // Nothing left to hand out, so help with the slowest tile if
+            // it is taking much longer than it should
+            double now = common::wallClockSeconds();
+            double slowest = 0;
+            for (unsigned int i = 0; (i < state->tiles.size()); i++)
+            {
+                const RenderState::TileState& tile = state->tiles[i];
+                if (tile.finished || tile.workersRendering != 1 || state->pixelsMeasured == 0)
+                    continue;
+                double expected = state->secondsPerPixel * tile.tile.area();
+                double elapsed = now - tile.startTime;
+                if (elapsed > std::max(STRAGGLER_FACTOR * expected, MIN_STRAGGLER_SECONDS) &&
+                    elapsed > slowest)
+                {
+                    slowest = elapsed;
+                    tileIndex = i;
+                }
+            }
+            if (tileIndex >= 0)
+                state->statistics.tilesReissued++;
+            else
+                state->changed.waitFor(state->mutex, IDLE_POLL_SECONDS);
+        }
+        if (tileIndex < 0)
+        {
+            state->mutex.unlock();
+            break;
+        }
+        RenderState::TileState& tileState = state->tiles[tileIndex];
+        if (tileState.workersRendering == 0)
+            tileState.startTime = common::wallClockSeconds();
+        tileState.workersRendering++;
+        Tile tile = tileState.tile;
+        state->mutex.unlock();
+
+        // Render it
+        double start = common::wallClockSeconds();
+        Image image(tile.width, tile.height);
+        protocol::RenderSummary summary;
+        {
+            tracing::ScopedEvent event("remote tile", tile.x, tile.y);
+            working = requestTile(connection, *state->settings, tile, image, summary);
+        }
+        double seconds = common::wallClockSeconds() - start;
+
+        state->mutex.lock();
+        tileState.workersRendering--;
+        if (!working)
+        {
+            // Let another worker have the tile, unless one already is
+            if (!tileState.finished && tileState.workersRendering == 0)
+            {
+                state->pending.push_front(tileIndex);
+                if (state->tilesLeft > 0)
+                    state->statistics.tilesReissued++;
+            }
+        }
+        else if (!tileState.finished)
+        {
+            for (int y = 0; (y < tile.height); y++)
+                for (int x = 0; (x < tile.width); x++)
+                    state->target->set(tile.x + x, tile.y + y, image.get(x, y));
+            tileState.finished = true;
+            tileState.seconds = seconds;
+            state->tilesLeft--;
+            state->secondsPerPixel = ((state->secondsPerPixel * state->pixelsMeasured) + seconds)
+                / (state->pixelsMeasured + tile.area());
+            state->pixelsMeasured += tile.area();
+
+            Statistics& statistics = state->statistics;
+            statistics.tilesRendered++;
+            statistics.tilesPerWorker[workerIndex]++;
+            statistics.primaryRays += summary.primaryRays;
+            statistics.reflectedRays += summary.reflectedRays;
+            statistics.refractedRays += summary.refractedRays;
+            statistics.shadowRays += summary.shadowRays;
+
+            // Render is finished, so stop workers still rendering copies of tiles
+            if (state->tilesLeft == 0)
+                for (unsigned int i = 0; (i < state->connections.size()); i++)
+                    if (i != workerIndex)
+                        net::shutdownSocket(state->connections[i]);
+        }
+        state->changed.broadcast();
+        state->mutex.unlock();
+    }
+
+    ScopedLock lock(state->mutex);
+    if (state->tilesLeft > 0)
+    {
+        state->statistics.workersFailed++;
+        fprintf(stderr, "Worker %s failed\n", workerAddresses[workerIndex].c_str());
+    }
+    state->connections[workerIndex] = -1;
+    net::closeSocket(connection);
+    // Wake idle workers, which may now need to take over this worker's tile
+    state->changed.broadcast();
+}
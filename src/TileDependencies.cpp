@@ -0,0 +1,279 @@
+#include "TileDependencies.h"
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace raytracer;
+
+const float TileDependencies::DEFAULT_CELL_SIZE = 2.0f;
+
+/* Fraction of a cell regions are grown by when finding affected tiles,
+ * so rays which just graze a cell boundary are not missed due to
+ * floating point error. */
+static const float REGION_MARGIN = 0.01f;
+
+/* Mixes bits of a cell's hash (MurmurHash3 finaliser). */
+static unsigned int mixBits(unsigned int hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/* Records rays cast by a raytracer against one tile. */
+class TileRecorder : public RayObserver
+{
+
+public:
+    TileRecorder(TileDependencies* dependencies, unsigned int tileIndex) :
+        dependencies(dependencies), tileIndex(tileIndex)
+    {
+    }
+
+    virtual void raySegment(const Vector3& start, const Vector3& end, bool shadowRay)
+    {
+        dependencies->recordSegment(tileIndex, start, end, shadowRay);
+    }
+
+private:
+    TileDependencies* dependencies;
+    unsigned int tileIndex;
+
+};
+
+TileDependencies::TileDependencies(const AABB& bounds, float cellSize,
+    unsigned int filterBits) : bounds(bounds), cellSize(cellSize),
+    filterBits(filterBits), wordsPerFilter((filterBits + 31) / 32)
+{
+    settings.width = 0;
+    settings.height = 0;
+}
+
+void TileDependencies::reset(const RenderSettings& newSettings, int tileSize)
+{
+    settings = newSettings;
+    tiles = splitIntoTiles(Tile(0, 0, settings.width, settings.height), tileSize);
+    filters.assign(tiles.size() * 2 * wordsPerFilter, 0);
+}
+
+const RenderSettings& TileDependencies::getSettings() const
+{
+    return settings;
+}
+
+const TileList& TileDependencies::getTiles() const
+{
+    return tiles;
+}
+
+void TileDependencies::clearTile(unsigned int tileIndex)
+{
+    std::fill(filters.begin() + (tileIndex * 2 * wordsPerFilter),
+        filters.begin() + ((tileIndex + 1) * 2 * wordsPerFilter), 0);
+}
+
+bool TileDependencies::clipToBounds(Vector3& start, Vector3& end) const
+{
+    float start3[3] = { start.x, start.y, start.z };
+    float end3[3] = { end.x, end.y, end.z };
+    float min3[3] = { bounds.bounds[0].x, bounds.bounds[0].y, bounds.bounds[0].z };
+    float max3[3] = { bounds.bounds[1].x, bounds.bounds[1].y, bounds.bounds[1].z };
+    // Fractions of the way along the segment it enters and leaves the bounds
+    float tMin = 0.0f;
+    float tMax = 1.0f;
+    for (int axis = 0; (axis < 3); axis++)
+    {
+        float delta = end3[axis] - start3[axis];
+        if (delta == 0.0f)
+        {
+            if (start3[axis] < min3[axis] || start3[axis] > max3[axis])
+                return false;
+            continue;
+        }
+        float t0 = (min3[axis] - start3[axis]) / delta;
+        float t1 = (max3[axis] - start3[axis]) / delta;
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+        if (tMin > tMax)
+            return false;
+    }
+    Vector3 direction = end - start;
+    end = start + (direction * tMax);
+    start = start + (direction * tMin);
+    return true;
+}
+
+int TileDependencies::cellCoordinate(float position, float boundsMin) const
+{
+    int cell = static_cast<int>(floor((position - boundsMin) / cellSize));
+    return std::max(cell, 0);
+}
+
+void TileDependencies::cellBits(int x, int y, int z, unsigned int& first,
+    unsigned int& second) const
+{
+    unsigned int hash = (static_cast<unsigned int>(x) * 73856093u) ^
+        (static_cast<unsigned int>(y) * 19349663u) ^
+        (static_cast<unsigned int>(z) * 83492791u);
+    first = mixBits(hash) & (filterBits - 1);
+    second = mixBits(hash ^ 0x9e3779b9u) & (filterBits - 1);
+}
+
+/* Walks through every cell a segment crosses (Amanatides & Woo). */
+void TileDependencies::recordSegment(unsigned int tileIndex, const Vector3& start,
+    const Vector3& end, bool shadowRay)
+{
+    Vector3 clippedStart = start;
+    Vector3 clippedEnd = end;
+    if (!clipToBounds(clippedStart, clippedEnd))
+        return;
+
+    float start3[3] = { clippedStart.x, clippedStart.y, clippedStart.z };
+    float end3[3] = { clippedEnd.x, clippedEnd.y, clippedEnd.z };
+    float min3[3] = { bounds.bounds[0].x, bounds.bounds[0].y, bounds.bounds[0].z };
+    int cell[3];
+    int step[3];
+    int remaining[3]; // cells still to cross along each axis
+    float tNext[3]; // fraction of the segment at which the next cell is entered
+    float tDelta[3]; // fraction of the segment taken to cross a whole cell
+    int totalRemaining = 0;
+    for (int axis = 0; (axis < 3); axis++)
+    {
+        cell[axis] = cellCoordinate(start3[axis], min3[axis]);
+        int lastCell = cellCoordinate(end3[axis], min3[axis]);
+        step[axis] = (lastCell >= cell[axis]) ? 1 : -1;
+        remaining[axis] = abs(lastCell - cell[axis]);
+        totalRemaining += remaining[axis];
+        float delta = end3[axis] - start3[axis];
+        if (remaining[axis] > 0 && delta != 0.0f)
+        {
+            float boundary = min3[axis] + ((cell[axis] + (step[axis] > 0 ? 1 : 0)) * cellSize);
+            tNext[axis] = (boundary - start3[axis]) / delta;
+            tDelta[axis] = cellSize / fabs(delta);
+        }
+        else
+        {
+            tNext[axis] = 2.0f; // never crosses a boundary on this axis
+            tDelta[axis] = 0.0f;
+        }
+    }
+
+    unsigned int* filter = &filters[((tileIndex * 2) + (shadowRay ? 1 : 0)) * wordsPerFilter];
+    while (true)
+    {
+        unsigned int first, second;
+        cellBits(cell[0], cell[1], cell[2], first, second);
+        filter[first >> 5] |= (1u << (first & 31));
+        filter[second >> 5] |= (1u << (second & 31));
+        if (totalRemaining == 0)
+            break;
+        // Step into the next cell along whichever axis reaches it first. Only
+        // axes with cells left are considered, so the walk always finishes in
+        // the cell holding the end of the segment.
+        int axis = -1;
+        for (int i = 0; (i < 3); i++)
+            if (remaining[i] > 0 && (axis < 0 || tNext[i] < tNext[axis]))
+                axis = i;
+        cell[axis] += step[axis];
+        tNext[axis] += tDelta[axis];
+        remaining[axis]--;
+        totalRemaining--;
+    }
+}
+
+std::vector<unsigned int> TileDependencies::affectedTiles(const std::vector<AABB>& regions,
+    bool shapesChanged) const
+{
+    std::vector<bool> affected(tiles.size(), false);
+    float margin = cellSize * REGION_MARGIN;
+    Vector3 marginVector(margin, margin, margin);
+    for (unsigned int r = 0; (r < regions.size()); r++)
+    {
+        AABB region(regions[r].bounds[0] - marginVector, regions[r].bounds[1] + marginVector);
+        if (!region.aabbsCollide(bounds))
+            continue;
+        // Bits set for each cell the region covers
+        std::vector<unsigned int> bits;
+        int minCell[3], maxCell[3];
+        float regionMin[3] = { region.bounds[0].x, region.bounds[0].y, region.bounds[0].z };
+        float regionMax[3] = { region.bounds[1].x, region.bounds[1].y, region.bounds[1].z };
+        float min3[3] = { bounds.bounds[0].x, bounds.bounds[0].y, bounds.bounds[0].z };
+        float max3[3] = { bounds.bounds[1].x, bounds.bounds[1].y, bounds.bounds[1].z };
+        for (int axis = 0; (axis < 3); axis++)
+        {
+            minCell[axis] = cellCoordinate(std::max(regionMin[axis], min3[axis]), min3[axis]);
+            maxCell[axis] = cellCoordinate(std::min(regionMax[axis], max3[axis]), min3[axis]);
+        }
+        for (int x = minCell[0]; (x <= maxCell[0]); x++)
+        {
+            for (int y = minCell[1]; (y <= maxCell[1]); y++)
+            {
+                for (int z = minCell[2]; (z <= maxCell[2]); z++)
+                {
+                    unsigned int first, second;
+                    cellBits(x, y, z, first, second);
+                    bits.push_back(first);
+                    bits.push_back(second);
+                }
+            }
+        }
+
+        unsigned int numFilters = (shapesChanged) ? 2 : 1;
+        for (unsigned int t = 0; (t < tiles.size()); t++)
+        {
+            for (unsigned int f = 0; (f < numFilters && !affected[t]); f++)
+            {
+                const unsigned int* filter = &filters[((t * 2) + f) * wordsPerFilter];
+                for (unsigned int i = 0; (i < bits.size() && !affected[t]); i += 2)
+                    affected[t] = (filter[bits[i] >> 5] & (1u << (bits[i] & 31))) &&
+                        (filter[bits[i + 1] >> 5] & (1u << (bits[i + 1] & 31)));
+            }
+        }
+    }
+
+    std::vector<unsigned int> indices;
+    for (unsigned int t = 0; (t < tiles.size()); t++)
+        if (affected[t])
+            indices.push_back(t);
+    return indices;
+}
+
+size_t TileDependencies::memoryUsed() const
+{
+    return filters.size() * sizeof(unsigned int);
+}
+
+/* Render one tile, recording what its rays pass through. */
+static void renderTrackedTile(Raytracer* renderer, TileDependencies* dependencies,
+    unsigned int tileIndex, Framebuffer* target)
+{
+    TileRecorder recorder(dependencies, tileIndex);
+    dependencies->clearTile(tileIndex);
+    renderer->setRayObserver(&recorder);
+    renderTile(renderer, dependencies->getSettings(), dependencies->getTiles()[tileIndex],
+        target);
+    renderer->setRayObserver(NULL);
+}
+
+void raytracer::renderTrackedTiles(Raytracer* renderer, TileDependencies* dependencies,
+    Framebuffer* target)
+{
+    for (unsigned int i = 0; (i < dependencies->getTiles().size()); i++)
+        renderTrackedTile(renderer, dependencies, i, target);
+}
+
+unsigned int raytracer::renderAffectedTiles(Raytracer* renderer,
+    TileDependencies* dependencies, const std::vector<AABB>& changedRegions,
+    bool shapesChanged, Framebuffer* target)
+{
+    std::vector<unsigned int> affected = dependencies->affectedTiles(changedRegions,
+        shapesChanged);
+    for (unsigned int i = 0; (i < affected.size()); i++)
+        renderTrackedTile(renderer, dependencies, affected[i], target);
+    return affected.size();
+}
@@ -0,0 +1,106 @@
+#include "TileRenderer.h"
+#include "Tracing.h"
+#include <algorithm>
+
+using namespace raytracer;
+
+TileList raytracer::splitIntoTiles(const Tile& region, int tileSize)
+{
+    TileList tiles;
+    if (tileSize <= 0)
+        return tiles;
+    for (int y = region.y; (y < region.y + region.height); y += tileSize)
+    {
+        for (int x = region.x; (x < region.x + region.width); x += tileSize)
+        {
+            int width = std::min(tileSize, region.x + region.width - x);
+            int height = std::min(tileSize, region.y + region.height - y);
+            tiles.push_back(Tile(x, y, width, height));
+        }
+    }
+    return tiles;
+}
+
+void raytracer::renderTile(Raytracer* renderer, const RenderSettings& settings,
+    const Tile& tile, Framebuffer* target, int targetX, int targetY, GBuffer* gbuffer)
+{
+    tracing::ScopedEvent event("tile", tile.x, tile.y);
+    unsigned int numSamples = samplesPerPixel(settings);
+    for (int y = tile.y; (y < tile.y + tile.height); y++)
+    {
+        for (int x = tile.x; (x < tile.x + tile.width); x++)
+        {
+            Colour colour;
+            bool hit = false;
+            if (!gbuffer)
+            {
+                hit = renderer->renderPixel(x, y, settings.width, settings.height,
+                    settings.samplingMethod, settings.numSamples, colour);
+            }
+            else
+            {
+                // Average samples which hit something, as renderPixel() does
+                Colour sum;
+                int hits = 0;
+                for (unsigned int sample = 0; (sample < numSamples); sample++)
+                {
+                    Colour sampleColour;
+                    if (renderSample(renderer, settings, x, y, sample, gbuffer, sampleColour))
+                    {
+                        sum += sampleColour;
+                        hits++;
+                    }
+                }
+                hit = (hits > 0);
+                colour = sum / std::max(1, hits);
+            }
+            if (!hit)
+                colour = BACKGROUND_COLOUR;
+            target->set(x - targetX, y - targetY, colour);
+        }
+    }
+}
+
+void raytracer::accumulateTile(Raytracer* renderer, AccumulationBuffer* buffer,
+    const Tile& tile, GBuffer* gbuffer)
+{
+    const RenderSettings& settings = buffer->getSettings();
+    for (int y = tile.y; (y < tile.y + tile.height); y++)
+    {
+        for (int x = tile.x; (x < tile.x + tile.width); x++)
+        {
+            unsigned int firstSample = buffer->samplesTaken(x, y);
+            unsigned int lastSample = firstSample + buffer->samplesNeeded(x, y);
+            for (unsigned int sample = firstSample; (sample < lastSample); sample++)
+            {
+                Colour colour;
+                bool hit = renderSample(renderer, settings, x, y, sample, gbuffer, colour);
+                buffer->addSample(x, y, colour, hit);
+            }
+        }
+    }
+}
+
+bool raytracer::renderSample(Raytracer* renderer, const RenderSettings& settings,
+    int x, int y, unsigned int sampleIndex, GBuffer* gbuffer, Colour& result)
+{
+    if (!gbuffer)
+        return renderer->renderPixelSample(x, y, settings.width, settings.height,
+            settings.samplingMethod, settings.numSamples, sampleIndex, result);
+
+    SurfaceHit hit;
+    bool found = false;
+    if (gbuffer->lookup(x, y, sampleIndex, hit))
+    {
+        found = (hit.objectHit || hit.testShapeHit);
+    }
+    else
+    {
+        found = renderer->tracePixelSample(x, y, settings.width, settings.height,
+            settings.samplingMethod, settings.numSamples, sampleIndex, hit);
+        gbuffer->store(x, y, sampleIndex, (found) ? &hit : NULL);
+    }
+    if (found)
+        result = renderer->shadeSurface(hit);
+    return found;
+}
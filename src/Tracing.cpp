@@ -0,0 +1,194 @@
+#include "Tracing.h"
+#include "Threading.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+using namespace raytracer;
+
+/* Buffers of threads which have exited are kept so their events can still
+ * be written out, up to this many (the oldest are freed first). */
+static const unsigned int MAX_EXITED_THREAD_BUFFERS = 256;
+
+struct TraceEvent
+{
+    const char* name;
+    const char* detail;
+    bool hasPosition;
+    int x, y;
+    uint64_t begin;
+    uint64_t end;
+};
+
+/* Ring buffer of one thread's events. Only its thread writes to it. */
+struct ThreadBuffer
+{
+    unsigned int threadId;
+    const char* name;
+    std::vector<TraceEvent> events;
+    // Events ever written; the newest is at (written - 1) % events.size()
+    uint64_t written;
+};
+
+bool tracing::tracingEnabled = false;
+static __thread ThreadBuffer* threadBuffer = NULL;
+static __thread const char* threadName = NULL;
+
+static threading::Mutex buffersMutex;
+static std::vector<ThreadBuffer*> runningBuffers;
+static std::deque<ThreadBuffer*> exitedBuffers;
+static unsigned int eventsPerThread = tracing::DEFAULT_EVENTS_PER_THREAD;
+static unsigned int nextThreadId = 1;
+// Cycle count events' times are measured from
+static uint64_t traceStart = 0;
+static pthread_key_t bufferKey;
+static pthread_once_t bufferKeyOnce = PTHREAD_ONCE_INIT;
+
+/* Called when a thread which has a buffer exits. */
+static void releaseThreadBuffer(void* data)
+{
+    ThreadBuffer* buffer = static_cast<ThreadBuffer*>(data);
+    threading::ScopedLock lock(buffersMutex);
+    for (unsigned int i = 0; (i < runningBuffers.size()); i++)
+    {
+        if (runningBuffers[i] == buffer)
+        {
+            runningBuffers.erase(runningBuffers.begin() + i);
+            break;
+        }
+    }
+    exitedBuffers.push_back(buffer);
+    if (exitedBuffers.size() > MAX_EXITED_THREAD_BUFFERS)
+    {
+        delete exitedBuffers.front();
+        exitedBuffers.pop_front();
+    }
+}
+
+static void createBufferKey()
+{
+    pthread_key_create(&bufferKey, releaseThreadBuffer);
+}
+
+static ThreadBuffer* createThreadBuffer()
+{
+    pthread_once(&bufferKeyOnce, createBufferKey);
+    ThreadBuffer* buffer = new ThreadBuffer();
+    buffer->name = threadName;
+    buffer->written = 0;
+    {
+        threading::ScopedLock lock(buffersMutex);
+        buffer->threadId = nextThreadId++;
+        buffer->events.resize(eventsPerThread);
+        runningBuffers.push_back(buffer);
+    }
+    pthread_setspecific(bufferKey, buffer);
+    threadBuffer = buffer;
+    return buffer;
+}
+
+/* Write the events still held by a buffer. 'first' is set to false once
+ * anything has been written. */
+static void writeBufferEvents(std::ostream& stream, const ThreadBuffer& buffer,
+    int processId, double microsecondsPerCycle, bool& first)
+{
+    stream << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": "
+        << processId << ", \"tid\": " << buffer.threadId << ", \"args\": {\"name\": \""
+        << common::escapeJSON(buffer.name ? buffer.name : "thread") << "\"}}";
+    first = false;
+
+    uint64_t written = __atomic_load_n(&buffer.written, __ATOMIC_ACQUIRE);
+    uint64_t capacity = buffer.events.size();
+    for (uint64_t i = (written > capacity) ? written - capacity : 0; (i < written); i++)
+    {
+        const TraceEvent& event = buffer.events[i % capacity];
+        stream << ",\n{\"name\": \"" << common::escapeJSON(event.name) << "\", \"ph\": \"X\", \"pid\": "
+            << processId << ", \"tid\": " << buffer.threadId
+            << ", \"ts\": " << ((event.begin - traceStart) * microsecondsPerCycle)
+            << ", \"dur\": " << ((event.end - event.begin) * microsecondsPerCycle);
+        if (event.detail)
+        {
+            stream << ", \"args\": {\"detail\": \"" << common::escapeJSON(event.detail) << "\"}";
+        }
+        else if (event.hasPosition)
+        {
+            stream << ", \"args\": {\"x\": " << event.x << ", \"y\": " << event.y << "}";
+        }
+        stream << "}";
+    }
+}
+
+void tracing::enable(unsigned int newEventsPerThread)
+{
+    threading::ScopedLock lock(buffersMutex);
+    eventsPerThread = std::max(1u, newEventsPerThread);
+    if (traceStart == 0)
+        traceStart = common::cycleCount();
+    __atomic_store_n(&tracingEnabled, true, __ATOMIC_RELAXED);
+}
+
+void tracing::disable()
+{
+    __atomic_store_n(&tracingEnabled, false, __ATOMIC_RELAXED);
+}
+
+void tracing::setThreadName(const char* name)
+{
+    threadName = name;
+    if (threadBuffer)
+        threadBuffer->name = name;
+}
+
+void tracing::record(const char* name, const char* detail, bool hasPosition, int x, int y,
+    uint64_t begin, uint64_t end)
+{
+    ThreadBuffer* buffer = (threadBuffer) ? threadBuffer : createThreadBuffer();
+    TraceEvent& event = buffer->events[buffer->written % buffer->events.size()];
+    event.name = name;
+    event.detail = detail;
+    event.hasPosition = hasPosition;
+    event.x = x;
+    event.y = y;
+    event.begin = begin;
+    event.end = end;
+    // Published after the event is written, so writeChromeTrace() sees it whole
+    __atomic_store_n(&buffer->written, buffer->written + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t tracing::eventCount()
+{
+    threading::ScopedLock lock(buffersMutex);
+    uint64_t count = 0;
+    for (unsigned int i = 0; (i < runningBuffers.size()); i++)
+        count += std::min<uint64_t>(__atomic_load_n(&runningBuffers[i]->written,
+            __ATOMIC_ACQUIRE), runningBuffers[i]->events.size());
+    for (unsigned int i = 0; (i < exitedBuffers.size()); i++)
+        count += std::min<uint64_t>(exitedBuffers[i]->written, exitedBuffers[i]->events.size());
+    return count;
+}
+
+bool tracing::writeChromeTrace(const std::string& filename)
+{
+    std::ofstream file(filename.c_str());
+    if (!file.is_open())
+        return false;
+    double microsecondsPerCycle = 1e6 / common::cyclesPerSecond();
+    int processId = getpid();
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    {
+        threading::ScopedLock lock(buffersMutex);
+        for (unsigned int i = 0; (i < exitedBuffers.size()); i++)
+            writeBufferEvents(file, *exitedBuffers[i], processId, microsecondsPerCycle, first);
+        for (unsigned int i = 0; (i < runningBuffers.size()); i++)
+            writeBufferEvents(file, *runningBuffers[i], processId, microsecondsPerCycle, first);
+    }
+    file << "\n]}\n";
+    file.close();
+    return !file.fail();
+}
@@ -1,5 +1,7 @@
 #include "Triangle.h"
 #include "Intersection.h"
+#include "Profiling.h"
+#include "RayCost.h"
 
 using namespace raytracer;
 
@@ -17,6 +19,8 @@ const Vector3& Triangle::getCentre() const
 
 bool Triangle::hit(const Ray& ray, float tMin, float tMax, float time, HitRecord& record) const
 {
+    PROFILE_STAGE(PRIMITIVE_TESTS);
+    raycost::countPrimitiveTest();
     bool isHit = intersection::triangleHit(p1, p2, p3, ray, tMin, tMax, time, record);
     // Augment hit record with the material of the hit shape
     if (isHit)
@@ -27,6 +31,8 @@ bool Triangle::hit(const Ray& ray, float tMin, float tMax, float time, HitRecord
 bool Triangle::shadowHit(const Ray& ray, float tMin, float tMax,
     float time, const Shape*& occludingShape) const
 {
+    PROFILE_STAGE(PRIMITIVE_TESTS);
+    raycost::countPrimitiveTest();
     bool isHit = intersection::triangleShadowHit(p1, p2, p3, ray, tMin, tMax, time);
     if (isHit)
         occludingShape = this;
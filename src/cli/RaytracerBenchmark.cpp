@@ -0,0 +1,654 @@
+/* Benchmark suite. Renders a fixed set of named cases with the demo scene,
+ * one after another on a single thread, and reports how long each took and
+ * how many rays of each type it cast, as JSON, so results can be compared
+ * across commits.
+ *
+ * Usage: raytracer-bench [options] [CASE ...]
+ *
+ * Only cases whose names start with one of the given CASEs are run (e.g.
+ * "sampling/" runs every sampling case); with none, every case is run.
+ * Options are:
+ *     --list          print the name and settings of every case, then exit
+ *     --report=FILE   write results to FILE (default: benchmark.json)
+ *     --label=TEXT    label stored in the report, e.g. the commit measured
+ *     --repeat=N      render each case N times, reporting the median and
+ *                     fastest times (default: 1)
+ *     --scale=F       multiply the width and height of every case by F, for
+ *                     quicker runs (default: 1)
+ *     --output-dir=DIR  write the image each case renders to DIR, so images
+ *                     from different commits can be compared
+ *     --compiled-scene=FILE  load the scene from a compiled scene file (see
+ *                     raytracer-cli)
+ *     --quality       measure how much quality cheaper renders lose instead.
+ *                     A reference image of the view is rendered with many
+ *                     random samples per pixel (or read back if it was
+ *                     rendered before), then each quality case (a cheaper
+ *                     sampling method, or an effect switched off) is timed
+ *                     and compared with it. The report gives each case's
+ *                     RMSE, PSNR and SSIM as well as its time and rays, and
+ *                     which cases are on the Pareto front: those no other
+ *                     case is both at least as fast and as close as
+ *     --view=SETTINGS  image the quality cases render, e.g. "camera=2
+ *                     terrain=peaks" (default: width=200 height=200)
+ *     --reference-samples=N  random samples per pixel of the reference
+ *                     image (default: 256)
+ *     --reference-dir=DIR  directory reference images are kept in, under a
+ *                     hash of the scene and settings (default: quality-reference)
+ *     --plot=FILE     also plot the PSNR of each quality case against its time
+ *                     to FILE as an SVG chart, joining those on the Pareto front
+ */
+#ifndef DW_RAYTRACER_GUI_ENABLED
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <sys/resource.h>
+#include "DemoScene.h"
+#include "RenderSettings.h"
+#include "TileRenderer.h"
+#include "TGA.h"
+#include "Common.h"
+#include "RenderCache.h"
+#include "ImageComparison.h"
+
+using namespace raytracer;
+
+/* Images rendered by the presets in the README. */
+static const char* const PRESET_CASES[][2] = {
+    { "preset/varied", "width=1000 height=1000 sampling=uniform samples=3 terrain=varied camera=1" },
+    { "preset/peaks", "width=1000 height=1000 sampling=uniform samples=3 terrain=peaks camera=2" },
+    { "preset/yellow-light", "width=1000 height=1000 sampling=single terrain=varied camera=1 lights=2" }
+};
+static const unsigned int NUM_PRESET_CASES = sizeof(PRESET_CASES) / sizeof(PRESET_CASES[0]);
+/* Settings shared by every case which is not a preset. */
+static const std::string MATRIX_SETTINGS = "width=200 height=200";
+/* Seed for random sampling, so every run casts the same rays. */
+static const unsigned int RANDOM_SEED = 1;
+/* Cheaper ways to render the quality sweep's view, each measured against
+ * the reference. Their settings are added to the view's. */
+static const char* const QUALITY_CASES[][2] = {
+    { "quality/single", "sampling=single" },
+    { "quality/uniform-2", "sampling=uniform samples=2" },
+    { "quality/uniform-3", "sampling=uniform samples=3" },
+    { "quality/uniform-4", "sampling=uniform samples=4" },
+    { "quality/random-2", "sampling=random samples=2" },
+    { "quality/random-4", "sampling=random samples=4" },
+    { "quality/random-8", "sampling=random samples=8" },
+    { "quality/random-16", "sampling=random samples=16" },
+    { "quality/single-no-shadows", "sampling=single shadows=off" },
+    { "quality/single-no-reflect", "sampling=single reflect=off" }
+};
+static const unsigned int NUM_QUALITY_CASES = sizeof(QUALITY_CASES) / sizeof(QUALITY_CASES[0]);
+static const unsigned int DEFAULT_REFERENCE_SAMPLES = 256;
+/* Size of the chart written by --plot, and the space around its axes. */
+static const int PLOT_WIDTH = 720;
+static const int PLOT_HEIGHT = 480;
+static const int PLOT_MARGIN = 60;
+
+/* Named render which is measured. */
+struct BenchmarkCase
+{
+    std::string name;
+    std::string settings;
+
+    BenchmarkCase(const std::string& name, const std::string& settings) :
+        name(name), settings(settings)
+    {
+    }
+};
+
+/* Measurements taken for a single case. */
+struct BenchmarkResult
+{
+    std::string name;
+    std::string settings;
+    bool success;
+    // Median and fastest time taken to render the image
+    double seconds;
+    double minSeconds;
+    // Time taken to build the terrain's accelerator, which is built before
+    // the image is rendered and not included in 'seconds', what was built
+    // and its statistics as a JSON object
+    double acceleratorBuildSeconds;
+    std::string acceleratorConfiguration;
+    std::string acceleratorStatistics;
+    uint64_t primaryRays;
+    uint64_t reflectedRays;
+    uint64_t refractedRays;
+    uint64_t shadowRays;
+    // Largest resident set size of the whole process by the time the case
+    // finished, including every case run before it. It is not the memory
+    // the case itself needed.
+    long processPeakRSSKilobytesSoFar;
+    // Quality cases only: how far the image is from the reference, and
+    // whether no other case is both at least as fast and as close
+    bool compared;
+    ImageError error;
+    bool paretoOptimal;
+
+    BenchmarkResult() : success(false), seconds(0), minSeconds(0),
+        acceleratorBuildSeconds(0), primaryRays(0), reflectedRays(0),
+        refractedRays(0), shadowRays(0), processPeakRSSKilobytesSoFar(0),
+        compared(false), paretoOptimal(false)
+    {
+    }
+};
+
+/* Every case in the suite: the README's presets, then each terrain seen
+ * from each camera, effects switched on and off one at a time, and each
+ * sampling method with each accelerator. */
+std::vector<BenchmarkCase> benchmarkCases()
+{
+    static const char* const TERRAINS[] = { "varied", "shallow", "peaks" };
+    static const char* const SAMPLING[] = { "single", "uniform", "random" };
+    static const char* const EFFECTS[][2] = {
+        { "all", "local=on reflect=on shadows=on" },
+        { "none", "local=off reflect=off shadows=off" },
+        { "no-local", "local=off" },
+        { "no-reflect", "reflect=off" },
+        { "no-shadows", "shadows=off" }
+    };
+
+    std::vector<BenchmarkCase> cases;
+    for (unsigned int i = 0; (i < NUM_PRESET_CASES); i++)
+        cases.push_back(BenchmarkCase(PRESET_CASES[i][0], PRESET_CASES[i][1]));
+    for (unsigned int t = 0; (t < 3); t++)
+    {
+        for (unsigned int c = 1; (c <= 3); c++)
+        {
+            std::string camera = common::toString(c);
+            cases.push_back(BenchmarkCase(
+                std::string("scene/") + TERRAINS[t] + "/camera" + camera,
+                MATRIX_SETTINGS + " terrain=" + TERRAINS[t] + " camera=" + camera));
+        }
+    }
+    for (unsigned int e = 0; (e < sizeof(EFFECTS) / sizeof(EFFECTS[0])); e++)
+        cases.push_back(BenchmarkCase(std::string("effects/") + EFFECTS[e][0],
+            MATRIX_SETTINGS + " " + EFFECTS[e][1]));
+    for (unsigned int s = 0; (s < 3); s++)
+    {
+        for (unsigned int a = 0; (a < NUM_ACCELERATOR_TYPES); a++)
+        {
+            const char* accelerator = acceleratorName(static_cast<AcceleratorType>(a));
+            cases.push_back(BenchmarkCase(
+                std::string("sampling/") + SAMPLING[s] + "/" + accelerator,
+                MATRIX_SETTINGS + " sampling=" + SAMPLING[s] + " accelerator=" + accelerator));
+        }
+    }
+    return cases;
+}
+
+/* Every case of the quality sweep, rendering the given view. */
+std::vector<BenchmarkCase> qualityCases(const std::string& view)
+{
+    std::vector<BenchmarkCase> cases;
+    for (unsigned int i = 0; (i < NUM_QUALITY_CASES); i++)
+        cases.push_back(BenchmarkCase(QUALITY_CASES[i][0], view + " " + QUALITY_CASES[i][1]));
+    return cases;
+}
+
+/* True if the case was asked for on the command line. */
+bool caseSelected(const BenchmarkCase& benchmarkCase, const std::vector<std::string>& prefixes)
+{
+    if (prefixes.empty())
+        return true;
+    for (unsigned int i = 0; (i < prefixes.size()); i++)
+        if (benchmarkCase.name.compare(0, prefixes[i].size(), prefixes[i]) == 0)
+            return true;
+    return false;
+}
+
+/* Largest resident set size the process has had since it started. It
+ * never goes down, so it can not be used to compare cases run in turn. */
+long processPeakRSSKilobytes()
+{
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return usage.ru_maxrss;
+}
+
+/* Rays of one type cast per second, or zero if no time was taken. */
+double raysPerSecond(uint64_t rays, double seconds)
+{
+    return (seconds > 0) ? (rays / seconds) : 0.0;
+}
+
+/* Render the case 'repeats' times, measuring each render. If 'rendered' is
+ * given, the image is copied to it. */
+BenchmarkResult runCase(DemoScene& scene, const BenchmarkCase& benchmarkCase,
+    double scale, unsigned int repeats, const std::string& outputDirectory,
+    Image* rendered = NULL)
+{
+    BenchmarkResult result;
+    result.name = benchmarkCase.name;
+    RenderSettings settings;
+    if (!parseRenderSettings(benchmarkCase.settings, settings))
+    {
+        std::cerr << "Invalid settings for " << benchmarkCase.name << std::endl;
+        return result;
+    }
+    settings.width = std::max(1, static_cast<int>(settings.width * scale));
+    settings.height = std::max(1, static_cast<int>(settings.height * scale));
+    result.settings = formatRenderSettings(settings);
+    if (!applyRenderSettings(scene, settings))
+    {
+        std::cerr << "Scene has no such camera or terrain" << std::endl;
+        return result;
+    }
+    // Build accelerator up front, so it is timed separately
+    const Accelerator* accelerator = terrainAccelerator(scene, settings);
+    if (accelerator)
+    {
+        result.acceleratorBuildSeconds = accelerator->getBuildSeconds();
+        result.acceleratorConfiguration = formatAcceleratorConfiguration(
+            accelerator->getType(), accelerator->getParameters());
+        result.acceleratorStatistics = accelerator->statistics().formatJSON();
+    }
+
+    Image image(settings.width, settings.height);
+    std::vector<double> times;
+    for (unsigned int i = 0; (i < repeats); i++)
+    {
+        srand(RANDOM_SEED);
+        scene.renderer->resetRayCount();
+        double start = common::wallClockSeconds();
+        renderTile(scene.renderer, settings, Tile(0, 0, settings.width, settings.height),
+            &image);
+        times.push_back(common::wallClockSeconds() - start);
+    }
+    std::sort(times.begin(), times.end());
+    result.seconds = times[times.size() / 2];
+    result.minSeconds = times[0];
+    result.primaryRays = scene.renderer->primaryRays();
+    result.reflectedRays = scene.renderer->reflectedRays();
+    result.refractedRays = scene.renderer->refractedRays();
+    result.shadowRays = scene.renderer->shadowRays();
+    result.processPeakRSSKilobytesSoFar = processPeakRSSKilobytes();
+    result.success = true;
+
+    if (!outputDirectory.empty())
+    {
+        std::string filename = benchmarkCase.name;
+        std::replace(filename.begin(), filename.end(), '/', '-');
+        filename = outputDirectory + "/" + filename + ".tga";
+        if (!tga::writeTGAFile(filename, image))
+            std::cerr << "    could not write " << filename << std::endl;
+    }
+    if (rendered)
+        *rendered = image;
+    return result;
+}
+
+/* Render the quality sweep's reference image, rendering only the tiles which
+ * are not in the cache, and adding them to it. 'summary' holds the time and
+ * rays taken to render the whole image, including tiles rendered before.
+ * Returns false if the settings are invalid. */
+bool renderReference(DemoScene& scene, const RenderSettings& settings, RenderCache& cache,
+    Image& reference, protocol::RenderSummary& summary)
+{
+    if (!applyRenderSettings(scene, settings))
+        return false;
+    std::string key = renderCacheKey(scene, settings);
+    std::vector<bool> cachedTiles;
+    unsigned int tilesFromCache = cache.lookup(key, settings, &reference, cachedTiles, summary);
+    TileList tiles = splitIntoTiles(Tile(0, 0, settings.width, settings.height),
+        RenderCache::TILE_SIZE);
+    if (tilesFromCache == tiles.size())
+        return true;
+
+    std::cout << "Rendering reference (" << samplesPerPixel(settings)
+        << " samples per pixel, " << tilesFromCache << " of " << tiles.size()
+        << " tiles cached)" << std::endl;
+    srand(RANDOM_SEED);
+    scene.renderer->resetRayCount();
+    double start = common::wallClockSeconds();
+    std::vector<bool> renderedTiles(tiles.size(), false);
+    for (unsigned int i = 0; (i < tiles.size()); i++)
+    {
+        if (cachedTiles[i])
+            continue;
+        renderTile(scene.renderer, settings, tiles[i], &reference);
+        renderedTiles[i] = true;
+    }
+    protocol::RenderSummary rendered;
+    rendered.seconds = common::wallClockSeconds() - start;
+    rendered.primaryRays = scene.renderer->primaryRays();
+    rendered.reflectedRays = scene.renderer->reflectedRays();
+    rendered.refractedRays = scene.renderer->refractedRays();
+    rendered.shadowRays = scene.renderer->shadowRays();
+    if (!cache.store(key, settings, reference, renderedTiles, rendered))
+        std::cerr << "Could not add reference to cache" << std::endl;
+    summary.seconds += rendered.seconds;
+    summary.primaryRays += rendered.primaryRays;
+    summary.reflectedRays += rendered.reflectedRays;
+    summary.refractedRays += rendered.refractedRays;
+    summary.shadowRays += rendered.shadowRays;
+    return true;
+}
+
+/* Mark the compared results which no other is both at least as fast as and
+ * at least as close to the reference as, while beating them on one. */
+void markParetoFront(std::vector<BenchmarkResult>& results)
+{
+    for (unsigned int i = 0; (i < results.size()); i++)
+    {
+        BenchmarkResult& result = results[i];
+        result.paretoOptimal = result.compared;
+        for (unsigned int j = 0; (result.paretoOptimal && j < results.size()); j++)
+        {
+            const BenchmarkResult& other = results[j];
+            if (j == i || !other.compared)
+                continue;
+            if (other.seconds <= result.seconds && other.error.rmse <= result.error.rmse &&
+                (other.seconds < result.seconds || other.error.rmse < result.error.rmse))
+                result.paretoOptimal = false;
+        }
+    }
+}
+
+bool secondsLess(const BenchmarkResult* a, const BenchmarkResult* b)
+{
+    return a->seconds < b->seconds;
+}
+
+/* Chart of each compared result's PSNR against its time, with time on a log
+ * scale, joining the results on the Pareto front. */
+bool writeParetoPlot(const std::string& filename, const std::vector<BenchmarkResult>& results)
+{
+    std::vector<const BenchmarkResult*> points;
+    for (unsigned int i = 0; (i < results.size()); i++)
+        if (results[i].compared && results[i].seconds > 0)
+            points.push_back(&results[i]);
+    if (points.empty())
+        return false;
+    std::sort(points.begin(), points.end(), secondsLess);
+    double minX = std::log10(points.front()->seconds);
+    double maxX = std::log10(points.back()->seconds);
+    double minY = points[0]->error.psnr;
+    double maxY = minY;
+    for (unsigned int i = 0; (i < points.size()); i++)
+    {
+        minY = std::min(minY, points[i]->error.psnr);
+        maxY = std::max(maxY, points[i]->error.psnr);
+    }
+    std::string psnrRange = common::toString(minY) + " to " + common::toString(maxY);
+    // Leave room around the points, and at least one unit along each axis
+    double padX = std::max(0.5 - ((maxX - minX) / 2.0), 0.05 * (maxX - minX));
+    double padY = std::max(1.0 - ((maxY - minY) / 2.0), 0.05 * (maxY - minY));
+    minX -= padX;
+    maxX += padX;
+    minY -= padY;
+    maxY += padY;
+    int plotWidth = PLOT_WIDTH - (2 * PLOT_MARGIN);
+    int plotHeight = PLOT_HEIGHT - (2 * PLOT_MARGIN);
+
+    std::ofstream plot(filename.c_str());
+    if (!plot.is_open())
+        return false;
+    plot << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << PLOT_WIDTH
+        << "\" height=\"" << PLOT_HEIGHT << "\" font-family=\"sans-serif\" font-size=\"11\">\n"
+        << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n"
+        << "<rect x=\"" << PLOT_MARGIN << "\" y=\"" << PLOT_MARGIN << "\" width=\""
+        << plotWidth << "\" height=\"" << plotHeight << "\" fill=\"none\" stroke=\"black\"/>\n"
+        << "<text x=\"" << (PLOT_WIDTH / 2) << "\" y=\"" << (PLOT_HEIGHT - 15)
+        << "\" text-anchor=\"middle\">seconds (log scale), "
+        << points.front()->seconds << " to " << points.back()->seconds << "</text>\n"
+        << "<text x=\"15\" y=\"" << (PLOT_HEIGHT / 2) << "\" text-anchor=\"middle\" "
+        << "transform=\"rotate(-90 15 " << (PLOT_HEIGHT / 2) << ")\">PSNR (dB), "
+        << psnrRange << "</text>\n";
+    std::vector<std::string> frontPoints;
+    for (unsigned int i = 0; (i < points.size()); i++)
+    {
+        const BenchmarkResult& result = *points[i];
+        double x = PLOT_MARGIN + (plotWidth * (std::log10(result.seconds) - minX) / (maxX - minX));
+        double y = PLOT_MARGIN + (plotHeight * (maxY - result.error.psnr) / (maxY - minY));
+        std::string name = result.name.substr(result.name.find('/') + 1);
+        plot << "<circle cx=\"" << x << "\" cy=\"" << y << "\" r=\"4\" fill=\""
+            << (result.paretoOptimal ? "red" : "grey") << "\"/>\n"
+            << "<text x=\"" << (x + 6) << "\" y=\"" << (y - 6) << "\">" << name << "</text>\n";
+        if (result.paretoOptimal)
+            frontPoints.push_back(common::toString(x) + "," + common::toString(y));
+    }
+    plot << "<polyline fill=\"none\" stroke=\"red\" points=\"";
+    for (unsigned int i = 0; (i < frontPoints.size()); i++)
+        plot << ((i > 0) ? " " : "") << frontPoints[i];
+    plot << "\"/>\n</svg>\n";
+    return plot.good();
+}
+
+/* Write one ray type's count and rate. */
+void writeRays(std::ofstream& report, const std::string& type, uint64_t rays,
+    double seconds)
+{
+    report << "      \"" << type << "Rays\": " << rays << ",\n"
+        << "      \"" << type << "RaysPerSecond\": " << raysPerSecond(rays, seconds) << ",\n";
+}
+
+/* 'reference' describes the quality sweep's reference image as a JSON
+ * object, or is empty if the speed cases were run. */
+bool writeReport(const std::string& filename, const std::string& label,
+    double sceneLoadSeconds, const std::vector<BenchmarkResult>& results,
+    const std::string& reference)
+{
+    std::ofstream report(filename.c_str());
+    if (!report.is_open())
+        return false;
+    report << "{\n  \"label\": \"" << common::escapeJSON(label) << "\",\n"
+        << "  \"sceneLoadSeconds\": " << sceneLoadSeconds << ",\n"
+        << "  \"processPeakRSSKilobytes\": " << processPeakRSSKilobytes() << ",\n";
+    if (!reference.empty())
+        report << "  \"reference\": " << reference << ",\n";
+    report << "  \"cases\": [\n";
+    for (unsigned int i = 0; (i < results.size()); i++)
+    {
+        const BenchmarkResult& result = results[i];
+        uint64_t totalRays = result.primaryRays + result.reflectedRays
+            + result.refractedRays + result.shadowRays;
+        report << "    {\n"
+            << "      \"name\": \"" << common::escapeJSON(result.name) << "\",\n"
+            << "      \"settings\": \"" << common::escapeJSON(result.settings) << "\",\n"
+            << "      \"success\": " << (result.success ? "true" : "false") << ",\n"
+            << "      \"seconds\": " << result.seconds << ",\n"
+            << "      \"minSeconds\": " << result.minSeconds << ",\n"
+            << "      \"acceleratorBuildSeconds\": " << result.acceleratorBuildSeconds << ",\n";
+        if (!result.acceleratorStatistics.empty())
+        {
+            report << "      \"accelerator\": \""
+                << common::escapeJSON(result.acceleratorConfiguration) << "\",\n"
+                << "      \"acceleratorStatistics\": " << result.acceleratorStatistics << ",\n";
+        }
+        writeRays(report, "primary", result.primaryRays, result.seconds);
+        writeRays(report, "reflected", result.reflectedRays, result.seconds);
+        writeRays(report, "refracted", result.refractedRays, result.seconds);
+        writeRays(report, "shadow", result.shadowRays, result.seconds);
+        writeRays(report, "total", totalRays, result.seconds);
+        if (result.compared)
+        {
+            report << "      \"rmse\": " << result.error.rmse << ",\n"
+                << "      \"psnr\": " << result.error.psnr << ",\n"
+                << "      \"ssim\": " << result.error.ssim << ",\n"
+                << "      \"maxError\": " << result.error.maxError << ",\n"
+                << "      \"paretoOptimal\": " << (result.paretoOptimal ? "true" : "false") << ",\n";
+        }
+        report << "      \"processPeakRSSKilobytesSoFar\": " << result.processPeakRSSKilobytesSoFar << "\n"
+            << "    }" << ((i + 1 < results.size()) ? "," : "") << "\n";
+    }
+    report << "  ]\n}\n";
+    return report.good();
+}
+
+int main(int argc, char* argv[])
+{
+    std::string reportFilename = "benchmark.json";
+    std::string label;
+    std::string outputDirectory;
+    std::string compiledSceneFilename;
+    unsigned int repeats = 1;
+    double scale = 1.0;
+    bool listCases = false;
+    bool measureQuality = false;
+    std::string view = MATRIX_SETTINGS;
+    unsigned int referenceSamples = DEFAULT_REFERENCE_SAMPLES;
+    std::string referenceDirectory = "quality-reference";
+    std::string plotFilename;
+    std::vector<std::string> prefixes;
+    for (int i = 1; (i < argc); i++)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            prefixes.push_back(arg);
+            continue;
+        }
+        size_t separator = arg.find('=');
+        std::string name = arg.substr(2, separator - 2);
+        std::string value = (separator != std::string::npos) ? arg.substr(separator + 1) : "";
+        if (name == "list") listCases = true;
+        else if (name == "report") reportFilename = value;
+        else if (name == "label") label = value;
+        else if (name == "repeat") repeats = std::max(1, atoi(value.c_str()));
+        else if (name == "scale") scale = atof(value.c_str());
+        else if (name == "output-dir") outputDirectory = value;
+        else if (name == "compiled-scene") compiledSceneFilename = value;
+        else if (name == "quality") measureQuality = true;
+        else if (name == "view") view = value;
+        else if (name == "reference-samples") referenceSamples = std::max(1, atoi(value.c_str()));
+        else if (name == "reference-dir") referenceDirectory = value;
+        else if (name == "plot") plotFilename = value;
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (scale <= 0)
+    {
+        std::cerr << "Scale must be positive" << std::endl;
+        return 1;
+    }
+
+    // Reference image the quality cases are compared with
+    RenderSettings referenceSettings;
+    if (measureQuality && !parseRenderSettings(view + " sampling=random samples=" +
+        common::toString(referenceSamples), referenceSettings))
+    {
+        std::cerr << "Invalid view: " << view << std::endl;
+        return 1;
+    }
+    referenceSettings.width = std::max(1, static_cast<int>(referenceSettings.width * scale));
+    referenceSettings.height = std::max(1, static_cast<int>(referenceSettings.height * scale));
+
+    std::vector<BenchmarkCase> allCases = (measureQuality) ? qualityCases(view) : benchmarkCases();
+    std::vector<BenchmarkCase> cases;
+    for (unsigned int i = 0; (i < allCases.size()); i++)
+    {
+        if (!caseSelected(allCases[i], prefixes))
+            continue;
+        cases.push_back(allCases[i]);
+        if (listCases)
+            std::cout << allCases[i].name << ": " << allCases[i].settings << std::endl;
+    }
+    if (listCases)
+        return 0;
+    if (cases.empty())
+    {
+        std::cerr << "No benchmark cases match" << std::endl;
+        return 1;
+    }
+
+    double start = common::wallClockSeconds();
+    DemoScene scene = constructDemoScene(compiledSceneFilename);
+    if (!scene.renderer)
+    {
+        std::cerr << "Could not load scene" << std::endl;
+        return 1;
+    }
+    double sceneLoadSeconds = common::wallClockSeconds() - start;
+    std::cout << "Loaded scene in " << sceneLoadSeconds << " seconds" << std::endl;
+
+    Image reference(referenceSettings.width, referenceSettings.height);
+    std::string referenceReport;
+    if (measureQuality)
+    {
+        RenderCache cache(referenceDirectory);
+        protocol::RenderSummary summary;
+        if (!renderReference(scene, referenceSettings, cache, reference, summary))
+        {
+            std::cerr << "Scene has no such camera or terrain" << std::endl;
+            return 1;
+        }
+        uint64_t totalRays = summary.primaryRays + summary.reflectedRays
+            + summary.refractedRays + summary.shadowRays;
+        std::cout << "Reference rendered in " << summary.seconds << " seconds using "
+            << totalRays << " rays" << std::endl;
+        referenceReport = "{\"settings\": \"" +
+            common::escapeJSON(formatRenderSettings(referenceSettings)) +
+            "\", \"seconds\": " + common::toString(summary.seconds) +
+            ", \"totalRays\": " + common::toString(totalRays) + "}";
+        if (!outputDirectory.empty() &&
+            !tga::writeTGAFile(outputDirectory + "/quality-reference.tga", reference))
+            std::cerr << "Could not write reference to " << outputDirectory << std::endl;
+    }
+
+    std::vector<BenchmarkResult> results;
+    bool allSucceeded = true;
+    for (unsigned int i = 0; (i < cases.size()); i++)
+    {
+        std::cout << "[" << (i + 1) << "/" << cases.size() << "] " << cases[i].name
+            << std::endl;
+        Image image(1, 1);
+        BenchmarkResult result = runCase(scene, cases[i], scale, repeats, outputDirectory,
+            measureQuality ? &image : NULL);
+        if (result.success && measureQuality)
+            result.compared = compareImages(image, reference, result.error);
+        if (result.success)
+        {
+            uint64_t totalRays = result.primaryRays + result.reflectedRays
+                + result.refractedRays + result.shadowRays;
+            std::cout << "    " << result.seconds << " seconds, "
+                << raysPerSecond(totalRays, result.seconds) << " rays/second";
+            if (result.compared)
+                std::cout << ", RMSE " << result.error.rmse << ", PSNR " << result.error.psnr
+                    << " dB, SSIM " << result.error.ssim;
+            std::cout << std::endl;
+        }
+        results.push_back(result);
+        allSucceeded = allSucceeded && result.success;
+    }
+    if (measureQuality)
+    {
+        markParetoFront(results);
+        std::cout << "Pareto front:";
+        for (unsigned int i = 0; (i < results.size()); i++)
+            if (results[i].paretoOptimal)
+                std::cout << " " << results[i].name;
+        std::cout << std::endl;
+        if (!plotFilename.empty() && !writeParetoPlot(plotFilename, results))
+        {
+            std::cerr << "Could not write plot to " << plotFilename << std::endl;
+            allSucceeded = false;
+        }
+    }
+
+    if (!writeReport(reportFilename, label, sceneLoadSeconds, results, referenceReport))
+    {
+        std::cerr << "Could not write report to " << reportFilename << std::endl;
+        allSucceeded = false;
+    }
+    std::cout << "Wrote " << reportFilename << std::endl;
+
+    // Clean up resources
+    delete scene.renderer;
+    delete ResourceManager::getInstance();
+    delete scene.compiledScene;
+
+    return (allSucceeded) ? 0 : 1;
+}
+
+#endif
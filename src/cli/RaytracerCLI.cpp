@@ -0,0 +1,1151 @@
+/* Headless command-line renderer. Loads the demo scene once, then renders
+ * one or more jobs, writing each image to a TGA file and (optionally) a
+ * JSON report with how long each job took.
+ *
+ * Usage: raytracer-cli [options] [setting=value ...]
+ *
+ * Settings are those understood by setRenderSetting() (see RenderSettings.h).
+ * Giving a comma-separated list of values renders every combination,
+ * e.g. "camera=1,2,3 shadows=on,off" renders six images. Options are:
+ *     --output=FILE   output filename. "{n}" is replaced by the job number
+ *                     (default: render.tga, or render-{n}.tga for many jobs)
+ *     --jobs=FILE     read jobs from file, one per line. Each line holds
+ *                     settings which override those given on the command line
+ *     --report=FILE   write timing report to FILE in JSON format. In builds
+ *                     with profiling (see Profiling.h), it includes the time
+ *                     spent in each stage of rendering, which is also printed
+ *     --compress      write RLE compressed TGA files
+ *     --mapped=FILE   render into a memory-mapped framebuffer stored in FILE,
+ *                     rather than streaming rows straight to the output
+ *     --daemon=ADDRESS  send jobs to the render daemon listening on ADDRESS
+ *                     (socket path or host:port) instead of loading the
+ *                     scene and rendering them here
+ *     --workers=ADDRESS,ADDRESS,...  split each job into tiles and share them
+ *                     between several render daemons, e.g. on other machines
+ *     --checkpoint=FILE  periodically save every sample taken so far to FILE
+ *                     ("{n}" is replaced as for --output). If FILE holds a
+ *                     checkpoint of the same image, the render carries on
+ *                     from it, and with random sampling more samples can be
+ *                     added to a finished render by raising "samples"
+ *     --checkpoint-interval=SECONDS  time between checkpoints (default: 60)
+ *     --gbuffer       keep the surface hit by each primary ray between jobs,
+ *                     so jobs which differ only in lights or effects (local,
+ *                     reflect, shadows) are relit rather than traced again
+ *     --cache=DIR     keep rendered images in DIR, under a hash of the scene,
+ *                     camera and settings. Jobs which were rendered before
+ *                     are read back from it rather than rendered again. If
+ *                     a render is interrupted, the tiles it finished are
+ *                     kept, and only the rest are rendered next time
+ *     --compiled-scene=FILE  load the scene from FILE, which holds decoded
+ *                     images and built terrain, instead of its resource
+ *                     files. FILE is written if it does not exist or is
+ *                     older than the resource files
+ *     --image-budget=MEGABYTES  free decoded images the scene is not using
+ *                     (e.g. heightmaps once their terrain is built) to keep
+ *                     images within MEGABYTES, decoding them again if needed
+ *     --edit=SPHERE:PROPERTY=VALUE  after rendering the (single) job, change
+ *                     a sphere and render again only the tiles the change
+ *                     affects, writing another image. Can be given several
+ *                     times to make a series of changes. Properties are
+ *                     centre=x,y,z, move=x,y,z, radius=r, colour=r,g,b and
+ *                     reflect=factor, e.g. "--edit=2:move=0,1,0"
+ *     --cost-maps=PREFIX  also record how much work went into each pixel
+ *                     (accelerator nodes visited, primitive tests, shadow
+ *                     and secondary rays, and time), writing each as a
+ *                     false colour image PREFIX-<metric>.tga and a float
+ *                     image PREFIX-<metric>.pfm ("{n}" is replaced as for
+ *                     --output). Not available with --daemon or --workers
+ *     --record-rays=FILE  render on one thread, recording every query made of
+ *                     the scene's shapes (primary, reflected, refracted and
+ *                     shadow rays, with what each found) to FILE ("{n}" is
+ *                     replaced as for --output), which raytracer-replay can
+ *                     replay against other accelerators. Not available with
+ *                     --daemon or --workers
+ *     --trace=FILE    record a timeline of what each thread did (loading
+ *                     the scene, building accelerators, rendering tiles)
+ *                     and write it to FILE in Chrome's trace format, for
+ *                     chrome://tracing or ui.perfetto.dev. With --daemon,
+ *                     the daemon (started with --trace) writes its own
+ *                     timeline to FILE on its machine instead
+ *     --memory-report  once every job is rendered, print how much memory
+ *                     each part of the scene (images, terrain triangles,
+ *                     accelerators, the compiled scene) and each buffer
+ *                     kept between jobs uses. The report written by
+ *                     --report always includes it. Not available with
+ *                     --daemon or --workers
+ *     --time-budget=SECONDS  render each job for about SECONDS, rather than
+ *                     taking a fixed number of samples. A quick pre-pass
+ *                     measures how long each tile takes and how noisy it
+ *                     is, then the time left is shared out so noisy tiles
+ *                     which are quick to sample get the most samples (see
+ *                     BudgetedRenderer.h). Sampling is always random, and
+ *                     "samples" is the most any pixel is given, e.g.
+ *                     "--time-budget=10 samples=256". The samples per pixel
+ *                     achieved are printed and included in the report. Not
+ *                     available with --daemon or --workers
+ *
+ * Only one of --edit, --cost-maps, --record-rays, --time-budget, --checkpoint,
+ * --cache and --mapped can be given, and --gbuffer cannot be used with the
+ * first three. Options which would be ignored are rejected.
+ */
+#ifndef DW_RAYTRACER_GUI_ENABLED
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+#include <cstdio>
+#include <csignal>
+#include "DemoScene.h"
+#include "RenderSettings.h"
+#include "MappedImage.h"
+#include "TGA.h"
+#include "Common.h"
+#include "TileRenderer.h"
+#include "RenderProtocol.h"
+#include "Socket.h"
+#include "TileCoordinator.h"
+#include "AccumulationBuffer.h"
+#include "GBuffer.h"
+#include "TileDependencies.h"
+#include "RenderCache.h"
+#include "Profiling.h"
+#include "CostMap.h"
+#include "Tracing.h"
+#include "MemoryReport.h"
+#include "BudgetedRenderer.h"
+
+using namespace raytracer;
+
+/* Rows rendered before they are written to the output file. */
+static const int OUTPUT_BAND_HEIGHT = 16;
+static const double DEFAULT_CHECKPOINT_INTERVAL = 60.0;
+
+/* Set when the program is asked to terminate, so checkpointed renders can
+ * save their progress before exiting. */
+static volatile sig_atomic_t terminationRequested = 0;
+
+void requestTermination(int)
+{
+    terminationRequested = 1;
+}
+
+struct CLIOptions
+{
+    std::string outputFilename;
+    std::string jobsFilename;
+    std::string reportFilename;
+    std::string mappedFilename;
+    std::string daemonSocket;
+    std::string checkpointFilename;
+    double checkpointInterval;
+    std::string cacheDirectory;
+    std::string compiledSceneFilename;
+    // Prefix of the cost map files to write, if any
+    std::string costMapPrefix;
+    // File to record every ray query of the render to, if any
+    std::string rayLogFilename;
+    // File to write the timeline of the render to, if any
+    std::string traceFilename;
+    // Zero if there is no limit on memory used by images
+    double imageBudgetMegabytes;
+    // Zero if jobs take a fixed number of samples rather than being
+    // rendered for a given time
+    double timeBudgetSeconds;
+    // Addresses of daemons to distribute tiles between
+    std::vector<std::string> workers;
+    // Changes to make to the scene after the job is rendered
+    std::vector<std::string> edits;
+    bool compress;
+    bool useGBuffer;
+    bool printMemoryReport;
+    // name=value settings given on the command line
+    std::vector<std::string> settings;
+
+    CLIOptions() : checkpointInterval(DEFAULT_CHECKPOINT_INTERVAL), imageBudgetMegabytes(0),
+        timeBudgetSeconds(0), compress(false), useGBuffer(false), printMemoryReport(false)
+    {
+    }
+};
+
+/* Result of a single render, used to generate the timing report. */
+struct JobResult
+{
+    std::string settings;
+    std::string outputFilename;
+    bool success;
+    double seconds;
+    uint64_t primaryRays;
+    uint64_t reflectedRays;
+    uint64_t refractedRays;
+    uint64_t shadowRays;
+    // Tiles read from the render cache rather than rendered
+    unsigned int tilesFromCache;
+    // Time taken to build the terrain's accelerator, if this job built it,
+    // what was built and its statistics as a JSON object
+    double acceleratorBuildSeconds;
+    std::string acceleratorConfiguration;
+    std::string acceleratorStatistics;
+    // Time spent in each stage of rendering, if profiling is compiled in
+    profiling::StageCounters stages;
+    // Samples achieved as a JSON object, if rendered with a time budget
+    std::string timeBudget;
+
+    JobResult() : success(false), seconds(0), primaryRays(0), reflectedRays(0),
+        refractedRays(0), shadowRays(0), tilesFromCache(0), acceleratorBuildSeconds(0)
+    {
+    }
+};
+
+bool parseArguments(int argc, char* argv[], CLIOptions& options)
+{
+    for (int i = 1; (i < argc); i++)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            options.settings.push_back(arg);
+            continue;
+        }
+        size_t separator = arg.find('=');
+        std::string name = arg.substr(2, separator - 2);
+        std::string value = (separator != std::string::npos) ? arg.substr(separator + 1) : "";
+        if (name == "output") options.outputFilename = value;
+        else if (name == "jobs") options.jobsFilename = value;
+        else if (name == "report") options.reportFilename = value;
+        else if (name == "mapped") options.mappedFilename = value;
+        else if (name == "daemon") options.daemonSocket = value;
+        else if (name == "checkpoint") options.checkpointFilename = value;
+        else if (name == "checkpoint-interval") options.checkpointInterval = atof(value.c_str());
+        else if (name == "workers")
+        {
+            std::stringstream addresses(value);
+            std::string address;
+            while (std::getline(addresses, address, ','))
+                options.workers.push_back(address);
+        }
+        else if (name == "cache") options.cacheDirectory = value;
+        else if (name == "compiled-scene") options.compiledSceneFilename = value;
+        else if (name == "image-budget") options.imageBudgetMegabytes = atof(value.c_str());
+        else if (name == "edit") options.edits.push_back(value);
+        else if (name == "compress") options.compress = true;
+        else if (name == "gbuffer") options.useGBuffer = true;
+        else if (name == "cost-maps") options.costMapPrefix = value;
+        else if (name == "record-rays") options.rayLogFilename = value;
+        else if (name == "trace") options.traceFilename = value;
+        else if (name == "memory-report") options.printMemoryReport = true;
+        else if (name == "time-budget") options.timeBudgetSeconds = atof(value.c_str());
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Returns false, printing why, if options were given which the way the jobs
+ * are rendered would ignore. Each of --edit, --cost-maps, --record-rays,
+ * --time-budget, --checkpoint, --cache and --mapped renders jobs its own
+ * way, so only one can be given. Jobs rendered by daemons can only be
+ * written through --mapped. */
+bool checkOptionCombinations(const CLIOptions& options)
+{
+    std::vector<std::string> renderModes;
+    if (!options.edits.empty()) renderModes.push_back("--edit");
+    if (!options.costMapPrefix.empty()) renderModes.push_back("--cost-maps");
+    if (!options.rayLogFilename.empty()) renderModes.push_back("--record-rays");
+    if (options.timeBudgetSeconds > 0) renderModes.push_back("--time-budget");
+    if (!options.checkpointFilename.empty()) renderModes.push_back("--checkpoint");
+    if (!options.cacheDirectory.empty()) renderModes.push_back("--cache");
+    if (!options.mappedFilename.empty()) renderModes.push_back("--mapped");
+    if (renderModes.size() > 1)
+    {
+        std::cerr << renderModes[0] << " cannot be used with " << renderModes[1] << std::endl;
+        return false;
+    }
+    if (options.useGBuffer && (!options.edits.empty() || !options.costMapPrefix.empty() ||
+        !options.rayLogFilename.empty()))
+    {
+        std::cerr << "--gbuffer cannot be used with " << renderModes[0] << std::endl;
+        return false;
+    }
+
+    if (!options.daemonSocket.empty() && !options.workers.empty())
+    {
+        std::cerr << "--daemon cannot be used with --workers" << std::endl;
+        return false;
+    }
+    bool useDaemon = !options.daemonSocket.empty() || !options.workers.empty();
+    std::string localOption;
+    if (!renderModes.empty() && renderModes[0] != "--mapped")
+        localOption = renderModes[0];
+    else if (options.useGBuffer)
+        localOption = "--gbuffer";
+    else if (options.printMemoryReport)
+        localOption = "--memory-report";
+    if (useDaemon && !localOption.empty())
+    {
+        std::cerr << localOption << " needs jobs to be rendered here" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/* Expand list of name=value pairs, where values may be comma-separated
+ * lists, into every combination of settings. Each combination is applied
+ * to a copy of 'base' and added to 'jobs'. */
+bool expandJobs(const RenderSettings& base, const std::vector<std::string>& pairs,
+    std::vector<RenderSettings>& jobs)
+{
+    std::vector<RenderSettings> combinations(1, base);
+    for (unsigned int i = 0; (i < pairs.size()); i++)
+    {
+        size_t separator = pairs[i].find('=');
+        if (separator == std::string::npos)
+        {
+            std::cerr << "Invalid setting (expected name=value): " << pairs[i] << std::endl;
+            return false;
+        }
+        std::string name = pairs[i].substr(0, separator);
+        std::stringstream values(pairs[i].substr(separator + 1));
+        std::string value;
+        std::vector<RenderSettings> expanded;
+        while (std::getline(values, value, ','))
+        {
+            for (unsigned int j = 0; (j < combinations.size()); j++)
+            {
+                RenderSettings settings = combinations[j];
+                if (!setRenderSetting(settings, name, value))
+                {
+                    std::cerr << "Invalid setting: " << name << "=" << value << std::endl;
+                    return false;
+                }
+                expanded.push_back(settings);
+            }
+        }
+        combinations = expanded;
+    }
+    jobs.insert(jobs.end(), combinations.begin(), combinations.end());
+    return true;
+}
+
+bool readJobFile(const std::string& filename, const RenderSettings& base,
+    std::vector<RenderSettings>& jobs)
+{
+    std::ifstream file(filename.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Could not open job file: " << filename << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        // Skip comments and blank lines
+        line = line.substr(0, line.find('#'));
+        std::stringstream stream(line);
+        std::vector<std::string> pairs;
+        std::string pair;
+        while (stream >> pair)
+            pairs.push_back(pair);
+        if (!pairs.empty() && !expandJobs(base, pairs, jobs))
+            return false;
+    }
+    return true;
+}
+
+/* Filename for job with given index. "{n}" in the filename is replaced
+ * with the job number, which is otherwise added before the extension
+ * if there are many jobs. */
+std::string filenameForJob(std::string filename, unsigned int jobIndex,
+    unsigned int numJobs)
+{
+    std::string number = common::toString(jobIndex + 1);
+    size_t placeholder = filename.find("{n}");
+    if (placeholder != std::string::npos)
+    {
+        filename.replace(placeholder, 3, number);
+    }
+    else if (numJobs > 1)
+    {
+        // Insert job number before the file extension so outputs are unique
+        size_t extension = filename.rfind('.');
+        if (extension == std::string::npos)
+            extension = filename.size();
+        filename.insert(extension, "-" + number);
+    }
+    return filename;
+}
+
+/* Output filename for job with given index. */
+std::string outputFilenameForJob(const CLIOptions& options, unsigned int jobIndex,
+    unsigned int numJobs)
+{
+    std::string filename = options.outputFilename;
+    if (filename.empty())
+        filename = (numJobs > 1) ? "render-{n}.tga" : "render.tga";
+    return filenameForJob(filename, jobIndex, numJobs);
+}
+
+/* Render image, streaming bands of rows to the output file as they finish. */
+bool renderStreamed(Raytracer* renderer, const RenderSettings& settings,
+    GBuffer* gbuffer, const std::string& filename, bool compress)
+{
+    tga::StreamWriter writer;
+    if (!writer.open(filename, settings.width, settings.height, compress))
+        return false;
+    Image band(settings.width, OUTPUT_BAND_HEIGHT);
+    for (int firstRow = 0; (firstRow < settings.height); firstRow += OUTPUT_BAND_HEIGHT)
+    {
+        int rows = std::min(OUTPUT_BAND_HEIGHT, settings.height - firstRow);
+        renderTile(renderer, settings, Tile(0, firstRow, settings.width, rows),
+            &band, 0, firstRow, gbuffer);
+        if (!writer.writeRows(band, 0, rows))
+            return false;
+    }
+    return writer.close();
+}
+
+/* Render image into memory-mapped framebuffer, then write it to output file. */
+bool renderMapped(Raytracer* renderer, const RenderSettings& settings,
+    GBuffer* gbuffer, const std::string& framebufferFilename, const std::string& filename, bool compress)
+{
+    MappedImage framebuffer;
+    if (!framebuffer.create(framebufferFilename, settings.width, settings.height))
+        return false;
+    for (int y = 0; (y < settings.height); y++)
+    {
+        renderTile(renderer, settings, Tile(0, y, settings.width, 1), &framebuffer,
+            0, 0, gbuffer);
+        framebuffer.rowsFinished(y, 1);
+    }
+    return framebuffer.writeTGA(filename, compress);
+}
+
+/* Render image, accumulating samples in a buffer which is saved to the
+ * checkpoint file every so often. Carries on from the checkpoint if it
+ * is of the same image and was saved with the same scene key. The image is written to the output file once
+ * every sample has been taken. */
+bool renderCheckpointed(Raytracer* renderer, const RenderSettings& settings,
+    GBuffer* gbuffer, const std::string& checkpointFilename, const std::string& sceneKey,
+    double checkpointInterval, const std::string& filename, bool compress)
+{
+    AccumulationBuffer buffer;
+    if (buffer.load(checkpointFilename, sceneKey) && buffer.canContinue(settings))
+    {
+        buffer.continueWith(settings);
+        std::cout << "    resuming from " << checkpointFilename << " ("
+            << buffer.pixelsComplete() << " of " << (settings.width * settings.height)
+            << " pixels complete)" << std::endl;
+    }
+    else
+    {
+        buffer.reset(settings);
+    }
+
+    double lastCheckpoint = common::wallClockSeconds();
+    for (int y = 0; (y < settings.height && !buffer.isComplete()); y++)
+    {
+        accumulateTile(renderer, &buffer, Tile(0, y, settings.width, 1), gbuffer);
+        double now = common::wallClockSeconds();
+        if (terminationRequested || now - lastCheckpoint >= checkpointInterval)
+        {
+            if (!buffer.save(checkpointFilename, sceneKey))
+            {
+                std::cerr << "Could not save checkpoint to " << checkpointFilename << std::endl;
+                return false;
+            }
+            lastCheckpoint = now;
+            if (terminationRequested)
+            {
+                std::cerr << "    stopped, progress saved to " << checkpointFilename << std::endl;
+                return false;
+            }
+        }
+    }
+    // Keep final checkpoint, so more samples can be added later
+    if (!buffer.save(checkpointFilename, sceneKey))
+        return false;
+
+    tga::StreamWriter writer;
+    if (!writer.open(filename, settings.width, settings.height, compress))
+        return false;
+    Image band(settings.width, OUTPUT_BAND_HEIGHT);
+    for (int firstRow = 0; (firstRow < settings.height); firstRow += OUTPUT_BAND_HEIGHT)
+    {
+        int rows = std::min(OUTPUT_BAND_HEIGHT, settings.height - firstRow);
+        for (int y = 0; (y < rows); y++)
+            for (int x = 0; (x < settings.width); x++)
+                band.set(x, y, buffer.resolve(x, firstRow + y));
+        if (!writer.writeRows(band, 0, rows))
+            return false;
+    }
+    return writer.close();
+}
+
+/* Read comma-separated list of floats into 'values'. Returns false if
+ * it does not hold exactly 'count' of them. */
+bool parseFloats(const std::string& text, unsigned int count, float* values)
+{
+    std::stringstream stream(text);
+    std::string value;
+    unsigned int numValues = 0;
+    while (std::getline(stream, value, ','))
+    {
+        if (numValues == count)
+            return false;
+        char* end = NULL;
+        values[numValues++] = static_cast<float>(strtod(value.c_str(), &end));
+        if (value.empty() || *end != '\0')
+            return false;
+    }
+    return (numValues == count);
+}
+
+/* Change sphere as described by an edit ("SPHERE:PROPERTY=VALUE", where
+ * spheres are numbered from 1). Regions of the scene which changed are
+ * added to 'changedRegions', and 'shapeChanged' is set to false if only
+ * the sphere's material changed. Returns false if the edit is invalid. */
+bool applySphereEdit(DemoScene& scene, const std::string& edit,
+    std::vector<AABB>& changedRegions, bool& shapeChanged)
+{
+    size_t colon = edit.find(':');
+    size_t equals = edit.find('=');
+    if (colon == std::string::npos || equals == std::string::npos || equals < colon)
+        return false;
+    unsigned int sphereIndex = atoi(edit.substr(0, colon).c_str());
+    if (sphereIndex < 1 || sphereIndex > scene.spheres.size())
+        return false;
+    Sphere* sphere = scene.spheres[sphereIndex - 1];
+    std::string property = edit.substr(colon + 1, equals - colon - 1);
+    std::string value = edit.substr(equals + 1);
+
+    // Whatever is changed, the sphere's old surroundings are affected
+    changedRegions.push_back(sphere->getBoundingBox());
+    float values[3];
+    shapeChanged = true;
+    if (property == "centre" && parseFloats(value, 3, values))
+    {
+        sphere->setCentre(Vector3(values[0], values[1], values[2]));
+    }
+    else if (property == "move" && parseFloats(value, 3, values))
+    {
+        sphere->setCentre(sphere->getCentre() + Vector3(values[0], values[1], values[2]));
+    }
+    else if (property == "radius" && parseFloats(value, 1, values) && values[0] > 0)
+    {
+        sphere->setRadius(values[0]);
+    }
+    else if ((property == "colour" && parseFloats(value, 3, values)) ||
+        (property == "reflect" && parseFloats(value, 1, values)))
+    {
+        const Material* oldMaterial = sphere->getMaterial();
+        Material* material = (oldMaterial) ? new Material(*oldMaterial) : new Material();
+        if (property == "colour")
+            material->setColour(Colour(values[0], values[1], values[2]));
+        else
+            material->setReflectivity(values[0]);
+        sphere->setMaterial(material);
+        delete oldMaterial;
+        shapeChanged = false;
+    }
+    else
+    {
+        changedRegions.pop_back();
+        return false;
+    }
+    changedRegions.push_back(sphere->getBoundingBox());
+    return true;
+}
+
+/* Render image, recording the cost of each pixel, then write it and the
+ * cost maps. */
+bool renderCostMapped(Raytracer* renderer, const RenderSettings& settings,
+    const std::string& costMapPrefix, const std::string& filename, bool compress)
+{
+    Image image(settings.width, settings.height);
+    CostMap costs(settings.width, settings.height);
+    renderCostedTile(renderer, settings, Tile(0, 0, settings.width, settings.height),
+        &image, &costs);
+    for (unsigned int i = 0; (i < CostMap::NUM_METRICS); i++)
+    {
+        CostMap::Metric metric = static_cast<CostMap::Metric>(i);
+        std::cout << "    " << CostMap::metricName(metric) << " per pixel: mean "
+            << costs.mean(metric) << ", max " << costs.maximum(metric) << std::endl;
+    }
+    return costs.writeAll(costMapPrefix) && tga::writeTGAFile(filename, image, compress);
+}
+
+/* Render image on this thread, logging every ray query made, then write
+ * it and the ray log. */
+bool renderRecorded(Raytracer* renderer, const RenderSettings& settings,
+    const std::string& rayLogFilename, const std::string& filename, bool compress)
+{
+    Image image(settings.width, settings.height);
+    RayLog log;
+    log.reset(settings);
+    renderer->setRayLog(&log);
+    for (int y = 0; (y < settings.height); y++)
+    {
+        for (int x = 0; (x < settings.width); x++)
+        {
+            Colour colour;
+            if (!renderer->renderPixel(x, y, settings.width, settings.height,
+                settings.samplingMethod, settings.numSamples, colour))
+                colour = BACKGROUND_COLOUR;
+            image.set(x, y, colour);
+        }
+    }
+    renderer->setRayLog(NULL);
+    std::cout << "    recorded " << log.getQueries().size() << " ray queries (";
+    for (unsigned int i = 0; (i < NUM_RAY_QUERY_TYPES); i++)
+    {
+        RayQueryType type = static_cast<RayQueryType>(i);
+        std::cout << ((i > 0) ? ", " : "") << log.count(type) << " " << rayQueryTypeName(type);
+    }
+    std::cout << ") to " << rayLogFilename << std::endl;
+    return log.save(rayLogFilename) && tga::writeTGAFile(filename, image, compress);
+}
+
+/* Render image for as long as the time budget allows, giving each tile as
+ * many samples as BudgetedRenderer decides, then write it and report the
+ * samples achieved. */
+bool renderBudgeted(Raytracer* renderer, const RenderSettings& settings,
+    GBuffer* gbuffer, double budgetSeconds, const std::string& filename, bool compress,
+    BudgetReport& report)
+{
+    AccumulationBuffer buffer;
+    buffer.reset(settings);
+    Image image(settings.width, settings.height);
+    BudgetedRenderer budgetedRenderer(renderer, &buffer, gbuffer);
+    if (!budgetedRenderer.render(budgetSeconds, &image, report))
+        return false;
+    std::cout << report.format("    ") << std::endl;
+    return tga::writeTGAFile(filename, image, compress);
+}
+
+/* Render image, recording which part of the scene each tile depends on,
+ * so it can be updated with renderAffectedTiles() after the scene changes. */
+bool renderTracked(Raytracer* renderer, TileDependencies* dependencies,
+    Image* image, const std::string& filename, bool compress)
+{
+    renderTrackedTiles(renderer, dependencies, image);
+    return tga::writeTGAFile(filename, *image, compress);
+}
+
+/* Render image, reading any tiles rendered before from the cache and
+ * storing those which are rendered now. Stops once termination is
+ * requested, keeping the tiles finished so far in the cache. The number
+ * of tiles read from the cache is stored in 'tilesFromCache'. */
+bool renderCached(Raytracer* renderer, const RenderSettings& settings, GBuffer* gbuffer,
+    RenderCache& cache, const std::string& key, const std::string& filename,
+    bool compress, unsigned int& tilesFromCache)
+{
+    Image image(settings.width, settings.height);
+    std::vector<bool> cachedTiles;
+    protocol::RenderSummary cachedSummary;
+    tilesFromCache = cache.lookup(key, settings, &image, cachedTiles, cachedSummary);
+    TileList tiles = splitIntoTiles(Tile(0, 0, settings.width, settings.height),
+        RenderCache::TILE_SIZE);
+    if (tilesFromCache > 0)
+    {
+        uint64_t totalRays = cachedSummary.primaryRays + cachedSummary.reflectedRays
+            + cachedSummary.refractedRays + cachedSummary.shadowRays;
+        std::cout << "    found " << tilesFromCache << " of " << tiles.size()
+            << " tiles in cache " << key << " (rendered in " << cachedSummary.seconds
+            << " seconds using " << totalRays << " rays)" << std::endl;
+    }
+
+    // Render tiles which aren't cached, then add them to the cache
+    double start = common::wallClockSeconds();
+    std::vector<bool> renderedTiles(tiles.size(), false);
+    bool anyRendered = false;
+    for (unsigned int i = 0; (i < tiles.size() && !terminationRequested); i++)
+    {
+        if (cachedTiles[i])
+            continue;
+        renderTile(renderer, settings, tiles[i], &image, 0, 0, gbuffer);
+        renderedTiles[i] = true;
+        anyRendered = true;
+    }
+    protocol::RenderSummary renderedSummary;
+    renderedSummary.seconds = common::wallClockSeconds() - start;
+    renderedSummary.primaryRays = renderer->primaryRays();
+    renderedSummary.reflectedRays = renderer->reflectedRays();
+    renderedSummary.refractedRays = renderer->refractedRays();
+    renderedSummary.shadowRays = renderer->shadowRays();
+    if (anyRendered && !cache.store(key, settings, image, renderedTiles, renderedSummary))
+        std::cerr << "    could not add render to cache" << std::endl;
+    if (terminationRequested)
+    {
+        std::cerr << "    stopped, finished tiles kept in cache" << std::endl;
+        return false;
+    }
+    return tga::writeTGAFile(filename, image, compress);
+}
+
+/* Send job to render daemon and write the tiles it sends back into
+ * 'target'. Ray counts and the time taken are stored in 'summary'. */
+bool renderWithDaemon(const std::string& socketPath, const RenderSettings& settings,
+    Framebuffer* target, protocol::RenderSummary& summary)
+{
+    int connection = net::connectToAddress(socketPath);
+    if (connection < 0)
+    {
+        std::cerr << "Could not connect to daemon at " << socketPath << std::endl;
+        return false;
+    }
+    protocol::RenderRequest request;
+    request.settings = settings;
+    std::string line;
+    bool success = net::sendLine(connection, protocol::formatRenderRequest(request)) &&
+        net::receiveLine(connection, line);
+    int numTiles = 0;
+    if (success && sscanf(line.c_str(), "OK %d", &numTiles) != 1)
+    {
+        std::cerr << "Daemon: " << line << std::endl;
+        success = false;
+    }
+    for (int i = 0; (success && i < numTiles); i++)
+    {
+        Tile tile;
+        success = net::receiveLine(connection, line) &&
+            protocol::parseTileHeader(line, tile) &&
+            protocol::receiveTilePixels(connection, tile, target);
+    }
+    success = success && net::receiveLine(connection, line) &&
+        protocol::parseRenderSummary(line, summary);
+    net::closeSocket(connection);
+    return success;
+}
+
+/* Render job by sharing its tiles between workers. */
+bool renderDistributed(TileCoordinator& coordinator, const RenderSettings& settings,
+    Framebuffer* target, protocol::RenderSummary& summary)
+{
+    bool success = coordinator.render(settings, target);
+    const TileCoordinator::Statistics& statistics = coordinator.lastRenderStatistics();
+    summary.primaryRays = statistics.primaryRays;
+    summary.reflectedRays = statistics.reflectedRays;
+    summary.refractedRays = statistics.refractedRays;
+    summary.shadowRays = statistics.shadowRays;
+    std::cout << "    tiles per worker:";
+    for (unsigned int i = 0; (i < statistics.tilesPerWorker.size()); i++)
+        std::cout << " " << statistics.tilesPerWorker[i];
+    std::cout << " (" << statistics.tilesReissued << " reissued, "
+        << statistics.workersFailed << " workers failed)" << std::endl;
+    return success;
+}
+
+/* Render job using the daemon or workers, then write result to output file. */
+bool renderRemotely(const CLIOptions& options, TileCoordinator& coordinator,
+    const RenderSettings& settings, const std::string& filename,
+    protocol::RenderSummary& summary)
+{
+    Image* image = NULL;
+    MappedImage framebuffer;
+    Framebuffer* target = NULL;
+    if (!options.mappedFilename.empty())
+    {
+        if (!framebuffer.create(options.mappedFilename, settings.width, settings.height))
+            return false;
+        target = &framebuffer;
+    }
+    else
+    {
+        image = new Image(settings.width, settings.height);
+        target = image;
+    }
+    bool success = (options.workers.empty()) ?
+        renderWithDaemon(options.daemonSocket, settings, target, summary) :
+        renderDistributed(coordinator, settings, target, summary);
+    if (success)
+        success = (image) ? tga::writeTGAFile(filename, *image, options.compress) :
+            framebuffer.writeTGA(filename, options.compress);
+    delete image;
+    return success;
+}
+
+/* Ask the render daemon to write the timeline it has traced to a file on
+ * its machine. */
+bool requestDaemonTrace(const std::string& socketPath, const std::string& filename)
+{
+    int connection = net::connectToAddress(socketPath);
+    if (connection < 0)
+        return false;
+    std::string line;
+    bool success = net::sendLine(connection, "TRACE " + filename) &&
+        net::receiveLine(connection, line) && line.compare(0, 3, "OK ") == 0;
+    net::closeSocket(connection);
+    if (success)
+        std::cout << "Daemon wrote " << line.substr(3) << " traced events to "
+            << filename << std::endl;
+    return success;
+}
+
+/* 'memory' is the memory report as a JSON object, or empty if there is none. */
+bool writeReport(const std::string& filename, double sceneLoadSeconds,
+    const std::vector<JobResult>& results, const std::string& memory)
+{
+    std::ofstream report(filename.c_str());
+    if (!report.is_open())
+        return false;
+    report << "{\n  \"sceneLoadSeconds\": " << sceneLoadSeconds << ",\n  \"jobs\": [\n";
+    for (unsigned int i = 0; (i < results.size()); i++)
+    {
+        const JobResult& result = results[i];
+        uint64_t totalRays = result.primaryRays + result.reflectedRays
+            + result.refractedRays + result.shadowRays;
+        report << "    {\n"
+            << "      \"settings\": \"" << common::escapeJSON(result.settings) << "\",\n"
+            << "      \"output\": \"" << common::escapeJSON(result.outputFilename) << "\",\n"
+            << "      \"success\": " << (result.success ? "true" : "false") << ",\n"
+            << "      \"seconds\": " << result.seconds << ",\n"
+            << "      \"primaryRays\": " << result.primaryRays << ",\n"
+            << "      \"reflectedRays\": " << result.reflectedRays << ",\n"
+            << "      \"refractedRays\": " << result.refractedRays << ",\n"
+            << "      \"shadowRays\": " << result.shadowRays << ",\n"
+            << "      \"totalRays\": " << totalRays << ",\n"
+            << "      \"tilesFromCache\": " << result.tilesFromCache << ",\n"
+            << "      \"acceleratorBuildSeconds\": " << result.acceleratorBuildSeconds;
+        if (!result.acceleratorStatistics.empty())
+        {
+            report << ",\n      \"accelerator\": \""
+                << common::escapeJSON(result.acceleratorConfiguration) << "\",\n"
+                << "      \"acceleratorStatistics\": " << result.acceleratorStatistics;
+        }
+        if (profiling::ENABLED)
+        {
+            report << ",\n      \"stageSeconds\": {";
+            for (unsigned int s = 0; (s < profiling::NUM_STAGES); s++)
+                report << ((s > 0) ? ", " : " ") << "\""
+                    << profiling::stageName(static_cast<profiling::Stage>(s)) << "\": "
+                    << (result.stages.cycles[s] / common::cyclesPerSecond());
+            report << " }";
+        }
+        if (!result.timeBudget.empty())
+            report << ",\n      \"timeBudget\": " << result.timeBudget;
+        report << "\n"
+            << "    }" << ((i + 1 < results.size()) ? "," : "") << "\n";
+    }
+    report << "  ]";
+    if (!memory.empty())
+        report << ",\n  \"memory\": " << memory;
+    report << "\n}\n";
+    return report.good();
+}
+
+int main(int argc, char* argv[])
+{
+    // Seed random number generator for varying results
+    srand(time(NULL));
+
+    CLIOptions options;
+    if (!parseArguments(argc, argv, options))
+        return 1;
+    if (!options.traceFilename.empty())
+    {
+        tracing::enable();
+        tracing::setThreadName("main");
+    }
+    // Give checkpointed and cached renders a chance to save their progress
+    if (!options.checkpointFilename.empty() || !options.cacheDirectory.empty())
+    {
+        signal(SIGINT, requestTermination);
+        signal(SIGTERM, requestTermination);
+    }
+    // Build list of jobs to render
+    std::vector<RenderSettings> jobs;
+    if (!options.jobsFilename.empty())
+    {
+        // Settings given on the command line are the defaults for every job
+        std::vector<RenderSettings> bases;
+        if (!expandJobs(RenderSettings(), options.settings, bases))
+            return 1;
+        for (unsigned int i = 0; (i < bases.size()); i++)
+            if (!readJobFile(options.jobsFilename, bases[i], jobs))
+                return 1;
+    }
+    else if (!expandJobs(RenderSettings(), options.settings, jobs))
+    {
+        return 1;
+    }
+    if (jobs.empty())
+    {
+        std::cerr << "No jobs to render." << std::endl;
+        return 1;
+    }
+    if (!checkOptionCombinations(options))
+        return 1;
+    if (!options.edits.empty() && jobs.size() > 1)
+    {
+        std::cerr << "--edit needs a single job" << std::endl;
+        return 1;
+    }
+    // Budgeted renders take as many random samples as they have time for,
+    // up to the number asked for
+    for (unsigned int i = 0; (options.timeBudgetSeconds > 0 && i < jobs.size()); i++)
+        jobs[i].samplingMethod = RANDOM_MULTISAMPLING;
+
+    // Load scene once and reuse it for every job. The daemon has its own
+    // copy of the scene, so there is nothing to load when using it.
+    bool useDaemon = !options.daemonSocket.empty() || !options.workers.empty();
+    TileCoordinator coordinator(options.workers);
+    double start = common::wallClockSeconds();
+    DemoScene scene;
+    scene.renderer = NULL;
+    scene.compiledScene = NULL;
+    ResourceManager::getInstance()->setImageMemoryBudget(
+        static_cast<size_t>(options.imageBudgetMegabytes * 1024 * 1024));
+    if (!useDaemon)
+    {
+        scene = constructDemoScene(options.compiledSceneFilename);
+        if (!scene.renderer)
+        {
+            std::cerr << "Could not load scene" << std::endl;
+            return 1;
+        }
+    }
+    double sceneLoadSeconds = common::wallClockSeconds() - start;
+    if (!useDaemon)
+        std::cout << "Loaded scene in " << sceneLoadSeconds << " seconds" << std::endl;
+
+    GBuffer gbuffer;
+    RenderCache* cache = NULL;
+    if (!options.cacheDirectory.empty())
+        cache = new RenderCache(options.cacheDirectory);
+    // Image rendered for the job and what its tiles depend on, kept so it
+    // can be updated after each edit
+    TileDependencies dependencies(scene.boundary);
+    Image* trackedImage = NULL;
+    unsigned int numOutputs = jobs.size() + options.edits.size();
+    std::vector<JobResult> results;
+    bool allSucceeded = true;
+    for (unsigned int i = 0; (i < jobs.size()); i++)
+    {
+        const RenderSettings& settings = jobs[i];
+        tracing::ScopedEvent jobEvent("render job");
+        JobResult result;
+        result.settings = formatRenderSettings(settings);
+        result.outputFilename = outputFilenameForJob(options, i, numOutputs);
+        std::cout << "[" << (i + 1) << "/" << jobs.size() << "] "
+            << result.settings << std::endl;
+
+        start = common::wallClockSeconds();
+        if (useDaemon)
+        {
+            protocol::RenderSummary summary;
+            result.success = renderRemotely(options, coordinator, settings,
+                result.outputFilename, summary);
+            result.primaryRays = summary.primaryRays;
+            result.reflectedRays = summary.reflectedRays;
+            result.refractedRays = summary.refractedRays;
+            result.shadowRays = summary.shadowRays;
+        }
+        else
+        {
+            scene.renderer->resetRayCount();
+            bool acceleratorBuilt = (builtTerrainAccelerator(scene, settings) != NULL);
+            result.success = applyRenderSettings(scene, settings);
+            // Build the accelerator first, so it is not timed as traversal
+            // or taken out of the time budget
+            if ((profiling::ENABLED || options.timeBudgetSeconds > 0) && result.success)
+                terrainAccelerator(scene, settings);
+            profiling::reset();
+            // Surfaces cached by previous jobs are only kept if they match
+            GBuffer* jobGBuffer = NULL;
+            if (options.useGBuffer &&
+                gbuffer.prepare(settings, primaryRayGeometryHash(scene, settings)))
+            {
+                jobGBuffer = &gbuffer;
+                if (gbuffer.samplesCached() > 0)
+                    std::cout << "    relighting " << gbuffer.samplesCached()
+                        << " cached primary ray hits" << std::endl;
+            }
+            if (!result.success)
+            {
+                std::cerr << "Scene has no such camera or terrain" << std::endl;
+            }
+            else if (!options.edits.empty())
+            {
+                dependencies.reset(settings);
+                trackedImage = new Image(settings.width, settings.height);
+                result.success = renderTracked(scene.renderer, &dependencies,
+                    trackedImage, result.outputFilename, options.compress);
+            }
+            else if (!options.costMapPrefix.empty())
+                result.success = renderCostMapped(scene.renderer, settings,
+                    filenameForJob(options.costMapPrefix, i, jobs.size()),
+                    result.outputFilename, options.compress);
+            else if (!options.rayLogFilename.empty())
+                result.success = renderRecorded(scene.renderer, settings,
+                    filenameForJob(options.rayLogFilename, i, jobs.size()),
+                    result.outputFilename, options.compress);
+            else if (options.timeBudgetSeconds > 0)
+            {
+                BudgetReport report;
+                result.success = renderBudgeted(scene.renderer, settings, jobGBuffer,
+                    options.timeBudgetSeconds, result.outputFilename, options.compress, report);
+                result.timeBudget = report.formatJSON();
+            }
+            else if (!options.checkpointFilename.empty())
+                result.success = renderCheckpointed(scene.renderer, settings, jobGBuffer,
+                    filenameForJob(options.checkpointFilename, i, jobs.size()),
+                    checkpointKey(scene, settings), options.checkpointInterval,
+                    result.outputFilename, options.compress);
+            else if (cache)
+                result.success = renderCached(scene.renderer, settings, jobGBuffer, *cache,
+                    renderCacheKey(scene, settings), result.outputFilename, options.compress,
+                    result.tilesFromCache);
+            else if (options.mappedFilename.empty())
+                result.success = renderStreamed(scene.renderer, settings, jobGBuffer,
+                    result.outputFilename, options.compress);
+            else
+                result.success = renderMapped(scene.renderer, settings, jobGBuffer,
+                    options.mappedFilename, result.outputFilename, options.compress);
+            result.primaryRays = scene.renderer->primaryRays();
+            result.reflectedRays = scene.renderer->reflectedRays();
+            result.refractedRays = scene.renderer->refractedRays();
+            result.shadowRays = scene.renderer->shadowRays();
+            result.stages = profiling::totals();
+            // Terrain accelerators are built by the first render to use them
+            const Accelerator* accelerator = builtTerrainAccelerator(scene, settings);
+            if (!acceleratorBuilt && accelerator)
+            {
+                AcceleratorStatistics statistics = accelerator->statistics();
+                result.acceleratorBuildSeconds = accelerator->getBuildSeconds();
+                result.acceleratorConfiguration = formatAcceleratorConfiguration(
+                    accelerator->getType(), accelerator->getParameters());
+                result.acceleratorStatistics = statistics.formatJSON();
+                std::cout << "    built " << acceleratorName(settings.accelerator)
+                    << " accelerator (" << result.acceleratorConfiguration << ") in "
+                    << result.acceleratorBuildSeconds << " seconds\n"
+                    << statistics.format("      ") << std::flush;
+            }
+        }
+        result.seconds = common::wallClockSeconds() - start;
+        results.push_back(result);
+
+        if (result.success)
+            std::cout << "    wrote " << result.outputFilename << " in "
+                << result.seconds << " seconds" << std::endl;
+        else
+            std::cerr << "    failed to render " << result.outputFilename << std::endl;
+        if (profiling::ENABLED && result.stages.totalCycles() > 0)
+            std::cout << "    time by stage (all threads):\n"
+                << profiling::formatBreakdown(result.stages);
+        allSucceeded = allSucceeded && result.success;
+        if (terminationRequested)
+            break;
+    }
+
+    // Make each edit in turn, rendering again only the tiles it affects
+    for (unsigned int i = 0; (trackedImage && i < options.edits.size()); i++)
+    {
+        tracing::ScopedEvent editEvent("edit");
+        JobResult result;
+        result.settings = "edit " + options.edits[i];
+        result.outputFilename = outputFilenameForJob(options, jobs.size() + i, numOutputs);
+        std::cout << "[edit " << (i + 1) << "/" << options.edits.size() << "] "
+            << options.edits[i] << std::endl;
+
+        start = common::wallClockSeconds();
+        scene.renderer->resetRayCount();
+        profiling::reset();
+        std::vector<AABB> changedRegions;
+        bool shapeChanged = true;
+        result.success = applySphereEdit(scene, options.edits[i], changedRegions, shapeChanged);
+        if (result.success)
+        {
+            unsigned int tilesRendered = renderAffectedTiles(scene.renderer,
+                &dependencies, changedRegions, shapeChanged, trackedImage);
+            std::cout << "    rendered " << tilesRendered << " of "
+                << dependencies.getTiles().size() << " tiles again" << std::endl;
+            result.success = tga::writeTGAFile(result.outputFilename, *trackedImage,
+                options.compress);
+        }
+        else
+        {
+            std::cerr << "Invalid edit: " << options.edits[i] << std::endl;
+        }
+        result.primaryRays = scene.renderer->primaryRays();
+        result.reflectedRays = scene.renderer->reflectedRays();
+        result.refractedRays = scene.renderer->refractedRays();
+        result.shadowRays = scene.renderer->shadowRays();
+        result.stages = profiling::totals();
+        result.seconds = common::wallClockSeconds() - start;
+        results.push_back(result);
+
+        if (result.success)
+            std::cout << "    wrote " << result.outputFilename << " in "
+                << result.seconds << " seconds" << std::endl;
+        else
+            std::cerr << "    failed to render " << result.outputFilename << std::endl;
+        if (profiling::ENABLED && result.stages.totalCycles() > 0)
+            std::cout << "    time by stage (all threads):\n"
+                << profiling::formatBreakdown(result.stages);
+        allSucceeded = allSucceeded && result.success;
+    }
+
+    // Memory the scene and the buffers kept between jobs use now
+    MemoryReport memory;
+    if (!useDaemon)
+    {
+        reportSceneMemory(scene, memory);
+        if (gbuffer.memoryUsed() > 0)
+            memory.add("framebuffers", "gbuffer", gbuffer.memoryUsed());
+        if (trackedImage)
+        {
+            memory.add("framebuffers", "edited image", sizeof(Image) + trackedImage->memoryUsed());
+            memory.add("framebuffers", "tile dependencies", dependencies.memoryUsed());
+        }
+        if (options.printMemoryReport)
+            std::cout << memory.format();
+    }
+    delete trackedImage;
+
+    if (!options.reportFilename.empty() &&
+        !writeReport(options.reportFilename, sceneLoadSeconds, results,
+            useDaemon ? "" : memory.formatJSON()))
+    {
+        std::cerr << "Could not write report to " << options.reportFilename << std::endl;
+        allSucceeded = false;
+    }
+    if (!options.traceFilename.empty() && !options.daemonSocket.empty())
+    {
+        if (!requestDaemonTrace(options.daemonSocket, options.traceFilename))
+        {
+            std::cerr << "Daemon could not write trace to " << options.traceFilename
+                << std::endl;
+            allSucceeded = false;
+        }
+    }
+    else if (!options.traceFilename.empty())
+    {
+        if (tracing::writeChromeTrace(options.traceFilename))
+        {
+            std::cout << "Wrote " << tracing::eventCount() << " traced events to "
+                << options.traceFilename << std::endl;
+        }
+        else
+        {
+            std::cerr << "Could not write trace to " << options.traceFilename << std::endl;
+            allSucceeded = false;
+        }
+    }
+
+    // Clean up resources
+    delete cache;
+    delete scene.renderer;
+    delete ResourceManager::getInstance();
+    delete scene.compiledScene;
+
+    return (allSucceeded) ? 0 : 1;
+}
+
+#endif
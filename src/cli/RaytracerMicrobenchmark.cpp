@@ -0,0 +1,587 @@
+/* Microbenchmarks for the functions the raytracer spends most of its time
+ * in. Rather than made-up inputs, each function is run over inputs recorded
+ * from a render of the demo scene: the pixels rendered, every primary,
+ * secondary and shadow ray cast, the octree boxes and terrain triangles
+ * those rays are tested against, the texture coordinates looked up and the
+ * surfaces lit. Times are measured with common::cycleCount().
+ *
+ * Usage: raytracer-microbench [options] [setting=value ...]
+ *
+ * Settings are those of raytracer-cli and choose the render inputs are
+ * recorded from (default: a 96x96 image from camera 1). Options are:
+ *     --kernel=NAME   only run kernels whose names start with NAME (may be
+ *                     given more than once)
+ *     --runs=N        time each kernel over all of its inputs N times,
+ *                     reporting the median, mean and variance (default: 15)
+ *     --report=FILE   also write results to FILE as JSON
+ *     --compiled-scene=FILE  load the scene from a compiled scene file
+ *
+ * Each kernel may have several variants (e.g. a SIMD version of a scalar
+ * test), which are run over the same inputs. To compare a replacement
+ * against the current code, add it to KERNELS after the "scalar" variant
+ * of the same kernel; its speedup is reported, and the values it computed
+ * are checked against the scalar variant's.
+ */
+#ifndef DW_RAYTRACER_GUI_ENABLED
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "DemoScene.h"
+#include "RenderSettings.h"
+#include "Accelerator.h"
+#include "MeshTriangle.h"
+#include "Intersection.h"
+#include "Texture.h"
+#include "TerrainHeightTexture.h"
+#include "Common.h"
+
+using namespace raytracer;
+
+/* Settings of the render inputs are recorded from, before any given on the
+ * command line. */
+static const char* const DEFAULT_RECORD_SETTINGS = "width=96 height=96 camera=1";
+static const unsigned int DEFAULT_RUNS = 15;
+/* Number of recorded rays, spread evenly over all of them, whose octree
+ * traversal is replayed. Each ray is tested against hundreds of boxes and
+ * triangles, so replaying every one would need gigabytes of inputs. */
+static const unsigned int MAX_TRAVERSED_RAYS = 1024;
+/* Relative difference allowed between the values computed by two variants
+ * of a kernel, as SIMD versions may round differently. */
+static const double CHECKSUM_TOLERANCE = 1e-4;
+
+/* Ray cast while recording, which covered 'length' units. */
+struct RecordedRay
+{
+    Ray ray;
+    float length;
+    bool shadowRay;
+};
+
+/* Test of a ray against the box of an octree node it was tested against
+ * during traversal. */
+struct BoxTest
+{
+    unsigned int ray;
+    AABB box;
+};
+
+/* Test of a ray against a terrain triangle in an octree node it entered.
+ * The vertices are those of the terrain's mesh, so are laid out in memory
+ * as they are when rendering. */
+struct TriangleTest
+{
+    unsigned int ray;
+    const Vertex* vertices[3];
+};
+
+struct ImageTexelLookup
+{
+    const ImageTexture* texture;
+    Vector2 texCoord;
+};
+
+struct TerrainTexelLookup
+{
+    const TerrainHeightTexture* texture;
+    Vector2 texCoord;
+    float height;
+};
+
+/* Everything recorded from the render, which kernels are run over. */
+struct MicrobenchmarkInputs
+{
+    Raytracer* renderer;
+    Camera* camera;
+    std::vector<Vector2> pixels; // normalised image coordinates
+    std::vector<RecordedRay> rays;
+    std::vector<BoxTest> boxTests;
+    std::vector<TriangleTest> triangleTests;
+    std::vector<TriangleTest> shadowTriangleTests;
+    std::vector<const Sphere*> spheres;
+    std::vector<ImageTexelLookup> imageTexels;
+    std::vector<TerrainTexelLookup> terrainTexels;
+    std::vector<SurfaceHit> surfaces;
+};
+
+/* Runs a function over every one of its inputs once, returning the number
+ * of inputs and a value computed from its results (so the compiler cannot
+ * remove the calls, and variants can be checked against each other). */
+typedef unsigned int (*KernelFunction)(const MicrobenchmarkInputs& inputs, double& checksum);
+
+struct Kernel
+{
+    const char* name;
+    const char* variant;
+    KernelFunction run;
+};
+
+struct KernelResult
+{
+    const Kernel* kernel;
+    unsigned int operations; // per run
+    double checksum;
+    // Nanoseconds per operation over every run
+    double medianNanoseconds;
+    double meanNanoseconds;
+    double minNanoseconds;
+    double variance;
+    double cyclesPerOperation; // median
+    // Compared to the first variant of the same kernel, or NULL if this is it
+    const KernelResult* baseline;
+};
+
+/* Records every ray the raytracer casts. */
+class RayRecorder : public RayObserver
+{
+
+public:
+    explicit RayRecorder(std::vector<RecordedRay>& rays) : rays(rays)
+    {
+    }
+
+    virtual void raySegment(const Vector3& start, const Vector3& end, bool shadowRay)
+    {
+        RecordedRay recorded;
+        Vector3 segment = end - start;
+        recorded.length = segment.length();
+        if (recorded.length <= 0.0f)
+            return;
+        recorded.ray = Ray(start, segment.normalise());
+        recorded.shadowRay = shadowRay;
+        rays.push_back(recorded);
+    }
+
+private:
+    std::vector<RecordedRay>& rays;
+
+};
+
+unsigned int runBoxIntersects(const MicrobenchmarkInputs& inputs, double& checksum)
+{
+    unsigned int hits = 0;
+    for (unsigned int i = 0; (i < inputs.boxTests.size()); i++)
+    {
+        const BoxTest& test = inputs.boxTests[i];
+        const RecordedRay& recorded = inputs.rays[test.ray];
+        if (test.box.intersects(recorded.ray, 0.0f, recorded.length))
+            hits++;
+    }
+    checksum = hits;
+    return inputs.boxTests.size();
+}
+
+unsigned int runTriangleHit(const MicrobenchmarkInputs& inputs, double& checksum)
+{
+    double sum = 0.0;
+    HitRecord record;
+    for (unsigned int i = 0; (i < inputs.triangleTests.size()); i++)
+    {
+        const TriangleTest& test = inputs.triangleTests[i];
+        const RecordedRay& recorded = inputs.rays[test.ray];
+        if (intersection::triangleHit(*test.vertices[0], *test.vertices[1], *test.vertices[2],
+            recorded.ray, 0.00001f, recorded.length * 2.0f, 0.0f, record))
+            sum += record.t;
+    }
+    checksum = sum;
+    return inputs.triangleTests.size();
+}
+
+unsigned int runTriangleShadowHit(const MicrobenchmarkInputs& inputs, double& checksum)
+{
+    unsigned int hits = 0;
+    for (unsigned int i = 0; (i < inputs.shadowTriangleTests.size()); i++)
+    {
+        const TriangleTest& test = inputs.shadowTriangleTests[i];
+        const RecordedRay& recorded = inputs.rays[test.ray];
+        if (intersection::triangleShadowHit(test.vertices[0]->position,
+            test.vertices[1]->position, test.vertices[2]->position,
+            recorded.ray, 0.0f, recorded.length, 0.0f))
+            hits++;
+    }
+    checksum = hits;
+    return inputs.shadowTriangleTests.size();
+}
+
+unsigned int runSphereHit(const MicrobenchmarkInputs& inputs, double& checksum)
+{
+    double sum = 0.0;
+    HitRecord record;
+    for (unsigned int i = 0; (i < inputs.rays.size()); i++)
+    {
+        const RecordedRay& recorded = inputs.rays[i];
+        for (unsigned int s = 0; (s < inputs.spheres.size()); s++)
+            if (inputs.spheres[s]->hit(recorded.ray, 0.00001f, MAX_RAY_DISTANCE, 0.0f, record))
+                sum += record.t;
+    }
+    checksum = sum;
+    return inputs.rays.size() * inputs.spheres.size();
+}
+
+unsigned int runCameraRays(const MicrobenchmarkInputs& inputs, double& checksum)
+{
+    double sum = 0.0;
+    for (unsigned int i = 0; (i < inputs.pixels.size()); i++)
+    {
+        Ray ray = inputs.camera->getRayToPixel(inputs.pixels[i].x, inputs.pixels[i].y);
+        sum += ray.direction().x;
+    }
+    checksum = sum;
+    return inputs.pixels.size();
+}
+
+unsigned int runImageTexels(const MicrobenchmarkInputs& inputs, double& checksum)
+{
+    double sum = 0.0;
+    for (unsigned int i = 0; (i < inputs.imageTexels.size()); i++)
+    {
+        const ImageTexelLookup& lookup = inputs.imageTexels[i];
+        sum += lookup.texture->getTexel(lookup.texCoord.x, lookup.texCoord.y).r;
+    }
+    checksum = sum;
+    return inputs.imageTexels.size();
+}
+
+unsigned int runTerrainTexels(const MicrobenchmarkInputs& inputs, double& checksum)
+{
+    double sum = 0.0;
+    for (unsigned int i = 0; (i < inputs.terrainTexels.size()); i++)
+    {
+        const TerrainTexelLookup& lookup = inputs.terrainTexels[i];
+        sum += lookup.texture->getTexelAtHeight(lookup.texCoord.x, lookup.texCoord.y,
+            lookup.height).r;
+    }
+    checksum = sum;
+    return inputs.terrainTexels.size();
+}
+
+unsigned int runLocalIllumination(const MicrobenchmarkInputs& inputs, double& checksum)
+{
+    double sum = 0.0;
+    for (unsigned int i = 0; (i < inputs.surfaces.size()); i++)
+    {
+        const SurfaceHit& surface = inputs.surfaces[i];
+        sum += inputs.renderer->localIllumination(surface.material, surface.objectColour,
+            surface.record).g;
+    }
+    checksum = sum;
+    return inputs.surfaces.size();
+}
+
+/* Every kernel measured. Variants of a kernel must be listed together, with
+ * the one the others are compared against first. */
+static const Kernel KERNELS[] = {
+    { "AABB::intersects", "scalar", runBoxIntersects },
+    { "intersection::triangleHit", "scalar", runTriangleHit },
+    { "intersection::triangleShadowHit", "scalar", runTriangleShadowHit },
+    { "Sphere::hit", "scalar", runSphereHit },
+    { "Camera::getRayToPixel", "scalar", runCameraRays },
+    { "ImageTexture::getTexel", "scalar", runImageTexels },
+    { "TerrainHeightTexture::getTexelAtHeight", "scalar", runTerrainTexels },
+    { "Raytracer::localIllumination", "scalar", runLocalIllumination }
+};
+static const unsigned int NUM_KERNELS = sizeof(KERNELS) / sizeof(KERNELS[0]);
+
+/* Replay the traversal an octree does for the ray, recording each box the
+ * ray is tested against and each triangle in the nodes it enters. */
+void recordOctreeTests(const std::vector<FlatOctreeNode>& nodes, const ShapeList& triangles,
+    unsigned int rayIndex, MicrobenchmarkInputs& inputs)
+{
+    const RecordedRay& recorded = inputs.rays[rayIndex];
+    std::vector<int> stack(1, 0);
+    while (!stack.empty())
+    {
+        const FlatOctreeNode& node = nodes[stack.back()];
+        stack.pop_back();
+        for (unsigned int i = 0; (i < node.numShapes); i++)
+        {
+            const MeshTriangle* triangle = static_cast<const MeshTriangle*>(
+                triangles[node.shapes[i]]);
+            TriangleTest test;
+            test.ray = rayIndex;
+            for (unsigned int v = 0; (v < 3); v++)
+                test.vertices[v] = &triangle->getVertex(v);
+            if (recorded.shadowRay)
+                inputs.shadowTriangleTests.push_back(test);
+            else
+                inputs.triangleTests.push_back(test);
+        }
+        if (node.firstChild < 0)
+            continue;
+        for (int child = node.firstChild; (child < node.firstChild + 8); child++)
+        {
+            BoxTest test;
+            test.ray = rayIndex;
+            test.box = nodes[child].boundary;
+            inputs.boxTests.push_back(test);
+            if (test.box.intersects(recorded.ray, 0.0f, recorded.length))
+                stack.push_back(child);
+        }
+    }
+}
+
+/* Render the image described by the settings one pixel at a time,
+ * recording the inputs of every kernel. Returns false if the scene could
+ * not be set up. */
+bool recordInputs(DemoScene& scene, const RenderSettings& settings,
+    MicrobenchmarkInputs& inputs)
+{
+    if (!applyRenderSettings(scene, settings))
+        return false;
+    // Triangles and boxes are those the terrain's octree would test
+    RenderSettings octreeSettings = settings;
+    octreeSettings.accelerator = OCTREE_ACCELERATOR;
+    const OctreeAccelerator* octree = dynamic_cast<const OctreeAccelerator*>(
+        terrainAccelerator(scene, octreeSettings));
+    if (!octree)
+        return false;
+
+    inputs.renderer = scene.renderer;
+    inputs.camera = scene.renderer->getCamera();
+    inputs.spheres.assign(scene.spheres.begin(), scene.spheres.end());
+    RayRecorder recorder(inputs.rays);
+    scene.renderer->setRayObserver(&recorder);
+    for (int j = 0; (j < settings.height); j++)
+    {
+        for (int i = 0; (i < settings.width); i++)
+        {
+            inputs.pixels.push_back(Vector2((i + 0.5f) / settings.width,
+                (j + 0.5f) / settings.height));
+            SurfaceHit hit;
+            if (!scene.renderer->tracePixelSample(i, j, settings.width, settings.height,
+                SINGLESAMPLING, 1, 0, hit))
+                continue;
+            scene.renderer->shadeSurface(hit);
+            if (!hit.objectHit)
+                continue;
+            inputs.surfaces.push_back(hit);
+            const Texture* texture = (hit.material) ? hit.material->getTexture() : NULL;
+            if (const TerrainHeightTexture* terrainTexture =
+                dynamic_cast<const TerrainHeightTexture*>(texture))
+            {
+                // Height is normalised the same way the raytracer does
+                TerrainTexelLookup lookup = { terrainTexture, hit.record.texCoord,
+                    hit.record.pointOfIntersection.y / (common::TERRAIN_MAX_HEIGHT * 0.75f) };
+                inputs.terrainTexels.push_back(lookup);
+            }
+            else if (const ImageTexture* imageTexture = dynamic_cast<const ImageTexture*>(texture))
+            {
+                ImageTexelLookup lookup = { imageTexture, hit.record.texCoord };
+                inputs.imageTexels.push_back(lookup);
+            }
+        }
+    }
+    scene.renderer->setRayObserver(NULL);
+
+    std::vector<FlatOctreeNode> nodes;
+    octree->getOctree()->flatten(octree->getPrimitives()->getPrimitives(), nodes);
+    unsigned int stride = std::max(1u,
+        static_cast<unsigned int>(inputs.rays.size() / MAX_TRAVERSED_RAYS));
+    for (unsigned int i = 0; (i < inputs.rays.size()); i += stride)
+        recordOctreeTests(nodes, octree->getPrimitives()->getPrimitives(), i, inputs);
+    return true;
+}
+
+/* Time the kernel 'runs' times over all of its inputs, after running it once
+ * to warm caches. */
+KernelResult measureKernel(const Kernel& kernel, const MicrobenchmarkInputs& inputs,
+    unsigned int runs)
+{
+    KernelResult result;
+    result.kernel = &kernel;
+    result.baseline = NULL;
+    result.operations = kernel.run(inputs, result.checksum);
+    std::vector<double> nanoseconds;
+    std::vector<double> cycles;
+    double secondsPerCycle = 1.0 / common::cyclesPerSecond();
+    for (unsigned int r = 0; (r < runs && result.operations > 0); r++)
+    {
+        double checksum = 0.0;
+        uint64_t start = common::cycleCount();
+        kernel.run(inputs, checksum);
+        uint64_t elapsed = common::cycleCount() - start;
+        cycles.push_back(static_cast<double>(elapsed) / result.operations);
+        nanoseconds.push_back(cycles.back() * secondsPerCycle * 1e9);
+    }
+    result.medianNanoseconds = result.meanNanoseconds = result.minNanoseconds = 0.0;
+    result.variance = result.cyclesPerOperation = 0.0;
+    if (nanoseconds.empty())
+        return result;
+
+    double sum = 0.0;
+    for (unsigned int r = 0; (r < nanoseconds.size()); r++)
+        sum += nanoseconds[r];
+    result.meanNanoseconds = sum / nanoseconds.size();
+    double squaredDeviations = 0.0;
+    for (unsigned int r = 0; (r < nanoseconds.size()); r++)
+        squaredDeviations += (nanoseconds[r] - result.meanNanoseconds)
+            * (nanoseconds[r] - result.meanNanoseconds);
+    result.variance = squaredDeviations / nanoseconds.size();
+    std::sort(nanoseconds.begin(), nanoseconds.end());
+    std::sort(cycles.begin(), cycles.end());
+    result.medianNanoseconds = nanoseconds[nanoseconds.size() / 2];
+    result.minNanoseconds = nanoseconds[0];
+    result.cyclesPerOperation = cycles[cycles.size() / 2];
+    return result;
+}
+
+/* True if a variant computed the same values as the one it is compared to. */
+bool matchesBaseline(const KernelResult& result)
+{
+    if (!result.baseline)
+        return true;
+    double expected = result.baseline->checksum;
+    double scale = std::max(1.0, fabs(expected));
+    return fabs(result.checksum - expected) <= CHECKSUM_TOLERANCE * scale;
+}
+
+bool kernelSelected(const Kernel& kernel, const std::vector<std::string>& prefixes)
+{
+    if (prefixes.empty())
+        return true;
+    std::string name = kernel.name;
+    for (unsigned int i = 0; (i < prefixes.size()); i++)
+        if (name.compare(0, prefixes[i].size(), prefixes[i]) == 0)
+            return true;
+    return false;
+}
+
+bool writeMicrobenchmarkReport(const std::string& filename, const std::string& settings,
+    const std::vector<KernelResult>& results)
+{
+    std::ofstream report(filename.c_str());
+    if (!report.is_open())
+        return false;
+    report << "{\n  \"settings\": \"" << common::escapeJSON(settings) << "\",\n"
+        << "  \"cyclesPerSecond\": " << common::cyclesPerSecond() << ",\n  \"kernels\": [\n";
+    for (unsigned int i = 0; (i < results.size()); i++)
+    {
+        const KernelResult& result = results[i];
+        report << "    {\n"
+            << "      \"name\": \"" << common::escapeJSON(result.kernel->name) << "\",\n"
+            << "      \"variant\": \"" << common::escapeJSON(result.kernel->variant) << "\",\n"
+            << "      \"operations\": " << result.operations << ",\n"
+            << "      \"nanosecondsPerOperation\": " << result.medianNanoseconds << ",\n"
+            << "      \"meanNanoseconds\": " << result.meanNanoseconds << ",\n"
+            << "      \"minNanoseconds\": " << result.minNanoseconds << ",\n"
+            << "      \"variance\": " << result.variance << ",\n"
+            << "      \"cyclesPerOperation\": " << result.cyclesPerOperation << ",\n";
+        if (result.baseline)
+        {
+            report << "      \"speedup\": " << (result.baseline->medianNanoseconds
+                / result.medianNanoseconds) << ",\n"
+                << "      \"matchesBaseline\": " << (matchesBaseline(result) ? "true" : "false")
+                << ",\n";
+        }
+        report << "      \"checksum\": " << result.checksum << "\n"
+            << "    }" << ((i + 1 < results.size()) ? "," : "") << "\n";
+    }
+    report << "  ]\n}\n";
+    return report.good();
+}
+
+int main(int argc, char* argv[])
+{
+    RenderSettings settings;
+    parseRenderSettings(DEFAULT_RECORD_SETTINGS, settings);
+    std::vector<std::string> prefixes;
+    std::string reportFilename;
+    std::string compiledSceneFilename;
+    unsigned int runs = DEFAULT_RUNS;
+    for (int i = 1; (i < argc); i++)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            if (!parseRenderSettings(arg, settings))
+            {
+                std::cerr << "Invalid setting: " << arg << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        size_t separator = arg.find('=');
+        std::string name = arg.substr(2, separator - 2);
+        std::string value = (separator != std::string::npos) ? arg.substr(separator + 1) : "";
+        if (name == "kernel") prefixes.push_back(value);
+        else if (name == "runs") runs = std::max(1, atoi(value.c_str()));
+        else if (name == "report") reportFilename = value;
+        else if (name == "compiled-scene") compiledSceneFilename = value;
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    DemoScene scene = constructDemoScene(compiledSceneFilename);
+    if (!scene.renderer)
+    {
+        std::cerr << "Could not load scene" << std::endl;
+        return 1;
+    }
+    MicrobenchmarkInputs inputs;
+    std::cout << "Recording inputs from " << formatRenderSettings(settings) << std::endl;
+    if (!recordInputs(scene, settings, inputs))
+    {
+        std::cerr << "Could not set up the scene with those settings" << std::endl;
+        return 1;
+    }
+    std::cout << "Counter runs at " << (common::cyclesPerSecond() / 1e9) << " GHz" << std::endl;
+
+    std::vector<KernelResult> results;
+    results.reserve(NUM_KERNELS);
+    std::map<std::string, unsigned int> baselines; // kernel name -> index in results
+    for (unsigned int k = 0; (k < NUM_KERNELS); k++)
+    {
+        if (!kernelSelected(KERNELS[k], prefixes))
+            continue;
+        results.push_back(measureKernel(KERNELS[k], inputs, runs));
+        KernelResult& result = results.back();
+        std::map<std::string, unsigned int>::const_iterator baseline =
+            baselines.find(KERNELS[k].name);
+        if (baseline != baselines.end())
+            result.baseline = &results[baseline->second];
+        else
+            baselines[KERNELS[k].name] = results.size() - 1;
+
+        std::cout << KERNELS[k].name << " (" << KERNELS[k].variant << "): ";
+        if (result.operations == 0)
+        {
+            std::cout << "no inputs recorded" << std::endl;
+            continue;
+        }
+        std::cout << result.medianNanoseconds << " ns/op, " << result.cyclesPerOperation
+            << " cycles/op, stddev " << sqrt(result.variance) << " ns, "
+            << result.operations << " ops";
+        if (result.baseline)
+        {
+            std::cout << ", " << (result.baseline->medianNanoseconds / result.medianNanoseconds)
+                << "x " << result.baseline->kernel->variant;
+            if (!matchesBaseline(result))
+                std::cout << ", RESULTS DIFFER";
+        }
+        std::cout << std::endl;
+    }
+
+    if (!reportFilename.empty() &&
+        !writeMicrobenchmarkReport(reportFilename, formatRenderSettings(settings), results))
+    {
+        std::cerr << "Could not write report to " << reportFilename << std::endl;
+        return 1;
+    }
+
+    // Clean up resources
+    delete scene.renderer;
+    delete ResourceManager::getInstance();
+    delete scene.compiledScene;
+
+    return 0;
+}
+
+#endif
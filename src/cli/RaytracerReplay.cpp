@@ -0,0 +1,394 @@
+/* Replays ray logs recorded by "raytracer-cli --record-rays=FILE" against
+ * the scene's accelerators. Every query in the log is made again of the
+ * scene's shapes, without any shading, so the time taken is only that of
+ * traversal and intersection. Each result is checked against the one
+ * recorded: queries must hit the same way and, except for shadow queries,
+ * find a surface at the same distance. This makes the log a correctness
+ * check for any change to an accelerator, as well as a quick benchmark.
+ *
+ * Usage: raytracer-replay [options] FILE
+ *
+ * The scene is set up with the settings the log was recorded with. Options
+ * are:
+ *     --accelerator=NAME,NAME,...  replay against each of these terrain
+ *                     accelerators (flat, octree, bvh, grid or auto) in turn
+ *                     (default: the one the log was recorded with)
+ *     --threads=N     split the queries between N threads, or one per
+ *                     processor if N is 0 (default: 1)
+ *     --repeat=N      replay the log N times against each accelerator,
+ *                     reporting the fastest (default: 3)
+ *     --report=FILE   also write results to FILE as JSON
+ *     --compiled-scene=FILE  load the scene from a compiled scene file (see
+ *                     raytracer-cli)
+ *
+ * Exits with status 1 if any accelerator's results differ from the log's.
+ */
+#ifndef DW_RAYTRACER_GUI_ENABLED
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "DemoScene.h"
+#include "RenderSettings.h"
+#include "RayLog.h"
+#include "Threading.h"
+#include "Common.h"
+
+using namespace raytracer;
+
+static const unsigned int DEFAULT_REPEATS = 3;
+/* Distances to the surface hit may differ by this much, relative to the
+ * distance, as accelerators may clip rays to their boxes before testing. */
+static const float DISTANCE_TOLERANCE = 1e-3f;
+/* Number of differing queries printed for each accelerator. */
+static const unsigned int MAX_REPORTED_MISMATCHES = 5;
+
+/* Results of replaying some of a log's queries. */
+struct ReplayCounts
+{
+    uint64_t hits[NUM_RAY_QUERY_TYPES];
+    uint64_t mismatches[NUM_RAY_QUERY_TYPES];
+    // Indices of the first few queries whose results differed
+    std::vector<size_t> firstMismatches;
+
+    ReplayCounts()
+    {
+        for (unsigned int i = 0; (i < NUM_RAY_QUERY_TYPES); i++)
+            hits[i] = mismatches[i] = 0;
+    }
+
+    void add(const ReplayCounts& other)
+    {
+        for (unsigned int i = 0; (i < NUM_RAY_QUERY_TYPES); i++)
+        {
+            hits[i] += other.hits[i];
+            mismatches[i] += other.mismatches[i];
+        }
+        for (unsigned int i = 0; (i < other.firstMismatches.size() &&
+            firstMismatches.size() < MAX_REPORTED_MISMATCHES); i++)
+            firstMismatches.push_back(other.firstMismatches[i]);
+    }
+
+    uint64_t totalMismatches() const
+    {
+        uint64_t total = 0;
+        for (unsigned int i = 0; (i < NUM_RAY_QUERY_TYPES); i++)
+            total += mismatches[i];
+        return total;
+    }
+};
+
+/* Replay of the log against one accelerator. */
+struct ReplayResult
+{
+    std::string configuration;
+    double buildSeconds;
+    double fastestSeconds;
+    double meanSeconds;
+    ReplayCounts counts;
+};
+
+/* Makes queries [begin, end) of a log again, counting those whose results
+ * differ from the ones recorded. */
+class ReplayTask : public threading::Task
+{
+
+public:
+    ReplayTask(const Shape* root, const std::vector<RayQuery>& queries, size_t begin,
+        size_t end, ReplayCounts* counts) :
+        root(root), queries(queries), begin(begin), end(end), counts(counts)
+    {
+    }
+
+    virtual void run()
+    {
+        // Counted locally, as threads' counts are next to each other in memory
+        ReplayCounts localCounts;
+        for (size_t i = begin; (i < end); i++)
+        {
+            const RayQuery& query = queries[i];
+            bool hit = false;
+            float t = 0.0f;
+            if (query.type == SHADOW_QUERY)
+            {
+                const Shape* occludingShape = NULL;
+                hit = root->shadowHit(query.ray(), query.tMin, query.tMax, 0.0f,
+                    occludingShape);
+            }
+            else
+            {
+                HitRecord record;
+                hit = root->hit(query.ray(), query.tMin, query.tMax, 0.0f, record);
+                if (hit)
+                    t = record.t;
+            }
+            if (hit)
+                localCounts.hits[query.type]++;
+            bool matches = (hit == static_cast<bool>(query.hit)) &&
+                (fabs(t - query.t) <= DISTANCE_TOLERANCE * std::max(1.0f, query.t));
+            if (!matches)
+            {
+                localCounts.mismatches[query.type]++;
+                if (localCounts.firstMismatches.size() < MAX_REPORTED_MISMATCHES)
+                    localCounts.firstMismatches.push_back(i);
+            }
+        }
+        *counts = localCounts;
+    }
+
+private:
+    const Shape* root;
+    const std::vector<RayQuery>& queries;
+    size_t begin;
+    size_t end;
+    ReplayCounts* counts;
+
+};
+
+/* Make every query of the log once, split between 'numThreads' threads,
+ * returning the wall clock time taken. */
+double replayQueries(const Shape* root, const std::vector<RayQuery>& queries,
+    unsigned int numThreads, ReplayCounts& counts)
+{
+    std::vector<ReplayCounts> threadCounts(numThreads);
+    double start = common::wallClockSeconds();
+    if (numThreads == 1)
+    {
+        ReplayTask(root, queries, 0, queries.size(), &threadCounts[0]).run();
+    }
+    else
+    {
+        // The pool waits for every task to finish when destroyed
+        threading::ThreadPool pool(numThreads);
+        size_t perThread = (queries.size() + numThreads - 1) / numThreads;
+        for (unsigned int i = 0; (i < numThreads); i++)
+        {
+            size_t begin = std::min(queries.size(), i * perThread);
+            size_t end = std::min(queries.size(), begin + perThread);
+            pool.addTask(new ReplayTask(root, queries, begin, end, &threadCounts[i]));
+        }
+    }
+    double seconds = common::wallClockSeconds() - start;
+    counts = ReplayCounts();
+    for (unsigned int i = 0; (i < numThreads); i++)
+        counts.add(threadCounts[i]);
+    return seconds;
+}
+
+void printMismatch(const RayQuery& query, const Shape* root, size_t index)
+{
+    HitRecord record;
+    bool hit = false;
+    if (query.type == SHADOW_QUERY)
+    {
+        const Shape* occludingShape = NULL;
+        hit = root->shadowHit(query.ray(), query.tMin, query.tMax, 0.0f, occludingShape);
+    }
+    else
+    {
+        hit = root->hit(query.ray(), query.tMin, query.tMax, 0.0f, record);
+    }
+    std::cout << "      query " << index << " (" << rayQueryTypeName(
+        static_cast<RayQueryType>(query.type)) << "): recorded ";
+    if (query.hit)
+        std::cout << "hit" << ((query.type != SHADOW_QUERY) ? " at t=" : "");
+    else
+        std::cout << "miss";
+    if (query.hit && query.type != SHADOW_QUERY)
+        std::cout << query.t;
+    std::cout << ", replayed ";
+    if (hit)
+        std::cout << "hit" << ((query.type != SHADOW_QUERY) ? " at t=" : "");
+    else
+        std::cout << "miss";
+    if (hit && query.type != SHADOW_QUERY)
+        std::cout << record.t;
+    std::cout << std::endl;
+}
+
+bool writeReplayReport(const std::string& filename, const std::string& logFilename,
+    const RayLog& log, unsigned int numThreads, const std::vector<ReplayResult>& results)
+{
+    std::ofstream report(filename.c_str());
+    if (!report.is_open())
+        return false;
+    report << "{\n  \"log\": \"" << common::escapeJSON(logFilename) << "\",\n"
+        << "  \"settings\": \""
+        << common::escapeJSON(formatRenderSettings(log.getSettings())) << "\",\n"
+        << "  \"queries\": " << log.getQueries().size() << ",\n"
+        << "  \"threads\": " << numThreads << ",\n  \"accelerators\": [\n";
+    for (unsigned int i = 0; (i < results.size()); i++)
+    {
+        const ReplayResult& result = results[i];
+        report << "    {\n"
+            << "      \"accelerator\": \"" << common::escapeJSON(result.configuration) << "\",\n"
+            << "      \"buildSeconds\": " << result.buildSeconds << ",\n"
+            << "      \"fastestSeconds\": " << result.fastestSeconds << ",\n"
+            << "      \"meanSeconds\": " << result.meanSeconds << ",\n"
+            << "      \"queriesPerSecond\": " << (log.getQueries().size()
+                / std::max(result.fastestSeconds, 1e-9)) << ",\n";
+        for (unsigned int t = 0; (t < NUM_RAY_QUERY_TYPES); t++)
+        {
+            RayQueryType type = static_cast<RayQueryType>(t);
+            report << "      \"" << rayQueryTypeName(type) << "\": { \"queries\": "
+                << log.count(type) << ", \"hits\": " << result.counts.hits[t]
+                << ", \"mismatches\": " << result.counts.mismatches[t] << " },\n";
+        }
+        report << "      \"matches\": " << ((result.counts.totalMismatches() == 0) ?
+            "true" : "false") << "\n"
+            << "    }" << ((i + 1 < results.size()) ? "," : "") << "\n";
+    }
+    report << "  ]\n}\n";
+    return report.good();
+}
+
+int main(int argc, char* argv[])
+{
+    std::string logFilename;
+    std::string reportFilename;
+    std::string compiledSceneFilename;
+    std::vector<std::string> accelerators;
+    unsigned int numThreads = 1;
+    unsigned int repeats = DEFAULT_REPEATS;
+    for (int i = 1; (i < argc); i++)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            logFilename = arg;
+            continue;
+        }
+        size_t separator = arg.find('=');
+        std::string name = arg.substr(2, separator - 2);
+        std::string value = (separator != std::string::npos) ? arg.substr(separator + 1) : "";
+        if (name == "accelerator")
+        {
+            std::stringstream names(value);
+            std::string accelerator;
+            while (std::getline(names, accelerator, ','))
+                accelerators.push_back(accelerator);
+        }
+        else if (name == "threads") numThreads = std::max(0, atoi(value.c_str()));
+        else if (name == "repeat") repeats = std::max(1, atoi(value.c_str()));
+        else if (name == "report") reportFilename = value;
+        else if (name == "compiled-scene") compiledSceneFilename = value;
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (logFilename.empty())
+    {
+        std::cerr << "Usage: raytracer-replay [options] FILE" << std::endl;
+        return 1;
+    }
+    if (numThreads == 0)
+        numThreads = threading::numProcessors();
+
+    RayLog log;
+    if (!log.load(logFilename))
+    {
+        std::cerr << "Could not read ray log " << logFilename << std::endl;
+        return 1;
+    }
+    const std::vector<RayQuery>& queries = log.getQueries();
+    std::cout << "Replaying " << queries.size() << " ray queries recorded from "
+        << formatRenderSettings(log.getSettings()) << " on " << numThreads
+        << " thread(s)" << std::endl;
+    // Check every accelerator name before loading the scene
+    std::vector<RenderSettings> jobs;
+    if (accelerators.empty())
+        accelerators.push_back(acceleratorName(log.getSettings().accelerator));
+    for (unsigned int i = 0; (i < accelerators.size()); i++)
+    {
+        RenderSettings settings = log.getSettings();
+        if (!setRenderSetting(settings, "accelerator", accelerators[i]))
+        {
+            std::cerr << "Unknown accelerator: " << accelerators[i] << std::endl;
+            return 1;
+        }
+        jobs.push_back(settings);
+    }
+
+    DemoScene scene = constructDemoScene(compiledSceneFilename);
+    if (!scene.renderer)
+    {
+        std::cerr << "Could not load scene" << std::endl;
+        return 1;
+    }
+    std::vector<ReplayResult> results;
+    bool allMatch = true;
+    for (unsigned int i = 0; (i < jobs.size()); i++)
+    {
+        const RenderSettings& settings = jobs[i];
+        const Accelerator* accelerator = NULL;
+        if (!applyRenderSettings(scene, settings) ||
+            !(accelerator = terrainAccelerator(scene, settings)))
+        {
+            std::cerr << "Scene has no such camera or terrain" << std::endl;
+            allMatch = false;
+            break;
+        }
+        ReplayResult result;
+        result.configuration = formatAcceleratorConfiguration(accelerator->getType(),
+            accelerator->getParameters());
+        result.buildSeconds = accelerator->getBuildSeconds();
+        const Shape* root = scene.renderer->getRootShape();
+        double totalSeconds = 0.0;
+        for (unsigned int r = 0; (r < repeats); r++)
+        {
+            ReplayCounts counts;
+            double seconds = replayQueries(root, queries, numThreads, counts);
+            totalSeconds += seconds;
+            if (r == 0 || seconds < result.fastestSeconds)
+                result.fastestSeconds = seconds;
+            if (r == 0)
+                result.counts = counts;
+        }
+        result.meanSeconds = totalSeconds / repeats;
+        results.push_back(result);
+
+        std::cout << "[" << (i + 1) << "/" << jobs.size() << "] " << result.configuration
+            << ": " << result.fastestSeconds << " seconds (" << (queries.size()
+            / std::max(result.fastestSeconds, 1e-9) / 1e6) << "M queries/s)" << std::endl;
+        for (unsigned int t = 0; (t < NUM_RAY_QUERY_TYPES); t++)
+        {
+            RayQueryType type = static_cast<RayQueryType>(t);
+            std::cout << "    " << rayQueryTypeName(type) << ": " << log.count(type)
+                << " queries, " << result.counts.hits[t] << " hits, "
+                << result.counts.mismatches[t] << " differ" << std::endl;
+        }
+        if (result.counts.totalMismatches() > 0)
+        {
+            allMatch = false;
+            std::cout << "    RESULTS DIFFER from the log, e.g." << std::endl;
+            for (unsigned int m = 0; (m < result.counts.firstMismatches.size()); m++)
+            {
+                size_t index = result.counts.firstMismatches[m];
+                printMismatch(queries[index], root, index);
+            }
+        }
+    }
+
+    if (!reportFilename.empty() &&
+        !writeReplayReport(reportFilename, logFilename, log, numThreads, results))
+    {
+        std::cerr << "Could not write report to " << reportFilename << std::endl;
+        allMatch = false;
+    }
+
+    // Clean up resources
+    delete scene.renderer;
+    delete ResourceManager::getInstance();
+    delete scene.compiledScene;
+
+    return (allMatch) ? 0 : 1;
+}
+
+#endif
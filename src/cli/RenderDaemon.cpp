@@ -0,0 +1,89 @@
+/* Render daemon. Keeps scenes loaded in memory and renders jobs sent to it
+ * over a Unix domain socket or TCP (see RenderProtocol.h), so clients such
+ * as "raytracer-cli --daemon" do not have to build the scene for every
+ * render. Daemons listening on TCP can also be used as the workers of a
+ * distributed render ("raytracer-cli --workers").
+ *
+ * Usage: raytracer-daemon [options]
+ *     --socket=PATH   path of socket to listen on (default: /tmp/raytracer.sock)
+ *     --port=N        listen on TCP port N instead of a Unix domain socket.
+ *                     TRACE and SHUTDOWN are refused over TCP.
+ *     --threads=N     number of render threads (default: one per processor)
+ *     --preload=ID    build scene before accepting connections (e.g. "demo")
+ *     --compiled-scene=FILE  load the demo scene from FILE, writing it first
+ *                     if it does not exist or is out of date
+ *     --trace         record a timeline of the jobs and tiles each thread
+ *                     renders, which a client can have written to a file
+ *                     with the TRACE command (e.g. "raytracer-cli
+ *                     --daemon=ADDRESS --trace=FILE")
+ */
+#ifndef DW_RAYTRACER_GUI_ENABLED
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <ctime>
+#include <signal.h>
+#include "RenderService.h"
+#include "Tracing.h"
+
+using namespace raytracer;
+
+static const std::string DEFAULT_SOCKET_PATH = "/tmp/raytracer.sock";
+
+int main(int argc, char* argv[])
+{
+    srand(time(NULL));
+    // Writing to a client which has disconnected should fail, not kill us
+    signal(SIGPIPE, SIG_IGN);
+    tracing::setThreadName("main");
+
+    std::string socketPath = DEFAULT_SOCKET_PATH;
+    std::string preload;
+    std::string compiledSceneFilename;
+    unsigned int numThreads = 0;
+    int port = 0;
+    for (int i = 1; (i < argc); i++)
+    {
+        std::string arg = argv[i];
+        size_t separator = arg.find('=');
+        std::string name = arg.substr(0, separator);
+        std::string value = (separator != std::string::npos) ? arg.substr(separator + 1) : "";
+        if (name == "--socket") socketPath = value;
+        else if (name == "--port") port = atoi(value.c_str());
+        else if (name == "--threads") numThreads = atoi(value.c_str());
+        else if (name == "--preload") preload = value;
+        else if (name == "--compiled-scene") compiledSceneFilename = value;
+        else if (name == "--trace") tracing::enable();
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    bool success = true;
+    {
+        RenderService service(numThreads);
+        service.setCompiledSceneFilename(compiledSceneFilename);
+        if (!preload.empty() && !service.preloadScene(preload))
+        {
+            std::cerr << "Unknown scene, or could not load it: " << preload << std::endl;
+            success = false;
+        }
+        else if (port > 0 && !service.serveTcpPort(port))
+        {
+            std::cerr << "Could not listen on port " << port << std::endl;
+            success = false;
+        }
+        else if (port <= 0 && !service.serveUnixSocket(socketPath))
+        {
+            std::cerr << "Could not listen on " << socketPath << std::endl;
+            success = false;
+        }
+    }
+    delete ResourceManager::getInstance();
+    return (success) ? 0 : 1;
+}
+
+#endif
@@ -1,31 +1,71 @@
 #include <QApplication>
+#include <iostream>
 #include "gui/RaytracerWindow.h"
 #include "gui/RaytracerController.h"
-#include "gui/DemoScene.h"
+#include "DemoScene.h"
+#include "Tracing.h"
 
 using namespace raytracer;
 
+/* Option which loads the demo scene from the given compiled scene file,
+ * writing it first if it does not exist or is out of date (see
+ * CompiledScene.h). By default the scene is loaded from its resources. */
+static const std::string COMPILED_SCENE_OPTION = "--compiled-scene=";
+/* Option which saves the render's progress to the given file, and resumes
+ * a render of the same image and scene saved there (see
+ * AccumulationBuffer.h). By default progress is not saved. */
+static const std::string CHECKPOINT_OPTION = "--checkpoint=";
+/* Option which records a timeline of loading and rendering, written to the
+ * given file in Chrome's trace format on exit (see Tracing.h). */
+static const std::string TRACE_OPTION = "--trace=";
+
 int main(int argc, char* argv[])
 {
     // Seed random number generator for varying results
     srand(time(NULL));
+    std::string compiledSceneFilename;
+    std::string checkpointFilename;
+    std::string traceFilename;
+    for (int i = 1; (i < argc); i++)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, COMPILED_SCENE_OPTION.size(), COMPILED_SCENE_OPTION) == 0)
+            compiledSceneFilename = arg.substr(COMPILED_SCENE_OPTION.size());
+        else if (arg.compare(0, CHECKPOINT_OPTION.size(), CHECKPOINT_OPTION) == 0)
+            checkpointFilename = arg.substr(CHECKPOINT_OPTION.size());
+        else if (arg.compare(0, TRACE_OPTION.size(), TRACE_OPTION) == 0)
+            traceFilename = arg.substr(TRACE_OPTION.size());
+    }
+    if (!traceFilename.empty())
+    {
+        tracing::enable();
+        tracing::setThreadName("main");
+    }
 
 	// Create demonstration scene
-	gui::DemoScene scene = gui::constructDemoScene();
+	DemoScene scene = constructDemoScene(compiledSceneFilename);
+	if (!scene.renderer)
+	{
+		std::cerr << "Could not load scene" << std::endl;
+		return 1;
+	}
 
     // Construct QT application
 	QApplication app(argc, argv);
 	// Create raytracer controller and window
 	gui::RaytracerWindow window(scene.renderer);
-	gui::RaytracerController controller(&window, &scene);
+	gui::RaytracerController controller(&window, &scene, checkpointFilename);
 	// Show window and execute application
 	window.show();
 	app.exec();
+	if (!traceFilename.empty() && !tracing::writeChromeTrace(traceFilename))
+		std::cerr << "Could not write trace to " << traceFilename << std::endl;
 
 	// Clean up resources
 	delete scene.renderer;
 	ResourceManager* resourceManager = ResourceManager::getInstance();
 	delete resourceManager;
+	delete scene.compiledScene;
 
 	return 0;
 }
@@ -8,13 +8,17 @@
 #include "gui/RaytracerController.h"
 #include "gui/GUICommon.h"
 #include "Common.h"
+#include "Profiling.h"
+#include "MemoryReport.h"
 
 using namespace raytracer::gui;
 
 // TODO: clean up thread elegantly so that there is no segmentation fault
 
-RaytracerController::RaytracerController(RaytracerWindow* window, DemoScene* scene)
-	: window(window), scene(scene), rendering(false), workerThread(NULL), worker(NULL)
+RaytracerController::RaytracerController(RaytracerWindow* window, DemoScene* scene,
+	const std::string& checkpointFilename)
+	: window(window), scene(scene), rendering(false), workerThread(NULL), worker(NULL),
+	checkpointFilename(checkpointFilename)
 {		
 	renderer = scene->renderer;
 	
@@ -26,13 +30,15 @@ RaytracerController::RaytracerController(RaytracerWindow* window, DemoScene* sce
 		SIGNAL(triggered()), QCoreApplication::instance(), SLOT(quit()));		
 	connect(reinterpret_cast<const QObject*>(window->saveAction),
 		SIGNAL(triggered()), this, SLOT(saveImage()));
+	connect(reinterpret_cast<const QObject*>(window->memoryAction),
+		SIGNAL(triggered()), this, SLOT(showMemoryUsage()));
 		
 	// Event handlers for raytracer settings
 	connect(window->sampMethod, SIGNAL(currentIndexChanged(int)), this, SLOT(samplingMethodChanged(int)));
 	// Event handlers for effects settings
 	connect(window->localIlluminationSwitch, SIGNAL(stateChanged(int)), this, SLOT(localIlluminationChanged(int)));
 	// Event handlers for geometric optimisation settings
-	connect(window->useOctree, SIGNAL(stateChanged(int)), this, SLOT(useOctreeChanged(int)));
+	connect(window->accelerator, SIGNAL(currentIndexChanged(int)), this, SLOT(acceleratorChanged(int)));
 	// Event handler for render button
 	connect(window->renderButton, SIGNAL(clicked()), this, SLOT(renderButtonPressed()));
 		
@@ -47,10 +53,9 @@ RaytracerController::RaytracerController(RaytracerWindow* window, DemoScene* sce
 		std::string camName = "Camera " + common::toString(i + 1);
 		window->viewpoint->addItem( QString::fromStdString(camName) );
 	}
-	// Add small and large heightmaps for terrain
-	window->terrainHeightmap->addItem("Varied");
-	window->terrainHeightmap->addItem("Low/Shallow");
-	window->terrainHeightmap->addItem("High Peaks");
+	// Add an entry to the terrain combo box for each heightmap
+	for (unsigned int i = 0; (i < scene->terrainNames.size()); i++)
+		window->terrainHeightmap->addItem( QString::fromStdString(scene->terrainNames[i]) );
 }
 
 RaytracerController::~RaytracerController()
@@ -86,6 +91,8 @@ void RaytracerController::renderFinished()
 	window->renderButton->setText("RENDER");
 	window->saveAction->setEnabled(true);
 	rendering = false;
+	if (window->timeBudget->value() > 0 && worker)
+		budgetSummary = worker->getBudgetReport().format();
 }
 
 void RaytracerController::samplingMethodChanged(int newIndex)
@@ -102,10 +109,10 @@ void RaytracerController::localIlluminationChanged(int newState)
 	window->shadowsSwitch->setEnabled(checked);
 }
 
-void RaytracerController::useOctreeChanged(int newState)
+void RaytracerController::acceleratorChanged(int newIndex)
 {
-	bool checked = (newState == Qt::Checked);
-	window->showOctree->setEnabled(checked);
+	// Only the octree can be visualised
+	window->showOctree->setEnabled(newIndex == OCTREE_ACCELERATOR);
 }
 
 void RaytracerController::renderButtonPressed()
@@ -129,7 +136,7 @@ void RaytracerController::startRender()
 	// Create renderer worker which will perform the actual rendering
 	CanvasWidget* canvasWidget = window->canvasWidget;
 	Image* canvas = canvasWidget->getCanvas();
-	worker = new RendererWorker(renderer, canvas);
+	worker = new RendererWorker(renderer, canvas, &accumulation);
 	worker->moveToThread(workerThread);
 
 	// When thread starts, start render and disable save action
@@ -143,69 +150,59 @@ void RaytracerController::startRender()
 	connect(reinterpret_cast<const QObject*>(window->quitAction),
 		SIGNAL(triggered()), worker, SLOT(stop()));	
 
-	// Configure octree visualisation
- 	bool checked = (window->showOctree->checkState() == Qt::Checked);	
-	renderer->showTestShapes(checked);
-
-	// Assign chosen camera
-	Camera* currentCamera = renderer->getCamera();;
-	*currentCamera = scene->cameras[window->viewpoint->currentIndex()];
-	// Configure effects settings
-	checked = (window->localIlluminationSwitch->checkState() == Qt::Checked);
-	renderer->enableLocalIllumination(checked);
- 	checked = (window->reflectRefractSwitch->checkState() == Qt::Checked);
-	renderer->enableReflectionAndRefraction(checked);
-	checked = (window->shadowsSwitch->checkState() == Qt::Checked);
-	renderer->enableShadows(checked);
-	// Configure raytracer settings
-	int sampleMethodIndex = window->sampMethod->currentIndex();
-	worker->setSamplingMethod( static_cast<SamplingMethod>(sampleMethodIndex) );
-	worker->setNumSamples( window->numSamples->value() );
-	
-	// Based on geometric optimisation approach and terrain, pick which terrain to render
-	bool usingOctree = (window->useOctree->checkState() == Qt::Checked);
-	int terrainIndexOffset = (usingOctree) ? 1 : 0;
-	int chosenTerrainIndex = window->terrainHeightmap->currentIndex() * 2;
-	Shape* terrain = NULL;
-	if (usingOctree)
-		terrain = scene->terrainVariants[chosenTerrainIndex + terrainIndexOffset];
-	else
-		terrain = scene->terrainVariants[chosenTerrainIndex + terrainIndexOffset];
-	BoundingShape* root = dynamic_cast<BoundingShape*>(renderer->getRootShape());
-	if (root)
+	// Gather settings chosen in the window and apply them to the scene
+	RenderSettings settings;
+	settings.width = window->widthBox->value();
+	settings.height = window->heightBox->value();
+	settings.samplingMethod = static_cast<SamplingMethod>(window->sampMethod->currentIndex());
+	settings.numSamples = window->numSamples->value();
+	settings.cameraIndex = window->viewpoint->currentIndex();
+	settings.terrainIndex = window->terrainHeightmap->currentIndex();
+	settings.accelerator = static_cast<AcceleratorType>(window->accelerator->currentIndex());
+	settings.showOctree = (window->showOctree->checkState() == Qt::Checked);
+	settings.localIllumination = (window->localIlluminationSwitch->checkState() == Qt::Checked);
+	settings.reflectionRefraction = (window->reflectRefractSwitch->checkState() == Qt::Checked);
+	settings.shadows = (window->shadowsSwitch->checkState() == Qt::Checked);
+	settings.enabledLights = 0;
+	if (window->lightOneSwitch->checkState() == Qt::Checked)
+		settings.enabledLights |= (1 << 0);
+	if (window->lightTwoSwitch->checkState() == Qt::Checked)
+		settings.enabledLights |= (1 << 1);
+	// Budgeted renders take as many random samples as they have time for
+	if (window->timeBudget->value() > 0)
 	{
-		// Be sure to remove all terrain from the root of the scene
-		// so only one terrain is rendered at a time
-		for (unsigned int i = 0; (i < scene->terrainVariants.size()); i++)
-			root->removeShape(scene->terrainVariants[i]);
-		// If terrain shape was found from user's selection
-		if (terrain)
-		{
-			root->addShape(terrain);
-		}
+		settings.samplingMethod = RANDOM_MULTISAMPLING;
+		settings.numSamples = BUDGET_MAX_SAMPLES;
 	}
+	applyRenderSettings(*scene, settings);
 
-	// If renderer is also showing test shapes, set octree lines for the
-	// terrain being rendered now
-	if (renderer->showingTestShapes())
+	// Resize canvas to required size and clear it
+	window->canvasWidget->resizeAndClear(settings.width, settings.height);
+	// Pick up where a checkpointed render of the same image was left (e.g.
+	// last time the program ran). The checkpoint is only loaded if it was
+	// saved with the same scene, and kept if it has the same settings.
+	std::string sceneKey = checkpointKey(*scene, settings);
+	if (!checkpointFilename.empty() && !accumulation.canContinue(settings))
+		accumulation.load(checkpointFilename, sceneKey);
+	worker->setCheckpoint(checkpointFilename, sceneKey, CHECKPOINT_INTERVAL);
+	// If the last render was of the same image, keep what it had rendered
+	// (and just add any extra samples), otherwise start from scratch
+	if (accumulation.canContinue(settings))
 	{
-		int terrainOctreeIndex = window->terrainHeightmap->currentIndex();
-		renderer->setRootTestShape(scene->octreeLines[terrainOctreeIndex], false);
+		accumulation.continueWith(settings);
+		accumulation.resolveInto(canvas);
 	}
-
-	/* Clear all lights from the scene, then add the ones which are enabled. */
-	renderer->removeAllLights();
-	checked = (window->lightOneSwitch->checkState() == Qt::Checked);
-	if (checked)
-		renderer->addLight(scene->lights[0]);
-	checked = (window->lightTwoSwitch->checkState() == Qt::Checked);
-	if (checked)
-		renderer->addLight(scene->lights[1]);
-
-	// Resize canvas to required size and clear it
-	int width = window->widthBox->value();
-	int height = window->heightBox->value();
-	window->canvasWidget->resizeAndClear(width, height);
+	else
+	{
+		accumulation.reset(settings);
+	}
+	// Surfaces cached by the last render are kept if the camera and
+	// geometry haven't changed. Too large an image isn't cached at all.
+	worker->setGBuffer(gbuffer.prepare(settings, primaryRayGeometryHash(*scene, settings)) ?
+		&gbuffer : NULL);
+	worker->setTimeBudget(window->timeBudget->value());
+	budgetSummary.clear();
+	profiling::reset();
 	// START RENDERING!
 	workerThread->start();	
 }
@@ -242,6 +239,24 @@ void RaytracerController::saveImage()
     }
 }
 
+void RaytracerController::showMemoryUsage()
+{
+	MemoryReport report;
+	reportSceneMemory(*scene, report);
+	Image* canvas = window->canvasWidget->getCanvas();
+	report.add("framebuffers", "canvas", sizeof(Image) + canvas->memoryUsed());
+	report.add("framebuffers", "accumulation buffer", accumulation.memoryUsed());
+	report.add("framebuffers", "gbuffer", gbuffer.memoryUsed());
+	// Totals of each subsystem, with every resource if asked for
+	QMessageBox messageBox(window);
+	messageBox.setWindowTitle("Memory Usage");
+	messageBox.setText(QString::fromStdString(report.format("", false)));
+	messageBox.setDetailedText(QString::fromStdString(report.format()));
+	messageBox.setIcon(QMessageBox::Information);
+	messageBox.setStandardButtons(QMessageBox::Ok);
+	messageBox.exec();
+}
+
 void RaytracerController::updateInterface()
 {
 	// Redraw contents of canvas
@@ -256,9 +271,14 @@ void RaytracerController::updateInterface()
 	QString message;
 	// If rendering has finished (either by 'rendering' flag being
 	// false or all the image being rendered), clear message
-	if (!rendering || rowsComplete == totalRows)
+	if (rendering && window->timeBudget->value() > 0)
 	{
-		message = "";
+		message = QString::fromStdString("Rendering with a time budget of " +
+			common::toString(window->timeBudget->value()) + " seconds");
+	}
+	else if (!rendering || rowsComplete == totalRows)
+	{
+		message = QString::fromStdString(budgetSummary);
 	}
 	else
 	{
@@ -267,6 +287,14 @@ void RaytracerController::updateInterface()
 		ss << std::setprecision(2) << std::fixed << progressPercentage << "% complete (rendering row " << rowsComplete << " out of " << totalRows << ")";
 		message = QString::fromStdString(ss.str());
 	}
+	// Show where the time of this (or the last) render went
+	profiling::StageCounters stages = profiling::totals();
+	if (profiling::ENABLED && stages.totalCycles() > 0)
+	{
+		if (!message.isEmpty())
+			message += " | ";
+		message += QString::fromStdString(profiling::formatSummary(stages));
+	}
 	window->statusBar()->showMessage(message);	
 }
 
@@ -3,6 +3,7 @@
 #include <QMenu>
 #include <QLabel>
 #include "gui/RaytracerWindow.h"
+#include "RenderSettings.h"
 
 using namespace raytracer::gui;
 
@@ -16,6 +17,8 @@ RaytracerWindow::RaytracerWindow(Raytracer* renderer) : renderer(renderer)
 	fileMenu = menuBar()->addMenu("&File");
 	saveAction = fileMenu->addAction("&Save Image");
 	quitAction = fileMenu->addAction("&Quit");
+	viewMenu = menuBar()->addMenu("&View");
+	memoryAction = viewMenu->addAction("&Memory Usage");
 	// Create canvas widget and add to centre of window
 	// Note that it is wrapped in a scroll pane in case
 	// it's larger than the window
@@ -56,10 +59,20 @@ RaytracerWindow::RaytracerWindow(Raytracer* renderer) : renderer(renderer)
 		rayRowThreeLayout->addWidget(widthBox);
 		rayRowThreeLayout->addWidget(xLabel);
 		rayRowThreeLayout->addWidget(heightBox);
+		timeBudgetLabel = new QLabel("Time Budget");
+		timeBudget = new QSpinBox();
+		timeBudget->setRange(0, 3600);
+		timeBudget->setValue(0);
+		timeBudget->setSuffix(" s");
+		timeBudget->setSpecialValueText("Off");
+		rayRowFourLayout = new QHBoxLayout();
+		rayRowFourLayout->addWidget(timeBudgetLabel);
+		rayRowFourLayout->addWidget(timeBudget);
 		raytracerSettingsLayout = new QVBoxLayout();
 		raytracerSettingsLayout->addLayout(rayRowOneLayout);
 		raytracerSettingsLayout->addLayout(rayRowTwoLayout);
 		raytracerSettingsLayout->addLayout(rayRowThreeLayout);
+		raytracerSettingsLayout->addLayout(rayRowFourLayout);
 		raytracerSettings->setLayout(raytracerSettingsLayout);
 	effectsSettings = new QGroupBox("Effects");
 		localIlluminationSwitch = new QCheckBox("Local Illumination");
@@ -95,11 +108,17 @@ RaytracerWindow::RaytracerWindow(Raytracer* renderer) : renderer(renderer)
 		sceneSettingsLayout->addLayout(sceneRowTwoLayout);
 		sceneSettings->setLayout(sceneSettingsLayout);
 	geometricOptSettings = new QGroupBox("Geometric Optimisation");
-		useOctree = new QCheckBox("Enable Octree");
-		useOctree->setChecked(true);
+		acceleratorLabel = new QLabel("Accelerator");
+		accelerator = new QComboBox();
+		for (unsigned int i = 0; (i < NUM_ACCELERATOR_TYPES); i++)
+			accelerator->addItem(acceleratorName(static_cast<AcceleratorType>(i)));
+		accelerator->setCurrentIndex(OCTREE_ACCELERATOR);
+		acceleratorRowLayout = new QHBoxLayout();
+		acceleratorRowLayout->addWidget(acceleratorLabel);
+		acceleratorRowLayout->addWidget(accelerator);
 		showOctree = new QCheckBox("Show Octree (very slow)");
 		geometricOptSettingsLayout = new QVBoxLayout();
-		geometricOptSettingsLayout->addWidget(useOctree);
+		geometricOptSettingsLayout->addLayout(acceleratorRowLayout);
 		geometricOptSettingsLayout->addWidget(showOctree);
 		geometricOptSettings->setLayout(geometricOptSettingsLayout);
 	renderButton = new QPushButton("RENDER");
@@ -133,7 +152,9 @@ RaytracerWindow::~RaytracerWindow()
 
 	delete renderButton;
 	delete showOctree;
-	delete useOctree;
+	delete accelerator;
+	delete acceleratorLabel;
+	delete acceleratorRowLayout;
 	delete geometricOptSettingsLayout;
 	delete geometricOptSettings;
 	delete viewpoint;
@@ -151,6 +172,9 @@ RaytracerWindow::~RaytracerWindow()
 	delete localIlluminationSwitch;
 	delete effectsSettingsLayout;
 	delete effectsSettings;
+	delete timeBudget;
+	delete timeBudgetLabel;
+	delete rayRowFourLayout;
 	delete heightBox;
 	delete xLabel;
 	delete widthBox;
@@ -1,118 +1,117 @@
 #include "gui/RendererWorker.h"
+#include "TileRenderer.h"
+#include "Common.h"
+#include "Tracing.h"
 
 using namespace raytracer;
 using namespace gui;
 
-static const Colour BACKGROUND_COLOUR(0.2f, 0.2f, 0.2f);
-
-RendererWorker::RendererWorker(Raytracer* renderer, Image* canvas) :
-	renderer(renderer), canvas(canvas), rendering(false),
-	samplingMethod(SINGLESAMPLING), numSamples(3)
+RendererWorker::RendererWorker(Raytracer* renderer, Framebuffer* canvas,
+	AccumulationBuffer* accumulation) :
+	renderer(renderer), canvas(canvas), accumulation(accumulation), gbuffer(NULL),
+	rendering(false), timeBudget(0), budgetedRenderer(renderer, accumulation),
+	checkpointInterval(0)
 {
 }
 
-void RendererWorker::setSamplingMethod(SamplingMethod newMethod)
+void RendererWorker::setCheckpoint(const std::string& filename, const std::string& sceneKey,
+	double interval)
 {
-	samplingMethod = newMethod;
+	checkpointFilename = filename;
+	checkpointSceneKey = sceneKey;
+	checkpointInterval = interval;
 }
 
-void RendererWorker::setNumSamples(unsigned int newNumSamples)
+void RendererWorker::setGBuffer(GBuffer* newGBuffer)
 {
-	numSamples = newNumSamples;
+	gbuffer = newGBuffer;
+	budgetedRenderer.setGBuffer(newGBuffer);
 }
 
-SamplingMethod RendererWorker::getSamplingMethod() const
+void RendererWorker::setTimeBudget(double seconds)
 {
-	return samplingMethod;
+	timeBudget = seconds;
 }
 
-unsigned int RendererWorker::getNumSamples() const
+const BudgetReport& RendererWorker::getBudgetReport() const
 {
-	return numSamples;
+	return budgetReport;
 }
 
 void RendererWorker::render()
 {
+	tracing::setThreadName("render worker");
+	tracing::ScopedEvent event("render");
 	rendering = true;
-
-    // Loop over the pixels of the image
-    unsigned int canvasWidth = canvas->getWidth();
-    unsigned int canvasHeight = canvas->getHeight();
-    Colour resultantColour;
-
-	// By defualt, render single sampled pixels
-	PixelRenderingMethod renderingMethod = &RendererWorker::renderSinglesamplePixel;
-	// Pick rendering method to use based on chosen sampling method
-	switch (samplingMethod)
+	if (timeBudget > 0)
 	{
-    case SINGLESAMPLING:
-        // do nothing
-        break;
-	case UNIFORM_MULTISAMPLING:
-		renderingMethod = &RendererWorker::renderUniformMultisamplePixel;
-		break;
-	case RANDOM_MULTISAMPLING:
-		renderingMethod = &RendererWorker::renderUniformMultisamplePixel;
-		break;
+		renderBudgeted();
+		return;
 	}
+	double lastCheckpoint = common::wallClockSeconds();
+
+    // Loop over the pixels of the image
+    unsigned int canvasWidth = accumulation->getWidth();
+    unsigned int canvasHeight = accumulation->getHeight();
 
-	// Render using the chosen pixel rendering method
+	// Take every sample each pixel still needs
 	for (unsigned int j = 0; (j < canvasHeight); j++)
 	{
+		tracing::ScopedEvent rowEvent("row", 0, j);
 		for (unsigned int i = 0; (i < canvasWidth); i++)
         {
-        	// If rendering has stopped, emit a finished signal and return from function
+        	// If rendering has stopped, save progress, emit a finished signal and return from function
         	if (!rendering)
         	{
+        		saveCheckpoint();
         		emit finished();
         		return;
         	}
 
-        	Colour resultantColour;
-        	bool hit = ((*this).*renderingMethod)(i, j, canvasWidth, canvasHeight, resultantColour);
-            if (hit)
-                canvas->set(i, j, resultantColour);
-            else
-                canvas->set(i, j, BACKGROUND_COLOUR);
+        	if (accumulation->samplesNeeded(i, j) == 0)
+        		continue;
+        	accumulateTile(renderer, accumulation, Tile(i, j, 1, 1), gbuffer);
+        	canvas->set(i, j, accumulation->resolve(i, j));
         }
+        canvas->rowsFinished(j, 1);
         emit finishedRow(j);
+
+        if (!checkpointFilename.empty() &&
+        	common::wallClockSeconds() - lastCheckpoint >= checkpointInterval)
+        {
+        	saveCheckpoint();
+        	lastCheckpoint = common::wallClockSeconds();
+        }
     }
 
+	saveCheckpoint();
 	emit finished();
 }
 
-void RendererWorker::stop()
-{
-	rendering = false;
-}
-
-bool RendererWorker::renderSinglesamplePixel(int i, int j,
-	unsigned int canvasWidth, unsigned int canvasHeight, Colour& result)
+void RendererWorker::renderBudgeted()
 {
-    // Convert pixel coordinates (i, j) to viewing plane coordinates (x, y)
-    // Note that this gets the pixel CENTRE due to 0.5f
-    float x = (static_cast<float>(i) + 0.5f) / canvasWidth; // a
-    float y = (static_cast<float>(j) + 0.5f) / canvasHeight; // b
-    return renderer->raytrace(x, y, result);
+	// Clear the last render's stop before checking whether this one has
+	// been stopped, so a stop() in between is never lost
+	budgetedRenderer.resume();
+	// Every tile is improved on each pass, so draw the whole canvas
+	int canvasHeight = accumulation->getHeight();
+	emit finishedRow(canvasHeight - 1);
+	if (rendering && !budgetedRenderer.render(timeBudget, canvas, budgetReport))
+		emit error(QString("Rendering with a time budget needs random multisampling"));
+	canvas->rowsFinished(0, canvasHeight);
+
+	saveCheckpoint();
+	emit finished();
 }
 
-bool RendererWorker::renderUniformMultisamplePixel(int i, int j,
-	unsigned int canvasWidth, unsigned int canvasHeight, Colour& result)
+void RendererWorker::stop()
 {
-	// Define RANGE the uniformly sampled pixels will be in
-    float minX = static_cast<float>(i) / canvasWidth;
-    float minY = static_cast<float>(j) / canvasHeight;
-    float maxX = static_cast<float>(i + 1) / canvasWidth;
-    float maxY = static_cast<float>(j + 1) / canvasHeight;
-    return renderer->uniformMultisample(minX, minY, maxX, maxY, numSamples, result);
+	rendering = false;
+	budgetedRenderer.stop();
 }
 
-bool RendererWorker::renderRandomMultisamplePixel(int i, int j,
-	unsigned int canvasWidth, unsigned int canvasHeight, Colour& result)
+void RendererWorker::saveCheckpoint()
 {
-    float minX = static_cast<float>(i) / canvasWidth;
-    float minY = static_cast<float>(j) / canvasHeight;
-    float maxX = static_cast<float>(i + 1) / canvasWidth;
-    float maxY = static_cast<float>(j + 1) / canvasHeight;
-    return renderer->randomMultisample(minX, minY, maxX, maxY, numSamples, result);
+	if (!checkpointFilename.empty() && !accumulation->save(checkpointFilename, checkpointSceneKey))
+		emit error(QString::fromStdString("Could not save checkpoint to " + checkpointFilename));
 }